@@ -69,6 +69,8 @@
 #define CLIENT_STATS_MODE_CODE   456987
 #define CLIENT_INFO_MODE_CODE   113366
 #define CLIENT_RELOAD_MODE_CODE   115599
+#define CLIENT_SUBSCRIBE_MODE_CODE   224466
+#define CLIENT_DELTA_SUBSCRIBE_MODE_CODE   335577
 
 #define FORMAT_MENU   "\x1b[36m"
 #define FORMAT_RESET   "\x1b[0m"
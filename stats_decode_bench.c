@@ -0,0 +1,268 @@
+/**
+ * \file stats_decode_bench.c
+ * \brief Microbenchmark of decoders of module stats received in JSON (jansson tree vs. in place parser).
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+
+#include "supervisor.h"
+#include "internal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <libtrap/trap.h>
+
+#define BENCH_DEFAULT_ITERATIONS 100000
+#define BENCH_DEFAULT_IN_IFCES 2
+#define BENCH_DEFAULT_OUT_IFCES 4
+
+extern running_module_t *running_modules;
+extern unsigned int running_modules_array_size;
+extern unsigned int loaded_modules_cnt;
+
+/**
+ * Reads an integer member of a jansson object.
+ */
+static int bench_get_int(json_t *obj, const char *key, json_int_t *value)
+{
+   json_t *item = json_object_get(obj, key);
+
+   if (item == NULL || json_is_integer(item) == 0) {
+      return -1;
+   }
+   *value = json_integer_value(item);
+   return 0;
+}
+
+/**
+ * Reference decoder building a jansson tree of the whole reply, the way service_decode_module_stats()
+ * decoded the stats before the in place parser.
+ */
+static int bench_decode_jansson(const char *data, int module_idx)
+{
+   json_error_t error;
+   json_t *root = NULL, *arr = NULL, *ifc = NULL;
+   json_int_t in_cnt = 0, out_cnt = 0, value = 0;
+   size_t idx = 0;
+   const char *str = NULL;
+   running_module_t *module = &running_modules[module_idx];
+
+   root = json_loads(data, 0, &error);
+   if (root == NULL || json_is_object(root) == 0) {
+      goto error;
+   }
+   if (bench_get_int(root, "in_cnt", &in_cnt) == -1 || bench_get_int(root, "out_cnt", &out_cnt) == -1) {
+      goto error;
+   }
+   if (service_set_ifces_cnt(module_idx, in_cnt, out_cnt) == -1) {
+      goto error;
+   }
+
+   arr = json_object_get(root, "in");
+   if (module->total_in_ifces_cnt > 0 && json_is_array(arr) == 0) {
+      goto error;
+   }
+   json_array_foreach(arr, idx, ifc) {
+      if (idx >= module->total_in_ifces_cnt) {
+         break;
+      }
+      if (bench_get_int(ifc, "messages", &value) == -1) {
+         goto error;
+      }
+      module->in_ifces_data[idx].recv_msg_cnt = value;
+      if (bench_get_int(ifc, "buffers", &value) == -1) {
+         goto error;
+      }
+      module->in_ifces_data[idx].recv_buffer_cnt = value;
+      if (bench_get_int(ifc, "ifc_type", &value) == -1) {
+         goto error;
+      }
+      module->in_ifces_data[idx].ifc_type = (char) value;
+      if (bench_get_int(ifc, "ifc_state", &value) == -1) {
+         goto error;
+      }
+      module->in_ifces_data[idx].ifc_state = (uint8_t) value;
+      str = json_string_value(json_object_get(ifc, "ifc_id"));
+      if (str == NULL || service_update_ifc_id(&module->in_ifces_data[idx].ifc_id, str, strlen(str)) == -1) {
+         goto error;
+      }
+   }
+
+   arr = json_object_get(root, "out");
+   if (module->total_out_ifces_cnt > 0 && json_is_array(arr) == 0) {
+      goto error;
+   }
+   json_array_foreach(arr, idx, ifc) {
+      if (idx >= module->total_out_ifces_cnt) {
+         break;
+      }
+      if (bench_get_int(ifc, "sent-messages", &value) == -1) {
+         goto error;
+      }
+      module->out_ifces_data[idx].sent_msg_cnt = value;
+      if (bench_get_int(ifc, "dropped-messages", &value) == -1) {
+         goto error;
+      }
+      module->out_ifces_data[idx].dropped_msg_cnt = value;
+      if (bench_get_int(ifc, "buffers", &value) == -1) {
+         goto error;
+      }
+      module->out_ifces_data[idx].sent_buffer_cnt = value;
+      if (bench_get_int(ifc, "autoflushes", &value) == -1) {
+         goto error;
+      }
+      module->out_ifces_data[idx].autoflush_cnt = value;
+      if (bench_get_int(ifc, "num_clients", &value) == -1) {
+         goto error;
+      }
+      module->out_ifces_data[idx].num_clients = (int32_t) value;
+      if (bench_get_int(ifc, "ifc_type", &value) == -1) {
+         goto error;
+      }
+      module->out_ifces_data[idx].ifc_type = (char) value;
+      str = json_string_value(json_object_get(ifc, "ifc_id"));
+      if (str == NULL || service_update_ifc_id(&module->out_ifces_data[idx].ifc_id, str, strlen(str)) == -1) {
+         goto error;
+      }
+   }
+
+   json_decref(root);
+   return 0;
+
+error:
+   if (root != NULL) {
+      json_decref(root);
+   }
+   return -1;
+}
+
+/**
+ * Creates stats of a module with the given number of interfaces in the format libtrap sends them.
+ */
+static char *bench_make_stats(unsigned int in_ifces, unsigned int out_ifces)
+{
+   size_t size = 128 + (size_t) (in_ifces + out_ifces) * 256, len = 0;
+   char *data = (char *) malloc(size);
+   unsigned int x = 0;
+
+   if (data == NULL) {
+      return NULL;
+   }
+   len += snprintf(data + len, size - len, "{\"in_cnt\": %u, \"out_cnt\": %u, \"in\": [", in_ifces, out_ifces);
+   for (x = 0; x < in_ifces; x++) {
+      len += snprintf(data + len, size - len, "%s{\"messages\": %u, \"buffers\": %u, \"ifc_type\": %d, \"ifc_state\": 1, \"ifc_id\": \"in_%u\"}",
+                      (x > 0 ? ", " : ""), 123456789 + x, 1234567 + x, 't', x);
+   }
+   len += snprintf(data + len, size - len, "], \"out\": [");
+   for (x = 0; x < out_ifces; x++) {
+      len += snprintf(data + len, size - len, "%s{\"sent-messages\": %u, \"dropped-messages\": %u, \"buffers\": %u, \"autoflushes\": %u, \"num_clients\": 2, \"ifc_type\": %d, \"ifc_id\": \"76%02u\"}",
+                      (x > 0 ? ", " : ""), 987654321 + x, 1234 + x, 7654321 + x, 42 + x, 'u', x);
+   }
+   snprintf(data + len, size - len, "]}");
+   return data;
+}
+
+/**
+ * Usage: stats_decode_bench [iterations [input_ifces [output_ifces]]]
+ *
+ * Both decoders get a fresh copy of the same reply in every iteration (the in place parser modifies it),
+ * so the copy is included in the time of both of them.
+ */
+int main(int argc, char **argv)
+{
+   unsigned long iterations = BENCH_DEFAULT_ITERATIONS, x = 0;
+   unsigned int in_ifces = BENCH_DEFAULT_IN_IFCES, out_ifces = BENCH_DEFAULT_OUT_IFCES;
+   uint64_t start = 0, jansson_time = 0, in_place_time = 0;
+   char *stats = NULL, *buffer = NULL;
+   size_t stats_len = 0;
+
+   if (argc > 1) {
+      iterations = strtoul(argv[1], NULL, 10);
+   }
+   if (argc > 2) {
+      in_ifces = strtoul(argv[2], NULL, 10);
+   }
+   if (argc > 3) {
+      out_ifces = strtoul(argv[3], NULL, 10);
+   }
+
+   running_modules = (running_module_t *) calloc(1, sizeof(running_module_t));
+   stats = bench_make_stats(in_ifces, out_ifces);
+   if (running_modules == NULL || stats == NULL) {
+      fprintf(stderr, "[ERROR] Could not allocate memory.\n");
+      return EXIT_FAILURE;
+   }
+   running_modules_array_size = 1;
+   loaded_modules_cnt = 1;
+   running_modules[0].module_name = strdup("bench");
+   stats_len = strlen(stats) + 1;
+   buffer = (char *) malloc(stats_len);
+   if (buffer == NULL) {
+      fprintf(stderr, "[ERROR] Could not allocate memory.\n");
+      return EXIT_FAILURE;
+   }
+
+   start = get_monotonic_time_ms();
+   for (x = 0; x < iterations; x++) {
+      memcpy(buffer, stats, stats_len);
+      if (bench_decode_jansson(buffer, 0) == -1) {
+         fprintf(stderr, "[ERROR] jansson decoder failed.\n");
+         return EXIT_FAILURE;
+      }
+   }
+   jansson_time = get_monotonic_time_ms() - start;
+
+   start = get_monotonic_time_ms();
+   for (x = 0; x < iterations; x++) {
+      memcpy(buffer, stats, stats_len);
+      if (service_decode_module_stats(&buffer, 0) == -1) {
+         fprintf(stderr, "[ERROR] In place decoder failed.\n");
+         return EXIT_FAILURE;
+      }
+   }
+   in_place_time = get_monotonic_time_ms() - start;
+
+   printf("Stats of %u input and %u output interfaces (%zu bytes), %lu iterations:\n", in_ifces, out_ifces, stats_len - 1, iterations);
+   printf("   jansson tree: %8" PRIu64 " ms  %10.1f ns/reply\n", jansson_time, (double) jansson_time * 1000000 / (iterations > 0 ? iterations : 1));
+   printf("   in place:     %8" PRIu64 " ms  %10.1f ns/reply\n", in_place_time, (double) in_place_time * 1000000 / (iterations > 0 ? iterations : 1));
+
+   free(buffer);
+   free(stats);
+   return EXIT_SUCCESS;
+}
@@ -58,15 +58,58 @@
 #include <pthread.h>
 #include <semaphore.h>
 #include <sys/ioctl.h>
+#include <stdarg.h>
 #include <net/if.h>
 #include <ifaddrs.h>
+#include <sys/epoll.h>
+#include <poll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <stdatomic.h>
+#include <endian.h>
+#include <dirent.h>
+#include <ctype.h>
 
 #include <libtrap/trap.h>
 
 #define TRAP_PARAM   "-i" ///< Interface parameter for libtrap
-#define DEFAULT_MODULE_RESTARTS_NUM   3  ///< Default number of module restarts per minute
-#define MAX_MODULE_RESTARTS_NUM  30  ///< Maximum number of module restarts per minute (loaded from configuration file)
+#define DEFAULT_MODULE_RESTARTS_NUM   3  ///< Default number of consecutive module restarts
+#define MAX_MODULE_RESTARTS_NUM  30  ///< Maximum number of consecutive module restarts (loaded from configuration file), this value means unlimited restarts
+#define RESTART_BACKOFF_MIN_MS   500  ///< Delay of the first restart of an exited module, it is doubled with every next consecutive exit
+#define DEFAULT_RESTART_BACKOFF_MAX_MS   60000  ///< Default maximal delay between restarts of a crashing module
+#define MAX_RESTART_BACKOFF_MAX_MS   3600000  ///< Maximal value of restart-backoff-max element
+#define DEFAULT_RESTART_COOLDOWN_SEC   600  ///< Default time after which a module that reached its restarts limit is started again
+#define MAX_RESTART_COOLDOWN_SEC   86400  ///< Maximal value of restart-cooldown element
+#define RESTART_STABLE_RUN_MS   60000  ///< Exit of a module running at least this long does not count as a consecutive failure
 #define MAX_SERVICE_IFC_CONN_FAILS   3
+#define DEFAULT_STATS_INTERVAL_MS   2000  ///< Default interval of requesting statistics from modules (the former service thread period)
+#define MIN_STATS_INTERVAL_MS   100  ///< Minimal interval of requesting statistics from modules (loaded from configuration file)
+#define MAX_STATS_INTERVAL_MS   3600000  ///< Maximal interval of requesting statistics from modules (loaded from configuration file)
+#define STATS_INTERVAL_ADAPTIVE   0  ///< Value of stats interval meaning the interval is adapted to the traffic of the module
+#define ADAPTIVE_STATS_MIN_INTERVAL_MS   500  ///< The shortest interval used for busy modules in adaptive mode
+#define ADAPTIVE_STATS_MAX_INTERVAL_MS   30000  ///< The longest interval used for idle modules in adaptive mode
+#define ADAPTIVE_STATS_BUSY_RATE   1000  ///< Number of messages per second (received and sent) since which the module is sampled more often in adaptive mode
+#define PROC_BUFFER_SIZE   1024  ///< Size of buffer for reading /proc/stat, /proc/PID/stat and /proc/PID/statm
+#define PROC_STATUS_BUFFER_SIZE   4096  ///< Size of buffer for reading /proc/PID/task/TID/status and /proc/PID/io
+#define MODULE_THREADS_STATS_MAX   64  ///< Maximal number of threads of one module with monitored resources usage
+#define PROC_THREADS_OPEN_FDS_MAX   256  ///< Maximal number of descriptors of /proc/PID/task/TID files kept opened (all modules together)
+#define CGROUP_MOUNT_POINT   "/sys/fs/cgroup"  ///< Mount point of the cgroup v2 hierarchy
+#define CGROUP_SUBTREE_NAME   "nemea-supervisor"  ///< Name of the subtree created if supervisor runs in the root cgroup
+#define CGROUP_CPU_PERIOD_USEC   100000  ///< Period of cpu.max, cpu-max in percent of one CPU is converted to quota of this period
+#define MAX_CPU_MAX_PERCENT   100000  ///< Maximal value of cpu-max element (percent of one CPU)
+#define LAUNCHER_STACK_SIZE   (64 * 1024)  ///< Size of the stack used by the module process until execve()
+#define LAUNCHER_SHELL   "/bin/sh"  ///< Shell executing module binaries which are not in an executable format (scripts without "#!")
+#define LISTEN_FDS_START   3  ///< First descriptor of listening sockets inherited by the module (SD_LISTEN_FDS_START of systemd)
+#define NUMA_SYSFS_PATH   "/sys/devices/system/node"  ///< Directory with online NUMA nodes and their CPUs in sysfs
+#define MAX_NUMA_NODES   64  ///< Maximal number of NUMA nodes modules are placed on (bits of the node mask passed to set_mempolicy)
+#define NUMA_NODE_AUTO   -2  ///< Value of numa-node element meaning the node is chosen by supervisor
+
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED   1  ///< Memory policy preferring the given node (from linux/mempolicy.h)
+#endif
 
 #define DEFAULT_DAEMON_SERVER_SOCKET   DEFAULT_PATH_TO_SOCKET  ///<  Daemon server socket
 #define DEFAULT_NETCONF_SERVER_SOCKET   "/tmp/netconf_supervisor.sock"  ///<  Netconf server socket
@@ -81,30 +124,95 @@
 #define MODULES_LOGS_DIR_NAME   "modules_logs"
 
 #define RET_ERROR   -1
-#define MAX_NUMBER_SUP_CLIENTS   5
+#define MAX_NUMBER_SUP_CLIENTS   1024  ///< Maximal number of connected supervisor clients
+#define DAEMON_MAX_EVENTS   64  ///< Maximal number of events returned by one epoll_wait() call of the server thread
+#define DAEMON_SERVER_WAIT_TIMEOUT_MS   500  ///< Time in ms the server thread waits for events before it checks termination and timeouts of clients
+#define DAEMON_ACCEPT_RETRY_MS   5000  ///< Time in ms after which accepting of clients paused for lack of file descriptors is retried
+#define DAEMON_CLIENT_TIMEOUT_MS   2000  ///< Time in ms a client has to send its mode code (or to receive another part of the reply)
+#define DAEMON_KEYFRAME_INTERVAL   30  ///< Every n-th record sent to a client in delta subscribe mode contains all stats
+#define METRICS_BUFFER_START_SIZE   16384  ///< Initial size of buffer for rendered metrics
+
+/* States of clients served by the server thread. */
+#define DAEMON_CLIENT_READING_CODE   0
+#define DAEMON_CLIENT_SENDING_REPLY   1
+#define DAEMON_CLIENT_CONFIG_MODE   2  ///< Client is served by its own thread
+#define DAEMON_CLIENT_SUBSCRIBED   3  ///< Client receives a record with stats after every period of service thread
+#define DAEMON_CLIENT_READING_HTTP   4  ///< Client of metrics exporter is sending HTTP request
 #define NUM_SERVICE_IFC_PERIODS   30
 
 /* Values for non-blocking sending and receiving service data. */
-#define SERVICE_WAIT_BEFORE_TIMEOUT 25000  ///< Timeout after EAGAIN or EWOULDBLOCK errno returned from service send() and recv().
-#define SERVICE_WAIT_MAX_TRY 8  ///< A maximal count of repeated timeouts per each service recv() and send() function call. 
+#define SERVICE_WAIT_BEFORE_TIMEOUT 25000  ///< Time in micro seconds the service thread waits after an unexpected error of epoll_wait().
+#define SERVICE_REPLY_TIMEOUT_MS 200  ///< Time in milliseconds to receive the whole reply from module service interface (other modules are served meanwhile).
 
 #define SERVICE_GET_COM 10
 #define SERVICE_SET_COM 11
 #define SERVICE_OK_REPLY 12
+#define SERVICE_GET_BIN_COM 13  ///< Request of stats encoded in binary format.
+#define SERVICE_OK_BIN_REPLY 14  ///< Reply with stats encoded in binary format.
+
+/* Format of stats negotiated with a module (modules with older libtrap reply only in JSON). */
+#define SERVICE_STATS_FORMAT_UNKNOWN 0  ///< Binary stats are requested, the module has not replied yet.
+#define SERVICE_STATS_FORMAT_JSON 1
+#define SERVICE_STATS_FORMAT_BIN 2
+#define SERVICE_BIN_STATS_MAX_UNANSWERED 3  ///< Binary stats are not requested after this number of connections without the reply.
+
+/*
+ * Binary stats (data of SERVICE_OK_BIN_REPLY message), all numbers are little-endian:
+ *    header:        uint8 version, 3B reserved, uint32 in_cnt, uint32 out_cnt
+ *    in_cnt times:  uint8 flags, uint8 ifc_state, int8 ifc_type, 1B reserved, uint64 recv_msg_cnt, uint64 recv_buffer_cnt
+ *    out_cnt times: uint8 flags, int8 ifc_type, 2B reserved, int32 num_clients, uint64 sent_msg_cnt,
+ *                   uint64 dropped_msg_cnt, uint64 sent_buffer_cnt, uint64 autoflush_cnt
+ * If SERVICE_BIN_STATS_IFC_ID_FLAG is set in flags of an interface, its counters are followed by
+ * uint16 length and the ifc_id string (without terminating zero). The module sends ifc_id in the first
+ * reply on the connection, after a change of the number of interfaces and when the ifc_id changes.
+ */
+#define SERVICE_BIN_STATS_VERSION 1
+#define SERVICE_BIN_STATS_HDR_SIZE 12
+#define SERVICE_BIN_STATS_IN_IFC_SIZE 20
+#define SERVICE_BIN_STATS_OUT_IFC_SIZE 40
+#define SERVICE_BIN_STATS_IFC_ID_FLAG 0x01
+
+/* Types of counters decoded from JSON stats (see stats_json_field_t) */
+#define STATS_JSON_UINT64 0
+#define STATS_JSON_INT32 1
+#define STATS_JSON_UINT8 2
+#define STATS_JSON_CHAR 3
+#define STATS_JSON_STRING 4
+#define STATS_JSON_MAX_DEPTH 16  ///< Maximal nesting of skipped unknown JSON values.
+
+/*
+ * Length of the service thread period in micro seconds.
+ * (the period means all tasks service thread has to complete - restart modules, receive their statistics etc.)
+ * The period is driven by a timerfd, modules are stopped and started between the periods as soon as
+ * the service thread is woken up by an event (module exit, user request, service interface hang-up).
+ * The value keeps the original cadence (0.5 s + 1.5 s) so the counter based on NUM_SERVICE_IFC_PERIODS
+ * (reconnection attempts) keeps its meaning.
+ */
+#define SERVICE_THREAD_PERIOD_IN_MICSEC 2000000
+
+#define SERVICE_MAX_EPOLL_EVENTS 64  ///< Maximal number of events returned by one epoll_wait() call in service thread.
 
 /*
- * Time in micro seconds the service thread spends sleeping after each period.
- * (the period means all tasks service thread has to complete - restart and stop modules according to their enable flag,
- * receive their statistics etc.)
+ * Started module is ready when supervisor connects to its service interface. Until then (at most
+ * STARTUP_READY_TIMEOUT_MS), modules consuming its output interfaces are not started and the service
+ * thread tries to connect every STARTUP_PROBE_INTERVAL_MS.
  */
-#define SERVICE_THREAD_SLEEP_IN_MICSEC 1500000
+#define STARTUP_PROBE_INTERVAL_MS 20
+#define STARTUP_READY_TIMEOUT_MS 3000
 
 /*
- * Time in micro seconds between sending SIGINT and SIGKILL to running modules.
- * Service thread sends SIGINT to stop running module, after time defined by this constant it checks modules status
- * and if the module is still running service thread sends SIGKILL to stop it.
+ * Time in milliseconds between sending SIGINT and SIGKILL to running modules (unless the module has its "stop-timeout").
+ * Service thread sends SIGINT to stop running module and sets a deadline defined by this constant. The service thread
+ * is woken up when the module exits or when the deadline expires and if the module is still running, it sends SIGKILL to stop it.
  */
-#define SERVICE_WAIT_FOR_MODULES_TO_FINISH 500000
+#define DEFAULT_STOP_TIMEOUT_MS 500
+#define MAX_STOP_TIMEOUT_MS 3600000  ///< Maximal value of stop-timeout element of a module
+
+#define NAME_INDEX_MIN_SIZE 64  ///< Initial number of items of name and PID indexes (power of 2)
+
+#define MODULE_STOP_NONE   0  ///< Module is not being stopped
+#define MODULE_STOP_SIGINT_SENT   1  ///< SIGINT was sent, the module drains until module_sigkill_deadline
+#define MODULE_STOP_SIGKILL_SENT   2  ///< SIGKILL was sent, supervisor waits for the exit of the module
 
 #define TIME_BUFFER_SIZE 26
 
@@ -126,6 +234,7 @@ char *gener_config_file = NULL;
 char *config_files_path = NULL;
 char *socket_path = NULL;
 char *logs_path = NULL;
+char *metrics_address = NULL; ///< Address of metrics exporter (--metrics), NULL ~ disabled
 
 /* Sup flags */
 int supervisor_initialized = FALSE;
@@ -138,11 +247,44 @@ int service_stop_all_modules = FALSE;
 
 
 unsigned long int last_total_cpu = 0; // Variable with total cpu usage of whole operating system
+int proc_stat_fd = -1; ///< Descriptor of /proc/stat kept opened between the samples.
+long proc_page_size_kb = 0; ///< Size of memory page in kB (for /proc/PID/statm).
+long proc_cpus_cnt = 0; ///< Number of online CPUs (CPU usage of a thread is related to one CPU).
+unsigned int proc_threads_open_fds = 0; ///< Number of descriptors of threads files currently opened (see PROC_THREADS_OPEN_FDS_MAX).
+dataflow_edge_t *dataflow_edges = NULL; ///< Edges producer -> consumer of dataflow graph of loaded modules.
+uint32_t dataflow_edges_cnt = 0; ///< Number of edges in dataflow_edges.
+uint32_t dataflow_max_wave = 0; ///< The last startup wave of loaded modules.
+unsigned int dataflow_graph_generation = UINT_MAX; ///< Value of modules_config_generation the graph was built for (UINT_MAX ~ never built).
+char *launcher_stack = NULL; ///< Stack of the module process between clone() and execve() (the process shares memory with supervisor).
+char *cgroup_modules_path = NULL; ///< Directory in cgroup v2 hierarchy with cgroups of modules (NULL if cgroups are not used).
+int numa_nodes_cnt = -1; ///< Number of online NUMA nodes (-1 ~ not detected yet, 0 ~ NUMA placement is not available).
+cpu_set_t numa_online_nodes; ///< Set of online NUMA nodes (bit N ~ node N), valid if numa_nodes_cnt > 0.
 pthread_mutex_t running_modules_lock; ///< mutex for locking counters
+name_index_t module_name_index; ///< Index of loaded modules by name (see find_loaded_module()).
+pid_index_t module_pid_index; ///< Index of loaded modules by PID of their processes (see find_module_by_pid()).
+uint64_t last_module_handle = 0; ///< Handle of the last inserted module (handles are never reused, see registry_assign_handle()).
+pthread_mutex_t reload_lock = PTHREAD_MUTEX_INITIALIZER; ///< Serializes reloads of the configuration, running_modules_lock is taken only to apply the new configuration.
+unsigned int modules_config_generation = 0; ///< Incremented whenever indexes of loaded modules or profiles can change (reload, removal of a module).
+
+/* Snapshot of modules state published by service thread for readers (daemon clients, netconf, statistics log) */
+_Atomic(modules_snapshot_t *) modules_snapshot = NULL; ///< The latest published snapshot.
+atomic_uint modules_snapshot_epoch = 0; ///< Incremented after every publication of a snapshot.
+atomic_uint modules_snapshot_readers[2]; ///< Number of active readers per parity of the epoch they entered in.
+modules_snapshot_t *modules_snapshot_retired = NULL; ///< Replaced snapshot waiting until its readers finish (used only by service thread).
+unsigned int modules_snapshot_retired_parity = 0; ///< Parity of readers which can still use the retired snapshot.
+uint64_t modules_snapshot_version = 0; ///< Version of the last created snapshot.
 int module_restarts_num_config = DEFAULT_MODULE_RESTARTS_NUM;
+int restart_backoff_max_config = DEFAULT_RESTART_BACKOFF_MAX_MS; ///< Maximal delay between restarts of a crashing module in ms loaded from "supervisor" element.
+int restart_cooldown_config = DEFAULT_RESTART_COOLDOWN_SEC; ///< Time in seconds after which a module that reached its restarts limit is started again (0 ~ the module is disabled).
+int stats_interval_config = DEFAULT_STATS_INTERVAL_MS; ///< Global stats interval in ms (or STATS_INTERVAL_ADAPTIVE) loaded from "supervisor" element.
 
 
 pthread_t service_thread_id; ///< Service thread identificator.
+int service_epoll_fd = -1; ///< Epoll instance the service thread is waiting on.
+int service_timer_fd = -1; ///< Timerfd expiring at the end of every service thread period.
+int service_event_fd = -1; ///< Eventfd used to wake up the service thread (see service_wakeup()).
+int service_signal_fd = -1; ///< Signalfd receiving SIGCHLD when a module exits.
+int service_pidfd_supported = TRUE; ///< FALSE if the kernel does not support pidfd_open(), module exits are tracked via SIGCHLD and kill -0 then.
 pthread_t netconf_server_thread_id;
 
 time_t sup_init_time = 0;
@@ -274,6 +416,123 @@ char *get_formatted_time()
    return formatted_time_buffer;
 }
 
+uint64_t get_monotonic_time_ms()
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ((uint64_t) ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
+
+int parse_stats_interval(const char *value, int *interval)
+{
+   int number = 0;
+
+   if (strcmp(value, "adaptive") == 0) {
+      *interval = STATS_INTERVAL_ADAPTIVE;
+      return 0;
+   }
+   if ((sscanf(value, "%d", &number) != 1) || (number < MIN_STATS_INTERVAL_MS) || (number > MAX_STATS_INTERVAL_MS)) {
+      return -1;
+   }
+   *interval = number;
+   return 0;
+}
+
+int parse_memory_size(const char *value, uint64_t *size)
+{
+   unsigned long long number = 0;
+   char *endptr = NULL;
+
+   if (strcmp(value, "max") == 0) {
+      *size = 0;
+      return 0;
+   }
+   errno = 0;
+   number = strtoull(value, &endptr, 10);
+   if (endptr == value || errno == ERANGE || number == 0) {
+      return -1;
+   }
+   switch (*endptr) {
+   case 'K': case 'k': number <<= 10; endptr++; break;
+   case 'M': case 'm': number <<= 20; endptr++; break;
+   case 'G': case 'g': number <<= 30; endptr++; break;
+   }
+   if (*endptr != 0) {
+      return -1;
+   }
+   *size = number;
+   return 0;
+}
+
+int parse_cpu_max(const char *value, int *percent)
+{
+   int number = 0;
+
+   if (strcmp(value, "max") == 0) {
+      *percent = 0;
+      return 0;
+   }
+   if ((sscanf(value, "%d", &number) != 1) || (number < 1) || (number > MAX_CPU_MAX_PERCENT)) {
+      return -1;
+   }
+   *percent = number;
+   return 0;
+}
+
+int parse_cpu_list(const char *value, cpu_set_t *set)
+{
+   unsigned long first = 0, last = 0, x = 0;
+   char *endptr = NULL;
+
+   CPU_ZERO(set);
+   while (*value != 0) {
+      if (!isdigit((unsigned char) *value)) {
+         return -1;
+      }
+      first = strtoul(value, &endptr, 10);
+      last = first;
+      if (*endptr == '-') {
+         value = endptr + 1;
+         if (!isdigit((unsigned char) *value)) {
+            return -1;
+         }
+         last = strtoul(value, &endptr, 10);
+      }
+      if (first > last || last >= CPU_SETSIZE) {
+         return -1;
+      }
+      for (x = first; x <= last; x++) {
+         CPU_SET(x, set);
+      }
+      value = endptr;
+      if (*value == ',') {
+         value++;
+      } else if (*value == '\n') {
+         // Lists read from sysfs end with a new line
+         break;
+      } else if (*value != 0) {
+         return -1;
+      }
+   }
+   return (CPU_COUNT(set) > 0 ? 0 : -1);
+}
+
+int parse_numa_node(const char *value, int *node)
+{
+   int number = 0;
+
+   if (strcmp(value, "auto") == 0) {
+      *node = NUMA_NODE_AUTO;
+      return 0;
+   }
+   if ((sscanf(value, "%d", &number) != 1) || (number < 0) || (number >= MAX_NUMA_NODES)) {
+      return -1;
+   }
+   *node = number;
+   return 0;
+}
+
 char **parse_module_params(const uint32_t module_idx, uint32_t *params_num)
 {
    uint32_t params_arr_size = 5, params_cnt = 0;
@@ -511,17 +770,6 @@ char **prep_module_args(const uint32_t module_idx)
       bin_args_pos++;
    }
 
-   fprintf(stdout,"%s [INFO] Supervisor - executed command: %s", get_formatted_time(), running_modules[module_idx].module_path);
-   fprintf(stderr,"%s [INFO] Supervisor - executed command: %s", get_formatted_time(), running_modules[module_idx].module_path);
-
-   for (x = 1; x < bin_args_num; x++) {
-      fprintf(stdout,"   %s",bin_args[x]);
-      fprintf(stderr,"   %s",bin_args[x]);
-   }
-
-   fprintf(stdout,"\n");
-   fprintf(stderr,"\n");
-
    NULLP_TEST_AND_FREE(ifc_spec)
    return bin_args;
 }
@@ -677,7 +925,7 @@ void init_module_variables(int module_number)
    running_modules[module_number].module_running = TRUE;
 
    // Initialize modules variables
-   running_modules[module_number].sent_sigint = FALSE;
+   running_modules[module_number].module_stop_state = MODULE_STOP_NONE;
    running_modules[module_number].virtual_memory_size = 0;
    running_modules[module_number].resident_set_size = 0;
    running_modules[module_number].last_period_cpu_usage_kernel_mode = 0;
@@ -749,12 +997,11 @@ void print_statistics_legend()
 }
 
 
-char *make_json_modules_info(uint8_t info_mask)
+json_t *make_json_modules_object(uint8_t info_mask, uint64_t *version)
 {
    uint x = 0, y = 0;
    char ifc_type[2];
    ifc_type[1] = 0;
-   char *result_data = NULL;
 
    json_t *module_info = NULL;
    json_t *module = NULL;
@@ -762,16 +1009,31 @@ char *make_json_modules_info(uint8_t info_mask)
    json_t *in_ifc_arr = NULL;
    json_t *out_ifc_arr = NULL;
    json_t *modules_obj = NULL;
+   json_t *threads_arr = NULL;
+   json_t *thread_info = NULL;
+   module_thread_stats_t *thread = NULL;
 
    uint8_t print_details = FALSE;
 
+   // Modules state is read from the snapshot published by service thread without any lock
+   unsigned int reader_parity = 0;
+   modules_snapshot_t *snapshot = modules_snapshot_acquire(&reader_parity);
+   if (snapshot == NULL) {
+      modules_snapshot_release(reader_parity);
+      return NULL;
+   }
+
+   if (version != NULL) {
+      *version = snapshot->version;
+   }
+
    // Decide which information should be included according to the info mask
    if ((info_mask & (uint8_t) 1) == (uint8_t) 1) {
       print_details = TRUE;
    }
 
-   for (x = 0; x < loaded_modules_cnt; x++) {
-      if (print_details == FALSE && running_modules[x].module_status == FALSE) {
+   for (x = 0; x < snapshot->modules_cnt; x++) {
+      if (print_details == FALSE && snapshot->modules[x].module_status == FALSE) {
          continue;
       }
 
@@ -783,67 +1045,106 @@ char *make_json_modules_info(uint8_t info_mask)
       }
 
       // Array of input ifces
-      for (y = 0; y < running_modules[x].total_in_ifces_cnt; y++) {
-         ifc_type[0] = running_modules[x].in_ifces_data[y].ifc_type;
+      for (y = 0; y < snapshot->modules[x].total_in_ifces_cnt; y++) {
+         ifc_type[0] = snapshot->modules[x].in_ifces_data[y].ifc_type;
          ifc_info = json_pack("{sssssisIsI}", "type", ifc_type,
-                                              "ID", running_modules[x].in_ifces_data[y].ifc_id,
-                                              "is-conn", running_modules[x].in_ifces_data[y].ifc_state,
-                                              "messages", running_modules[x].in_ifces_data[y].recv_msg_cnt,
-                                              "buffers", running_modules[x].in_ifces_data[y].recv_buffer_cnt);
+                                              "ID", snapshot->modules[x].in_ifces_data[y].ifc_id,
+                                              "is-conn", snapshot->modules[x].in_ifces_data[y].ifc_state,
+                                              "messages", snapshot->modules[x].in_ifces_data[y].recv_msg_cnt,
+                                              "buffers", snapshot->modules[x].in_ifces_data[y].recv_buffer_cnt);
 
          if (ifc_info == NULL || json_array_append_new(in_ifc_arr, ifc_info) == -1) {
-            VERBOSE(SUP_LOG, "[ERROR] Could not append module input ifc info to JSON array (module \"%s\").\n", running_modules[x].module_name);
+            VERBOSE(SUP_LOG, "[ERROR] Could not append module input ifc info to JSON array (module \"%s\").\n", snapshot->modules[x].module_name);
             goto clean_up;
          }
       }
       // Array of output ifces
-      for (y = 0; y < running_modules[x].total_out_ifces_cnt; y++) {
-         ifc_type[0] = running_modules[x].out_ifces_data[y].ifc_type;
+      for (y = 0; y < snapshot->modules[x].total_out_ifces_cnt; y++) {
+         ifc_type[0] = snapshot->modules[x].out_ifces_data[y].ifc_type;
          ifc_info = json_pack("{sssssisIsIsIsI}", "type", ifc_type,
-                                                  "ID", running_modules[x].out_ifces_data[y].ifc_id,
-                                                  "cli-num", running_modules[x].out_ifces_data[y].num_clients,
-                                                  "sent-msg", running_modules[x].out_ifces_data[y].sent_msg_cnt,
-                                                  "drop-msg", running_modules[x].out_ifces_data[y].dropped_msg_cnt,
-                                                  "buffers", running_modules[x].out_ifces_data[y].sent_buffer_cnt,
-                                                  "autoflush", running_modules[x].out_ifces_data[y].autoflush_cnt);
+                                                  "ID", snapshot->modules[x].out_ifces_data[y].ifc_id,
+                                                  "cli-num", snapshot->modules[x].out_ifces_data[y].num_clients,
+                                                  "sent-msg", snapshot->modules[x].out_ifces_data[y].sent_msg_cnt,
+                                                  "drop-msg", snapshot->modules[x].out_ifces_data[y].dropped_msg_cnt,
+                                                  "buffers", snapshot->modules[x].out_ifces_data[y].sent_buffer_cnt,
+                                                  "autoflush", snapshot->modules[x].out_ifces_data[y].autoflush_cnt);
 
          if (ifc_info == NULL || json_array_append_new(out_ifc_arr, ifc_info) == -1) {
-            VERBOSE(SUP_LOG, "[ERROR] Could not append module output ifc info to JSON array (module \"%s\").\n", running_modules[x].module_name);
+            VERBOSE(SUP_LOG, "[ERROR] Could not append module output ifc info to JSON array (module \"%s\").\n", snapshot->modules[x].module_name);
             goto clean_up;
          }
       }
 
 
       if (print_details == TRUE) {
-         module_info = json_pack("{sisssssssisisIsIsoso}",
-                                 "idx", x,
-                                 "params", (running_modules[x].module_params == NULL ? "none" : running_modules[x].module_params),
-                                 "path", running_modules[x].module_path,
-                                 "status", (running_modules[x].module_status == TRUE ? "running" : "stopped"),
-                                 "CPU-u", running_modules[x].last_period_percent_cpu_usage_user_mode,
-                                 "CPU-s", running_modules[x].last_period_percent_cpu_usage_kernel_mode,
-                                 "MEM-vms", running_modules[x].virtual_memory_size,
-                                 "MEM-rss", running_modules[x].resident_set_size * 1024, // Output RSS in bytes as well as VMS
+         module_info = json_pack("{sisIsssssssisisIsIsoso}",
+                                 "idx", snapshot->modules[x].module_idx,
+                                 "handle", (json_int_t) snapshot->modules[x].module_handle,
+                                 "params", (snapshot->modules[x].module_params == NULL ? "none" : snapshot->modules[x].module_params),
+                                 "path", snapshot->modules[x].module_path,
+                                 "status", (snapshot->modules[x].module_status == TRUE ? "running" : "stopped"),
+                                 "CPU-u", snapshot->modules[x].last_period_percent_cpu_usage_user_mode,
+                                 "CPU-s", snapshot->modules[x].last_period_percent_cpu_usage_kernel_mode,
+                                 "MEM-vms", snapshot->modules[x].virtual_memory_size,
+                                 "MEM-rss", snapshot->modules[x].resident_set_size * 1024, // Output RSS in bytes as well as VMS
                                  "inputs", in_ifc_arr,
                                  "outputs", out_ifc_arr);
       } else {
          module_info = json_pack("{sisisIsIsoso}",
-                                 "CPU-u", running_modules[x].last_period_percent_cpu_usage_user_mode,
-                                 "CPU-s", running_modules[x].last_period_percent_cpu_usage_kernel_mode,
-                                 "MEM-vms", running_modules[x].virtual_memory_size,
-                                 "MEM-rss", running_modules[x].resident_set_size * 1024, // Output RSS in bytes as well as VMS
+                                 "CPU-u", snapshot->modules[x].last_period_percent_cpu_usage_user_mode,
+                                 "CPU-s", snapshot->modules[x].last_period_percent_cpu_usage_kernel_mode,
+                                 "MEM-vms", snapshot->modules[x].virtual_memory_size,
+                                 "MEM-rss", snapshot->modules[x].resident_set_size * 1024, // Output RSS in bytes as well as VMS
                                  "inputs", in_ifc_arr,
                                  "outputs", out_ifc_arr);
       }
 
       if (module_info == NULL) {
-         VERBOSE(SUP_LOG, "[ERROR] Could not create JSON object of a module \"%s\".\n", running_modules[x].module_name);
+         VERBOSE(SUP_LOG, "[ERROR] Could not create JSON object of a module \"%s\".\n", snapshot->modules[x].module_name);
+         goto clean_up;
+      }
+
+      // Resources usage of the whole process and in info mode also of its threads (CPU usage of a thread is related to one CPU)
+      if (json_object_set_new(module_info, "IO-read", json_integer(snapshot->modules[x].read_bytes)) == -1 ||
+          json_object_set_new(module_info, "IO-write", json_integer(snapshot->modules[x].write_bytes)) == -1 ||
+          json_object_set_new(module_info, "majflt", json_integer(snapshot->modules[x].major_faults)) == -1 ||
+          json_object_set_new(module_info, "ctxt-vol", json_integer(snapshot->modules[x].voluntary_ctxt_switches)) == -1 ||
+          json_object_set_new(module_info, "ctxt-invol", json_integer(snapshot->modules[x].nonvoluntary_ctxt_switches)) == -1) {
+         VERBOSE(SUP_LOG, "[ERROR] Could not create JSON object of a module \"%s\".\n", snapshot->modules[x].module_name);
+         json_decref(module_info);
+         goto clean_up;
+      }
+      threads_arr = (print_details == TRUE ? json_array() : NULL);
+      if (print_details == TRUE && threads_arr == NULL) {
+         VERBOSE(SUP_LOG, "[ERROR] Could not create JSON arrays (probably not enough memory).\n");
+         json_decref(module_info);
+         goto clean_up;
+      }
+      for (y = 0; threads_arr != NULL && y < snapshot->modules[x].threads_cnt; y++) {
+         thread = &snapshot->modules[x].threads[y];
+         thread_info = json_pack("{sisssIsIsIsIsI}", "TID", thread->tid,
+                                                     "name", thread->name,
+                                                     "CPU-u", (json_int_t) thread->percent_cpu_usage_user_mode,
+                                                     "CPU-s", (json_int_t) thread->percent_cpu_usage_kernel_mode,
+                                                     "ctxt-vol", (json_int_t) thread->voluntary_ctxt_switches,
+                                                     "ctxt-invol", (json_int_t) thread->nonvoluntary_ctxt_switches,
+                                                     "majflt", (json_int_t) thread->major_faults);
+         if (thread_info == NULL || json_array_append_new(threads_arr, thread_info) == -1) {
+            VERBOSE(SUP_LOG, "[ERROR] Could not append module thread info to JSON array (module \"%s\").\n", snapshot->modules[x].module_name);
+            json_decref(threads_arr);
+            json_decref(module_info);
+            goto clean_up;
+         }
+      }
+      if (threads_arr != NULL && json_object_set_new(module_info, "threads", threads_arr) == -1) {
+         VERBOSE(SUP_LOG, "[ERROR] Could not create JSON object of a module \"%s\".\n", snapshot->modules[x].module_name);
+         json_decref(module_info);
          goto clean_up;
       }
 
-      module = json_pack("{so}", running_modules[x].module_name, module_info);
+      module = json_pack("{so}", snapshot->modules[x].module_name, module_info);
       if (module == NULL) {
-         VERBOSE(SUP_LOG, "[ERROR] Could not create JSON object of a module \"%s\".\n", running_modules[x].module_name);
+         VERBOSE(SUP_LOG, "[ERROR] Could not create JSON object of a module \"%s\".\n", snapshot->modules[x].module_name);
          goto clean_up;
       }
 
@@ -851,7 +1152,7 @@ char *make_json_modules_info(uint8_t info_mask)
          modules_obj = module;
       } else {
          if (json_object_update(modules_obj, module) == -1) {
-            VERBOSE(SUP_LOG, "[ERROR] Could not append module \"%s\" final JSON object.\n", running_modules[x].module_name);
+            VERBOSE(SUP_LOG, "[ERROR] Could not append module \"%s\" final JSON object.\n", snapshot->modules[x].module_name);
             goto clean_up;
          }
          json_decref(module);
@@ -859,16 +1160,17 @@ char *make_json_modules_info(uint8_t info_mask)
    }
 
 
-   result_data = json_dumps(modules_obj, 0);
-   if (modules_obj != NULL) {
-      json_decref(modules_obj);
+   modules_snapshot_release(reader_parity);
+   if (modules_obj == NULL) {
+      modules_obj = json_object();
    }
-   return result_data;
+   return modules_obj;
 
 clean_up:
    if (modules_obj != NULL) {
       json_decref(modules_obj);
    }
+   modules_snapshot_release(reader_parity);
    return NULL;
 }
 
@@ -879,6 +1181,8 @@ char *make_formated_statistics(uint8_t stats_mask)
    char *buffer = (char *) calloc(size_of_buffer, sizeof(char));
    unsigned int x, y;
    int ptr = 0;
+   modules_snapshot_t *snapshot = NULL;
+   unsigned int reader_parity = 0;
 
    // Decide which stats should be printed according to the stats mask
    if ((stats_mask & (uint8_t) 1) == (uint8_t) 1) {
@@ -891,16 +1195,22 @@ char *make_formated_statistics(uint8_t stats_mask)
       print_memory_stats = TRUE;
    }
 
+   snapshot = modules_snapshot_acquire(&reader_parity);
+   if (snapshot == NULL) {
+      modules_snapshot_release(reader_parity);
+      return buffer;
+   }
+
    if (print_ifc_stats == TRUE) {
-      for (x = 0; x < loaded_modules_cnt; x++) {
-         if (running_modules[x].module_status == TRUE && running_modules[x].module_service_ifc_isconnected == TRUE) {
-            if (running_modules[x].in_ifces_data != NULL) {
-               for (y = 0; y < running_modules[x].total_in_ifces_cnt; y++) {
-                  ptr += sprintf(buffer + ptr, "%s,in,%c,%s,%"PRIu64",%"PRIu64"\n", running_modules[x].module_name,
-                                 running_modules[x].in_ifces_data[y].ifc_type,
-                                 (running_modules[x].in_ifces_data[y].ifc_id != NULL ? running_modules[x].in_ifces_data[y].ifc_id : "none"),
-                                 running_modules[x].in_ifces_data[y].recv_msg_cnt,
-                                 running_modules[x].in_ifces_data[y].recv_buffer_cnt);
+      for (x = 0; x < snapshot->modules_cnt; x++) {
+         if (snapshot->modules[x].module_status == TRUE && snapshot->modules[x].module_service_ifc_isconnected == TRUE) {
+            if (snapshot->modules[x].in_ifces_data != NULL) {
+               for (y = 0; y < snapshot->modules[x].total_in_ifces_cnt; y++) {
+                  ptr += sprintf(buffer + ptr, "%s,in,%c,%s,%"PRIu64",%"PRIu64"\n", snapshot->modules[x].module_name,
+                                 snapshot->modules[x].in_ifces_data[y].ifc_type,
+                                 (snapshot->modules[x].in_ifces_data[y].ifc_id != NULL ? snapshot->modules[x].in_ifces_data[y].ifc_id : "none"),
+                                 snapshot->modules[x].in_ifces_data[y].recv_msg_cnt,
+                                 snapshot->modules[x].in_ifces_data[y].recv_buffer_cnt);
                   if (strlen(buffer) >= (3 * size_of_buffer) / 5) {
                      size_of_buffer += size_of_buffer / 2;
                      buffer = (char *) realloc (buffer, size_of_buffer * sizeof(char));
@@ -908,15 +1218,15 @@ char *make_formated_statistics(uint8_t stats_mask)
                   }
                }
             }
-            if (running_modules[x].out_ifces_data != NULL) {
-               for (y = 0; y < running_modules[x].total_out_ifces_cnt; y++) {
-                  ptr += sprintf(buffer + ptr, "%s,out,%c,%s,%"PRIu64",%"PRIu64",%"PRIu64",%"PRIu64"\n", running_modules[x].module_name,
-                                 running_modules[x].out_ifces_data[y].ifc_type,
-                                 (running_modules[x].out_ifces_data[y].ifc_id != NULL ? running_modules[x].out_ifces_data[y].ifc_id : "none"),
-                                 running_modules[x].out_ifces_data[y].sent_msg_cnt,
-                                 running_modules[x].out_ifces_data[y].dropped_msg_cnt,
-                                 running_modules[x].out_ifces_data[y].sent_buffer_cnt,
-                                 running_modules[x].out_ifces_data[y].autoflush_cnt);
+            if (snapshot->modules[x].out_ifces_data != NULL) {
+               for (y = 0; y < snapshot->modules[x].total_out_ifces_cnt; y++) {
+                  ptr += sprintf(buffer + ptr, "%s,out,%c,%s,%"PRIu64",%"PRIu64",%"PRIu64",%"PRIu64"\n", snapshot->modules[x].module_name,
+                                 snapshot->modules[x].out_ifces_data[y].ifc_type,
+                                 (snapshot->modules[x].out_ifces_data[y].ifc_id != NULL ? snapshot->modules[x].out_ifces_data[y].ifc_id : "none"),
+                                 snapshot->modules[x].out_ifces_data[y].sent_msg_cnt,
+                                 snapshot->modules[x].out_ifces_data[y].dropped_msg_cnt,
+                                 snapshot->modules[x].out_ifces_data[y].sent_buffer_cnt,
+                                 snapshot->modules[x].out_ifces_data[y].autoflush_cnt);
                   if (strlen(buffer) >= (3 * size_of_buffer) / 5) {
                      size_of_buffer += size_of_buffer / 2;
                      buffer = (char *) realloc (buffer, size_of_buffer * sizeof(char));
@@ -929,11 +1239,11 @@ char *make_formated_statistics(uint8_t stats_mask)
    }
 
    if (print_cpu_stats == TRUE) {
-      for (x=0; x<loaded_modules_cnt; x++) {
-         if (running_modules[x].module_status == TRUE) {
-            ptr += sprintf(buffer + ptr, "%s,cpu,%lu,%lu\n", running_modules[x].module_name,
-                                                             running_modules[x].last_period_percent_cpu_usage_kernel_mode,
-                                                             running_modules[x].last_period_percent_cpu_usage_user_mode);
+      for (x = 0; x < snapshot->modules_cnt; x++) {
+         if (snapshot->modules[x].module_status == TRUE) {
+            ptr += sprintf(buffer + ptr, "%s,cpu,%lu,%lu\n", snapshot->modules[x].module_name,
+                                                             snapshot->modules[x].last_period_percent_cpu_usage_kernel_mode,
+                                                             snapshot->modules[x].last_period_percent_cpu_usage_user_mode);
             if (strlen(buffer) >= (3*size_of_buffer)/5) {
                size_of_buffer += size_of_buffer/2;
                buffer = (char *) realloc (buffer, size_of_buffer * sizeof(char));
@@ -944,10 +1254,10 @@ char *make_formated_statistics(uint8_t stats_mask)
    }
 
    if (print_memory_stats == TRUE) {
-      for (x=0; x<loaded_modules_cnt; x++) {
-         if (running_modules[x].module_status == TRUE) {
-            ptr += sprintf(buffer + ptr, "%s,mem,%lu\n", running_modules[x].module_name,
-                                                         running_modules[x].virtual_memory_size / (1024*1024)); // to convert B to MB, divide by 1024*1024
+      for (x = 0; x < snapshot->modules_cnt; x++) {
+         if (snapshot->modules[x].module_status == TRUE) {
+            ptr += sprintf(buffer + ptr, "%s,mem,%lu\n", snapshot->modules[x].module_name,
+                                                         snapshot->modules[x].virtual_memory_size / (1024*1024)); // to convert B to MB, divide by 1024*1024
             if (strlen(buffer) >= (3*size_of_buffer)/5) {
                size_of_buffer += size_of_buffer/2;
                buffer = (char *) realloc (buffer, size_of_buffer * sizeof(char));
@@ -957,16 +1267,18 @@ char *make_formated_statistics(uint8_t stats_mask)
       }
    }
 
+   modules_snapshot_release(reader_parity);
    return buffer;
 }
 
 int find_loaded_module(char *name)
 {
-   unsigned int x;
-   for (x=0; x<loaded_modules_cnt; x++) {
-      if (strcmp(running_modules[x].module_name, name) == 0) {
-         return x;
-      }
+   int module_idx = name_index_find(&module_name_index, name);
+
+   // The index is updated whenever modules are inserted or shifted, the check only guards against a stale item
+   if (module_idx >= 0 && (unsigned int) module_idx < loaded_modules_cnt && running_modules[module_idx].module_name != NULL &&
+       strcmp(running_modules[module_idx].module_name, name) == 0) {
+      return module_idx;
    }
    return -1;
 }
@@ -1008,7 +1320,7 @@ void generate_backup_config_file()
          }
          for (x=0; x<loaded_modules_cnt; x++) {
             if (running_modules[x].modules_profile != NULL) {
-               if (strcmp(running_modules[x].modules_profile->profile_name, ptr->profile_name) == 0) {
+               if (running_modules[x].modules_profile == ptr) {
                   module = xmlNewChild(modules, NULL, BAD_CAST "module", NULL);
 
                   memset(buffer,0,20);
@@ -1100,420 +1412,2971 @@ void generate_backup_config_file()
  * Functions for getting statistics *
  *****************************************************************/
 
-int get_total_cpu_usage(unsigned long int *total_cpu_usage)
+int proc_read_file(int fd, char *buffer, size_t buffer_size)
 {
-   unsigned long int num = 0;
-   const char delim[2] = " ";
-   char *line = NULL, *token = NULL, *endptr = NULL;
-   int ret_val = 0;
-   size_t line_len = 0;
-   FILE *proc_stat_fd = fopen("/proc/stat","r");
+   ssize_t len = 0;
 
-   if (proc_stat_fd == NULL) {
+   // Files in /proc are generated again on every read from the beginning
+   do {
+      len = pread(fd, buffer, buffer_size - 1, 0);
+   } while (len == -1 && errno == EINTR);
+   if (len <= 0) {
       return -1;
    }
-   if (getline(&line, &line_len, proc_stat_fd) == -1) {
-      ret_val = -1;
-      goto cleanup;
-   }
-
-   token = strtok(line, delim);
-   if (token == NULL) {
-      ret_val = -1;
-      goto cleanup;
-   }
-   if (strcmp(token, "cpu") != 0) {
-      ret_val = -1;
-      goto cleanup;
-   }
-   token = strtok(NULL, delim);
-
-   while (token != NULL) {
-      num = strtoul(token, &endptr, 10);
-      if (endptr == token) {
-         ret_val = -1;
-         break;
-      }
-      *total_cpu_usage += num;
-      token = strtok(NULL, delim);
-   }
-
-cleanup:
-   fclose(proc_stat_fd);
-   NULLP_TEST_AND_FREE(line);
-   return ret_val;
+   buffer[len] = 0;
+   return 0;
 }
 
-void update_modules_resources_usage()
+int proc_read_thread_file(const int module_idx, const module_thread_stats_t *thread, const int fd, const char *file, char *buffer, size_t buffer_size)
 {
-   const char delim[2] = " ";
-   char *line = NULL, *token = NULL, *endptr = NULL;
-   size_t line_len = 0;
-   FILE *proc_stat_fd = NULL;
-   int x = 0, y = 0;
    char path[DEFAULT_SIZE_OF_BUFFER];
-   unsigned long int utime = 0, stime = 0, diff_total_cpu = 0, new_total_cpu = 0, num = 0;
+   int tmp_fd = -1, ret = 0;
 
-   if (get_total_cpu_usage(&new_total_cpu) == -1) {
-      return;
+   if (fd != -1) {
+      return proc_read_file(fd, buffer, buffer_size);
    }
-
-   diff_total_cpu = new_total_cpu - last_total_cpu;
-   if (diff_total_cpu == 0) {
-      return;
+   snprintf(path, DEFAULT_SIZE_OF_BUFFER, "/proc/%d/task/%d/%s", running_modules[module_idx].module_pid, thread->tid, file);
+   tmp_fd = open(path, O_RDONLY | O_CLOEXEC);
+   if (tmp_fd == -1) {
+      return -1;
    }
-   last_total_cpu = new_total_cpu;
-
-   for (x = 0; x < loaded_modules_cnt; x++) {
-      if (running_modules[x].module_status == TRUE) {
-         memset(path, 0, DEFAULT_SIZE_OF_BUFFER * sizeof(char));
-         snprintf(path, DEFAULT_SIZE_OF_BUFFER * sizeof(char), "/proc/%d/stat", running_modules[x].module_pid);
-
-         proc_stat_fd = fopen(path, "r");
-         if (proc_stat_fd == NULL) {
-            continue;
-         }
-
-         if (getline(&line, &line_len, proc_stat_fd) == -1) {
-            fclose(proc_stat_fd);
-            continue;
-         }
-
-         token = strtok(line, delim);
-         if (token == NULL) {
-            fclose(proc_stat_fd);
-            continue;
-         }
-
-         for (y = 1; y <= 23; y++) {
-            if (y == 14) { // position of "user mode time" field in /proc/pid/stat file is 14
-               utime = strtoul(token, &endptr, 10);
-               if (endptr == token) {
-                  continue;
-               }
-               running_modules[x].last_period_percent_cpu_usage_user_mode = 100 * ((double)(utime - running_modules[x].last_period_cpu_usage_user_mode) / (double)diff_total_cpu);
-               running_modules[x].last_period_cpu_usage_user_mode = utime;
-            } else if (y == 15) { // position of "kernel mode time" field in /proc/pid/stat file is 15
-               stime = strtoul(token, &endptr, 10);
-               if (endptr == token) {
-                  continue;
-               }
-               running_modules[x].last_period_percent_cpu_usage_kernel_mode = 100 * ((double)(stime - running_modules[x].last_period_cpu_usage_kernel_mode) / (double)diff_total_cpu);
-               running_modules[x].last_period_cpu_usage_kernel_mode = stime;
-            } else if (y == 23) {// position of "virtual memory size" field in /proc/pid/stat file is 23
-               num = strtoul(token, &endptr, 10);
-               if (endptr == token) {
-                  continue;
-               }
-               running_modules[x].virtual_memory_size = num;
-            }
-
-            token = strtok(NULL, delim);
-            if (token == NULL) {
-               break;
-            }
-         }
-         fclose(proc_stat_fd);
-
-         memset(path, 0, DEFAULT_SIZE_OF_BUFFER * sizeof(char));
-         snprintf(path, DEFAULT_SIZE_OF_BUFFER * sizeof(char), "/proc/%d/status", running_modules[x].module_pid);
-
-         proc_stat_fd = fopen(path, "r");
-         if (proc_stat_fd == NULL) {
-            continue;
-         }
+   ret = proc_read_file(tmp_fd, buffer, buffer_size);
+   close(tmp_fd);
+   return ret;
+}
 
-         while (getline(&line, &line_len, proc_stat_fd) != -1) {
-            if (strstr(line, "VmRSS") != NULL) {
-               token = strtok(line, delim);
-               while (token != NULL) {
-                  num = strtoul(token, &endptr, 10);
-                  if (num > 0) {
-                     running_modules[x].resident_set_size = num;
-                     break;
-                  }
-                  token = strtok(NULL, delim);
-               }
-               break;
-            }
-         }
-         fclose(proc_stat_fd);
+char *proc_skip_fields(char *pos, int cnt)
+{
+   while (cnt-- > 0) {
+      while (*pos == ' ') {
+         pos++;
+      }
+      while (*pos != ' ' && *pos != '\n' && *pos != 0) {
+         pos++;
       }
    }
-   NULLP_TEST_AND_FREE(line);
+   while (*pos == ' ') {
+      pos++;
+   }
+   return pos;
 }
 
-
-/*****************************************************************
- * Daemon mode functions *
- *****************************************************************/
-
-int daemon_init_process()
+int proc_get_number(char **pos, unsigned long int *num)
 {
-   pid_t process_id = 0;
-   pid_t sid = 0;
+   char *p = *pos;
+   unsigned long int value = 0;
 
-   process_id = fork();
-   if (process_id < 0)  {
-      VERBOSE(N_STDOUT,"%s [ERROR] Fork: could not initialize daemon process!\n", get_formatted_time());
-      return -1;
-   } else if (process_id > 0) {
-      NULLP_TEST_AND_FREE(config_files_path)
-      NULLP_TEST_AND_FREE(gener_config_file)
-      NULLP_TEST_AND_FREE(templ_config_file)
-      NULLP_TEST_AND_FREE(logs_path)
-      free_output_file_strings_and_streams();
-      fprintf(stdout, "%s [INFO] PID of daemon process: %d.\n", get_formatted_time(), process_id);
-      exit(EXIT_SUCCESS);
+   while (*p == ' ') {
+      p++;
    }
-
-   umask(0);
-   sid = setsid();
-   if (sid < 0) {
-      VERBOSE(N_STDOUT,"[ERROR] Setsid: calling process is process group leader!\n");
+   if (*p < '0' || *p > '9') {
       return -1;
    }
-
+   while (*p >= '0' && *p <= '9') {
+      value = value * 10 + (*p - '0');
+      p++;
+   }
+   *num = value;
+   *pos = p;
    return 0;
 }
 
-int daemon_init_structures()
+int proc_find_value(char *buffer, const char *key, unsigned long int *num)
 {
-   unsigned int x = 0;
+   char *pos = strstr(buffer, key);
 
-   server_internals = (server_internals_t *) calloc(1, sizeof(server_internals_t));
-   if (server_internals == NULL) {
-      VERBOSE(N_STDOUT, "%s [ERROR] Could not allocate dameon_internals, cannot proceed without it!\n", get_formatted_time());
-      return -1;
-   }
-   server_internals->clients = (sup_client_t **) calloc(MAX_NUMBER_SUP_CLIENTS, sizeof(sup_client_t*));
-   if (server_internals->clients == NULL) {
-      VERBOSE(N_STDOUT, "%s [ERROR] Could not allocate structures for clients, cannot proceed without it!\n", get_formatted_time());
+   if (pos == NULL) {
       return -1;
    }
-   for (x = 0; x < MAX_NUMBER_SUP_CLIENTS; x++) {
-      server_internals->clients[x] = (sup_client_t *) calloc(1, sizeof(sup_client_t));
-      if (server_internals->clients[x] != NULL) {
-         server_internals->clients[x]->client_sd = -1;
-         server_internals->clients[x]->client_input_stream_fd = -1;
-      } else {
-         VERBOSE(N_STDOUT, "%s [ERROR] Could not allocate structures for clients, cannot proceed without it!\n", get_formatted_time());
-         return -1;
-      }
+   pos += strlen(key);
+   while (*pos == '\t') {
+      pos++;
    }
-   // Initialize daemon's structure mutex
-   pthread_mutex_init(&server_internals->lock,NULL);
-
-   return 0;
+   return proc_get_number(&pos, num);
 }
 
-int daemon_init_socket()
+int get_total_cpu_usage(unsigned long int *total_cpu_usage)
 {
-   union tcpip_socket_addr addr;
-   memset(&addr, 0, sizeof(addr));
-   addr.unix_addr.sun_family = AF_UNIX;
-   snprintf(addr.unix_addr.sun_path, sizeof(addr.unix_addr.sun_path) - 1, "%s", socket_path);
+   char buffer[PROC_BUFFER_SIZE];
+   char *pos = buffer;
+   unsigned long int num = 0;
 
-   /* if socket file exists, it could be hard to create new socket and bind */
-   unlink(socket_path); /* error when file does not exist is not a problem */
-   server_internals->server_sd = socket(AF_UNIX, SOCK_STREAM, 0);
-   if (server_internals->server_sd == -1) {
-      VERBOSE(N_STDOUT, "%s [ERROR] Could not create daemon socket.\n", get_formatted_time());
-      return -1;
+   if (proc_stat_fd == -1) {
+      proc_stat_fd = open("/proc/stat", O_RDONLY | O_CLOEXEC);
+      if (proc_stat_fd == -1) {
+         return -1;
+      }
    }
-   if (fcntl(server_internals->server_sd, F_SETFL, O_NONBLOCK) == -1) {
-      VERBOSE(N_STDOUT, "%s [ERROR] Could not set nonblocking mode on daemon socket.\n", get_formatted_time());
+   if (proc_read_file(proc_stat_fd, buffer, PROC_BUFFER_SIZE) == -1) {
       return -1;
    }
 
-   if (bind(server_internals->server_sd, (struct sockaddr *) &addr.unix_addr, sizeof(addr.unix_addr)) != -1) {
-      if (chmod(socket_path, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH) == -1) {
-         VERBOSE(N_STDOUT, "%s [WARNING] Failed to set permissions to socket (%s)\n", get_formatted_time(), socket_path);
-      }
-   } else {
-      VERBOSE(N_STDOUT,"%s [ERROR] Bind: could not bind the daemon socket \"%s\"!\n", get_formatted_time(), socket_path);
+   // The first line is "cpu" followed by times spent in all modes
+   if (strncmp(buffer, "cpu ", 4) != 0) {
       return -1;
    }
-
-   if (listen(server_internals->server_sd, MAX_NUMBER_SUP_CLIENTS) == -1) {
-      VERBOSE(N_STDOUT,"%s [ERROR] Listen: could not listen on the daemon socket \"%s\"!\n", get_formatted_time(), socket_path);
-      return -1;
+   pos += 4;
+   while (proc_get_number(&pos, &num) == 0) {
+      *total_cpu_usage += num;
    }
-
    return 0;
 }
 
-
-int daemon_mode_initialization()
+void close_module_proc_fds(const int module_idx)
+{
+   if (running_modules[module_idx].proc_stat_fd != -1) {
+      close(running_modules[module_idx].proc_stat_fd);
+      running_modules[module_idx].proc_stat_fd = -1;
+   }
+   if (running_modules[module_idx].proc_statm_fd != -1) {
+      close(running_modules[module_idx].proc_statm_fd);
+      running_modules[module_idx].proc_statm_fd = -1;
+   }
+   if (running_modules[module_idx].proc_io_fd != -1) {
+      close(running_modules[module_idx].proc_io_fd);
+      running_modules[module_idx].proc_io_fd = -1;
+   }
+   while (running_modules[module_idx].threads_cnt > 0) {
+      remove_module_thread(module_idx, running_modules[module_idx].threads_cnt - 1);
+   }
+   running_modules[module_idx].proc_fds_pid = 0;
+}
+
+int open_module_proc_fds(const int module_idx)
+{
+   char path[DEFAULT_SIZE_OF_BUFFER];
+
+   if (running_modules[module_idx].proc_fds_pid == running_modules[module_idx].module_pid && running_modules[module_idx].proc_stat_fd != -1) {
+      return 0;
+   }
+   // Module was restarted, files of the previous process are not valid anymore
+   close_module_proc_fds(module_idx);
+
+   snprintf(path, DEFAULT_SIZE_OF_BUFFER, "/proc/%d/stat", running_modules[module_idx].module_pid);
+   running_modules[module_idx].proc_stat_fd = open(path, O_RDONLY | O_CLOEXEC);
+   snprintf(path, DEFAULT_SIZE_OF_BUFFER, "/proc/%d/statm", running_modules[module_idx].module_pid);
+   running_modules[module_idx].proc_statm_fd = open(path, O_RDONLY | O_CLOEXEC);
+   if (running_modules[module_idx].proc_stat_fd == -1 || running_modules[module_idx].proc_statm_fd == -1) {
+      close_module_proc_fds(module_idx);
+      return -1;
+   }
+   // Counters of finished threads belonged to the previous process
+   running_modules[module_idx].finished_threads_voluntary_ctxt_switches = 0;
+   running_modules[module_idx].finished_threads_nonvoluntary_ctxt_switches = 0;
+   // I/O counters are not accessible without permission to trace the process (e.g. module started by other user)
+   snprintf(path, DEFAULT_SIZE_OF_BUFFER, "/proc/%d/io", running_modules[module_idx].module_pid);
+   running_modules[module_idx].proc_io_fd = open(path, O_RDONLY | O_CLOEXEC);
+   running_modules[module_idx].proc_fds_pid = running_modules[module_idx].module_pid;
+   return 0;
+}
+
+void remove_module_thread(const int module_idx, const uint32_t thread_idx)
+{
+   module_thread_stats_t *thread = &running_modules[module_idx].threads[thread_idx];
+
+   if (thread->stat_fd != -1) {
+      close(thread->stat_fd);
+      proc_threads_open_fds--;
+   }
+   if (thread->status_fd != -1) {
+      close(thread->status_fd);
+      proc_threads_open_fds--;
+   }
+   running_modules[module_idx].threads_cnt--;
+   // Order of threads does not matter, the last one is moved to the free place
+   if (thread_idx != running_modules[module_idx].threads_cnt) {
+      memcpy(thread, &running_modules[module_idx].threads[running_modules[module_idx].threads_cnt], sizeof(module_thread_stats_t));
+   }
+}
+
+module_thread_stats_t *add_module_thread(const int module_idx, pid_t tid)
+{
+   char path[DEFAULT_SIZE_OF_BUFFER];
+   module_thread_stats_t *thread = NULL;
+   void *tmp = NULL;
+
+   if (running_modules[module_idx].threads_cnt >= MODULE_THREADS_STATS_MAX) {
+      return NULL;
+   }
+   if (running_modules[module_idx].threads_cnt == running_modules[module_idx].threads_arr_size) {
+      tmp = realloc(running_modules[module_idx].threads, (running_modules[module_idx].threads_arr_size + 8) * sizeof(module_thread_stats_t));
+      if (tmp == NULL) {
+         return NULL;
+      }
+      running_modules[module_idx].threads = (module_thread_stats_t *) tmp;
+      running_modules[module_idx].threads_arr_size += 8;
+   }
+
+   thread = &running_modules[module_idx].threads[running_modules[module_idx].threads_cnt];
+   memset(thread, 0, sizeof(module_thread_stats_t));
+   thread->tid = tid;
+   thread->stat_fd = -1;
+   thread->status_fd = -1;
+   /* Descriptors are kept opened only for a limited number of threads of all modules, files of other threads
+    * are opened in every sweep (see proc_read_thread_file()) so supervisor does not run out of descriptors. */
+   if (proc_threads_open_fds + 2 <= PROC_THREADS_OPEN_FDS_MAX) {
+      snprintf(path, DEFAULT_SIZE_OF_BUFFER, "/proc/%d/task/%d/stat", running_modules[module_idx].module_pid, tid);
+      thread->stat_fd = open(path, O_RDONLY | O_CLOEXEC);
+      snprintf(path, DEFAULT_SIZE_OF_BUFFER, "/proc/%d/task/%d/status", running_modules[module_idx].module_pid, tid);
+      thread->status_fd = open(path, O_RDONLY | O_CLOEXEC);
+      if (thread->stat_fd == -1 || thread->status_fd == -1) {
+         if (thread->stat_fd != -1) {
+            close(thread->stat_fd);
+         }
+         if (thread->status_fd != -1) {
+            close(thread->status_fd);
+         }
+         return NULL;
+      }
+      proc_threads_open_fds += 2;
+   }
+   running_modules[module_idx].threads_cnt++;
+   return thread;
+}
+
+void update_module_threads_usage(const int module_idx, const unsigned long int diff_total_cpu)
+{
+   char path[DEFAULT_SIZE_OF_BUFFER];
+   char buffer[PROC_STATUS_BUFFER_SIZE];
+   char *pos = NULL, *name_end = NULL;
+   DIR *task_dir = NULL;
+   struct dirent *entry = NULL;
+   module_thread_stats_t *thread = NULL;
+   uint32_t x = 0;
+   pid_t tid = 0;
+   int new_thread = FALSE;
+   unsigned long int utime = 0, stime = 0, num = 0;
+
+   snprintf(path, DEFAULT_SIZE_OF_BUFFER, "/proc/%d/task", running_modules[module_idx].module_pid);
+   task_dir = opendir(path);
+   if (task_dir == NULL) {
+      return;
+   }
+   for (x = 0; x < running_modules[module_idx].threads_cnt; x++) {
+      running_modules[module_idx].threads[x].seen = FALSE;
+   }
+   // Context switches of the module are counters, so the finished threads are still counted
+   running_modules[module_idx].voluntary_ctxt_switches = running_modules[module_idx].finished_threads_voluntary_ctxt_switches;
+   running_modules[module_idx].nonvoluntary_ctxt_switches = running_modules[module_idx].finished_threads_nonvoluntary_ctxt_switches;
+
+   while ((entry = readdir(task_dir)) != NULL) {
+      tid = (pid_t) strtol(entry->d_name, &pos, 10);
+      if (pos == entry->d_name || *pos != 0) {
+         continue;
+      }
+      thread = NULL;
+      for (x = 0; x < running_modules[module_idx].threads_cnt; x++) {
+         if (running_modules[module_idx].threads[x].tid == tid) {
+            thread = &running_modules[module_idx].threads[x];
+            break;
+         }
+      }
+      new_thread = FALSE;
+      if (thread == NULL) {
+         thread = add_module_thread(module_idx, tid);
+         if (thread == NULL) {
+            continue;
+         }
+         new_thread = TRUE;
+      }
+      thread->seen = TRUE;
+
+      if (proc_read_thread_file(module_idx, thread, thread->stat_fd, "stat", buffer, PROC_BUFFER_SIZE) == 0) {
+         // Name of the thread is in parentheses, the following fields are counted from the last ')'
+         pos = strchr(buffer, '(');
+         name_end = strrchr(buffer, ')');
+         if (pos != NULL && name_end != NULL && name_end > pos) {
+            snprintf(thread->name, sizeof(thread->name), "%.*s", (int) (name_end - pos - 1), pos + 1);
+            // position of "major faults" field in /proc/pid/task/tid/stat file is 12, user and kernel mode time are 14 and 15
+            pos = proc_skip_fields(name_end + 1, 9);
+            if (proc_get_number(&pos, &num) == 0) {
+               thread->major_faults = num;
+            }
+            pos = proc_skip_fields(pos, 1);
+            if (proc_get_number(&pos, &utime) == 0 && proc_get_number(&pos, &stime) == 0) {
+               // CPU usage of a thread is related to one CPU, so a saturated thread has 100 %
+               if (new_thread == FALSE) {
+                  thread->percent_cpu_usage_user_mode = 100 * ((double)(utime - thread->last_cpu_usage_user_mode) * proc_cpus_cnt / (double)diff_total_cpu);
+                  thread->percent_cpu_usage_kernel_mode = 100 * ((double)(stime - thread->last_cpu_usage_kernel_mode) * proc_cpus_cnt / (double)diff_total_cpu);
+               }
+               thread->last_cpu_usage_user_mode = utime;
+               thread->last_cpu_usage_kernel_mode = stime;
+            }
+         }
+      }
+
+      if (proc_read_thread_file(module_idx, thread, thread->status_fd, "status", buffer, PROC_STATUS_BUFFER_SIZE) == 0) {
+         if (proc_find_value(buffer, "\nvoluntary_ctxt_switches:", &num) == 0) {
+            thread->voluntary_ctxt_switches = num;
+         }
+         if (proc_find_value(buffer, "\nnonvoluntary_ctxt_switches:", &num) == 0) {
+            thread->nonvoluntary_ctxt_switches = num;
+         }
+      }
+      running_modules[module_idx].voluntary_ctxt_switches += thread->voluntary_ctxt_switches;
+      running_modules[module_idx].nonvoluntary_ctxt_switches += thread->nonvoluntary_ctxt_switches;
+   }
+   closedir(task_dir);
+
+   // Forget finished threads, their last values of context switches are kept in the module counters
+   x = 0;
+   while (x < running_modules[module_idx].threads_cnt) {
+      if (running_modules[module_idx].threads[x].seen == FALSE) {
+         running_modules[module_idx].finished_threads_voluntary_ctxt_switches += running_modules[module_idx].threads[x].voluntary_ctxt_switches;
+         running_modules[module_idx].finished_threads_nonvoluntary_ctxt_switches += running_modules[module_idx].threads[x].nonvoluntary_ctxt_switches;
+         running_modules[module_idx].voluntary_ctxt_switches += running_modules[module_idx].threads[x].voluntary_ctxt_switches;
+         running_modules[module_idx].nonvoluntary_ctxt_switches += running_modules[module_idx].threads[x].nonvoluntary_ctxt_switches;
+         remove_module_thread(module_idx, x);
+      } else {
+         x++;
+      }
+   }
+}
+
+void update_modules_resources_usage()
+{
+   char buffer[PROC_BUFFER_SIZE];
+   char *pos = NULL;
+   int x = 0, cgroup_used = FALSE;
+   unsigned long int utime = 0, stime = 0, diff_total_cpu = 0, new_total_cpu = 0, num = 0;
+
+   if (get_total_cpu_usage(&new_total_cpu) == -1) {
+      return;
+   }
+
+   diff_total_cpu = new_total_cpu - last_total_cpu;
+   if (diff_total_cpu == 0) {
+      return;
+   }
+   last_total_cpu = new_total_cpu;
+
+   if (proc_page_size_kb == 0) {
+      proc_page_size_kb = sysconf(_SC_PAGESIZE) / 1024;
+      proc_cpus_cnt = sysconf(_SC_NPROCESSORS_ONLN);
+      if (proc_cpus_cnt < 1) {
+         proc_cpus_cnt = 1;
+      }
+   }
+
+   for (x = 0; x < loaded_modules_cnt; x++) {
+      if (running_modules[x].module_status == FALSE) {
+         close_module_proc_fds(x);
+         continue;
+      }
+      if (open_module_proc_fds(x) == -1) {
+         continue;
+      }
+      // CPU, memory and I/O of modules started in a cgroup include all their child processes
+      cgroup_used = (cgroup_update_module_usage(x, diff_total_cpu) == 0) ? TRUE : FALSE;
+
+      if (proc_read_file(running_modules[x].proc_stat_fd, buffer, PROC_BUFFER_SIZE) == 0) {
+         // Name of the module (2nd field) is in parentheses and it can contain spaces, fields are counted from the last ')'
+         pos = strrchr(buffer, ')');
+         if (pos != NULL) {
+            // position of "major faults" field in /proc/pid/stat file is 12
+            pos = proc_skip_fields(pos + 1, 9);
+            if (proc_get_number(&pos, &num) == 0) {
+               running_modules[x].major_faults = num;
+            }
+            // position of "user mode time" field in /proc/pid/stat file is 14 and "kernel mode time" follows
+            pos = proc_skip_fields(pos, 1);
+            if (proc_get_number(&pos, &utime) == 0 && proc_get_number(&pos, &stime) == 0) {
+               if (cgroup_used == FALSE) {
+                  running_modules[x].last_period_percent_cpu_usage_user_mode = 100 * ((double)(utime - running_modules[x].last_period_cpu_usage_user_mode) / (double)diff_total_cpu);
+                  running_modules[x].last_period_percent_cpu_usage_kernel_mode = 100 * ((double)(stime - running_modules[x].last_period_cpu_usage_kernel_mode) / (double)diff_total_cpu);
+               }
+               running_modules[x].last_period_cpu_usage_user_mode = utime;
+               running_modules[x].last_period_cpu_usage_kernel_mode = stime;
+
+               // position of "virtual memory size" field in /proc/pid/stat file is 23
+               pos = proc_skip_fields(pos, 7);
+               if (proc_get_number(&pos, &num) == 0) {
+                  running_modules[x].virtual_memory_size = num;
+               }
+            }
+         }
+      }
+
+      // The second field of /proc/pid/statm is resident set size in pages
+      if (cgroup_used == FALSE && proc_read_file(running_modules[x].proc_statm_fd, buffer, PROC_BUFFER_SIZE) == 0) {
+         pos = proc_skip_fields(buffer, 1);
+         if (proc_get_number(&pos, &num) == 0) {
+            running_modules[x].resident_set_size = num * proc_page_size_kb;
+         }
+      }
+
+      if (cgroup_used == FALSE && running_modules[x].proc_io_fd != -1 && proc_read_file(running_modules[x].proc_io_fd, buffer, PROC_BUFFER_SIZE) == 0) {
+         if (proc_find_value(buffer, "\nread_bytes:", &num) == 0) {
+            running_modules[x].read_bytes = num;
+         }
+         if (proc_find_value(buffer, "\nwrite_bytes:", &num) == 0) {
+            running_modules[x].write_bytes = num;
+         }
+      }
+
+      update_module_threads_usage(x, diff_total_cpu);
+   }
+}
+
+
+/*****************************************************************
+ * Module registry functions *
+ *****************************************************************/
+
+uint32_t name_index_hash(const char *name)
+{
+   uint32_t hash = 2166136261U;
+
+   for (; *name != 0; name++) {
+      hash = (hash ^ (uint8_t) *name) * 16777619U;
+   }
+   return hash;
+}
+
+int name_index_resize(name_index_t *index, const uint32_t size)
+{
+   name_index_item_t *old_items = index->items;
+   uint32_t old_size = index->size, x = 0, pos = 0;
+
+   index->items = (name_index_item_t *) calloc(size, sizeof(name_index_item_t));
+   if (index->items == NULL) {
+      index->items = old_items;
+      return -1;
+   }
+   index->size = size;
+   for (x = 0; x < old_size; x++) {
+      if (old_items[x].name != NULL) {
+         for (pos = name_index_hash(old_items[x].name) & (size - 1); index->items[pos].name != NULL; pos = (pos + 1) & (size - 1)) {
+         }
+         index->items[pos] = old_items[x];
+      }
+   }
+   NULLP_TEST_AND_FREE(old_items)
+   return 0;
+}
+
+int name_index_insert(name_index_t *index, const char *name, const int idx)
+{
+   uint32_t pos = 0;
+
+   // Load factor is kept under 1/2, so the linear probing stays short
+   if ((index->cnt + 1) * 2 > index->size && name_index_resize(index, (index->size == 0 ? NAME_INDEX_MIN_SIZE : index->size * 2)) == -1) {
+      return -1;
+   }
+   for (pos = name_index_hash(name) & (index->size - 1); index->items[pos].name != NULL; pos = (pos + 1) & (index->size - 1)) {
+      if (strcmp(index->items[pos].name, name) == 0) {
+         index->items[pos].idx = idx;
+         return 0;
+      }
+   }
+   index->items[pos].name = name;
+   index->items[pos].idx = idx;
+   index->cnt++;
+   return 0;
+}
+
+int name_index_find(const name_index_t *index, const char *name)
+{
+   uint32_t pos = 0;
+
+   if (index->size == 0 || name == NULL) {
+      return -1;
+   }
+   for (pos = name_index_hash(name) & (index->size - 1); index->items[pos].name != NULL; pos = (pos + 1) & (index->size - 1)) {
+      if (strcmp(index->items[pos].name, name) == 0) {
+         return index->items[pos].idx;
+      }
+   }
+   return -1;
+}
+
+void name_index_free(name_index_t *index)
+{
+   NULLP_TEST_AND_FREE(index->items)
+   index->size = 0;
+   index->cnt = 0;
+}
+
+void registry_add_module(const int module_idx)
+{
+   if (running_modules[module_idx].module_name != NULL) {
+      name_index_insert(&module_name_index, running_modules[module_idx].module_name, module_idx);
+   }
+}
+
+void registry_rebuild_modules()
+{
+   unsigned int x = 0;
+
+   if (module_name_index.items != NULL) {
+      memset(module_name_index.items, 0, module_name_index.size * sizeof(name_index_item_t));
+   }
+   module_name_index.cnt = 0;
+   for (x = 0; x < loaded_modules_cnt; x++) {
+      registry_add_module(x);
+   }
+}
+
+void registry_assign_handle(const int module_idx)
+{
+   running_modules[module_idx].module_handle = ++last_module_handle;
+}
+
+void registry_release_handle(const int module_idx)
+{
+   running_modules[module_idx].module_handle = 0;
+}
+
+void registry_rebuild_pids()
+{
+   uint32_t size = NAME_INDEX_MIN_SIZE, x = 0, y = 0, pos = 0;
+   pid_t pids[2];
+
+   // Every module can have two processes during hot restart
+   while (size < loaded_modules_cnt * 4) {
+      size *= 2;
+   }
+   if (size != module_pid_index.size) {
+      NULLP_TEST_AND_FREE(module_pid_index.items)
+      module_pid_index.items = (pid_index_item_t *) calloc(size, sizeof(pid_index_item_t));
+      module_pid_index.size = (module_pid_index.items == NULL ? 0 : size);
+   } else {
+      memset(module_pid_index.items, 0, size * sizeof(pid_index_item_t));
+   }
+   for (x = 0; x < loaded_modules_cnt && module_pid_index.size > 0; x++) {
+      pids[0] = running_modules[x].module_pid;
+      pids[1] = running_modules[x].module_retiring_pid;
+      for (y = 0; y < 2; y++) {
+         if (pids[y] <= 0) {
+            continue;
+         }
+         for (pos = ((uint32_t) pids[y] * 2654435761U) & (size - 1); module_pid_index.items[pos].pid != 0; pos = (pos + 1) & (size - 1)) {
+         }
+         module_pid_index.items[pos].pid = pids[y];
+         module_pid_index.items[pos].idx = x;
+      }
+   }
+}
+
+int find_module_by_pid(const pid_t pid)
+{
+   uint32_t pos = 0, attempt = 0;
+   int module_idx = -1;
+
+   if (pid <= 0) {
+      return -1;
+   }
+   // PIDs change with every start of a module, the index is rebuilt when it does not know the PID
+   for (attempt = 0; attempt < 2; attempt++) {
+      if (attempt == 1) {
+         registry_rebuild_pids();
+      }
+      if (module_pid_index.size == 0) {
+         continue;
+      }
+      for (pos = ((uint32_t) pid * 2654435761U) & (module_pid_index.size - 1); module_pid_index.items[pos].pid != 0; pos = (pos + 1) & (module_pid_index.size - 1)) {
+         if (module_pid_index.items[pos].pid == pid) {
+            module_idx = module_pid_index.items[pos].idx;
+            break;
+         }
+      }
+      if (module_idx >= 0 && (unsigned int) module_idx < loaded_modules_cnt &&
+          (running_modules[module_idx].module_pid == pid || running_modules[module_idx].module_retiring_pid == pid)) {
+         return module_idx;
+      }
+      module_idx = -1;
+   }
+   return -1;
+}
+
+
+/*****************************************************************
+ * Cgroup functions *
+ *****************************************************************/
+
+int cgroup_write_file(const char *dir, const char *file, const char *value)
+{
+   char path[PATH_MAX];
+   int fd = -1, ret_val = 0;
+
+   if (snprintf(path, PATH_MAX, "%s/%s", dir, file) >= PATH_MAX) {
+      errno = ENAMETOOLONG;
+      return -1;
+   }
+   fd = open(path, O_WRONLY | O_CLOEXEC);
+   if (fd == -1) {
+      return -1;
+   }
+   if (write(fd, value, strlen(value)) == -1) {
+      ret_val = -1;
+   }
+   close(fd);
+   return ret_val;
+}
+
+void cgroup_init()
+{
+   char buffer[PATH_MAX], pid_str[DEFAULT_SIZE_OF_BUFFER];
+   char *base = NULL, *supervisor_path = NULL;
+   const char *controllers[] = {"+cpu", "+memory", "+io"};
+   char *own_cgroup = NULL;
+   FILE *proc_cgroup = NULL;
+   unsigned int x = 0;
+
+   if (cgroup_modules_path != NULL) {
+      return;
+   }
+   snprintf(buffer, PATH_MAX, "%s/cgroup.controllers", CGROUP_MOUNT_POINT);
+   if (access(buffer, F_OK) != 0) {
+      VERBOSE(SUP_LOG, "%s [CGROUP] cgroup v2 is not mounted, resources usage of modules is read from /proc.\n", get_formatted_time());
+      return;
+   }
+
+   // Find the cgroup of supervisor (line "0::/path" of unified hierarchy)
+   proc_cgroup = fopen("/proc/self/cgroup", "r");
+   if (proc_cgroup == NULL) {
+      return;
+   }
+   while (fgets(buffer, PATH_MAX, proc_cgroup) != NULL) {
+      if (strncmp(buffer, "0::", 3) == 0) {
+         buffer[strcspn(buffer, "\n")] = 0;
+         own_cgroup = buffer + 3;
+         break;
+      }
+   }
+   fclose(proc_cgroup);
+   if (own_cgroup == NULL) {
+      return;
+   }
+
+   /* Cgroups with processes can not enable controllers for their children ("no internal processes" rule).
+    * In the root cgroup a new subtree is created, otherwise (e.g. systemd service with Delegate=yes)
+    * supervisor moves itself to a leaf and cgroups of modules are its siblings. */
+   if (strcmp(own_cgroup, "/") == 0) {
+      if (asprintf(&base, "%s/%s", CGROUP_MOUNT_POINT, CGROUP_SUBTREE_NAME) < 0) {
+         base = NULL;
+         goto cgroup_not_available;
+      }
+      if (mkdir(base, 0755) == -1 && errno != EEXIST) {
+         goto cgroup_not_available;
+      }
+   } else {
+      if (asprintf(&base, "%s%s", CGROUP_MOUNT_POINT, own_cgroup) < 0) {
+         base = NULL;
+         goto cgroup_not_available;
+      }
+      if (asprintf(&supervisor_path, "%s/supervisor", base) < 0) {
+         supervisor_path = NULL;
+         goto cgroup_not_available;
+      }
+      if (mkdir(supervisor_path, 0755) == -1 && errno != EEXIST) {
+         goto cgroup_not_available;
+      }
+      snprintf(pid_str, DEFAULT_SIZE_OF_BUFFER, "%d", getpid());
+      if (cgroup_write_file(supervisor_path, "cgroup.procs", pid_str) == -1) {
+         goto cgroup_not_available;
+      }
+      free(supervisor_path);
+   }
+
+   for (x = 0; x < sizeof(controllers) / sizeof(controllers[0]); x++) {
+      if (cgroup_write_file(base, "cgroup.subtree_control", controllers[x]) == -1) {
+         VERBOSE(SUP_LOG, "%s [CGROUP] Could not enable controller \"%s\" in %s.\n", get_formatted_time(), controllers[x] + 1, base);
+      }
+   }
+   cgroup_modules_path = base;
+   VERBOSE(SUP_LOG, "%s [CGROUP] Modules are started in cgroups under %s.\n", get_formatted_time(), base);
+   return;
+
+cgroup_not_available:
+   VERBOSE(SUP_LOG, "%s [CGROUP] Could not create cgroups under %s (%s), resources usage of modules is read from /proc.\n", get_formatted_time(), (base == NULL ? CGROUP_MOUNT_POINT : base), strerror(errno));
+   NULLP_TEST_AND_FREE(base)
+   NULLP_TEST_AND_FREE(supervisor_path)
+}
+
+void cgroup_apply_module_limits(const int module_idx)
+{
+   char value[DEFAULT_SIZE_OF_BUFFER];
+
+   if (running_modules[module_idx].cgroup_path == NULL) {
+      return;
+   }
+   if (running_modules[module_idx].module_cpu_max > 0) {
+      snprintf(value, DEFAULT_SIZE_OF_BUFFER, "%d %d", running_modules[module_idx].module_cpu_max * (CGROUP_CPU_PERIOD_USEC / 100), CGROUP_CPU_PERIOD_USEC);
+   } else {
+      snprintf(value, DEFAULT_SIZE_OF_BUFFER, "max %d", CGROUP_CPU_PERIOD_USEC);
+   }
+   if (cgroup_write_file(running_modules[module_idx].cgroup_path, "cpu.max", value) == -1 && running_modules[module_idx].module_cpu_max > 0) {
+      VERBOSE(MODULE_EVENT, "%s [CGROUP] Could not set cpu-max of module %s.\n", get_formatted_time(), running_modules[module_idx].module_name);
+   }
+
+   if (running_modules[module_idx].module_memory_max > 0) {
+      snprintf(value, DEFAULT_SIZE_OF_BUFFER, "%"PRIu64, running_modules[module_idx].module_memory_max);
+   } else {
+      snprintf(value, DEFAULT_SIZE_OF_BUFFER, "max");
+   }
+   if (cgroup_write_file(running_modules[module_idx].cgroup_path, "memory.max", value) == -1 && running_modules[module_idx].module_memory_max > 0) {
+      VERBOSE(MODULE_EVENT, "%s [CGROUP] Could not set memory-max of module %s.\n", get_formatted_time(), running_modules[module_idx].module_name);
+   }
+}
+
+void cgroup_close_module_fds(const int module_idx)
+{
+   if (running_modules[module_idx].cgroup_cpu_stat_fd != -1) {
+      close(running_modules[module_idx].cgroup_cpu_stat_fd);
+      running_modules[module_idx].cgroup_cpu_stat_fd = -1;
+   }
+   if (running_modules[module_idx].cgroup_memory_stat_fd != -1) {
+      close(running_modules[module_idx].cgroup_memory_stat_fd);
+      running_modules[module_idx].cgroup_memory_stat_fd = -1;
+   }
+   if (running_modules[module_idx].cgroup_io_stat_fd != -1) {
+      close(running_modules[module_idx].cgroup_io_stat_fd);
+      running_modules[module_idx].cgroup_io_stat_fd = -1;
+   }
+}
+
+int cgroup_open_module_file(const int module_idx, const char *file, const int flags)
+{
+   char path[PATH_MAX];
+
+   if (snprintf(path, PATH_MAX, "%s/%s", running_modules[module_idx].cgroup_path, file) >= PATH_MAX) {
+      errno = ENAMETOOLONG;
+      return -1;
+   }
+   return open(path, flags | O_CLOEXEC);
+}
+
+char *cgroup_module_path(const char *module_name)
+{
+   size_t len = strlen(cgroup_modules_path) + strlen("/module-") + 3 * strlen(module_name) + 1;
+   char *path = (char *) malloc(len);
+   char *ptr = NULL;
+
+   if (path == NULL) {
+      return NULL;
+   }
+   ptr = path + sprintf(path, "%s/module-", cgroup_modules_path);
+   /* Characters other than alphanumerics, '-', '_' and '.' are written as %XX (including '%' itself),
+    * so the name can not create nested directories and different modules never share a cgroup. */
+   for (; *module_name != 0; module_name++) {
+      if (isalnum((unsigned char) *module_name) || *module_name == '-' || *module_name == '_' || *module_name == '.') {
+         *ptr++ = *module_name;
+      } else {
+         ptr += sprintf(ptr, "%%%02X", (unsigned char) *module_name);
+      }
+   }
+   *ptr = 0;
+   return path;
+}
+
+int cgroup_prepare_module(const int module_idx)
+{
+   char *path = NULL;
+
+   if (cgroup_modules_path == NULL) {
+      return -1;
+   }
+   if (running_modules[module_idx].cgroup_path == NULL) {
+      path = cgroup_module_path(running_modules[module_idx].module_name);
+      if (path == NULL) {
+         return -1;
+      }
+      // Too long paths are rejected by mkdir() with ENAMETOOLONG
+      if (mkdir(path, 0755) == -1 && errno != EEXIST) {
+         VERBOSE(MODULE_EVENT, "%s [CGROUP] Could not create cgroup %s (%s).\n", get_formatted_time(), path, strerror(errno));
+         free(path);
+         return -1;
+      }
+      running_modules[module_idx].cgroup_path = path;
+   }
+   cgroup_apply_module_limits(module_idx);
+
+   // Counters of the cgroup are cumulative, the descriptors stay opened between restarts of the module
+   if (running_modules[module_idx].cgroup_cpu_stat_fd == -1) {
+      running_modules[module_idx].cgroup_cpu_stat_fd = cgroup_open_module_file(module_idx, "cpu.stat", O_RDONLY);
+      running_modules[module_idx].cgroup_memory_stat_fd = cgroup_open_module_file(module_idx, "memory.stat", O_RDONLY);
+      running_modules[module_idx].cgroup_io_stat_fd = cgroup_open_module_file(module_idx, "io.stat", O_RDONLY);
+   }
+   return 0;
+}
+
+int cgroup_open_module_procs(const int module_idx)
+{
+   // The module process moves itself to the cgroup by writing to this descriptor before execve()
+   if (running_modules[module_idx].cgroup_path == NULL) {
+      return -1;
+   }
+   return cgroup_open_module_file(module_idx, "cgroup.procs", O_WRONLY);
+}
+
+void cgroup_remove_module(const int module_idx)
+{
+   cgroup_close_module_fds(module_idx);
+   if (running_modules[module_idx].cgroup_path != NULL) {
+      // Cgroup of a module which is still running (supervisor is terminated without stopping modules) can not be removed
+      if (rmdir(running_modules[module_idx].cgroup_path) == -1 && errno != EBUSY) {
+         VERBOSE(DEBUG, "%s [CGROUP] Could not remove cgroup %s (%s).\n", get_formatted_time(), running_modules[module_idx].cgroup_path, strerror(errno));
+      }
+      NULLP_TEST_AND_FREE(running_modules[module_idx].cgroup_path)
+   }
+}
+
+int cgroup_update_module_usage(const int module_idx, const unsigned long int diff_total_cpu)
+{
+   char buffer[PROC_STATUS_BUFFER_SIZE];
+   char *pos = NULL;
+   unsigned long int user_usec = 0, system_usec = 0, num = 0, anon = 0, file_mapped = 0;
+   uint64_t read_bytes = 0, write_bytes = 0;
+   double diff_total_usec = 0;
+
+   if (running_modules[module_idx].cgroup_cpu_stat_fd == -1 || proc_read_file(running_modules[module_idx].cgroup_cpu_stat_fd, buffer, PROC_BUFFER_SIZE) == -1) {
+      return -1;
+   }
+   if (proc_find_value(buffer, "\nuser_usec", &user_usec) == -1 || proc_find_value(buffer, "\nsystem_usec", &system_usec) == -1) {
+      return -1;
+   }
+   // Total CPU time of all CPUs in the last period in micro seconds (the first sample of the cgroup is used only as a base)
+   diff_total_usec = (double) diff_total_cpu * 1000000 / sysconf(_SC_CLK_TCK);
+   if (running_modules[module_idx].cgroup_last_user_usec != 0 || running_modules[module_idx].cgroup_last_system_usec != 0) {
+      running_modules[module_idx].last_period_percent_cpu_usage_user_mode = 100 * ((double)(user_usec - running_modules[module_idx].cgroup_last_user_usec) / diff_total_usec);
+      running_modules[module_idx].last_period_percent_cpu_usage_kernel_mode = 100 * ((double)(system_usec - running_modules[module_idx].cgroup_last_system_usec) / diff_total_usec);
+   }
+   running_modules[module_idx].cgroup_last_user_usec = user_usec;
+   running_modules[module_idx].cgroup_last_system_usec = system_usec;
+
+   /* Resident memory of all processes of the cgroup in bytes: anonymous memory and mapped files, like RSS
+    * (memory.current includes also page cache of files the module only reads or writes). The first line
+    * of memory.stat is "anon", the buffer starts with '\n' so all keys are found the same way. */
+   buffer[0] = '\n';
+   if (running_modules[module_idx].cgroup_memory_stat_fd != -1 && proc_read_file(running_modules[module_idx].cgroup_memory_stat_fd, buffer + 1, PROC_STATUS_BUFFER_SIZE - 1) == 0) {
+      if (proc_find_value(buffer, "\nanon ", &anon) == 0 && proc_find_value(buffer, "\nfile_mapped ", &file_mapped) == 0) {
+         running_modules[module_idx].resident_set_size = (anon + file_mapped) / 1024;
+      }
+   }
+
+   // One line per device: "MAJ:MIN rbytes=N wbytes=N rios=N wios=N dbytes=N dios=N"
+   if (running_modules[module_idx].cgroup_io_stat_fd != -1 && proc_read_file(running_modules[module_idx].cgroup_io_stat_fd, buffer, PROC_STATUS_BUFFER_SIZE) == 0) {
+      pos = buffer;
+      while ((pos = strstr(pos, "rbytes=")) != NULL) {
+         pos += 7;
+         if (proc_get_number(&pos, &num) == 0) {
+            read_bytes += num;
+         }
+         if (strncmp(pos, " wbytes=", 8) == 0) {
+            pos += 8;
+            if (proc_get_number(&pos, &num) == 0) {
+               write_bytes += num;
+            }
+         }
+      }
+      running_modules[module_idx].read_bytes = read_bytes;
+      running_modules[module_idx].write_bytes = write_bytes;
+   }
+   return 0;
+}
+
+
+/*****************************************************************
+ * Placement functions *
+ *****************************************************************/
+
+int placement_read_sysfs_list(const char *path, cpu_set_t *set)
+{
+   char buffer[PROC_STATUS_BUFFER_SIZE];
+   int fd = -1;
+   ssize_t len = 0;
+
+   fd = open(path, O_RDONLY | O_CLOEXEC);
+   if (fd == -1) {
+      return -1;
+   }
+   len = read(fd, buffer, PROC_STATUS_BUFFER_SIZE - 1);
+   close(fd);
+   if (len <= 0) {
+      return -1;
+   }
+   buffer[len] = 0;
+   return parse_cpu_list(buffer, set);
+}
+
+void placement_init_numa()
+{
+   if (numa_nodes_cnt != -1) {
+      return;
+   }
+   numa_nodes_cnt = 0;
+   if (placement_read_sysfs_list(NUMA_SYSFS_PATH "/online", &numa_online_nodes) == 0) {
+      numa_nodes_cnt = CPU_COUNT(&numa_online_nodes);
+   }
+   VERBOSE(SUP_LOG, "%s [PLACEMENT] Number of online NUMA nodes: %d.\n", get_formatted_time(), numa_nodes_cnt);
+}
+
+int placement_unixsocket_connects(const interface_t *out_ifc, const interface_t *in_ifc)
+{
+   size_t out_len = 0, in_len = 0;
+
+   if (out_ifc->int_ifc_type != UNIXSOCKET_MODULE_IFC_TYPE || in_ifc->int_ifc_type != UNIXSOCKET_MODULE_IFC_TYPE ||
+       out_ifc->int_ifc_direction != OUT_MODULE_IFC_DIRECTION || in_ifc->int_ifc_direction != IN_MODULE_IFC_DIRECTION ||
+       out_ifc->ifc_params == NULL || in_ifc->ifc_params == NULL) {
+      return FALSE;
+   }
+   // Name of the socket is the first parameter, the others (e.g. number of clients of output interface) are separated by ':'
+   out_len = strcspn(out_ifc->ifc_params, ":");
+   in_len = strcspn(in_ifc->ifc_params, ":");
+   return (out_len == in_len && strncmp(out_ifc->ifc_params, in_ifc->ifc_params, out_len) == 0);
+}
+
+int placement_modules_connected(const int module_idx1, const int module_idx2)
+{
+   unsigned int x = 0, y = 0;
+
+   for (x = 0; x < running_modules[module_idx1].config_ifces_cnt; x++) {
+      for (y = 0; y < running_modules[module_idx2].config_ifces_cnt; y++) {
+         if (placement_unixsocket_connects(&running_modules[module_idx1].config_ifces[x], &running_modules[module_idx2].config_ifces[y]) ||
+             placement_unixsocket_connects(&running_modules[module_idx2].config_ifces[y], &running_modules[module_idx1].config_ifces[x])) {
+            return TRUE;
+         }
+      }
+   }
+   return FALSE;
+}
+
+int placement_find_group(int *groups, int module_idx)
+{
+   while (groups[module_idx] != module_idx) {
+      groups[module_idx] = groups[groups[module_idx]];
+      module_idx = groups[module_idx];
+   }
+   return module_idx;
+}
+
+void placement_assign_numa_nodes()
+{
+   int *groups = NULL, *group_nodes = NULL;
+   int nodes_load[MAX_NUMA_NODES];
+   int x = 0, y = 0, group = 0, node = 0, auto_modules_cnt = 0;
+
+   placement_init_numa();
+   memset(nodes_load, 0, MAX_NUMA_NODES * sizeof(int));
+
+   // Modules with a fixed node are placed first, their load is taken into account for automatic placement
+   for (x = 0; x < loaded_modules_cnt; x++) {
+      running_modules[x].numa_node = -1;
+      if (running_modules[x].module_numa_node == NUMA_NODE_AUTO) {
+         auto_modules_cnt++;
+      } else if (running_modules[x].module_numa_node >= 0) {
+         if (numa_nodes_cnt <= 0 || !CPU_ISSET(running_modules[x].module_numa_node, &numa_online_nodes)) {
+            VERBOSE(MODULE_EVENT, "%s [PLACEMENT] NUMA node %d of module %s is not online, the module is not placed.\n", get_formatted_time(), running_modules[x].module_numa_node, running_modules[x].module_name);
+            continue;
+         }
+         running_modules[x].numa_node = running_modules[x].module_numa_node;
+         if (running_modules[x].module_enabled == TRUE) {
+            nodes_load[running_modules[x].numa_node]++;
+         }
+      }
+   }
+   if (auto_modules_cnt == 0 || numa_nodes_cnt <= 1) {
+      return;
+   }
+
+   groups = (int *) calloc(loaded_modules_cnt, sizeof(int));
+   group_nodes = (int *) calloc(loaded_modules_cnt, sizeof(int));
+   if (groups == NULL || group_nodes == NULL) {
+      VERBOSE(N_STDOUT, "%s [ERROR] Could not allocate memory for placement of modules.\n", get_formatted_time());
+      goto cleanup;
+   }
+
+   // Modules connected by unix socket interfaces form a group which is placed on one node
+   for (x = 0; x < loaded_modules_cnt; x++) {
+      groups[x] = x;
+      group_nodes[x] = -1;
+   }
+   for (x = 0; x < loaded_modules_cnt; x++) {
+      for (y = x + 1; y < loaded_modules_cnt; y++) {
+         if (placement_modules_connected(x, y)) {
+            groups[placement_find_group(groups, y)] = placement_find_group(groups, x);
+         }
+      }
+   }
+   // A group containing a module with a fixed node follows that module
+   for (x = 0; x < loaded_modules_cnt; x++) {
+      group = placement_find_group(groups, x);
+      if (running_modules[x].numa_node >= 0 && group_nodes[group] == -1) {
+         group_nodes[group] = running_modules[x].numa_node;
+      }
+   }
+   // Other groups are placed on the least loaded node
+   for (x = 0; x < loaded_modules_cnt; x++) {
+      if (running_modules[x].module_numa_node != NUMA_NODE_AUTO) {
+         continue;
+      }
+      group = placement_find_group(groups, x);
+      if (group_nodes[group] == -1) {
+         for (node = 0; node < MAX_NUMA_NODES; node++) {
+            if (CPU_ISSET(node, &numa_online_nodes) && (group_nodes[group] == -1 || nodes_load[node] < nodes_load[group_nodes[group]])) {
+               group_nodes[group] = node;
+            }
+         }
+      }
+      running_modules[x].numa_node = group_nodes[group];
+      if (running_modules[x].module_enabled == TRUE) {
+         nodes_load[running_modules[x].numa_node]++;
+      }
+      VERBOSE(DEBUG, "%s [PLACEMENT] Module %s is placed on NUMA node %d.\n", get_formatted_time(), running_modules[x].module_name, running_modules[x].numa_node);
+   }
+
+cleanup:
+   NULLP_TEST_AND_FREE(groups)
+   NULLP_TEST_AND_FREE(group_nodes)
+}
+
+int placement_get_module_cpus(const int module_idx, cpu_set_t *cpus)
+{
+   char path[PATH_MAX];
+   cpu_set_t node_cpus, affinity;
+
+   if (running_modules[module_idx].module_cpu_affinity == NULL && running_modules[module_idx].numa_node < 0) {
+      return -1;
+   }
+   if (running_modules[module_idx].module_cpu_affinity == NULL || parse_cpu_list(running_modules[module_idx].module_cpu_affinity, &affinity) == -1) {
+      // Module may use every CPU supervisor is allowed to run on
+      if (sched_getaffinity(0, sizeof(cpu_set_t), &affinity) == -1) {
+         return -1;
+      }
+   }
+   *cpus = affinity;
+   if (running_modules[module_idx].numa_node >= 0) {
+      snprintf(path, PATH_MAX, "%s/node%d/cpulist", NUMA_SYSFS_PATH, running_modules[module_idx].numa_node);
+      if (placement_read_sysfs_list(path, &node_cpus) == 0) {
+         CPU_AND(cpus, &affinity, &node_cpus);
+         if (CPU_COUNT(cpus) == 0) {
+            VERBOSE(MODULE_EVENT, "%s [PLACEMENT] cpu-affinity of module %s has no CPU on NUMA node %d, the node is used for memory only.\n", get_formatted_time(), running_modules[module_idx].module_name, running_modules[module_idx].numa_node);
+            *cpus = affinity;
+         }
+      }
+   }
+   return 0;
+}
+
+void placement_enter_module(const cpu_set_t *cpus, const int numa_node)
+{
+   unsigned long nodemask = 0;
+
+   // Called by the module process before execve(), only system calls are used (memory is shared with supervisor)
+   if (cpus != NULL && sched_setaffinity(0, sizeof(cpu_set_t), cpus) == -1) {
+      launcher_child_error("Could not set CPU affinity.\n");
+   }
+   if (numa_node >= 0) {
+      nodemask = 1UL << numa_node;
+      // Memory is preferably allocated on the node, other nodes are used if it is full
+      if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, &nodemask, MAX_NUMA_NODES + 1) == -1) {
+         launcher_child_error("Could not set memory policy to the NUMA node.\n");
+      }
+   }
+}
+
+void placement_apply_running_module(const int module_idx)
+{
+   char path[PATH_MAX];
+   cpu_set_t cpus;
+   DIR *task_dir = NULL;
+   struct dirent *task = NULL;
+   pid_t tid = 0;
+
+   if (running_modules[module_idx].module_status == FALSE || running_modules[module_idx].module_pid <= 0) {
+      return;
+   }
+   // Threads of a module without placement are not touched (it could set the affinity of its threads itself)
+   if (placement_get_module_cpus(module_idx, &cpus) == -1) {
+      return;
+   }
+   // Affinity is a property of a thread, all threads of the running module are moved
+   snprintf(path, PATH_MAX, "/proc/%d/task", running_modules[module_idx].module_pid);
+   task_dir = opendir(path);
+   if (task_dir == NULL) {
+      return;
+   }
+   while ((task = readdir(task_dir)) != NULL) {
+      tid = atoi(task->d_name);
+      if (tid > 0 && sched_setaffinity(tid, sizeof(cpu_set_t), &cpus) == -1) {
+         VERBOSE(DEBUG, "%s [PLACEMENT] Could not set CPU affinity of thread %d of module %s (%s).\n", get_formatted_time(), tid, running_modules[module_idx].module_name, strerror(errno));
+      }
+   }
+   closedir(task_dir);
+}
+
+
+/*****************************************************************
+ * Module launcher functions *
+ *****************************************************************/
+
+void launcher_child_error(const char *msg)
+{
+   if (write(STDERR_FILENO, msg, strlen(msg)) == -1) {
+      // Nothing to do here, the module process has no other output
+   }
+}
+
+int launcher_child(void *arg)
+{
+   module_launch_t *launch = (module_launch_t *) arg;
+   struct sigaction sig_action;
+   sigset_t module_sigmask;
+   int sig = 0, len = 0;
+   uint32_t x = 0;
+   pid_t pid = 0;
+   char pid_digits[16];
+
+   /* The process shares memory with the suspended supervisor thread until execve(),
+    * so only system calls are used here (no allocation, no stdio, no locks). */
+   dup2(launch->stdout_fd, STDOUT_FILENO);
+   dup2(launch->stderr_fd, STDERR_FILENO);
+   if (launch->cgroup_procs_fd != -1 && write(launch->cgroup_procs_fd, "0", 1) == -1) {
+      launcher_child_error("Could not enter cgroup of the module.\n");
+   }
+   setsid(); // important for sending SIGINT to supervisor.. modules can't receive the signal too !!!
+   placement_enter_module((launch->cpus_set ? &launch->cpus : NULL), launch->numa_node);
+
+   // Handlers of supervisor are reset before signals are unblocked, module starts with an empty signal mask
+   for (sig = 1; sig < NSIG; sig++) {
+      if (sigaction(sig, NULL, &sig_action) == 0 && sig_action.sa_handler != SIG_DFL && sig_action.sa_handler != SIG_IGN) {
+         sig_action.sa_handler = SIG_DFL;
+         sigaction(sig, &sig_action, NULL);
+      }
+   }
+   sigemptyset(&module_sigmask);
+   sigprocmask(SIG_SETMASK, &module_sigmask, NULL);
+
+   if (launch->listen_fds_cnt > 0) {
+      // Sockets are moved above the target range first, so dup2() cannot overwrite a socket which was not moved yet
+      for (x = 0; x < launch->listen_fds_cnt; x++) {
+         launch->listen_fds[x] = fcntl(launch->listen_fds[x], F_DUPFD_CLOEXEC, LISTEN_FDS_START + launch->listen_fds_cnt);
+      }
+      for (x = 0; x < launch->listen_fds_cnt; x++) {
+         if (launch->listen_fds[x] == -1 || dup2(launch->listen_fds[x], LISTEN_FDS_START + x) == -1) {
+            launcher_child_error("Could not pass listening socket to the module.\n");
+         }
+      }
+      // LISTEN_PID is the PID of the module process, it is known only here
+      for (pid = getpid(); pid > 0 && len < (int) sizeof(pid_digits); pid /= 10) {
+         pid_digits[len++] = '0' + (pid % 10);
+      }
+      for (x = 0; len > 0; x++) {
+         launch->listen_pid_env[strlen("LISTEN_PID=") + x] = pid_digits[--len];
+      }
+      launch->listen_pid_env[strlen("LISTEN_PID=") + x] = 0;
+   }
+
+   execve(launch->path, launch->argv, (launch->envp != NULL ? launch->envp : environ));
+   if (errno == ENOEXEC) {
+      // A script without "#!" line is executed by the shell, as execvp() does
+      execve(LAUNCHER_SHELL, launch->sh_argv, (launch->envp != NULL ? launch->envp : environ));
+   }
+   launch->exec_errno = errno;
+   _exit(EXIT_FAILURE);
+}
+
+int launcher_open_log(const char *path)
+{
+   int fd = -1, high_fd = -1;
+
+   fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, PERM_LOGFILE);
+   if (fd == -1 || fd > STDERR_FILENO) {
+      return fd;
+   }
+   // Descriptors 0-2 could be closed (daemon mode), dup2() to stdout or stderr must not overwrite the other log
+   high_fd = fcntl(fd, F_DUPFD_CLOEXEC, STDERR_FILENO + 1);
+   close(fd);
+   return high_fd;
+}
+
+char *launcher_resolve_path(const char *name)
+{
+   char *env_path = getenv("PATH");
+   const char *dir = NULL, *dir_end = NULL;
+   char *path = NULL;
+
+   // Same lookup as execvp() does, but it is done before the module process is created
+   if (strchr(name, '/') != NULL || env_path == NULL) {
+      return strdup(name);
+   }
+   for (dir = env_path; *dir != 0; dir = (*dir_end == ':' ? dir_end + 1 : dir_end)) {
+      dir_end = strchrnul(dir, ':');
+      if (dir_end == dir) {
+         continue;
+      }
+      if (asprintf(&path, "%.*s/%s", (int) (dir_end - dir), dir, name) < 0) {
+         return NULL;
+      }
+      if (access(path, X_OK) == 0) {
+         return path;
+      }
+      free(path);
+   }
+   return strdup(name);
+}
+
+int launcher_prepare(const int module_idx, module_launch_t *launch, const char *log_path_stdout, const char *log_path_stderr)
+{
+   char timebuf[TIME_BUFFER_SIZE];
+   struct tm timeinfo;
+   time_t rawtime;
+   int x = 0, y = 0, fd = -1;
+
+   memset(launch, 0, sizeof(module_launch_t));
+   launch->stdout_fd = -1;
+   launch->stderr_fd = -1;
+   launch->cgroup_procs_fd = -1;
+   launch->numa_node = -1;
+
+   if (running_modules[module_idx].module_path == NULL) {
+      VERBOSE(N_STDOUT,"%s [ERROR] Starting module: module path is missing!\n", get_formatted_time());
+      return -1;
+   }
+   launch->argv = prep_module_args(module_idx);
+   if (launch->argv == NULL) {
+      return -1;
+   }
+   launch->path = launcher_resolve_path(running_modules[module_idx].module_path);
+   for (x = 0; launch->argv[x] != NULL; x++) {
+   }
+   // Arguments of the shell for a binary which is not in an executable format ("sh path arg1 arg2 ...")
+   launch->sh_argv = (char **) calloc(x + 2, sizeof(char *));
+   if (launch->path == NULL || launch->sh_argv == NULL) {
+      launcher_cleanup(launch);
+      return -1;
+   }
+   launch->sh_argv[0] = LAUNCHER_SHELL;
+   launch->sh_argv[1] = launch->path;
+   for (y = 1; y < x; y++) {
+      launch->sh_argv[y + 1] = launch->argv[y];
+   }
+
+   launch->stdout_fd = launcher_open_log(log_path_stdout);
+   launch->stderr_fd = launcher_open_log(log_path_stderr);
+   if (launch->stdout_fd == -1 || launch->stderr_fd == -1) {
+      VERBOSE(N_STDOUT,"%s [ERROR] Starting module: could not open log files of %s (%s)!\n", get_formatted_time(), running_modules[module_idx].module_name, strerror(errno));
+      launcher_cleanup(launch);
+      return -1;
+   }
+
+   // Module is started in its own cgroup (if cgroups are available)
+   if (cgroup_prepare_module(module_idx) == 0) {
+      launch->cgroup_procs_fd = cgroup_open_module_procs(module_idx);
+   }
+   launch->cpus_set = (placement_get_module_cpus(module_idx, &launch->cpus) == 0);
+   launch->numa_node = running_modules[module_idx].numa_node;
+
+   // Listening sockets held by supervisor are inherited by the module (hot restart)
+   hot_restart_update_sockets(module_idx);
+   if (running_modules[module_idx].module_listen_socks_cnt > 0 && launcher_prepare_listen_fds(module_idx, launch) == -1) {
+      VERBOSE(N_STDOUT,"%s [ERROR] Starting module: could not prepare listening sockets of %s!\n", get_formatted_time(), running_modules[module_idx].module_name);
+      launcher_cleanup(launch);
+      return -1;
+   }
+
+   time(&rawtime);
+   localtime_r(&rawtime, &timeinfo);
+   asctime_r(&timeinfo, timebuf);
+   for (x = 0; x < 2; x++) {
+      fd = (x == 0 ? launch->stdout_fd : launch->stderr_fd);
+      dprintf(fd, "---> %s", timebuf);
+      dprintf(fd, "%s [INFO] Supervisor - executed command: %s", get_formatted_time(), running_modules[module_idx].module_path);
+      for (y = 1; launch->argv[y] != NULL; y++) {
+         dprintf(fd, "   %s", launch->argv[y]);
+      }
+      dprintf(fd, "\n");
+   }
+   return 0;
+}
+
+int launcher_prepare_listen_fds(const int module_idx, module_launch_t *launch)
+{
+   uint32_t x = 0, environ_cnt = 0, names_len = 0, cnt = running_modules[module_idx].module_listen_socks_cnt;
+   const handover_socket_t *socks = running_modules[module_idx].module_listen_socks;
+   char *names = NULL;
+
+   launch->listen_fds = (int *) calloc(cnt, sizeof(int));
+   for (environ_cnt = 0; environ[environ_cnt] != NULL; environ_cnt++) {
+   }
+   // LISTEN_PID, LISTEN_FDS, LISTEN_FDNAMES, environment of supervisor and terminating NULL
+   launch->envp = (char **) calloc(environ_cnt + 4, sizeof(char *));
+   for (x = 0; x < cnt; x++) {
+      names_len += strlen(socks[x].name) + 1;
+   }
+   names = (char *) calloc(strlen("LISTEN_FDNAMES=") + names_len + 1, sizeof(char));
+   if (launch->listen_fds == NULL || launch->envp == NULL || names == NULL) {
+      NULLP_TEST_AND_FREE(names)
+      return -1;
+   }
+   launch->listen_fds_cnt = cnt;
+
+   strcpy(names, "LISTEN_FDNAMES=");
+   for (x = 0; x < cnt; x++) {
+      launch->listen_fds[x] = socks[x].fd;
+      if (x > 0) {
+         strcat(names, ":");
+      }
+      strcat(names, socks[x].name);
+   }
+   strcpy(launch->listen_pid_env, "LISTEN_PID=");
+   launch->envp[0] = launch->listen_pid_env;
+   launch->envp[2] = names;
+   if (asprintf(&launch->envp[1], "LISTEN_FDS=%" PRIu32, cnt) == -1) {
+      launch->envp[1] = NULL;
+      launch->envp[2] = NULL;
+      free(names);
+      return -1;
+   }
+   for (x = 0, cnt = 3; x < environ_cnt; x++) {
+      // Variables of a socket activated supervisor are not passed to modules
+      if (strncmp(environ[x], "LISTEN_", strlen("LISTEN_")) != 0) {
+         launch->envp[cnt++] = environ[x];
+      }
+   }
+   return 0;
+}
+
+pid_t launcher_spawn(module_launch_t *launch)
+{
+   sigset_t all_signals, old_sigmask;
+   pid_t pid = -1;
+
+   if (launcher_stack == NULL) {
+      launcher_stack = (char *) malloc(LAUNCHER_STACK_SIZE);
+      if (launcher_stack == NULL) {
+         return -1;
+      }
+   }
+   /* Signals are blocked until the module process resets handlers of supervisor.
+    * CLONE_VFORK suspends the calling thread until execve() or exit of the module process,
+    * page tables of supervisor are not copied. */
+   sigfillset(&all_signals);
+   pthread_sigmask(SIG_SETMASK, &all_signals, &old_sigmask);
+   pid = clone(launcher_child, launcher_stack + LAUNCHER_STACK_SIZE, CLONE_VM | CLONE_VFORK | SIGCHLD, launch);
+   pthread_sigmask(SIG_SETMASK, &old_sigmask, NULL);
+   return pid;
+}
+
+void launcher_cleanup(module_launch_t *launch)
+{
+   int x = 0;
+
+   if (launch->argv != NULL) {
+      for (x = 0; launch->argv[x] != NULL; x++) {
+         free(launch->argv[x]);
+      }
+      NULLP_TEST_AND_FREE(launch->argv)
+   }
+   // Strings of sh_argv are owned by argv and path
+   NULLP_TEST_AND_FREE(launch->sh_argv)
+   NULLP_TEST_AND_FREE(launch->path)
+   if (launch->stdout_fd != -1) {
+      close(launch->stdout_fd);
+      launch->stdout_fd = -1;
+   }
+   if (launch->stderr_fd != -1) {
+      close(launch->stderr_fd);
+      launch->stderr_fd = -1;
+   }
+   if (launch->cgroup_procs_fd != -1) {
+      close(launch->cgroup_procs_fd);
+      launch->cgroup_procs_fd = -1;
+   }
+   // Sockets in listen_fds are owned by module_listen_socks of the module
+   NULLP_TEST_AND_FREE(launch->listen_fds)
+   launch->listen_fds_cnt = 0;
+   if (launch->envp != NULL) {
+      // Strings from environ are not owned by envp, only LISTEN_FDS and LISTEN_FDNAMES are allocated
+      NULLP_TEST_AND_FREE(launch->envp[1])
+      NULLP_TEST_AND_FREE(launch->envp[2])
+      NULLP_TEST_AND_FREE(launch->envp)
+   }
+}
+
+
+/*****************************************************************
+ * Dataflow functions *
+ *****************************************************************/
+
+int dataflow_tcp_connects(const interface_t *out_ifc, const interface_t *in_ifc)
+{
+   const char *in_port = NULL, *in_host_end = NULL;
+   size_t out_port_len = 0, in_port_len = 0, in_host_len = 0;
+
+   if (out_ifc->int_ifc_type != TCP_MODULE_IFC_TYPE || in_ifc->int_ifc_type != TCP_MODULE_IFC_TYPE ||
+       out_ifc->int_ifc_direction != OUT_MODULE_IFC_DIRECTION || in_ifc->int_ifc_direction != IN_MODULE_IFC_DIRECTION ||
+       out_ifc->ifc_params == NULL || in_ifc->ifc_params == NULL) {
+      return FALSE;
+   }
+   // Output interface listens on the port given by the first parameter
+   out_port_len = strcspn(out_ifc->ifc_params, ":");
+
+   // Input interface connects to "port" (localhost), "host:port" or "host,port" (previous format)
+   in_host_end = in_ifc->ifc_params + strcspn(in_ifc->ifc_params, ":,");
+   if (strspn(in_ifc->ifc_params, "0123456789") == (size_t) (in_host_end - in_ifc->ifc_params)) {
+      in_port = in_ifc->ifc_params;
+   } else if (*in_host_end != 0) {
+      in_host_len = in_host_end - in_ifc->ifc_params;
+      // Only modules connected on this machine are ordered
+      if (!((in_host_len == strlen("localhost") && strncmp(in_ifc->ifc_params, "localhost", in_host_len) == 0) ||
+            (in_host_len == strlen("127.0.0.1") && strncmp(in_ifc->ifc_params, "127.0.0.1", in_host_len) == 0))) {
+         return FALSE;
+      }
+      in_port = in_host_end + 1;
+   } else {
+      return FALSE;
+   }
+   in_port_len = strcspn(in_port, ":,");
+   return (out_port_len > 0 && out_port_len == in_port_len && strncmp(out_ifc->ifc_params, in_port, out_port_len) == 0);
+}
+
+int dataflow_modules_connected(const int producer_idx, const int consumer_idx)
+{
+   unsigned int x = 0, y = 0;
+   const interface_t *out_ifc = NULL, *in_ifc = NULL;
+
+   for (x = 0; x < running_modules[producer_idx].config_ifces_cnt; x++) {
+      out_ifc = &running_modules[producer_idx].config_ifces[x];
+      if (out_ifc->int_ifc_direction != OUT_MODULE_IFC_DIRECTION) {
+         continue;
+      }
+      for (y = 0; y < running_modules[consumer_idx].config_ifces_cnt; y++) {
+         in_ifc = &running_modules[consumer_idx].config_ifces[y];
+         if (placement_unixsocket_connects(out_ifc, in_ifc) || dataflow_tcp_connects(out_ifc, in_ifc)) {
+            return TRUE;
+         }
+      }
+   }
+   return FALSE;
+}
+
+void dataflow_update_graph()
+{
+   uint32_t x = 0, y = 0, edges_arr_size = 0, processed_cnt = 0, queue_head = 0;
+   uint32_t *in_degree = NULL, *queue = NULL;
+   dataflow_edge_t *new_edges = NULL;
+
+   if (dataflow_graph_generation == modules_config_generation) {
+      return;
+   }
+   dataflow_graph_generation = modules_config_generation;
+   NULLP_TEST_AND_FREE(dataflow_edges)
+   dataflow_edges_cnt = 0;
+   dataflow_max_wave = 0;
+   for (x = 0; x < loaded_modules_cnt; x++) {
+      running_modules[x].startup_wave = 0;
+   }
+
+   // Edge producer -> consumer for every pair of modules connected by an output and an input interface
+   for (x = 0; x < loaded_modules_cnt; x++) {
+      for (y = 0; y < loaded_modules_cnt; y++) {
+         if (x == y || dataflow_modules_connected(x, y) == FALSE) {
+            continue;
+         }
+         if (dataflow_edges_cnt == edges_arr_size) {
+            edges_arr_size = (edges_arr_size == 0 ? loaded_modules_cnt : 2 * edges_arr_size);
+            new_edges = (dataflow_edge_t *) realloc(dataflow_edges, edges_arr_size * sizeof(dataflow_edge_t));
+            if (new_edges == NULL) {
+               VERBOSE(N_STDOUT, "%s [ERROR] Could not allocate memory for dataflow graph of modules, modules are started without ordering.\n", get_formatted_time());
+               dataflow_edges_cnt = 0;
+               return;
+            }
+            dataflow_edges = new_edges;
+         }
+         dataflow_edges[dataflow_edges_cnt].producer = x;
+         dataflow_edges[dataflow_edges_cnt].consumer = y;
+         dataflow_edges_cnt++;
+      }
+   }
+   if (dataflow_edges_cnt == 0) {
+      return;
+   }
+
+   // Topological sort, the wave of a module is the length of the longest path from a module without producers
+   in_degree = (uint32_t *) calloc(loaded_modules_cnt, sizeof(uint32_t));
+   queue = (uint32_t *) calloc(loaded_modules_cnt, sizeof(uint32_t));
+   if (in_degree == NULL || queue == NULL) {
+      dataflow_edges_cnt = 0;
+      goto cleanup;
+   }
+   for (x = 0; x < dataflow_edges_cnt; x++) {
+      in_degree[dataflow_edges[x].consumer]++;
+   }
+   for (x = 0; x < loaded_modules_cnt; x++) {
+      if (in_degree[x] == 0) {
+         queue[processed_cnt++] = x;
+      }
+   }
+   while (queue_head < processed_cnt) {
+      x = queue[queue_head++];
+      for (y = 0; y < dataflow_edges_cnt; y++) {
+         if (dataflow_edges[y].producer != x) {
+            continue;
+         }
+         if (running_modules[dataflow_edges[y].consumer].startup_wave < running_modules[x].startup_wave + 1) {
+            running_modules[dataflow_edges[y].consumer].startup_wave = running_modules[x].startup_wave + 1;
+         }
+         if (--in_degree[dataflow_edges[y].consumer] == 0) {
+            queue[processed_cnt++] = dataflow_edges[y].consumer;
+         }
+      }
+      if (running_modules[x].startup_wave > dataflow_max_wave) {
+         dataflow_max_wave = running_modules[x].startup_wave;
+      }
+   }
+
+   // Modules in a cycle are started in the last wave, edges which do not lead to a later wave are dropped
+   if (processed_cnt < loaded_modules_cnt) {
+      dataflow_max_wave++;
+      for (x = 0; x < loaded_modules_cnt; x++) {
+         if (in_degree[x] != 0) {
+            running_modules[x].startup_wave = dataflow_max_wave;
+         }
+      }
+      VERBOSE(SUP_LOG, "%s [STARTUP] Interfaces of %u modules form a cycle, they are started together in the last wave.\n", get_formatted_time(), loaded_modules_cnt - processed_cnt);
+   }
+   for (x = 0, y = 0; x < dataflow_edges_cnt; x++) {
+      if (running_modules[dataflow_edges[x].producer].startup_wave < running_modules[dataflow_edges[x].consumer].startup_wave) {
+         dataflow_edges[y++] = dataflow_edges[x];
+      }
+   }
+   dataflow_edges_cnt = y;
+   VERBOSE(DEBUG, "%s [STARTUP] Dataflow graph of modules has %u edges, modules are started in %u waves.\n", get_formatted_time(), dataflow_edges_cnt, dataflow_max_wave + 1);
+
+cleanup:
+   NULLP_TEST_AND_FREE(in_degree)
+   NULLP_TEST_AND_FREE(queue)
+}
+
+int dataflow_producers_ready(const int module_idx)
+{
+   uint32_t x = 0, producer = 0;
+
+   for (x = 0; x < dataflow_edges_cnt; x++) {
+      if (dataflow_edges[x].consumer != module_idx) {
+         continue;
+      }
+      producer = dataflow_edges[x].producer;
+      // Producers which are not going to run are not waited for
+      if (running_modules[producer].modules_profile == NULL || running_modules[producer].modules_profile->profile_enabled == FALSE ||
+          running_modules[producer].module_enabled == FALSE) {
+         continue;
+      }
+      if (running_modules[producer].module_status == FALSE ||
+          (running_modules[producer].module_service_ifc_isconnected == FALSE && running_modules[producer].startup_probing == TRUE)) {
+         return FALSE;
+      }
+   }
+   return TRUE;
+}
+
+/*****************************************************************
+ * Hot restart functions *
+ *****************************************************************/
+
+int hot_restart_open_socket(const int ifc_type, const char *name)
+{
+   union tcpip_socket_addr addr;
+   struct addrinfo *addr_list = NULL, *ai = NULL;
+   int fd = -1, on = 1;
+
+   memset(&addr, 0, sizeof(addr));
+   if (ifc_type == UNIXSOCKET_MODULE_IFC_TYPE) {
+      addr.unix_addr.sun_family = AF_UNIX;
+      snprintf(addr.unix_addr.sun_path, sizeof(addr.unix_addr.sun_path) - 1, trap_default_socket_path_format, name);
+      fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+      if (fd == -1) {
+         return -1;
+      }
+      // Socket file left by a killed module
+      unlink(addr.unix_addr.sun_path);
+      if (bind(fd, (struct sockaddr *) &addr.unix_addr, sizeof(addr.unix_addr)) == -1 || listen(fd, SOMAXCONN) == -1) {
+         close(fd);
+         return -1;
+      }
+      return fd;
+   }
+
+   // Output TCP interface listens on all addresses (the same way as libtrap does)
+   addr.tcpip_addr.ai_family = AF_UNSPEC;
+   addr.tcpip_addr.ai_socktype = SOCK_STREAM;
+   addr.tcpip_addr.ai_flags = AI_PASSIVE;
+   if (getaddrinfo(NULL, name, &addr.tcpip_addr, &addr_list) != 0) {
+      return -1;
+   }
+   for (ai = addr_list; ai != NULL; ai = ai->ai_next) {
+      fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+      if (fd == -1) {
+         continue;
+      }
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+      if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, SOMAXCONN) == 0) {
+         break;
+      }
+      close(fd);
+      fd = -1;
+   }
+   freeaddrinfo(addr_list);
+   return fd;
+}
+
+void hot_restart_close_sockets(const int module_idx)
+{
+   char path[PATH_MAX];
+   uint32_t x = 0;
+
+   for (x = 0; x < running_modules[module_idx].module_listen_socks_cnt; x++) {
+      if (running_modules[module_idx].module_listen_socks[x].fd != -1) {
+         close(running_modules[module_idx].module_listen_socks[x].fd);
+         if (running_modules[module_idx].module_listen_socks[x].ifc_type == UNIXSOCKET_MODULE_IFC_TYPE) {
+            snprintf(path, PATH_MAX, trap_default_socket_path_format, running_modules[module_idx].module_listen_socks[x].name);
+            unlink(path);
+         }
+      }
+      NULLP_TEST_AND_FREE(running_modules[module_idx].module_listen_socks[x].name)
+   }
+   NULLP_TEST_AND_FREE(running_modules[module_idx].module_listen_socks)
+   running_modules[module_idx].module_listen_socks_cnt = 0;
+}
+
+void hot_restart_update_sockets(const int module_idx)
+{
+   handover_socket_t *old_socks = running_modules[module_idx].module_listen_socks, *new_socks = NULL;
+   uint32_t old_socks_cnt = running_modules[module_idx].module_listen_socks_cnt, new_socks_cnt = 0, x = 0, y = 0;
+   const interface_t *ifc = NULL;
+
+   // Stock TRAP library binds its sockets itself, they are held only for modules which take them from LISTEN_FDS
+   if (running_modules[module_idx].module_hot_restart == FALSE || running_modules[module_idx].module_listen_fds == FALSE) {
+      hot_restart_close_sockets(module_idx);
+      return;
+   }
+   if (running_modules[module_idx].config_ifces_cnt > 0) {
+      new_socks = (handover_socket_t *) calloc(running_modules[module_idx].config_ifces_cnt, sizeof(handover_socket_t));
+      if (new_socks == NULL) {
+         return;
+      }
+   }
+
+   for (x = 0; x < running_modules[module_idx].config_ifces_cnt; x++) {
+      ifc = &running_modules[module_idx].config_ifces[x];
+      if (ifc->int_ifc_direction != OUT_MODULE_IFC_DIRECTION || ifc->ifc_params == NULL ||
+          (ifc->int_ifc_type != UNIXSOCKET_MODULE_IFC_TYPE && ifc->int_ifc_type != TCP_MODULE_IFC_TYPE)) {
+         continue;
+      }
+      // Name of the socket (or port) is the first parameter of the interface
+      new_socks[new_socks_cnt].name = strndup(ifc->ifc_params, strcspn(ifc->ifc_params, ":,"));
+      if (new_socks[new_socks_cnt].name == NULL) {
+         continue;
+      }
+      new_socks[new_socks_cnt].ifc_type = ifc->int_ifc_type;
+      new_socks[new_socks_cnt].fd = -1;
+      // The socket of unchanged interface is kept, so the clients connect to the same socket as before
+      for (y = 0; y < old_socks_cnt; y++) {
+         if (old_socks[y].fd != -1 && old_socks[y].ifc_type == ifc->int_ifc_type && strcmp(old_socks[y].name, new_socks[new_socks_cnt].name) == 0) {
+            new_socks[new_socks_cnt].fd = old_socks[y].fd;
+            old_socks[y].fd = -1;
+            break;
+         }
+      }
+      if (new_socks[new_socks_cnt].fd == -1) {
+         new_socks[new_socks_cnt].fd = hot_restart_open_socket(ifc->int_ifc_type, new_socks[new_socks_cnt].name);
+         if (new_socks[new_socks_cnt].fd == -1) {
+            VERBOSE(MODULE_EVENT, "%s [WARNING] Could not create listening socket \"%s\" of module %s (%s), the module creates it itself.\n",
+                    get_formatted_time(), new_socks[new_socks_cnt].name, running_modules[module_idx].module_name, strerror(errno));
+            NULLP_TEST_AND_FREE(new_socks[new_socks_cnt].name)
+            continue;
+         }
+      }
+      new_socks_cnt++;
+   }
+
+   // Sockets of removed interfaces are closed
+   hot_restart_close_sockets(module_idx);
+   if (new_socks_cnt == 0) {
+      NULLP_TEST_AND_FREE(new_socks)
+   }
+   running_modules[module_idx].module_listen_socks = new_socks;
+   running_modules[module_idx].module_listen_socks_cnt = new_socks_cnt;
+}
+
+void hot_restart_module(const int module_idx)
+{
+   VERBOSE(MODULE_EVENT, "%s [RESTART] Hot restart of module %s, the previous instance (PID: %d) is stopped after the new one is ready.\n",
+           get_formatted_time(), running_modules[module_idx].module_name, running_modules[module_idx].module_pid);
+
+   // The running instance keeps its sockets and connections until the new instance is ready
+   running_modules[module_idx].module_retiring_pid = running_modules[module_idx].module_pid;
+   running_modules[module_idx].module_retiring_pidfd = running_modules[module_idx].module_pidfd;
+   running_modules[module_idx].module_retiring_stop_state = MODULE_STOP_NONE;
+   running_modules[module_idx].module_pidfd = -1;
+   service_disconnect_from_module(module_idx);
+   close_module_proc_fds(module_idx);
+   running_modules[module_idx].module_pid = 0;
+   running_modules[module_idx].module_status = FALSE;
+   running_modules[module_idx].module_restart_cnt = -1;
+   service_start_module(module_idx);
+}
+
+void hot_restart_reap_retiring_module(const int module_idx)
+{
+   pid_t result;
+   int status = 0;
+
+   result = waitpid(running_modules[module_idx].module_retiring_pid, &status, WNOHANG);
+   if (result == 0 || (result == -1 && errno != ECHILD)) {
+      return;
+   }
+   if (result > 0 && WIFSIGNALED(status)) {
+      VERBOSE(MODULE_EVENT, "%s [STOP] Previous instance of module \"%s\" (PID: %d) was terminated by signal %d.\n",
+              get_formatted_time(), running_modules[module_idx].module_name, running_modules[module_idx].module_retiring_pid, WTERMSIG(status));
+   } else {
+      VERBOSE(MODULE_EVENT, "%s [STOP] Previous instance of module \"%s\" (PID: %d) finished.\n",
+              get_formatted_time(), running_modules[module_idx].module_name, running_modules[module_idx].module_retiring_pid);
+   }
+   if (running_modules[module_idx].module_retiring_pidfd != -1) {
+      close(running_modules[module_idx].module_retiring_pidfd);
+      running_modules[module_idx].module_retiring_pidfd = -1;
+   }
+   running_modules[module_idx].module_retiring_pid = 0;
+   running_modules[module_idx].module_retiring_stop_state = MODULE_STOP_NONE;
+}
+
+void hot_restart_stop_retiring_modules()
+{
+   unsigned int x = 0;
+   int stop_timeout = 0;
+   uint64_t now = get_monotonic_time_ms();
+
+   for (x = 0; x < loaded_modules_cnt; x++) {
+      if (running_modules[x].module_retiring_pid <= 0) {
+         continue;
+      }
+      // Without pidfd, the exit of the previous instance is checked in every pass (it is woken up by SIGCHLD)
+      if (running_modules[x].module_retiring_pidfd == -1) {
+         hot_restart_reap_retiring_module(x);
+         if (running_modules[x].module_retiring_pid == 0) {
+            continue;
+         }
+      }
+      if (running_modules[x].module_retiring_stop_state == MODULE_STOP_NONE
+          && (running_modules[x].startup_probing == FALSE || running_modules[x].module_status == FALSE)) {
+         // The new instance is ready (or it is not going to be), the previous one can finish its work
+         stop_timeout = (running_modules[x].module_stop_timeout > -1 ? running_modules[x].module_stop_timeout : DEFAULT_STOP_TIMEOUT_MS);
+         VERBOSE(MODULE_EVENT, "%s [STOP] Stopping previous instance of module %s (PID: %d)... sending SIGINT (SIGKILL in %d ms)\n",
+                 get_formatted_time(), running_modules[x].module_name, running_modules[x].module_retiring_pid, stop_timeout);
+         kill(-running_modules[x].module_retiring_pid, 2);
+         running_modules[x].module_retiring_stop_state = MODULE_STOP_SIGINT_SENT;
+         running_modules[x].module_retiring_deadline = now + stop_timeout;
+      } else if (running_modules[x].module_retiring_stop_state == MODULE_STOP_SIGINT_SENT && now >= running_modules[x].module_retiring_deadline) {
+         VERBOSE(MODULE_EVENT, "%s [STOP] Stopping previous instance of module %s (PID: %d)... sending SIGKILL\n",
+                 get_formatted_time(), running_modules[x].module_name, running_modules[x].module_retiring_pid);
+         kill(-running_modules[x].module_retiring_pid, 9);
+         running_modules[x].module_retiring_stop_state = MODULE_STOP_SIGKILL_SENT;
+      }
+   }
+}
+
+
+/*****************************************************************
+ * Modules snapshot functions *
+ *****************************************************************/
+
+modules_snapshot_t *modules_snapshot_create()
+{
+   unsigned int x = 0, y = 0;
+   size_t size = sizeof(modules_snapshot_t) + loaded_modules_cnt * sizeof(module_snapshot_t);
+   size_t strings_size = 0;
+   modules_snapshot_t *snapshot = NULL;
+   module_snapshot_t *module = NULL;
+   char *data_ptr = NULL, *str_ptr = NULL;
+
+#define SNAPSHOT_STRLEN(str) ((str) == NULL ? 0 : strlen(str) + 1)
+   // Compute the size of the whole snapshot, it is allocated as one block
+   for (x = 0; x < loaded_modules_cnt; x++) {
+      size += running_modules[x].total_in_ifces_cnt * sizeof(in_ifc_stats_t);
+      size += running_modules[x].total_out_ifces_cnt * sizeof(out_ifc_stats_t);
+      size += running_modules[x].threads_cnt * sizeof(module_thread_stats_t);
+      strings_size += SNAPSHOT_STRLEN(running_modules[x].module_name);
+      strings_size += SNAPSHOT_STRLEN(running_modules[x].module_params);
+      strings_size += SNAPSHOT_STRLEN(running_modules[x].module_path);
+      for (y = 0; y < running_modules[x].total_in_ifces_cnt; y++) {
+         strings_size += SNAPSHOT_STRLEN(running_modules[x].in_ifces_data[y].ifc_id);
+      }
+      for (y = 0; y < running_modules[x].total_out_ifces_cnt; y++) {
+         strings_size += SNAPSHOT_STRLEN(running_modules[x].out_ifces_data[y].ifc_id);
+      }
+   }
+
+   snapshot = (modules_snapshot_t *) calloc(1, size + strings_size);
+   if (snapshot == NULL) {
+      VERBOSE(SUP_LOG, "%s [ERROR] Could not allocate snapshot of modules.\n", get_formatted_time());
+      return NULL;
+   }
+   snapshot->modules_cnt = loaded_modules_cnt;
+   snapshot->modules = (module_snapshot_t *) (snapshot + 1);
+   data_ptr = (char *) (snapshot->modules + loaded_modules_cnt);
+   str_ptr = ((char *) snapshot) + size;
+
+#define SNAPSHOT_STRDUP(dest, str) do { \
+   if ((str) == NULL) { \
+      (dest) = NULL; \
+   } else { \
+      (dest) = strcpy(str_ptr, (str)); \
+      str_ptr += strlen(str) + 1; \
+   } \
+} while (0)
+
+   for (x = 0; x < loaded_modules_cnt; x++) {
+      module = &snapshot->modules[x];
+      module->module_idx = x;
+      module->module_handle = running_modules[x].module_handle;
+      SNAPSHOT_STRDUP(module->module_name, running_modules[x].module_name);
+      SNAPSHOT_STRDUP(module->module_params, running_modules[x].module_params);
+      SNAPSHOT_STRDUP(module->module_path, running_modules[x].module_path);
+      module->module_status = running_modules[x].module_status;
+      module->module_restart_cnt = running_modules[x].module_restart_cnt;
+      module->module_starts_cnt = running_modules[x].module_starts_cnt;
+      module->module_service_ifc_isconnected = running_modules[x].module_service_ifc_isconnected;
+      module->last_period_percent_cpu_usage_kernel_mode = running_modules[x].last_period_percent_cpu_usage_kernel_mode;
+      module->last_period_percent_cpu_usage_user_mode = running_modules[x].last_period_percent_cpu_usage_user_mode;
+      module->virtual_memory_size = running_modules[x].virtual_memory_size;
+      module->resident_set_size = running_modules[x].resident_set_size;
+      module->major_faults = running_modules[x].major_faults;
+      module->voluntary_ctxt_switches = running_modules[x].voluntary_ctxt_switches;
+      module->nonvoluntary_ctxt_switches = running_modules[x].nonvoluntary_ctxt_switches;
+      module->read_bytes = running_modules[x].read_bytes;
+      module->write_bytes = running_modules[x].write_bytes;
+
+      module->threads_cnt = running_modules[x].threads_cnt;
+      module->threads = (module_thread_stats_t *) data_ptr;
+      data_ptr += module->threads_cnt * sizeof(module_thread_stats_t);
+      if (module->threads_cnt > 0) {
+         memcpy(module->threads, running_modules[x].threads, module->threads_cnt * sizeof(module_thread_stats_t));
+      }
+
+      module->total_in_ifces_cnt = running_modules[x].total_in_ifces_cnt;
+      module->in_ifces_data = (in_ifc_stats_t *) data_ptr;
+      data_ptr += module->total_in_ifces_cnt * sizeof(in_ifc_stats_t);
+      for (y = 0; y < module->total_in_ifces_cnt; y++) {
+         module->in_ifces_data[y] = running_modules[x].in_ifces_data[y];
+         SNAPSHOT_STRDUP(module->in_ifces_data[y].ifc_id, running_modules[x].in_ifces_data[y].ifc_id);
+      }
+
+      module->total_out_ifces_cnt = running_modules[x].total_out_ifces_cnt;
+      module->out_ifces_data = (out_ifc_stats_t *) data_ptr;
+      data_ptr += module->total_out_ifces_cnt * sizeof(out_ifc_stats_t);
+      for (y = 0; y < module->total_out_ifces_cnt; y++) {
+         module->out_ifces_data[y] = running_modules[x].out_ifces_data[y];
+         SNAPSHOT_STRDUP(module->out_ifces_data[y].ifc_id, running_modules[x].out_ifces_data[y].ifc_id);
+      }
+   }
+#undef SNAPSHOT_STRDUP
+#undef SNAPSHOT_STRLEN
+
+   return snapshot;
+}
+
+int modules_snapshot_reclaim()
+{
+   if (modules_snapshot_retired == NULL) {
+      return TRUE;
+   }
+   if (atomic_load(&modules_snapshot_readers[modules_snapshot_retired_parity]) != 0) {
+      return FALSE;
+   }
+   free(modules_snapshot_retired);
+   modules_snapshot_retired = NULL;
+   return TRUE;
+}
+
+void modules_snapshot_publish()
+{
+   modules_snapshot_t *new_snapshot = NULL;
+   unsigned int epoch = 0;
+
+   /* Only one replaced snapshot can wait for its readers. If they have not finished yet,
+    * the publication is postponed to the next pass and readers keep the current snapshot. */
+   if (modules_snapshot_reclaim() == FALSE) {
+      return;
+   }
+
+   new_snapshot = modules_snapshot_create();
+   if (new_snapshot == NULL) {
+      return;
+   }
+   new_snapshot->version = ++modules_snapshot_version;
+
+   modules_snapshot_retired = atomic_exchange(&modules_snapshot, new_snapshot);
+   // Readers which entered in the current epoch can still use the replaced snapshot, new readers will enter in the next epoch
+   epoch = atomic_fetch_add(&modules_snapshot_epoch, 1);
+   modules_snapshot_retired_parity = epoch & 1;
+   modules_snapshot_reclaim();
+}
+
+uint64_t modules_snapshot_get_version()
+{
+   unsigned int reader_parity = 0;
+   uint64_t version = 0;
+   modules_snapshot_t *snapshot = modules_snapshot_acquire(&reader_parity);
+
+   if (snapshot != NULL) {
+      version = snapshot->version;
+   }
+   modules_snapshot_release(reader_parity);
+   return version;
+}
+
+modules_snapshot_t *modules_snapshot_acquire(unsigned int *reader_parity)
+{
+   unsigned int epoch = 0;
+
+   while (TRUE) {
+      epoch = atomic_load(&modules_snapshot_epoch);
+      atomic_fetch_add(&modules_snapshot_readers[epoch & 1], 1);
+      if (atomic_load(&modules_snapshot_epoch) == epoch) {
+         break;
+      }
+      // A snapshot was published in the meantime, the counter of this parity may be already checked by the service thread
+      atomic_fetch_sub(&modules_snapshot_readers[epoch & 1], 1);
+   }
+
+   *reader_parity = epoch & 1;
+   return atomic_load(&modules_snapshot);
+}
+
+void modules_snapshot_release(unsigned int reader_parity)
+{
+   atomic_fetch_sub(&modules_snapshot_readers[reader_parity], 1);
+}
+
+void modules_snapshot_free()
+{
+   unsigned int epoch = 0, tries = 0;
+
+   // Service thread is not running anymore, wait a while for readers of the retired snapshot
+   while (modules_snapshot_reclaim() == FALSE) {
+      if (++tries > 10) {
+         // Some client is still reading, snapshots are left to the exit of the process
+         return;
+      }
+      usleep(10000);
+   }
+   modules_snapshot_retired = atomic_exchange(&modules_snapshot, NULL);
+   epoch = atomic_fetch_add(&modules_snapshot_epoch, 1);
+   modules_snapshot_retired_parity = epoch & 1;
+   tries = 0;
+   while (modules_snapshot_reclaim() == FALSE && ++tries <= 10) {
+      usleep(10000);
+   }
+}
+
+
+/*****************************************************************
+ * Daemon mode functions *
+ *****************************************************************/
+
+int daemon_init_process()
+{
+   pid_t process_id = 0;
+   pid_t sid = 0;
+
+   process_id = fork();
+   if (process_id < 0)  {
+      VERBOSE(N_STDOUT,"%s [ERROR] Fork: could not initialize daemon process!\n", get_formatted_time());
+      return -1;
+   } else if (process_id > 0) {
+      NULLP_TEST_AND_FREE(config_files_path)
+      NULLP_TEST_AND_FREE(gener_config_file)
+      NULLP_TEST_AND_FREE(templ_config_file)
+      NULLP_TEST_AND_FREE(logs_path)
+      free_output_file_strings_and_streams();
+      fprintf(stdout, "%s [INFO] PID of daemon process: %d.\n", get_formatted_time(), process_id);
+      exit(EXIT_SUCCESS);
+   }
+
+   umask(0);
+   sid = setsid();
+   if (sid < 0) {
+      VERBOSE(N_STDOUT,"[ERROR] Setsid: calling process is process group leader!\n");
+      return -1;
+   }
+
+   return 0;
+}
+
+int daemon_init_structures()
+{
+   server_internals = (server_internals_t *) calloc(1, sizeof(server_internals_t));
+   if (server_internals == NULL) {
+      VERBOSE(N_STDOUT, "%s [ERROR] Could not allocate dameon_internals, cannot proceed without it!\n", get_formatted_time());
+      return -1;
+   }
+   server_internals->clients = NULL;
+   server_internals->epoll_fd = -1;
+   server_internals->metrics_sd = -1;
+   server_internals->subscribers_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+   if (server_internals->subscribers_event_fd == -1) {
+      VERBOSE(N_STDOUT, "%s [ERROR] Could not create eventfd for subscribed clients (%s).\n", get_formatted_time(), strerror(errno));
+      return -1;
+   }
+   // Initialize daemon's structure mutex
+   pthread_mutex_init(&server_internals->lock,NULL);
+
+   return 0;
+}
+
+int daemon_init_socket()
+{
+   union tcpip_socket_addr addr;
+   memset(&addr, 0, sizeof(addr));
+   addr.unix_addr.sun_family = AF_UNIX;
+   snprintf(addr.unix_addr.sun_path, sizeof(addr.unix_addr.sun_path) - 1, "%s", socket_path);
+
+   /* if socket file exists, it could be hard to create new socket and bind */
+   unlink(socket_path); /* error when file does not exist is not a problem */
+   server_internals->server_sd = socket(AF_UNIX, SOCK_STREAM, 0);
+   if (server_internals->server_sd == -1) {
+      VERBOSE(N_STDOUT, "%s [ERROR] Could not create daemon socket.\n", get_formatted_time());
+      return -1;
+   }
+   if (fcntl(server_internals->server_sd, F_SETFL, O_NONBLOCK) == -1) {
+      VERBOSE(N_STDOUT, "%s [ERROR] Could not set nonblocking mode on daemon socket.\n", get_formatted_time());
+      return -1;
+   }
+
+   if (bind(server_internals->server_sd, (struct sockaddr *) &addr.unix_addr, sizeof(addr.unix_addr)) != -1) {
+      if (chmod(socket_path, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH) == -1) {
+         VERBOSE(N_STDOUT, "%s [WARNING] Failed to set permissions to socket (%s)\n", get_formatted_time(), socket_path);
+      }
+   } else {
+      VERBOSE(N_STDOUT,"%s [ERROR] Bind: could not bind the daemon socket \"%s\"!\n", get_formatted_time(), socket_path);
+      return -1;
+   }
+
+   if (listen(server_internals->server_sd, SOMAXCONN) == -1) {
+      VERBOSE(N_STDOUT,"%s [ERROR] Listen: could not listen on the daemon socket \"%s\"!\n", get_formatted_time(), socket_path);
+      return -1;
+   }
+
+   if (metrics_address != NULL) {
+      server_internals->metrics_sd = metrics_open_socket(metrics_address);
+      if (server_internals->metrics_sd == -1) {
+         VERBOSE(N_STDOUT,"%s [ERROR] Could not listen on the metrics socket \"%s\"!\n", get_formatted_time(), metrics_address);
+         return -1;
+      }
+   }
+
+   return 0;
+}
+
+
+int daemon_mode_initialization()
 {
    fflush(stdout);
 
-   // initialize daemon process
-   if (daemon_init_process() != 0) {
+   // initialize daemon process
+   if (daemon_init_process() != 0) {
+      return -1;
+   }
+
+   // allocate structures needed by daemon process
+   if (daemon_init_structures() != 0) {
+      return -1;
+   }
+
+   // create socket
+   if (daemon_init_socket() != 0) {
+      return -1;
+   }
+
+   daemon_mode_initialized = TRUE;
+   VERBOSE(N_STDOUT, "%s [INFO] Daemon process successfully initialized.\n", get_formatted_time());
+   return 0;
+}
+
+
+void daemon_mode_server_routine()
+{
+   struct epoll_event ev, events[DAEMON_MAX_EVENTS];
+   sup_client_t *client = NULL;
+   uint64_t now = 0, next_timeouts_check = 0;
+   int events_cnt = 0, x = 0, ret_val = 0, send_records = FALSE;
+
+   get_total_cpu_usage(&last_total_cpu);
+
+   server_internals->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+   if (server_internals->epoll_fd == -1) {
+      VERBOSE(SUP_LOG, "%s [ERROR] Server thread: could not create epoll instance (%s).\n", get_formatted_time(), strerror(errno));
+      return;
+   }
+   // Daemon socket is registered with NULL pointer, clients with pointers to their structures
+   memset(&ev, 0, sizeof(ev));
+   ev.events = EPOLLIN;
+   ev.data.ptr = NULL;
+   if (epoll_ctl(server_internals->epoll_fd, EPOLL_CTL_ADD, server_internals->server_sd, &ev) == -1) {
+      VERBOSE(SUP_LOG, "%s [ERROR] Server thread: could not watch daemon socket (%s).\n", get_formatted_time(), strerror(errno));
+      close(server_internals->epoll_fd);
+      server_internals->epoll_fd = -1;
+      return;
+   }
+   // Eventfd and socket of metrics exporter are registered with pointers to themselves
+   ev.data.ptr = &server_internals->subscribers_event_fd;
+   if (epoll_ctl(server_internals->epoll_fd, EPOLL_CTL_ADD, server_internals->subscribers_event_fd, &ev) == -1) {
+      VERBOSE(SUP_LOG, "%s [ERROR] Server thread: could not watch eventfd of subscribed clients (%s).\n", get_formatted_time(), strerror(errno));
+      close(server_internals->epoll_fd);
+      server_internals->epoll_fd = -1;
+      return;
+   }
+   ev.data.ptr = &server_internals->metrics_sd;
+   if (server_internals->metrics_sd != -1 && epoll_ctl(server_internals->epoll_fd, EPOLL_CTL_ADD, server_internals->metrics_sd, &ev) == -1) {
+      VERBOSE(SUP_LOG, "%s [ERROR] Server thread: could not watch metrics socket (%s).\n", get_formatted_time(), strerror(errno));
+      close(server_internals->epoll_fd);
+      server_internals->epoll_fd = -1;
+      return;
+   }
+
+   VERBOSE(SUP_LOG, "%s [INFO] Starting server thread.\n", get_formatted_time());
+   while (server_internals->daemon_terminated == FALSE) {
+      events_cnt = epoll_wait(server_internals->epoll_fd, events, DAEMON_MAX_EVENTS, DAEMON_SERVER_WAIT_TIMEOUT_MS);
+      if (events_cnt == -1) {
+         if (errno == EINTR) {
+            continue;
+         }
+         VERBOSE(SUP_LOG, "%s [ERROR] Server thread: epoll_wait call failed.\n", get_formatted_time());
+         break;
+      }
+
+      send_records = FALSE;
+      for (x = 0; x < events_cnt; x++) {
+         client = (sup_client_t *) events[x].data.ptr;
+         if (client == NULL) {
+            daemon_accept_clients(server_internals->server_sd, FALSE);
+         } else if (events[x].data.ptr == &server_internals->subscribers_event_fd) {
+            // Sending of records can disconnect any subscribed client, so it waits until no event refers to clients
+            send_records = TRUE;
+         } else if (events[x].data.ptr == &server_internals->metrics_sd) {
+            daemon_accept_clients(server_internals->metrics_sd, TRUE);
+         } else if (client->client_state == DAEMON_CLIENT_READING_HTTP) {
+            ret_val = metrics_get_request(client);
+            if (ret_val < 0) {
+               daemon_disconnect_client(client);
+            } else if (ret_val == 1) {
+               metrics_serve_request(client);
+            }
+         } else if (client->client_state == DAEMON_CLIENT_READING_CODE) {
+            // get code from client according to operation he wants to perform
+            ret_val = daemon_get_code_from_client(client);
+            if (ret_val == -2) {
+               VERBOSE(SUP_LOG, "[ERROR] Client has disconnected -> gonna wait for new client\n");
+               daemon_disconnect_client(client);
+            } else if (ret_val == -1) {
+               VERBOSE(SUP_LOG, "[ERROR] Error while waiting for a mode-code from client -> gonna wait for new client\n");
+               daemon_disconnect_client(client);
+            } else if (ret_val != 0) {
+               daemon_serve_client_code(client, ret_val);
+            }
+         } else if (client->client_state == DAEMON_CLIENT_SENDING_REPLY) {
+            ret_val = daemon_send_reply(client);
+            if (ret_val == 1) {
+               VERBOSE((client->client_http == TRUE ? DEBUG : SUP_LOG), "%s [INFO] Reply sent to client. (client's ID: %d)\n", get_formatted_time(), client->client_id);
+               daemon_disconnect_client(client);
+            } else if (ret_val == -1) {
+               VERBOSE(SUP_LOG, "%s [WARNING] Could not send reply to client. (client's ID: %d)\n", get_formatted_time(), client->client_id);
+               daemon_disconnect_client(client);
+            }
+         } else if (client->client_state == DAEMON_CLIENT_SUBSCRIBED) {
+            daemon_serve_subscriber(client, events[x].events);
+         }
+      }
+
+      // Records are sent and clients are checked after all events are processed, so no event refers to a freed client
+      if (send_records == TRUE) {
+         daemon_send_records();
+      }
+      now = get_monotonic_time_ms();
+      if (now >= next_timeouts_check) {
+         daemon_check_clients_timeouts(now);
+         next_timeouts_check = now + DAEMON_SERVER_WAIT_TIMEOUT_MS;
+      }
+      daemon_resume_accept(now);
+   }
+
+   // Clients in configuration mode are disconnected by their threads
+   while (server_internals->clients != NULL) {
+      daemon_disconnect_client(server_internals->clients);
+   }
+   for (x = 0; x < DAEMON_REPLY_TYPES_CNT; x++) {
+      if (server_internals->cached_replies[x] != NULL) {
+         daemon_release_shared_reply(server_internals->cached_replies[x]);
+         server_internals->cached_replies[x] = NULL;
+      }
+   }
+   close(server_internals->epoll_fd);
+   server_internals->epoll_fd = -1;
+   return;
+}
+
+void daemon_pause_accept()
+{
+   struct epoll_event ev;
+
+   if (server_internals->accept_resume_time == 0) {
+      VERBOSE(SUP_LOG, "%s [WARNING] Server thread: out of file descriptors, new clients are accepted after a client disconnects.\n", get_formatted_time());
+   }
+   pthread_mutex_lock(&server_internals->lock);
+   server_internals->accept_paused_clients_cnt = server_internals->clients_cnt;
+   pthread_mutex_unlock(&server_internals->lock);
+   // Descriptors can be released also by modules, so accepting is retried after a while anyway
+   server_internals->accept_resume_time = get_monotonic_time_ms() + DAEMON_ACCEPT_RETRY_MS;
+
+   memset(&ev, 0, sizeof(ev));
+   ev.data.ptr = NULL;
+   epoll_ctl(server_internals->epoll_fd, EPOLL_CTL_MOD, server_internals->server_sd, &ev);
+   if (server_internals->metrics_sd != -1) {
+      ev.data.ptr = &server_internals->metrics_sd;
+      epoll_ctl(server_internals->epoll_fd, EPOLL_CTL_MOD, server_internals->metrics_sd, &ev);
+   }
+}
+
+void daemon_resume_accept(const uint64_t now)
+{
+   struct epoll_event ev;
+   int clients_cnt = 0;
+
+   pthread_mutex_lock(&server_internals->lock);
+   clients_cnt = server_internals->clients_cnt;
+   pthread_mutex_unlock(&server_internals->lock);
+   if (server_internals->accept_resume_time == 0 || (clients_cnt >= server_internals->accept_paused_clients_cnt && now < server_internals->accept_resume_time)) {
+      return;
+   }
+   server_internals->accept_resume_time = 0;
+
+   memset(&ev, 0, sizeof(ev));
+   ev.events = EPOLLIN;
+   ev.data.ptr = NULL;
+   epoll_ctl(server_internals->epoll_fd, EPOLL_CTL_MOD, server_internals->server_sd, &ev);
+   if (server_internals->metrics_sd != -1) {
+      ev.data.ptr = &server_internals->metrics_sd;
+      epoll_ctl(server_internals->epoll_fd, EPOLL_CTL_MOD, server_internals->metrics_sd, &ev);
+   }
+}
+
+void daemon_accept_clients(const int listen_sd, const int http)
+{
+   struct epoll_event ev;
+   sup_client_t *client = NULL;
+   int new_client = -1;
+
+   while (1) {
+      new_client = accept4(listen_sd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (new_client == -1) {
+         if (errno == EINTR || errno == ECONNABORTED) {
+            // Some client wanted to connect but before accepting, he canceled the connection attempt
+            continue;
+         } else if (errno == EMFILE || errno == ENFILE) {
+            // Pending connection keeps the socket readable, so it would be reported again and again
+            daemon_pause_accept();
+         } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            VERBOSE(SUP_LOG,"%s [ERROR] Server thread: accept call failed (%s).\n", get_formatted_time(), strerror(errno));
+         }
+         return;
+      }
+
+      pthread_mutex_lock(&server_internals->lock);
+      if (server_internals->clients_cnt >= MAX_NUMBER_SUP_CLIENTS) {
+         pthread_mutex_unlock(&server_internals->lock);
+         // Daemon cannot accept another client -> reject the new client
+         VERBOSE(SUP_LOG, "[WARNING] New client has connected, but there is too many clients - cannot accept another one.\n");
+         close(new_client);
+         continue;
+      }
+      server_internals->clients_cnt++;
+      pthread_mutex_unlock(&server_internals->lock);
+
+      client = (sup_client_t *) calloc(1, sizeof(sup_client_t));
+      if (client == NULL) {
+         VERBOSE(SUP_LOG, "%s [ERROR] Could not allocate structure for a new client.\n", get_formatted_time());
+         close(new_client);
+         pthread_mutex_lock(&server_internals->lock);
+         server_internals->clients_cnt--;
+         pthread_mutex_unlock(&server_internals->lock);
+         continue;
+      }
+      client->client_sd = new_client;
+      client->client_input_stream_fd = -1;
+      client->client_id = server_internals->next_client_id;
+      client->client_connected = TRUE;
+      client->client_http = http;
+      client->client_state = (http == TRUE ? DAEMON_CLIENT_READING_HTTP : DAEMON_CLIENT_READING_CODE);
+      client->client_deadline = get_monotonic_time_ms() + DAEMON_CLIENT_TIMEOUT_MS;
+      server_internals->next_client_id++;
+      pthread_mutex_lock(&server_internals->lock);
+      client->next = server_internals->clients;
+      if (server_internals->clients != NULL) {
+         server_internals->clients->prev = client;
+      }
+      server_internals->clients = client;
+      pthread_mutex_unlock(&server_internals->lock);
+
+      memset(&ev, 0, sizeof(ev));
+      ev.events = EPOLLIN;
+      ev.data.ptr = client;
+      if (epoll_ctl(server_internals->epoll_fd, EPOLL_CTL_ADD, client->client_sd, &ev) == -1) {
+         VERBOSE(SUP_LOG, "%s [ERROR] Server thread: could not watch client's socket (%s).\n", get_formatted_time(), strerror(errno));
+         daemon_disconnect_client(client);
+         continue;
+      }
+      // Scrapes of metrics would flood the supervisor log
+      VERBOSE((http == TRUE ? DEBUG : SUP_LOG),"%s [INFO] New client has connected. (client's ID: %d)\n", get_formatted_time(), client->client_id);
+   }
+}
+
+int daemon_get_code_from_client(sup_client_t *cli)
+{
+   char *code_end = cli->client_code + cli->client_code_len;
+   char *newline = NULL;
+   ssize_t len = 0;
+   int request = -1;
+
+   // Data are peeked first, only the line with the code is consumed
+   len = recv(cli->client_sd, code_end, DAEMON_CLIENT_CODE_SIZE - 1 - cli->client_code_len, MSG_PEEK);
+   if (len == 0) {
+      // client has disconnected
+      return -2;
+   } else if (len == -1) {
+      return ((errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1);
+   }
+   newline = (char *) memchr(code_end, '\n', len);
+   if (newline != NULL) {
+      len = newline - code_end + 1;
+   }
+   if (recv(cli->client_sd, code_end, len, 0) != len) {
       return -1;
    }
+   cli->client_code_len += len;
+   if (newline == NULL) {
+      // wait for the rest of the code, too long code is an error
+      return (cli->client_code_len >= DAEMON_CLIENT_CODE_SIZE - 1 ? -1 : 0);
+   }
+   cli->client_code[cli->client_code_len] = '\0';
 
-   // allocate structures needed by daemon process
-   if (daemon_init_structures() != 0) {
+   if (sscanf(cli->client_code, "%d", &request) != 1) {
+      // wrong format of code
       return -1;
    }
 
-   // create socket
-   if (daemon_init_socket() != 0) {
+   switch (request) {
+   case CLIENT_CONFIG_MODE_CODE:
+   case CLIENT_RELOAD_MODE_CODE:
+   case CLIENT_STATS_MODE_CODE:
+   case CLIENT_INFO_MODE_CODE:
+   case CLIENT_SUBSCRIBE_MODE_CODE:
+   case CLIENT_DELTA_SUBSCRIBE_MODE_CODE:
+      return request;
+
+   default:
+      // unknown code
       return -1;
    }
+}
 
-   daemon_mode_initialized = TRUE;
-   VERBOSE(N_STDOUT, "%s [INFO] Daemon process successfully initialized.\n", get_formatted_time());
-   return 0;
+void daemon_serve_client_code(sup_client_t *cli, const int code)
+{
+   pthread_t thread_id;
+   json_t *modules_obj = NULL;
+   shared_reply_t *shared_reply = NULL;
+   char *reply = NULL;
+   int newline = FALSE;
+
+   switch (code) {
+   case CLIENT_CONFIG_MODE_CODE: // normal client configure mode -> pass the client to its own thread
+      // Check whether any client is already connected in config mode
+      pthread_mutex_lock(&server_internals->lock);
+      if (server_internals->config_mode_active == TRUE) {
+         pthread_mutex_unlock(&server_internals->lock);
+         VERBOSE(SUP_LOG, "%s [INFO] Got configuration mode code, but another client is already connected in this mode. (client's ID: %d)\n", get_formatted_time(), cli->client_id);
+         reply = strdup(FORMAT_WARNING "[WARNING] Another client is connected to supervisor in configuration mode, you have to wait.\n" FORMAT_RESET);
+         break;
+      }
+      VERBOSE(SUP_LOG, "%s [INFO] Got configuration mode code. (client's ID: %d)\n", get_formatted_time(), cli->client_id);
+      server_internals->config_mode_active = TRUE;
+      pthread_mutex_unlock(&server_internals->lock);
+
+      // The session is interactive and uses blocking streams, so it must not be served by the server thread
+      epoll_ctl(server_internals->epoll_fd, EPOLL_CTL_DEL, cli->client_sd, NULL);
+      pthread_mutex_lock(&server_internals->lock);
+      if (cli->prev != NULL) {
+         cli->prev->next = cli->next;
+      } else {
+         server_internals->clients = cli->next;
+      }
+      if (cli->next != NULL) {
+         cli->next->prev = cli->prev;
+      }
+      cli->prev = cli->next = NULL;
+      cli->client_state = DAEMON_CLIENT_CONFIG_MODE;
+      pthread_mutex_unlock(&server_internals->lock);
+      if (pthread_create(&thread_id, NULL, daemon_serve_client_routine, (void *) cli) != 0) {
+         VERBOSE(SUP_LOG, "%s [ERROR] Could not create client's thread.\n", get_formatted_time());
+         pthread_mutex_lock(&server_internals->lock);
+         server_internals->config_mode_active = FALSE;
+         pthread_mutex_unlock(&server_internals->lock);
+         daemon_disconnect_client(cli);
+         return;
+      }
+      pthread_detach(thread_id);
+      return;
+
+   case CLIENT_RELOAD_MODE_CODE: // just reload configuration and wait for new client
+      VERBOSE(SUP_LOG, "%s [INFO] Got reload mode code. (client's ID: %d)\n", get_formatted_time(), cli->client_id);
+      daemon_disconnect_client(cli);
+      if (pthread_create(&thread_id, NULL, daemon_reload_routine, NULL) != 0) {
+         reload_configuration(RELOAD_DEFAULT_CONFIG_FILE, NULL);
+      } else {
+         pthread_detach(thread_id);
+      }
+      return;
+
+   case CLIENT_STATS_MODE_CODE: // send stats to current client and wait for new one
+      VERBOSE(SUP_LOG, "%s [INFO] Got modules_stats_mode code. (client's ID: %d)\n", get_formatted_time(), cli->client_id);
+      shared_reply = daemon_get_shared_reply(DAEMON_REPLY_STATS);
+      break;
+
+   case CLIENT_INFO_MODE_CODE:
+      VERBOSE(SUP_LOG, "%s [INFO] Got modules_info_mode code. (client's ID: %d)\n", get_formatted_time(), cli->client_id);
+      shared_reply = daemon_get_shared_reply(DAEMON_REPLY_INFO);
+      // Info is terminated by a new line
+      newline = TRUE;
+      break;
+
+   case CLIENT_SUBSCRIBE_MODE_CODE: // keep the client connected and send it stats after every period
+   case CLIENT_DELTA_SUBSCRIBE_MODE_CODE:
+      VERBOSE(SUP_LOG, "%s [INFO] Got %ssubscribe mode code. (client's ID: %d)\n", get_formatted_time(),
+              (code == CLIENT_DELTA_SUBSCRIBE_MODE_CODE ? "delta " : ""), cli->client_id);
+      if (daemon_parse_subscriber_filter(cli) != 0) {
+         VERBOSE(SUP_LOG, "%s [ERROR] Could not parse names of modules of subscribed client. (client's ID: %d)\n", get_formatted_time(), cli->client_id);
+         daemon_disconnect_client(cli);
+         return;
+      }
+      cli->client_state = DAEMON_CLIENT_SUBSCRIBED;
+      cli->client_delta = (code == CLIENT_DELTA_SUBSCRIBE_MODE_CODE ? TRUE : FALSE);
+      atomic_fetch_add(&server_internals->subscribers_cnt, 1);
+      // The first record is sent immediately (keyframe in delta mode), the next ones after every period of service thread
+      if (cli->client_delta == FALSE && cli->client_filter_cnt == 0) {
+         shared_reply = daemon_get_shared_reply(DAEMON_REPLY_STATS);
+      } else {
+         modules_obj = make_json_modules_object(0, NULL);
+         if (modules_obj != NULL) {
+            if (cli->client_delta == TRUE) {
+               reply = daemon_make_delta_record(cli, modules_obj, server_internals->records_version);
+            } else {
+               reply = daemon_make_record(modules_obj, cli->client_filter, cli->client_filter_cnt);
+            }
+            json_decref(modules_obj);
+         }
+      }
+      if (reply == NULL && shared_reply == NULL) {
+         VERBOSE(SUP_LOG, "%s [INFO] JSON data was not created successfully -> modules info could not be sent to client. (client's ID: %d)\n", get_formatted_time(), cli->client_id);
+         daemon_disconnect_client(cli);
+         return;
+      }
+      daemon_send_record(cli, reply, shared_reply);
+      return;
+
+   default: // just in case of unknown code.. clean up and wait for new client
+      daemon_disconnect_client(cli);
+      return;
+   }
+
+   // There is nothing to send if no module matches the request
+   if (shared_reply != NULL && shared_reply->modules_cnt == 0) {
+      daemon_release_shared_reply(shared_reply);
+      shared_reply = NULL;
+   }
+   if (reply == NULL && shared_reply == NULL) {
+      VERBOSE(SUP_LOG, "%s [INFO] JSON data was not created successfully -> modules info could not be sent to client. (client's ID: %d)\n", get_formatted_time(), cli->client_id);
+      daemon_disconnect_client(cli);
+      return;
+   }
+   daemon_start_reply(cli, reply, shared_reply, newline);
 }
 
+void daemon_start_reply(sup_client_t *cli, char *reply, shared_reply_t *shared_reply, const int newline)
+{
+   struct epoll_event ev;
 
-void daemon_mode_server_routine()
+   if (reply != NULL) {
+      cli->client_reply = reply;
+      cli->client_reply_len = strlen(reply);
+   } else {
+      cli->client_shared_reply = shared_reply;
+      cli->client_reply_newline = newline;
+      cli->client_reply_len = shared_reply->len + (newline == TRUE ? 1 : 0);
+   }
+   cli->client_reply_sent = 0;
+   cli->client_state = DAEMON_CLIENT_SENDING_REPLY;
+   cli->client_deadline = get_monotonic_time_ms() + DAEMON_CLIENT_TIMEOUT_MS;
+
+   // Most replies fit into the socket buffer, the rest is sent when the socket becomes writable
+   switch (daemon_send_reply(cli)) {
+   case 1:
+      VERBOSE((cli->client_http == TRUE ? DEBUG : SUP_LOG), "%s [INFO] Reply sent to client. (client's ID: %d)\n", get_formatted_time(), cli->client_id);
+      daemon_disconnect_client(cli);
+      break;
+
+   case 0:
+      memset(&ev, 0, sizeof(ev));
+      ev.events = EPOLLOUT;
+      ev.data.ptr = cli;
+      if (epoll_ctl(server_internals->epoll_fd, EPOLL_CTL_MOD, cli->client_sd, &ev) == -1) {
+         daemon_disconnect_client(cli);
+      }
+      break;
+
+   default:
+      VERBOSE(SUP_LOG, "%s [WARNING] Could not send reply to client. (client's ID: %d)\n", get_formatted_time(), cli->client_id);
+      daemon_disconnect_client(cli);
+      break;
+   }
+}
+
+shared_reply_t *daemon_get_shared_reply(const int reply_type)
+{
+   shared_reply_t *reply = server_internals->cached_replies[reply_type];
+   json_t *modules_obj = NULL;
+
+   // Cached reply is valid until a new snapshot is published
+   if (reply == NULL || reply->version != modules_snapshot_get_version()) {
+      reply = (shared_reply_t *) calloc(1, sizeof(shared_reply_t));
+      if (reply == NULL) {
+         return NULL;
+      }
+      if (reply_type == DAEMON_REPLY_METRICS) {
+         reply->data = metrics_make_response(&reply->version);
+      } else {
+         modules_obj = make_json_modules_object((reply_type == DAEMON_REPLY_INFO ? 1 : 0), &reply->version);
+         if (modules_obj != NULL) {
+            reply->modules_cnt = json_object_size(modules_obj);
+            reply->data = json_dumps(modules_obj, 0);
+            json_decref(modules_obj);
+         }
+      }
+      if (reply->data == NULL) {
+         free(reply);
+         return NULL;
+      }
+      reply->len = strlen(reply->data);
+      reply->refcnt = 1;
+      if (server_internals->cached_replies[reply_type] != NULL) {
+         daemon_release_shared_reply(server_internals->cached_replies[reply_type]);
+      }
+      server_internals->cached_replies[reply_type] = reply;
+   }
+   reply->refcnt++;
+   return reply;
+}
+
+void daemon_release_shared_reply(shared_reply_t *reply)
+{
+   reply->refcnt--;
+   if (reply->refcnt == 0) {
+      NULLP_TEST_AND_FREE(reply->data)
+      free(reply);
+   }
+}
+
+void daemon_clear_reply(sup_client_t *cli)
+{
+   NULLP_TEST_AND_FREE(cli->client_reply)
+   if (cli->client_shared_reply != NULL) {
+      daemon_release_shared_reply(cli->client_shared_reply);
+      cli->client_shared_reply = NULL;
+   }
+   cli->client_reply_newline = FALSE;
+   cli->client_reply_len = 0;
+   cli->client_reply_sent = 0;
+}
+
+int daemon_send_reply(sup_client_t *cli)
+{
+   struct msghdr msg;
+   struct iovec iov[2];
+   const char *data = (cli->client_shared_reply != NULL ? cli->client_shared_reply->data : cli->client_reply);
+   size_t data_len = cli->client_reply_len - (cli->client_reply_newline == TRUE ? 1 : 0);
+   ssize_t sent = 0;
+
+   while (cli->client_reply_sent < cli->client_reply_len) {
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_iov = iov;
+      if (cli->client_reply_sent < data_len) {
+         iov[msg.msg_iovlen].iov_base = (void *) (data + cli->client_reply_sent);
+         iov[msg.msg_iovlen].iov_len = data_len - cli->client_reply_sent;
+         msg.msg_iovlen++;
+      }
+      // New line is not a part of the shared data
+      if (cli->client_reply_newline == TRUE) {
+         iov[msg.msg_iovlen].iov_base = (void *) "\n";
+         iov[msg.msg_iovlen].iov_len = 1;
+         msg.msg_iovlen++;
+      }
+      sent = sendmsg(cli->client_sd, &msg, MSG_NOSIGNAL);
+      if (sent == -1) {
+         if (errno == EINTR) {
+            continue;
+         }
+         return ((errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1);
+      }
+      cli->client_reply_sent += sent;
+      cli->client_deadline = get_monotonic_time_ms() + DAEMON_CLIENT_TIMEOUT_MS;
+   }
+   return 1;
+}
+
+void daemon_check_clients_timeouts(const uint64_t now)
+{
+   sup_client_t *client = server_internals->clients, *next = NULL;
+
+   while (client != NULL) {
+      next = client->next;
+      // Subscribed client has a deadline only while it is receiving a record
+      if (now >= client->client_deadline && (client->client_state != DAEMON_CLIENT_SUBSCRIBED || client->client_reply_len != 0)) {
+         if (client->client_state == DAEMON_CLIENT_READING_CODE) {
+            VERBOSE(SUP_LOG, "[ERROR] Timeout, client has not sent mode-code -> gonna wait for new client\n");
+         } else if (client->client_state == DAEMON_CLIENT_READING_HTTP) {
+            VERBOSE(DEBUG, "%s [WARNING] Timeout, client has not sent HTTP request. (client's ID: %d)\n", get_formatted_time(), client->client_id);
+         } else {
+            VERBOSE(SUP_LOG, "%s [WARNING] Timeout, client has not received the reply. (client's ID: %d)\n", get_formatted_time(), client->client_id);
+         }
+         daemon_disconnect_client(client);
+      }
+      client = next;
+   }
+}
+
+void *daemon_reload_routine(void *arg)
+{
+   reload_configuration(RELOAD_DEFAULT_CONFIG_FILE, NULL);
+   pthread_exit(EXIT_SUCCESS);
+}
+
+int daemon_parse_subscriber_filter(sup_client_t *cli)
+{
+   char *saveptr = NULL, *name = NULL;
+   char **new_filter = NULL;
+
+   // The first token is the mode code itself
+   strtok_r(cli->client_code, " \t\r\n", &saveptr);
+   while ((name = strtok_r(NULL, " \t\r\n", &saveptr)) != NULL) {
+      new_filter = (char **) realloc(cli->client_filter, (cli->client_filter_cnt + 1) * sizeof(char *));
+      if (new_filter == NULL) {
+         return -1;
+      }
+      cli->client_filter = new_filter;
+      cli->client_filter[cli->client_filter_cnt] = strdup(name);
+      if (cli->client_filter[cli->client_filter_cnt] == NULL) {
+         return -1;
+      }
+      cli->client_filter_cnt++;
+   }
+   return 0;
+}
+
+json_t *daemon_filter_modules(json_t *modules_obj, char **filter, const unsigned int filter_cnt)
 {
-   get_total_cpu_usage(&last_total_cpu);
    unsigned int x = 0;
-   int ret_val = 0, new_client = 0;
-   struct sockaddr_storage remoteaddr; // client address
-   socklen_t addrlen = sizeof remoteaddr;
-   fd_set read_fds;
-   struct timeval tv;
+   json_t *filtered_obj = NULL, *module = NULL;
 
-   pthread_attr_t clients_thread_attr;
-   pthread_attr_init(&clients_thread_attr);
-   pthread_attr_setdetachstate(&clients_thread_attr, PTHREAD_CREATE_DETACHED);
+   if (filter_cnt == 0) {
+      return json_incref(modules_obj);
+   }
+   filtered_obj = json_object();
+   if (filtered_obj == NULL) {
+      return NULL;
+   }
+   for (x = 0; x < filter_cnt; x++) {
+      // Stopped and unknown modules are not in the record
+      module = json_object_get(modules_obj, filter[x]);
+      if (module != NULL && json_object_set(filtered_obj, filter[x], module) == -1) {
+         json_decref(filtered_obj);
+         return NULL;
+      }
+   }
+   return filtered_obj;
+}
 
-   VERBOSE(SUP_LOG, "%s [INFO] Starting server thread.\n", get_formatted_time());
-   while (server_internals->daemon_terminated == FALSE) {
-      FD_ZERO(&read_fds);
-      FD_SET(server_internals->server_sd, &read_fds);
+char *daemon_dump_record(json_t *record_obj)
+{
+   char *record = NULL, *new_record = NULL;
 
-      tv.tv_sec = 1;
-      tv.tv_usec = 0;
+   record = json_dumps(record_obj, 0);
+   if (record == NULL) {
+      return NULL;
+   }
+   // Records are separated by new lines (dumped JSON does not contain any)
+   new_record = (char *) realloc(record, strlen(record) + 2);
+   if (new_record == NULL) {
+      free(record);
+      return NULL;
+   }
+   strcat(new_record, "\n");
+   return new_record;
+}
 
-      ret_val = select(server_internals->server_sd+1, &read_fds, NULL, NULL, &tv);
-      if (ret_val == -1) {
-         // Select error, return -1 and terminate
-         VERBOSE(SUP_LOG, "%s [ERROR] Server thread: select call failed.\n", get_formatted_time());
-         return;
-      } else if (ret_val != 0) {
-         if (FD_ISSET(server_internals->server_sd, &read_fds)) {
-            new_client = accept(server_internals->server_sd, (struct sockaddr *)&remoteaddr, &addrlen);
-            if (new_client == -1) {
-               if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                  // Some client wanted to connect but before accepting, he canceled the connection attempt
-                  VERBOSE(SUP_LOG, "%s [WARNING] Accept would block error, wait for another client.\n", get_formatted_time());
-                  continue;
-               } else {
-                  VERBOSE(SUP_LOG,"%s [ERROR] Server thread: accept call failed.\n", get_formatted_time());
-                  continue;
-               }
-            } else {
-               if (server_internals->clients_cnt < MAX_NUMBER_SUP_CLIENTS) {
-                  // Find a free spot in the clients buffer for a new client
-                  for (x = 0; x < MAX_NUMBER_SUP_CLIENTS; x++) {
-                     if (server_internals->clients[x]->client_sd == -1) {
-                        VERBOSE(SUP_LOG,"%s [INFO] New client has connected and will be saved to position %d. (client's ID: %d)\n", get_formatted_time(), x, server_internals->next_client_id);
-                        server_internals->clients[x]->client_sd = new_client;
-                        server_internals->clients[x]->client_id = server_internals->next_client_id;
-                        server_internals->clients[x]->client_connected = TRUE;
-                        server_internals->next_client_id++;
-                        pthread_mutex_lock(&server_internals->lock);
-                        server_internals->clients_cnt++;
-                        pthread_mutex_unlock(&server_internals->lock);
-                        // Serve the new client
-                        if (pthread_create(&server_internals->clients[x]->client_thread_id,  &clients_thread_attr, daemon_serve_client_routine, (void *) (server_internals->clients[x])) != 0) {
-                           VERBOSE(SUP_LOG, "%s [ERROR] Could not create client's thread.\n", get_formatted_time());
-                           close(server_internals->clients[x]->client_sd);
-                           server_internals->clients[x]->client_sd = -1;
-                           server_internals->clients[x]->client_connected = FALSE;
-                           pthread_mutex_lock(&server_internals->lock);
-                           server_internals->clients_cnt--;
-                           pthread_mutex_unlock(&server_internals->lock);
-                        }
-                        break;
-                     }
-                  }
+char *daemon_make_record(json_t *modules_obj, char **filter, const unsigned int filter_cnt)
+{
+   json_t *filtered_obj = NULL;
+   char *record = NULL;
+
+   filtered_obj = daemon_filter_modules(modules_obj, filter, filter_cnt);
+   if (filtered_obj == NULL) {
+      return NULL;
+   }
+   record = daemon_dump_record(filtered_obj);
+   json_decref(filtered_obj);
+   return record;
+}
+
+json_t *daemon_json_diff(json_t *old_value, json_t *new_value)
+{
+   json_t *changes = NULL, *change = NULL, *value = NULL;
+   const char *key = NULL;
+   char index[24]; // Decimal size_t needs at most 20 digits
+   size_t x = 0;
+
+   if (old_value == NULL) {
+      return json_incref(new_value);
+   }
+
+   if (json_is_object(old_value) && json_is_object(new_value)) {
+      changes = json_object();
+      if (changes == NULL) {
+         return NULL;
+      }
+      json_object_foreach(new_value, key, value) {
+         change = daemon_json_diff(json_object_get(old_value, key), value);
+         if (change != NULL && json_object_set_new(changes, key, change) == -1) {
+            json_decref(changes);
+            return NULL;
+         }
+      }
+      json_object_foreach(old_value, key, value) {
+         if (json_object_get(new_value, key) == NULL && json_object_set_new(changes, key, json_null()) == -1) {
+            json_decref(changes);
+            return NULL;
+         }
+      }
+   } else if (json_is_array(old_value) && json_is_array(new_value) && json_array_size(old_value) == json_array_size(new_value)) {
+      // Interfaces and threads of a module keep their positions, so only changed elements are sent
+      changes = json_object();
+      if (changes == NULL) {
+         return NULL;
+      }
+      for (x = 0; x < json_array_size(new_value); x++) {
+         change = daemon_json_diff(json_array_get(old_value, x), json_array_get(new_value, x));
+         if (change != NULL) {
+            snprintf(index, sizeof(index), "%zu", x);
+            if (json_object_set_new(changes, index, change) == -1) {
+               json_decref(changes);
+               return NULL;
+            }
+         }
+      }
+   } else if (json_equal(old_value, new_value)) {
+      return NULL;
+   } else {
+      return json_incref(new_value);
+   }
+
+   if (json_object_size(changes) == 0) {
+      json_decref(changes);
+      return NULL;
+   }
+   return changes;
+}
+
+char *daemon_make_delta_record(sup_client_t *cli, json_t *modules_obj, const uint64_t version)
+{
+   json_t *current = NULL, *changes = NULL, *record_obj = NULL;
+   char *record = NULL;
+
+   current = daemon_filter_modules(modules_obj, cli->client_filter, cli->client_filter_cnt);
+   if (current == NULL) {
+      return NULL;
+   }
+
+   if (cli->client_last_record == NULL || cli->client_records_cnt % DAEMON_KEYFRAME_INTERVAL == 0) {
+      record_obj = json_pack("{sIsO}", "version", (json_int_t) version, "modules", current);
+   } else {
+      changes = daemon_json_diff(cli->client_last_record, current);
+      if (changes == NULL) {
+         // Nothing has changed, the next delta will be related to the same base
+         json_decref(current);
+         return NULL;
+      }
+      record_obj = json_pack("{sIsIso}", "version", (json_int_t) version, "base", (json_int_t) cli->client_last_version, "modules", changes);
+   }
+   if (record_obj != NULL) {
+      record = daemon_dump_record(record_obj);
+      json_decref(record_obj);
+   }
+   if (record == NULL) {
+      json_decref(current);
+      return NULL;
+   }
+
+   // Records are never dropped once they are passed to the socket, so the next delta can be related to this one
+   if (cli->client_last_record != NULL) {
+      json_decref(cli->client_last_record);
+   }
+   cli->client_last_record = current;
+   cli->client_last_version = version;
+   cli->client_records_cnt++;
+   return record;
+}
+
+void daemon_send_record(sup_client_t *cli, char *record, shared_reply_t *shared_record)
+{
+   struct epoll_event ev;
+
+   if (record != NULL) {
+      cli->client_reply = record;
+      cli->client_reply_len = strlen(record);
+   } else {
+      // Shared stats are not terminated by a new line
+      cli->client_shared_reply = shared_record;
+      cli->client_reply_newline = TRUE;
+      cli->client_reply_len = shared_record->len + 1;
+   }
+   cli->client_reply_sent = 0;
+   cli->client_deadline = get_monotonic_time_ms() + DAEMON_CLIENT_TIMEOUT_MS;
+
+   switch (daemon_send_reply(cli)) {
+   case 1:
+      daemon_clear_reply(cli);
+      break;
+
+   case 0:
+      memset(&ev, 0, sizeof(ev));
+      ev.events = EPOLLIN | EPOLLOUT;
+      ev.data.ptr = cli;
+      if (epoll_ctl(server_internals->epoll_fd, EPOLL_CTL_MOD, cli->client_sd, &ev) == -1) {
+         daemon_disconnect_client(cli);
+      }
+      break;
+
+   default:
+      VERBOSE(SUP_LOG, "%s [WARNING] Could not send record to subscribed client. (client's ID: %d)\n", get_formatted_time(), cli->client_id);
+      daemon_disconnect_client(cli);
+      break;
+   }
+}
+
+void daemon_send_records()
+{
+   sup_client_t *client = server_internals->clients, *next = NULL;
+   json_t *modules_obj = NULL;
+   shared_reply_t *stats = NULL;
+   char *client_record = NULL;
+   uint64_t value = 0;
+
+   // Reset the eventfd, periods elapsed meanwhile are merged into one record
+   if (read(server_internals->subscribers_event_fd, &value, sizeof(value)) == -1 || atomic_load(&server_internals->subscribers_cnt) == 0) {
+      return;
+   }
+   server_internals->records_version++;
+
+   while (client != NULL) {
+      next = client->next;
+      if (client->client_state == DAEMON_CLIENT_SUBSCRIBED && client->client_reply_len == 0) {
+         if (client->client_delta == FALSE && client->client_filter_cnt == 0) {
+            // Stats of all modules are serialized once and shared by all clients without filter
+            if (stats == NULL) {
+               stats = daemon_get_shared_reply(DAEMON_REPLY_STATS);
+            }
+            if (stats != NULL) {
+               stats->refcnt++;
+               daemon_send_record(client, NULL, stats);
+            }
+         } else {
+            // JSON object is created once for all clients with filter or in delta mode
+            if (modules_obj == NULL) {
+               modules_obj = make_json_modules_object(0, NULL);
+            }
+            client_record = NULL;
+            if (modules_obj != NULL) {
+               if (client->client_delta == TRUE) {
+                  client_record = daemon_make_delta_record(client, modules_obj, server_internals->records_version);
                } else {
-                  // Daemon cannot accept another client -> reject the new client
-                  VERBOSE(SUP_LOG, "[WARNING] New client has connected, but there is too many clients - cannot accept another one.\n");
-                  close(new_client);
-                  continue;
+                  client_record = daemon_make_record(modules_obj, client->client_filter, client->client_filter_cnt);
                }
             }
+            if (client_record != NULL) {
+               daemon_send_record(client, client_record, NULL);
+            }
          }
-      } else {
-         /* Select timeout - nothing to do (waiting for incoming connections). */
       }
+      client = next;
    }
-   return;
-}
 
+   if (stats != NULL) {
+      daemon_release_shared_reply(stats);
+   }
+   if (modules_obj != NULL) {
+      json_decref(modules_obj);
+   }
+}
 
-int daemon_get_code_from_client(sup_client_t **cli)
+void daemon_serve_subscriber(sup_client_t *cli, const uint32_t events)
 {
-   sup_client_t * client = *cli;
-   int bytes_to_read = 0; // value can be also -1 <=> ioctl error
-   int ret_val = 0;
-   int request = -1;
-   char *buffer = NULL;
-   fd_set read_fds;
-   struct timeval tv;
-
-   while (1) {
-         FD_ZERO(&read_fds);
-         FD_SET(client->client_input_stream_fd, &read_fds);
-
-         tv.tv_sec = 2;
-         tv.tv_usec = 0;
-
-         ret_val = select(client->client_input_stream_fd+1, &read_fds, NULL, NULL, &tv);
-         if (ret_val == -1) {
-            // select error, return -1 and wait for new client
-            return -1;
-         } else if (ret_val != 0) {
-            if (FD_ISSET(client->client_input_stream_fd, &read_fds)) {
-               ioctl(client->client_input_stream_fd, FIONREAD, &bytes_to_read);
-               if (bytes_to_read == 0 || bytes_to_read == -1) {
-                  // client has disconnected, return -2 and wait for new client
-                  return -2;
-               }
-
-               buffer = get_input_from_stream(client->client_input_stream);
-               if (buffer == NULL) {
-                  // problem with input, return -1 and wait for new client
-                  return -1;
-               }
-               if (sscanf(buffer, "%d", &request) != 1) {
-                  // wrong format of code, return -1 and wait for new client
-                  free(buffer);
-                  return -1;
-               }
-               free(buffer);
+   struct epoll_event ev;
+   char buffer[256];
+   ssize_t len = 0;
+
+   if ((events & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0) {
+      // Subscribed client is not expected to send anything, the data are discarded
+      len = recv(cli->client_sd, buffer, sizeof(buffer), 0);
+      if (len == 0 || (len == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+         VERBOSE(SUP_LOG, "%s [INFO] Subscribed client has disconnected. (client's ID: %d)\n", get_formatted_time(), cli->client_id);
+         daemon_disconnect_client(cli);
+         return;
+      }
+   }
 
-               switch (request) {
-               case CLIENT_CONFIG_MODE_CODE:
-                  return CLIENT_CONFIG_MODE_CODE;
+   if ((events & EPOLLOUT) != 0 && cli->client_reply_len != 0) {
+      switch (daemon_send_reply(cli)) {
+      case 1:
+         // Whole record was sent, wait only for disconnection until the next one
+         daemon_clear_reply(cli);
+         memset(&ev, 0, sizeof(ev));
+         ev.events = EPOLLIN;
+         ev.data.ptr = cli;
+         if (epoll_ctl(server_internals->epoll_fd, EPOLL_CTL_MOD, cli->client_sd, &ev) == -1) {
+            daemon_disconnect_client(cli);
+         }
+         break;
 
-               case CLIENT_RELOAD_MODE_CODE:
-                  return CLIENT_RELOAD_MODE_CODE;
+      case 0:
+         break;
 
-               case CLIENT_STATS_MODE_CODE:
-                  return CLIENT_STATS_MODE_CODE;
+      default:
+         VERBOSE(SUP_LOG, "%s [WARNING] Could not send record to subscribed client. (client's ID: %d)\n", get_formatted_time(), cli->client_id);
+         daemon_disconnect_client(cli);
+         break;
+      }
+   }
+}
 
-               case CLIENT_INFO_MODE_CODE:
-                  return CLIENT_INFO_MODE_CODE;
+void daemon_notify_subscribers()
+{
+   uint64_t value = 1;
 
-               default:
-                  // unknown code, return -1 and wait for new client
-                  return -1;
-               }
-            }
-         } else {
-            // timeout instead of mode-code, return -3 and wait for new client
-            return -3;
-         }
+   if (server_internals != NULL && atomic_load(&server_internals->subscribers_cnt) > 0 && server_internals->subscribers_event_fd != -1) {
+      if (write(server_internals->subscribers_event_fd, &value, sizeof(value)) == -1 && errno != EAGAIN) {
+         VERBOSE(DEBUG, "%s [SERVICE] Could not wake up server thread (%s).\n", get_formatted_time(), strerror(errno));
       }
+   }
 }
 
 void daemon_send_options_to_client()
@@ -1538,14 +4401,22 @@ int daemon_open_client_streams(sup_client_t **cli)
 {
    // open input stream on client' s socket
    sup_client_t * client = *cli;
+   int output_sd = -1;
+
    client->client_input_stream = fdopen(client->client_sd, "r");
    if (client->client_input_stream == NULL) {
       VERBOSE(N_STDOUT,"%s [ERROR] Fdopen: could not open client's input stream! (client's ID: %d)\n", get_formatted_time(), client->client_id);
       return -1;
    }
 
-   // open output stream on client' s socket
-   client->client_output_stream = fdopen(client->client_sd, "w");
+   // open output stream on a duplicate of client' s socket, so every stream closes its own descriptor
+   output_sd = dup(client->client_sd);
+   if (output_sd != -1) {
+      client->client_output_stream = fdopen(output_sd, "w");
+      if (client->client_output_stream == NULL) {
+         close(output_sd);
+      }
+   }
    if (client->client_output_stream == NULL) {
       VERBOSE(N_STDOUT,"%s [ERROR] Fdopen: could not open client's output stream! (client's ID: %d)\n", get_formatted_time(), client->client_id);
       return -1;
@@ -1564,135 +4435,86 @@ int daemon_open_client_streams(sup_client_t **cli)
 void daemon_disconnect_client(sup_client_t *cli)
 {
    cli->client_connected = FALSE;
-   if (cli->client_input_stream_fd >= 0) {
-      close(cli->client_input_stream_fd);
-      cli->client_input_stream_fd = -1;
+   // Streams close their own descriptors (input stream is opened on client's socket)
+   if (cli->client_output_stream != NULL) {
+      fclose(cli->client_output_stream);
+      cli->client_output_stream = NULL;
    }
    if (cli->client_input_stream != NULL) {
       fclose(cli->client_input_stream);
       cli->client_input_stream = NULL;
-   }
-   if (cli->client_output_stream != NULL) {
-      fclose(cli->client_output_stream);
-      cli->client_output_stream = NULL;
+      cli->client_input_stream_fd = -1;
+      cli->client_sd = -1;
    }
    if (cli->client_sd >= 0) {
       close(cli->client_sd);
       cli->client_sd = -1;
    }
+
+   // Remove the client from the list of the server thread (clients in configuration mode are not in the list)
    pthread_mutex_lock(&server_internals->lock);
+   if (cli->prev != NULL) {
+      cli->prev->next = cli->next;
+   } else if (server_internals->clients == cli) {
+      server_internals->clients = cli->next;
+   }
+   if (cli->next != NULL) {
+      cli->next->prev = cli->prev;
+   }
    server_internals->clients_cnt--;
    pthread_mutex_unlock(&server_internals->lock);
-   VERBOSE(SUP_LOG, "%s [INFO] Disconnected client. (client's ID: %d)\n", get_formatted_time(), cli->client_id);
+   daemon_clear_reply(cli);
+   if (cli->client_state == DAEMON_CLIENT_SUBSCRIBED) {
+      atomic_fetch_sub(&server_internals->subscribers_cnt, 1);
+   }
+   while (cli->client_filter_cnt > 0) {
+      cli->client_filter_cnt--;
+      NULLP_TEST_AND_FREE(cli->client_filter[cli->client_filter_cnt])
+   }
+   NULLP_TEST_AND_FREE(cli->client_filter)
+   if (cli->client_last_record != NULL) {
+      json_decref(cli->client_last_record);
+      cli->client_last_record = NULL;
+   }
+
+   VERBOSE((cli->client_http == TRUE ? DEBUG : SUP_LOG), "%s [INFO] Disconnected client. (client's ID: %d)\n", get_formatted_time(), cli->client_id);
+   free(cli);
 }
 
 void *daemon_serve_client_routine (void *cli)
 {
    sup_client_t * client = (sup_client_t *) cli;
    int bytes_to_read = 0; // value can be also -1 <=> ioctl error
-   int ret_val = 0, nine_cnt = 0;
+   int ret_val = 0, nine_cnt = 0, flags = 0;
    int request = -1;
-   fd_set read_fds;
-   struct timeval tv;
-
-   // Open client's streams
-   if (daemon_open_client_streams(&client) != 0) {
-      daemon_disconnect_client(client);
-      pthread_exit(EXIT_SUCCESS);
-   }
-
-   // get code from client according to operation he wants to perform
-   switch (daemon_get_code_from_client(&client)) {
-   case -3: // timeout
-      VERBOSE(SUP_LOG, "[ERROR] Timeout, client has not sent mode-code -> gonna wait for new client\n");
-      daemon_disconnect_client(client);
-      pthread_exit(EXIT_SUCCESS);
-
-   case -2: // client has disconnected
-      VERBOSE(SUP_LOG, "[ERROR] Client has disconnected -> gonna wait for new client\n");
-      daemon_disconnect_client(client);
-      pthread_exit(EXIT_SUCCESS);
-
-   case -1: // another error while receiving mode-code from client
-      VERBOSE(SUP_LOG, "[ERROR] Error while waiting for a mode-code from client -> gonna wait for new client\n");
-      daemon_disconnect_client(client);
-      pthread_exit(EXIT_SUCCESS);
+   struct pollfd pfd;
 
-   case CLIENT_CONFIG_MODE_CODE: // normal client configure mode -> continue to options loop
-      // Check whether any client is already connected in config mode
+   // Switch client's socket to blocking mode and open client's streams
+   flags = fcntl(client->client_sd, F_GETFL);
+   if (flags == -1 || fcntl(client->client_sd, F_SETFL, flags & ~O_NONBLOCK) == -1 || daemon_open_client_streams(&client) != 0) {
       pthread_mutex_lock(&server_internals->lock);
-      if (server_internals->config_mode_active == TRUE) {
-         VERBOSE(SUP_LOG, "%s [INFO] Got configuration mode code, but another client is already connected in this mode. (client's ID: %d)\n", get_formatted_time(), client->client_id);
-         fprintf(client->client_output_stream, FORMAT_WARNING "[WARNING] Another client is connected to supervisor in configuration mode, you have to wait.\n" FORMAT_RESET);
-         fflush(client->client_output_stream);
-         pthread_mutex_unlock(&server_internals->lock);
-         daemon_disconnect_client(client);
-         pthread_exit(EXIT_SUCCESS);
-      } else {
-         VERBOSE(SUP_LOG, "%s [INFO] Got configuration mode code. (client's ID: %d)\n", get_formatted_time(), client->client_id);
-         server_internals->config_mode_active = TRUE;
-      }
+      server_internals->config_mode_active = FALSE;
       pthread_mutex_unlock(&server_internals->lock);
-      output_fd = client->client_output_stream;
-      input_fd = client->client_input_stream;
-      daemon_send_options_to_client();
-      break;
-
-   case CLIENT_RELOAD_MODE_CODE: // just reload configuration and wait for new client
-      VERBOSE(SUP_LOG, "%s [INFO] Got reload mode code. (client's ID: %d)\n", get_formatted_time(), client->client_id);
-      daemon_disconnect_client(client);
-      reload_configuration(RELOAD_DEFAULT_CONFIG_FILE, NULL);
-      pthread_exit(EXIT_SUCCESS);
-
-   case CLIENT_STATS_MODE_CODE: { // send stats to current client and wait for new one
-      VERBOSE(SUP_LOG, "%s [INFO] Got modules_stats_mode code. (client's ID: %d)\n", get_formatted_time(), client->client_id);
-      char *info_buffer = make_json_modules_info(0); // info_buffer is a string returned from json_dump function, null-terminated
-      if (info_buffer == NULL) {
-         VERBOSE(SUP_LOG, "%s [INFO] JSON data was not created successfully -> modules info could not be sent to client. (client's ID: %d)\n", get_formatted_time(), client->client_id);
-         daemon_disconnect_client(client);
-         pthread_exit(EXIT_SUCCESS);
-      }
-      fprintf(client->client_output_stream, "%s", info_buffer);
-      fflush(client->client_output_stream);
-      NULLP_TEST_AND_FREE(info_buffer)
-      VERBOSE(SUP_LOG, "%s [INFO] Modules stats sent to client. (client's ID: %d)\n", get_formatted_time(), client->client_id);
-      daemon_disconnect_client(client);
-      pthread_exit(EXIT_SUCCESS);
-   }
-
-   case CLIENT_INFO_MODE_CODE: {
-      VERBOSE(SUP_LOG, "%s [INFO] Got modules_info_mode code. (client's ID: %d)\n", get_formatted_time(), client->client_id);
-      char *info_buffer = make_json_modules_info(1); // info_buffer is a string returned from json_dump function, null-terminated
-      if (info_buffer == NULL) {
-         VERBOSE(SUP_LOG, "%s [INFO] JSON data was not created successfully -> modules info could not be sent to client. (client's ID: %d)\n", get_formatted_time(), client->client_id);
-         daemon_disconnect_client(client);
-         pthread_exit(EXIT_SUCCESS);
-      }
-      fprintf(client->client_output_stream, "%s\n", info_buffer);
-      fflush(client->client_output_stream);
-      NULLP_TEST_AND_FREE(info_buffer)
-      VERBOSE(SUP_LOG, "%s [INFO] Modules info sent to client. (client's ID: %d)\n", get_formatted_time(), client->client_id);
-      daemon_disconnect_client(client);
-      pthread_exit(EXIT_SUCCESS);
-   }
-
-   default: // just in case of unknown return value.. clean up and wait for new client
       daemon_disconnect_client(client);
       pthread_exit(EXIT_SUCCESS);
    }
+   output_fd = client->client_output_stream;
+   input_fd = client->client_input_stream;
+   daemon_send_options_to_client();
 
    // Configuration mode MAIN LOOP
    while (client->client_connected == TRUE && server_internals->daemon_terminated == FALSE) {
       request = -1;
-      FD_ZERO(&read_fds);
-      FD_SET(client->client_input_stream_fd, &read_fds);
-
-      tv.tv_sec = 0;
-      tv.tv_usec = 500000;
+      // Descriptor of the client can be greater than FD_SETSIZE, so poll() is used instead of select()
+      pfd.fd = client->client_input_stream_fd;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
 
-      ret_val = select(client->client_input_stream_fd+1, &read_fds, NULL, NULL, &tv);
-      if (ret_val == -1) {
-         VERBOSE(SUP_LOG,"%s [ERROR] Client's thread: select error.\n", get_formatted_time());
+      ret_val = poll(&pfd, 1, 500);
+      if (ret_val == -1 && errno == EINTR) {
+         continue;
+      } else if (ret_val == -1) {
+         VERBOSE(SUP_LOG,"%s [ERROR] Client's thread: poll error.\n", get_formatted_time());
          input_fd = stdin;
          output_fd = supervisor_log_fd;
          pthread_mutex_lock(&server_internals->lock);
@@ -1701,7 +4523,7 @@ void *daemon_serve_client_routine (void *cli)
          daemon_disconnect_client(client);
          pthread_exit(EXIT_SUCCESS);
       } else if (ret_val != 0) {
-         if (FD_ISSET(client->client_input_stream_fd, &read_fds)) {
+         if ((pfd.revents & (POLLIN | POLLHUP | POLLERR)) != 0) {
             ioctl(client->client_input_stream_fd, FIONREAD, &bytes_to_read);
             if (bytes_to_read == 0 || bytes_to_read == -1) {
                input_fd = stdin;
@@ -1779,6 +4601,346 @@ void *daemon_serve_client_routine (void *cli)
 
 
 
+/*****************************************************************
+ * Metrics exporter functions *
+ *****************************************************************/
+
+/* Metric families of modules, values are read by metrics_render() in this order. */
+static const metrics_family_t metrics_module_families[] = {
+   {"nemea_module_up", "gauge", "Whether the module is running (1) or stopped (0)."},
+   {"nemea_module_restarts", "counter", "Number of restarts of the module since it was loaded."},
+   {"nemea_module_cpu_user_percent", "gauge", "CPU usage of the module in user mode in the last period in percents."},
+   {"nemea_module_cpu_system_percent", "gauge", "CPU usage of the module in kernel mode in the last period in percents."},
+   {"nemea_module_memory_virtual_bytes", "gauge", "Virtual memory size of the module."},
+   {"nemea_module_memory_resident_bytes", "gauge", "Resident set size of the module."},
+   {"nemea_module_io_read_bytes", "counter", "Bytes read by the module from storage."},
+   {"nemea_module_io_write_bytes", "counter", "Bytes written by the module to storage."},
+   {"nemea_module_major_faults", "counter", "Major page faults of the module."},
+   {"nemea_module_voluntary_context_switches", "counter", "Voluntary context switches of threads of the module."},
+   {"nemea_module_involuntary_context_switches", "counter", "Involuntary context switches of threads of the module."},
+   {"nemea_module_threads", "gauge", "Number of threads of the module."},
+};
+
+/* Metric families of input interfaces. */
+static const metrics_family_t metrics_in_ifc_families[] = {
+   {"nemea_input_ifc_connected", "gauge", "Whether the input interface is connected (1) or not (0)."},
+   {"nemea_input_ifc_messages", "counter", "Messages received by the input interface."},
+   {"nemea_input_ifc_buffers", "counter", "Buffers received by the input interface."},
+};
+
+/* Metric families of output interfaces. */
+static const metrics_family_t metrics_out_ifc_families[] = {
+   {"nemea_output_ifc_clients", "gauge", "Number of clients connected to the output interface."},
+   {"nemea_output_ifc_messages", "counter", "Messages sent by the output interface."},
+   {"nemea_output_ifc_dropped_messages", "counter", "Messages dropped by the output interface."},
+   {"nemea_output_ifc_buffers", "counter", "Buffers sent by the output interface."},
+   {"nemea_output_ifc_autoflushes", "counter", "Autoflushes of the output interface."},
+};
+
+int metrics_open_socket(const char *address)
+{
+   union tcpip_socket_addr addr;
+   struct addrinfo *addr_list = NULL, *ai = NULL;
+   char *host = NULL, *port = NULL, *colon = NULL;
+   int fd = -1, on = 1;
+
+   memset(&addr, 0, sizeof(addr));
+   if (strchr(address, '/') != NULL) {
+      addr.unix_addr.sun_family = AF_UNIX;
+      snprintf(addr.unix_addr.sun_path, sizeof(addr.unix_addr.sun_path) - 1, "%s", address);
+      fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+      if (fd == -1) {
+         return -1;
+      }
+      unlink(address);
+      if (bind(fd, (struct sockaddr *) &addr.unix_addr, sizeof(addr.unix_addr)) == -1 || listen(fd, SOMAXCONN) == -1) {
+         close(fd);
+         return -1;
+      }
+      if (chmod(address, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH) == -1) {
+         VERBOSE(N_STDOUT, "%s [WARNING] Failed to set permissions to socket (%s)\n", get_formatted_time(), address);
+      }
+      return fd;
+   }
+
+   // TCP address is "[host:]port", without host it listens on all addresses
+   host = strdup(address);
+   if (host == NULL) {
+      return -1;
+   }
+   colon = strrchr(host, ':');
+   if (colon != NULL) {
+      *colon = '\0';
+      port = colon + 1;
+   } else {
+      port = host;
+   }
+   addr.tcpip_addr.ai_family = AF_UNSPEC;
+   addr.tcpip_addr.ai_socktype = SOCK_STREAM;
+   addr.tcpip_addr.ai_flags = AI_PASSIVE;
+   if (getaddrinfo((colon != NULL && host[0] != '\0' ? host : NULL), port, &addr.tcpip_addr, &addr_list) != 0) {
+      free(host);
+      return -1;
+   }
+   for (ai = addr_list; ai != NULL; ai = ai->ai_next) {
+      fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+      if (fd == -1) {
+         continue;
+      }
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+      if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, SOMAXCONN) == 0) {
+         break;
+      }
+      close(fd);
+      fd = -1;
+   }
+   freeaddrinfo(addr_list);
+   free(host);
+   return fd;
+}
+
+void metrics_close_socket()
+{
+   if (server_internals == NULL || server_internals->metrics_sd == -1) {
+      return;
+   }
+   close(server_internals->metrics_sd);
+   server_internals->metrics_sd = -1;
+   if (metrics_address != NULL && strchr(metrics_address, '/') != NULL) {
+      unlink(metrics_address);
+   }
+}
+
+int metrics_reserve(metrics_buffer_t *buffer, const size_t needed)
+{
+   char *new_data = NULL;
+   size_t new_size = 0;
+
+   if (buffer->len + needed < buffer->size) {
+      return 0;
+   }
+   new_size = (buffer->size == 0 ? METRICS_BUFFER_START_SIZE : buffer->size);
+   while (buffer->len + needed >= new_size) {
+      new_size *= 2;
+   }
+   new_data = (char *) realloc(buffer->data, new_size);
+   if (new_data == NULL) {
+      return -1;
+   }
+   buffer->data = new_data;
+   buffer->size = new_size;
+   return 0;
+}
+
+int metrics_append(metrics_buffer_t *buffer, const char *format, ...)
+{
+   va_list args;
+   int len = 0;
+
+   va_start(args, format);
+   len = vsnprintf(NULL, 0, format, args);
+   va_end(args);
+   if (len < 0 || metrics_reserve(buffer, len) == -1) {
+      return -1;
+   }
+   va_start(args, format);
+   vsnprintf(buffer->data + buffer->len, buffer->size - buffer->len, format, args);
+   va_end(args);
+   buffer->len += len;
+   return 0;
+}
+
+int metrics_append_label_value(metrics_buffer_t *buffer, const char *value)
+{
+   const char *c = NULL;
+
+   // Every character is escaped at most to two characters
+   if (metrics_reserve(buffer, 2 * strlen(value)) == -1) {
+      return -1;
+   }
+   for (c = value; *c != '\0'; c++) {
+      if (*c == '\\' || *c == '"') {
+         buffer->data[buffer->len++] = '\\';
+         buffer->data[buffer->len++] = *c;
+      } else if (*c == '\n') {
+         buffer->data[buffer->len++] = '\\';
+         buffer->data[buffer->len++] = 'n';
+      } else {
+         buffer->data[buffer->len++] = *c;
+      }
+   }
+   buffer->data[buffer->len] = '\0';
+   return 0;
+}
+
+char *metrics_render(uint64_t *version)
+{
+   const metrics_family_t *family = NULL;
+   metrics_buffer_t buffer;
+   module_snapshot_t *module = NULL;
+   modules_snapshot_t *snapshot = NULL;
+   unsigned int reader_parity = 0, f = 0, x = 0;
+   uint32_t y = 0;
+   uint64_t value = 0;
+   int ret = 0;
+
+   memset(&buffer, 0, sizeof(buffer));
+   *version = 0;
+   // Modules state is read from the snapshot published by service thread without any lock
+   snapshot = modules_snapshot_acquire(&reader_parity);
+   if (snapshot != NULL) {
+      *version = snapshot->version;
+   }
+
+   // Samples of one family must be together, so modules are iterated for every family
+   for (f = 0; snapshot != NULL && ret == 0 && f < sizeof(metrics_module_families) / sizeof(metrics_family_t); f++) {
+      family = &metrics_module_families[f];
+      ret = metrics_append(&buffer, "# TYPE %s %s\n# HELP %s %s\n", family->name, family->type, family->name, family->help);
+      for (x = 0; ret == 0 && x < snapshot->modules_cnt; x++) {
+         module = &snapshot->modules[x];
+         // Stopped modules have only their state and restarts
+         if (module->module_status == FALSE && f > 1) {
+            continue;
+         }
+         switch (f) {
+         case 0: value = (module->module_status == TRUE ? 1 : 0); break;
+         // module_restart_cnt is reset when the module is stopped, the counter has to be monotonic
+         case 1: value = (module->module_starts_cnt > 0 ? module->module_starts_cnt - 1 : 0); break;
+         case 2: value = module->last_period_percent_cpu_usage_user_mode; break;
+         case 3: value = module->last_period_percent_cpu_usage_kernel_mode; break;
+         case 4: value = module->virtual_memory_size; break;
+         case 5: value = module->resident_set_size * 1024; break;
+         case 6: value = module->read_bytes; break;
+         case 7: value = module->write_bytes; break;
+         case 8: value = module->major_faults; break;
+         case 9: value = module->voluntary_ctxt_switches; break;
+         case 10: value = module->nonvoluntary_ctxt_switches; break;
+         default: value = module->threads_cnt; break;
+         }
+         ret = metrics_append(&buffer, "%s%s{module=\"", family->name, (family->type[0] == 'c' ? "_total" : ""));
+         ret = (ret == 0 ? metrics_append_label_value(&buffer, module->module_name) : ret);
+         ret = (ret == 0 ? metrics_append(&buffer, "\"} %" PRIu64 "\n", value) : ret);
+      }
+   }
+
+   for (f = 0; snapshot != NULL && ret == 0 && f < sizeof(metrics_in_ifc_families) / sizeof(metrics_family_t); f++) {
+      family = &metrics_in_ifc_families[f];
+      ret = metrics_append(&buffer, "# TYPE %s %s\n# HELP %s %s\n", family->name, family->type, family->name, family->help);
+      for (x = 0; ret == 0 && x < snapshot->modules_cnt; x++) {
+         module = &snapshot->modules[x];
+         for (y = 0; ret == 0 && module->module_status == TRUE && y < module->total_in_ifces_cnt; y++) {
+            switch (f) {
+            case 0: value = module->in_ifces_data[y].ifc_state; break;
+            case 1: value = module->in_ifces_data[y].recv_msg_cnt; break;
+            default: value = module->in_ifces_data[y].recv_buffer_cnt; break;
+            }
+            ret = metrics_append(&buffer, "%s%s{module=\"", family->name, (family->type[0] == 'c' ? "_total" : ""));
+            ret = (ret == 0 ? metrics_append_label_value(&buffer, module->module_name) : ret);
+            ret = (ret == 0 ? metrics_append(&buffer, "\",ifc=\"") : ret);
+            ret = (ret == 0 ? metrics_append_label_value(&buffer, (module->in_ifces_data[y].ifc_id == NULL ? "" : module->in_ifces_data[y].ifc_id)) : ret);
+            ret = (ret == 0 ? metrics_append(&buffer, "\",type=\"%c\"} %" PRIu64 "\n", module->in_ifces_data[y].ifc_type, value) : ret);
+         }
+      }
+   }
+
+   for (f = 0; snapshot != NULL && ret == 0 && f < sizeof(metrics_out_ifc_families) / sizeof(metrics_family_t); f++) {
+      family = &metrics_out_ifc_families[f];
+      ret = metrics_append(&buffer, "# TYPE %s %s\n# HELP %s %s\n", family->name, family->type, family->name, family->help);
+      for (x = 0; ret == 0 && x < snapshot->modules_cnt; x++) {
+         module = &snapshot->modules[x];
+         for (y = 0; ret == 0 && module->module_status == TRUE && y < module->total_out_ifces_cnt; y++) {
+            switch (f) {
+            case 0: value = (module->out_ifces_data[y].num_clients < 0 ? 0 : module->out_ifces_data[y].num_clients); break;
+            case 1: value = module->out_ifces_data[y].sent_msg_cnt; break;
+            case 2: value = module->out_ifces_data[y].dropped_msg_cnt; break;
+            case 3: value = module->out_ifces_data[y].sent_buffer_cnt; break;
+            default: value = module->out_ifces_data[y].autoflush_cnt; break;
+            }
+            ret = metrics_append(&buffer, "%s%s{module=\"", family->name, (family->type[0] == 'c' ? "_total" : ""));
+            ret = (ret == 0 ? metrics_append_label_value(&buffer, module->module_name) : ret);
+            ret = (ret == 0 ? metrics_append(&buffer, "\",ifc=\"") : ret);
+            ret = (ret == 0 ? metrics_append_label_value(&buffer, (module->out_ifces_data[y].ifc_id == NULL ? "" : module->out_ifces_data[y].ifc_id)) : ret);
+            ret = (ret == 0 ? metrics_append(&buffer, "\",type=\"%c\"} %" PRIu64 "\n", module->out_ifces_data[y].ifc_type, value) : ret);
+         }
+      }
+   }
+   modules_snapshot_release(reader_parity);
+
+   if (ret != 0 || metrics_append(&buffer, "# EOF\n") != 0) {
+      NULLP_TEST_AND_FREE(buffer.data)
+      return NULL;
+   }
+   return buffer.data;
+}
+
+char *metrics_make_response(uint64_t *version)
+{
+   metrics_buffer_t response;
+   char *metrics = metrics_render(version);
+
+   if (metrics == NULL) {
+      return NULL;
+   }
+   memset(&response, 0, sizeof(response));
+   if (metrics_append(&response, "HTTP/1.1 200 OK\r\n"
+                                 "Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+                                 "Content-Length: %zu\r\n"
+                                 "Connection: close\r\n\r\n%s", strlen(metrics), metrics) != 0) {
+      NULLP_TEST_AND_FREE(response.data)
+   }
+   free(metrics);
+   return response.data;
+}
+
+int metrics_get_request(sup_client_t *cli)
+{
+   ssize_t len = 0;
+
+   len = recv(cli->client_sd, cli->client_code + cli->client_code_len, DAEMON_CLIENT_CODE_SIZE - 1 - cli->client_code_len, 0);
+   if (len == 0) {
+      return -2;
+   } else if (len == -1) {
+      return ((errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1);
+   }
+   cli->client_code_len += len;
+   cli->client_code[cli->client_code_len] = '\0';
+
+   // Only the request line is used, the rest of a long header is ignored
+   if (strstr(cli->client_code, "\r\n\r\n") != NULL || strstr(cli->client_code, "\n\n") != NULL ||
+       cli->client_code_len >= DAEMON_CLIENT_CODE_SIZE - 1) {
+      return 1;
+   }
+   return 0;
+}
+
+void metrics_serve_request(sup_client_t *cli)
+{
+   shared_reply_t *shared_reply = NULL;
+   char method[8], path[256];
+   const char *error_response = NULL;
+
+   if (sscanf(cli->client_code, "%7s %255s", method, path) != 2) {
+      error_response = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+   } else if (strcmp(method, "GET") != 0) {
+      error_response = "HTTP/1.1 405 Method Not Allowed\r\nAllow: GET\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+   } else if (strcmp(path, "/metrics") != 0 && strncmp(path, "/metrics?", 9) != 0) {
+      error_response = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+   } else {
+      shared_reply = daemon_get_shared_reply(DAEMON_REPLY_METRICS);
+      if (shared_reply == NULL) {
+         error_response = "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+      }
+   }
+
+   if (error_response != NULL) {
+      daemon_start_reply(cli, strdup(error_response), NULL, FALSE);
+   } else {
+      daemon_start_reply(cli, NULL, shared_reply, FALSE);
+   }
+}
+
+
+
 /*****************************************************************
  * Service thread functions *
  *****************************************************************/
@@ -1800,6 +4962,8 @@ void service_start_module(const int module_idx)
 
    char log_path_stdout[PATH_MAX];
    char log_path_stderr[PATH_MAX];
+   module_launch_t launch;
+   int spawn_errno = 0;
    memset(log_path_stderr, 0, PATH_MAX);
    memset(log_path_stdout, 0, PATH_MAX);
 
@@ -1808,56 +4972,43 @@ void service_start_module(const int module_idx)
 
    init_module_variables(module_idx);
 
-   time_t rawtime;
-   struct tm timeinfo;
-   char timebuf[TIME_BUFFER_SIZE];
-   time ( &rawtime );
-   localtime_r ( &rawtime , &timeinfo);
+   // Everything the module process needs is prepared here, it only sets it up and executes the binary
+   if (launcher_prepare(module_idx, &launch, log_path_stdout, log_path_stderr) == -1) {
+      // The failed start counts as a short run of the module, so its next start is delayed by restart backoff
+      running_modules[module_idx].module_status = FALSE;
+      running_modules[module_idx].module_start_time = get_monotonic_time_ms();
+      running_modules[module_idx].module_restart_cnt++;
+      running_modules[module_idx].module_starts_cnt++;
+      return;
+   }
+   running_modules[module_idx].module_pid = launcher_spawn(&launch);
+   spawn_errno = errno;
+   if (running_modules[module_idx].module_pid > 0 && launch.exec_errno != 0) {
+      // The process has already exited, it is cleaned up as any other finished module
+      VERBOSE(MODULE_EVENT,"%s [ERROR] Module execution: could not execute %s binary %s (%s)! (possible reason - wrong module binary path)\n", get_formatted_time(), running_modules[module_idx].module_name, launch.path, strerror(launch.exec_errno));
+   }
+   launcher_cleanup(&launch);
 
-   fflush(stdout);
-   running_modules[module_idx].module_pid = fork();
-   if (running_modules[module_idx].module_pid == 0) {
-      int fd_stdout = open(log_path_stdout, O_RDWR | O_CREAT | O_APPEND, PERM_LOGFILE);
-      int fd_stderr = open(log_path_stderr, O_RDWR | O_CREAT | O_APPEND, PERM_LOGFILE);
-      if (fd_stdout != -1) {
-         dup2(fd_stdout,1); //stdout
-         close(fd_stdout);
-      }
-      if (fd_stderr != -1) {
-         dup2(fd_stderr,2); //stderr
-         close(fd_stderr);
-      }
-      setsid(); // important for sending SIGINT to supervisor.. modules can't receive the signal too !!!
-      fprintf(stdout,"---> %s", asctime_r (&timeinfo, timebuf));
-      fprintf(stderr,"---> %s", asctime_r (&timeinfo, timebuf));
-      if (running_modules[module_idx].module_path == NULL) {
-         VERBOSE(N_STDOUT,"%s [ERROR] Starting module: module path is missing!\n", get_formatted_time());
-         running_modules[module_idx].module_enabled = FALSE;
-      } else {
-         char **params = prep_module_args(module_idx);
-         if (params == NULL) {
-            goto execute_fail;
-         }
-         fflush(stdout);
-         fflush(stderr);
-         execvp(running_modules[module_idx].module_path, params);
-execute_fail:
-         exit(EXIT_FAILURE);
-      }
-      VERBOSE(MODULE_EVENT,"%s [ERROR] Module execution: could not execute %s binary! (possible reason - wrong module binary path)\n", get_formatted_time(), running_modules[module_idx].module_name);
-      running_modules[module_idx].module_enabled = FALSE;
-      exit(EXIT_FAILURE);
-   } else if (running_modules[module_idx].module_pid == -1) {
+   if (running_modules[module_idx].module_pid == -1) {
       running_modules[module_idx].module_status = FALSE;
+      running_modules[module_idx].module_start_time = get_monotonic_time_ms();
       running_modules[module_idx].module_restart_cnt++;
-      VERBOSE(N_STDOUT,"%s [ERROR] Fork: could not fork supervisor process!\n", get_formatted_time());
+      running_modules[module_idx].module_starts_cnt++;
+      VERBOSE(N_STDOUT,"%s [ERROR] Clone: could not create process of module %s (%s)!\n", get_formatted_time(), running_modules[module_idx].module_name, strerror(spawn_errno));
    } else {
       running_modules[module_idx].module_is_my_child = TRUE;
       running_modules[module_idx].module_status = TRUE;
+      running_modules[module_idx].module_start_time = get_monotonic_time_ms();
+      // Dependent modules wait until the module is ready (see service_probe_started_modules())
+      running_modules[module_idx].startup_probing = TRUE;
+      running_modules[module_idx].startup_next_probe = get_monotonic_time_ms() + STARTUP_PROBE_INTERVAL_MS;
+      running_modules[module_idx].startup_ready_deadline = get_monotonic_time_ms() + STARTUP_READY_TIMEOUT_MS;
+      // New process can be linked with a different libtrap, stats format is negotiated again
+      running_modules[module_idx].service_stats_format = SERVICE_STATS_FORMAT_UNKNOWN;
+      running_modules[module_idx].service_bin_unanswered = 0;
+      service_track_module_exit(module_idx);
       running_modules[module_idx].module_restart_cnt++;
-      if (running_modules[module_idx].module_restart_cnt == 1) {
-         running_modules[module_idx].module_restart_timer = 0;
-      }
+      running_modules[module_idx].module_starts_cnt++;
    }
 }
 
@@ -1871,7 +5022,100 @@ void service_disconnect_from_module(const int module_idx)
       }
       running_modules[module_idx].module_service_ifc_isconnected = FALSE;
    }
-   running_modules[module_idx].service_ifc_conn_timer = 0;
+   if (running_modules[module_idx].service_reply_pending == TRUE && running_modules[module_idx].service_stats_format == SERVICE_STATS_FORMAT_UNKNOWN) {
+      /* The connection can be closed for other reasons (e.g. the module is just exiting), so the next connection
+       * requests binary stats again and JSON is used only if the module repeatedly does not answer them. */
+      running_modules[module_idx].service_bin_unanswered++;
+      if (running_modules[module_idx].service_bin_unanswered >= SERVICE_BIN_STATS_MAX_UNANSWERED) {
+         VERBOSE(MODULE_EVENT, "%s [SERVICE] Module %s does not support binary stats, JSON will be used.\n", get_formatted_time(), running_modules[module_idx].module_name);
+         running_modules[module_idx].service_stats_format = SERVICE_STATS_FORMAT_JSON;
+      }
+   }
+   running_modules[module_idx].service_reply_pending = FALSE;
+   running_modules[module_idx].service_ifc_conn_timer = 0;
+}
+
+void service_track_module_exit(const int module_idx)
+{
+#ifdef SYS_pidfd_open
+   int pidfd = -1;
+
+   if (service_pidfd_supported == FALSE || running_modules[module_idx].module_pidfd != -1) {
+      return;
+   }
+
+   pidfd = syscall(SYS_pidfd_open, running_modules[module_idx].module_pid, 0);
+   if (pidfd == -1) {
+      if (errno == ENOSYS) {
+         VERBOSE(SUP_LOG, "%s [WARNING] pidfd_open is not supported, module exits will be detected via SIGCHLD and kill -0.\n", get_formatted_time());
+         service_pidfd_supported = FALSE;
+      }
+      // ESRCH - module is not running, it is handled by service_check_modules_status()
+      return;
+   }
+   if (service_watch_fd(pidfd, EPOLLIN) == -1) {
+      close(pidfd);
+      return;
+   }
+   running_modules[module_idx].module_pidfd = pidfd;
+#endif
+}
+
+void service_handle_module_exit(const int module_idx, const int status, const struct rusage *usage)
+{
+   if (status == -1 || usage == NULL) {
+      VERBOSE(MODULE_EVENT,"%s [STOP] Module \"%s\" (PID: %d) is not running!\n", get_formatted_time(), running_modules[module_idx].module_name, running_modules[module_idx].module_pid);
+   } else if (WIFSIGNALED(status)) {
+      VERBOSE(MODULE_EVENT,"%s [STOP] Module \"%s\" (PID: %d) was terminated by signal %d (user %ld.%03lds, system %ld.%03lds, max RSS %ld kB).\n",
+              get_formatted_time(), running_modules[module_idx].module_name, running_modules[module_idx].module_pid, WTERMSIG(status),
+              usage->ru_utime.tv_sec, usage->ru_utime.tv_usec / 1000, usage->ru_stime.tv_sec, usage->ru_stime.tv_usec / 1000, usage->ru_maxrss);
+   } else {
+      VERBOSE(MODULE_EVENT,"%s [STOP] Module \"%s\" (PID: %d) exited with status %d (user %ld.%03lds, system %ld.%03lds, max RSS %ld kB).\n",
+              get_formatted_time(), running_modules[module_idx].module_name, running_modules[module_idx].module_pid, WEXITSTATUS(status),
+              usage->ru_utime.tv_sec, usage->ru_utime.tv_usec / 1000, usage->ru_stime.tv_sec, usage->ru_stime.tv_usec / 1000, usage->ru_maxrss);
+   }
+
+   running_modules[module_idx].module_exit_status = status;
+   if (usage != NULL) {
+      memcpy(&running_modules[module_idx].module_exit_rusage, usage, sizeof(struct rusage));
+   } else {
+      memset(&running_modules[module_idx].module_exit_rusage, 0, sizeof(struct rusage));
+   }
+
+   if (running_modules[module_idx].module_pidfd != -1) {
+      close(running_modules[module_idx].module_pidfd);
+      running_modules[module_idx].module_pidfd = -1;
+   }
+   close_module_proc_fds(module_idx);
+   if (running_modules[module_idx].module_service_sd != -1) {
+      close(running_modules[module_idx].module_service_sd);
+      running_modules[module_idx].module_service_sd = -1;
+   }
+   running_modules[module_idx].module_status = FALSE;
+   running_modules[module_idx].module_service_ifc_isconnected = FALSE;
+   running_modules[module_idx].module_is_my_child = FALSE;
+   running_modules[module_idx].module_pid = 0;
+}
+
+void service_reap_module(const int module_idx)
+{
+   pid_t result;
+   int status;
+   struct rusage usage;
+
+   if (running_modules[module_idx].module_is_my_child == FALSE) {
+      service_handle_module_exit(module_idx, -1, NULL);
+      return;
+   }
+
+   result = wait4(running_modules[module_idx].module_pid, &status, WNOHANG, &usage);
+   if (result == running_modules[module_idx].module_pid) {
+      service_handle_module_exit(module_idx, status, &usage);
+   } else if (result == -1 && errno == ECHILD) {
+      // The module was not started by this supervisor (e.g. it was loaded from backup file)
+      running_modules[module_idx].module_is_my_child = FALSE;
+      service_handle_module_exit(module_idx, -1, NULL);
+   }
 }
 
 // Returns a number of running modules
@@ -1880,11 +5124,25 @@ int service_check_modules_status()
    unsigned int x, some_module_running = 0;
 
    for (x=0; x<loaded_modules_cnt; x++) {
+      // Previous instance of hot restarted module has to finish as well
+      if (running_modules[x].module_retiring_pid > 0) {
+         some_module_running++;
+      }
       if (running_modules[x].module_pid > 0) {
+         // Modules loaded from backup file (or started without pidfd) are tracked as soon as possible
+         if (running_modules[x].module_pidfd == -1) {
+            service_track_module_exit(x);
+         }
+         if (running_modules[x].module_pidfd != -1) {
+            // The exit of the module is reported by its pidfd, the module is running until then
+            running_modules[x].module_status = TRUE;
+            if (running_modules[x].module_root_perm_needed == FALSE || service_thread_continue == TRUE) {
+               some_module_running++;
+            }
+            continue;
+         }
          if (kill(running_modules[x].module_pid, 0) == -1) {
-            if (errno == ESRCH) {
-               VERBOSE(MODULE_EVENT,"%s [STOP] kill -0: module \"%s\" (PID: %d) is not running!\n", get_formatted_time(), running_modules[x].module_name, running_modules[x].module_pid);
-            } else if (errno == EPERM) {
+            if (errno == EPERM) {
                if (running_modules[x].module_root_perm_needed == FALSE) {
                   VERBOSE(MODULE_EVENT,"%s [WARNING]] kill -0: Does not have permissions to send signals to module \"%s\"\n", get_formatted_time(), running_modules[x].module_name);
                   running_modules[x].module_root_perm_needed = TRUE;
@@ -1897,13 +5155,7 @@ int service_check_modules_status()
                }
                continue;
             }
-            if (running_modules[x].module_service_sd != -1) {
-                  close(running_modules[x].module_service_sd);
-                  running_modules[x].module_service_sd = -1;
-            }
-            running_modules[x].module_status = FALSE;
-            running_modules[x].module_service_ifc_isconnected = FALSE;
-            running_modules[x].module_pid = 0;
+            service_handle_module_exit(x, -1, NULL);
          } else {
             running_modules[x].module_status = TRUE;
             running_modules[x].module_root_perm_needed = FALSE;
@@ -1916,23 +5168,12 @@ int service_check_modules_status()
 
 void service_clean_after_children()
 {
-   pid_t result;
    unsigned int x;
-   int status;
 
+   // Modules with pidfd are reaped by service_process_events() when their pidfd becomes readable
    for (x=0; x<loaded_modules_cnt; x++) {
-      if (running_modules[x].module_pid > 0 && running_modules[x].module_is_my_child) {
-         result = waitpid(running_modules[x].module_pid , &status, WNOHANG);
-         if (result == 0) {
-           // Child still alive, nothing to do here!
-         } else if (result == -1) {
-           // Error
-            if (errno == ECHILD) {
-               running_modules[x].module_is_my_child = FALSE;
-            }
-         } else {
-           // Child exited
-         }
+      if (running_modules[x].module_pid > 0 && running_modules[x].module_is_my_child && running_modules[x].module_pidfd == -1) {
+         service_reap_module(x);
       }
    }
 }
@@ -1940,17 +5181,27 @@ void service_clean_after_children()
 void service_stop_modules_sigint()
 {
    unsigned int x;
+   int stop_timeout = 0;
    for (x=0; x<loaded_modules_cnt; x++) {
       if (running_modules[x].module_status == TRUE && running_modules[x].module_root_perm_needed == FALSE
           && ((running_modules[x].modules_profile != NULL && running_modules[x].modules_profile->profile_enabled == FALSE) || running_modules[x].module_enabled == FALSE)
-          && running_modules[x].sent_sigint == FALSE) {
+          && running_modules[x].module_stop_state == MODULE_STOP_NONE) {
          #ifdef nemea_plugin
             netconf_notify(MODULE_EVENT_STOPPED,running_modules[x].module_name);
          #endif
-         VERBOSE(MODULE_EVENT, "%s [STOP] Stopping module %s... sending SIGINT\n", get_formatted_time(), running_modules[x].module_name);
+         stop_timeout = (running_modules[x].module_stop_timeout > -1 ? running_modules[x].module_stop_timeout : DEFAULT_STOP_TIMEOUT_MS);
+         VERBOSE(MODULE_EVENT, "%s [STOP] Stopping module %s... sending SIGINT (SIGKILL in %d ms)\n", get_formatted_time(), running_modules[x].module_name, stop_timeout);
          // kill with negative PID to send the signal to processes in the same process group (subprocesses created by the main process)
-         kill(-running_modules[x].module_pid, 2);
-         running_modules[x].sent_sigint = TRUE;
+         if (kill(-running_modules[x].module_pid, 2) == -1 && errno == EPERM) {
+            VERBOSE(MODULE_EVENT,"%s [WARNING] Does not have permissions to send signals to module \"%s\"\n", get_formatted_time(), running_modules[x].module_name);
+            running_modules[x].module_root_perm_needed = TRUE;
+            continue;
+         }
+         // Disabled module does not keep its listening sockets
+         hot_restart_close_sockets(x);
+         // The module drains in parallel with other modules, its exit or the deadline wakes up the service thread
+         running_modules[x].module_stop_state = MODULE_STOP_SIGINT_SENT;
+         running_modules[x].module_sigkill_deadline = get_monotonic_time_ms() + stop_timeout;
          running_modules[x].module_restart_cnt = -1;
       }
    }
@@ -1963,14 +5214,17 @@ void service_stop_modules_sigkill()
    char *dest_port = NULL;
    char buffer[DEFAULT_SIZE_OF_BUFFER];
    unsigned int x, y;
+   uint64_t now = get_monotonic_time_ms();
 
    for (x = 0; x < loaded_modules_cnt; x++) {
       if (running_modules[x].module_status == TRUE
           && (running_modules[x].module_enabled == FALSE || (running_modules[x].modules_profile != NULL && running_modules[x].modules_profile->profile_enabled == FALSE))
-          && running_modules[x].sent_sigint == TRUE) {
+          && running_modules[x].module_stop_state == MODULE_STOP_SIGINT_SENT
+          && now >= running_modules[x].module_sigkill_deadline) {
          VERBOSE(MODULE_EVENT, "%s [STOP] Stopping module %s... sending SIGKILL\n", get_formatted_time(), running_modules[x].module_name);
          // kill with negative PID to send the signal to processes in the same process group (subprocesses created by the main process)
          kill(-running_modules[x].module_pid, 9);
+         running_modules[x].module_stop_state = MODULE_STOP_SIGKILL_SENT;
          running_modules[x].module_restart_cnt = -1;
 
          // Delete all unix-socket files after killing the module
@@ -2003,43 +5257,131 @@ void service_stop_modules_sigkill()
 
 
 
-void service_update_modules_status()
+uint64_t service_restart_backoff(uint32_t failures)
+{
+   uint64_t delay = RESTART_BACKOFF_MIN_MS;
+
+   // The delay is doubled with every consecutive failure up to restart-backoff-max
+   while (failures > 1 && delay < (uint64_t) restart_backoff_max_config) {
+      delay *= 2;
+      failures--;
+   }
+   if (delay > (uint64_t) restart_backoff_max_config) {
+      delay = restart_backoff_max_config;
+   }
+   // Jitter spreads restarts of modules which exited together (e.g. after a failure of their common producer)
+   return (delay / 2) + (random() % ((delay / 2) + 1));
+}
+
+int service_schedule_restart(const int module_idx)
 {
-   unsigned int x = 0;
    int max_restarts = 0;
+   uint64_t now = get_monotonic_time_ms();
 
-   for (x=0; x<loaded_modules_cnt; x++) {
-      if (++running_modules[x].module_restart_timer >= NUM_SERVICE_IFC_PERIODS) {
-         running_modules[x].module_restart_timer = 0;
-         if (running_modules[x].module_restart_cnt > 0) {
-            running_modules[x].module_restart_cnt = 0;
-         }
-      }
+   if (running_modules[module_idx].module_max_restarts_per_minute > -1) {
+      max_restarts = running_modules[module_idx].module_max_restarts_per_minute;
+   } else {
+      max_restarts = module_restarts_num_config;
+   }
 
-      // TODO why assigning this value in every service thread cycle???
-      if (running_modules[x].module_max_restarts_per_minute > -1) {
-         max_restarts = running_modules[x].module_max_restarts_per_minute;
-      } else {
-         max_restarts = module_restarts_num_config;
-      }
+   // A module that ran long enough is not crash-looping, its backoff starts from the beginning
+   if (now - running_modules[module_idx].module_start_time >= RESTART_STABLE_RUN_MS) {
+      running_modules[module_idx].module_restart_failures = 0;
+   }
+   running_modules[module_idx].module_restart_failures++;
 
-      if ((running_modules[x].modules_profile != NULL && running_modules[x].modules_profile->profile_enabled == TRUE)
-           && running_modules[x].module_enabled == TRUE
-           && running_modules[x].module_status == FALSE
-           && (running_modules[x].module_restart_cnt == max_restarts)) {
-         VERBOSE(MODULE_EVENT,"%s [RESTART] Module: %s was restarted %d times per minute and it is down again. I set it disabled.\n", get_formatted_time(), running_modules[x].module_name, max_restarts);
-         running_modules[x].module_enabled = FALSE;
+   if (max_restarts < MAX_MODULE_RESTARTS_NUM && running_modules[module_idx].module_restart_failures > max_restarts) {
+      if (restart_cooldown_config == 0) {
+         VERBOSE(MODULE_EVENT,"%s [RESTART] Module: %s was restarted %d times and it is down again. I set it disabled.\n", get_formatted_time(), running_modules[module_idx].module_name, max_restarts);
+         running_modules[module_idx].module_enabled = FALSE;
          #ifdef nemea_plugin
-            netconf_notify(MODULE_EVENT_DISABLED,running_modules[x].module_name);
+            netconf_notify(MODULE_EVENT_DISABLED,running_modules[module_idx].module_name);
          #endif
-      } else if ((running_modules[x].modules_profile != NULL && running_modules[x].modules_profile->profile_enabled == TRUE)
-                 && running_modules[x].module_status == FALSE
-                 && running_modules[x].module_enabled == TRUE) {
+         return -1;
+      }
+      VERBOSE(MODULE_EVENT,"%s [RESTART] Module: %s was restarted %d times and it is down again. It will be started after cool-down of %d s.\n", get_formatted_time(), running_modules[module_idx].module_name, max_restarts, restart_cooldown_config);
+      running_modules[module_idx].module_restart_failures = 0;
+      running_modules[module_idx].module_restart_deadline = now + ((uint64_t) restart_cooldown_config * 1000);
+      return 0;
+   }
+
+   running_modules[module_idx].module_restart_deadline = now + service_restart_backoff(running_modules[module_idx].module_restart_failures);
+   VERBOSE(DEBUG,"%s [RESTART] Module %s exited (%u. time in a row), it will be restarted in %"PRIu64" ms.\n", get_formatted_time(), running_modules[module_idx].module_name, running_modules[module_idx].module_restart_failures, running_modules[module_idx].module_restart_deadline - now);
+   return 0;
+}
+
+void service_update_modules_status()
+{
+   unsigned int x = 0, wave = 0;
+   uint64_t now = get_monotonic_time_ms();
+
+   // Modules are started in waves of dataflow graph, so consumers find their producers ready
+   dataflow_update_graph();
+   for (wave = 0; wave <= dataflow_max_wave; wave++) {
+      for (x=0; x<loaded_modules_cnt; x++) {
+         if (running_modules[x].startup_wave != wave) {
+            continue;
+         }
+         if (running_modules[x].modules_profile == NULL || running_modules[x].modules_profile->profile_enabled == FALSE
+             || running_modules[x].module_enabled == FALSE || running_modules[x].module_status == TRUE) {
+            continue;
+         }
+
+         if (running_modules[x].module_running == FALSE || running_modules[x].module_restart_cnt == -1) {
+            // Modules enabled by user or by reload are started immediately and their backoff starts from the beginning
+            running_modules[x].module_restart_failures = 0;
+            running_modules[x].module_restart_deadline = 0;
+         } else if (running_modules[x].module_restart_deadline == 0) {
+            // The module exited without being stopped by supervisor, its restart is scheduled
+            if (service_schedule_restart(x) == -1) {
+               continue;
+            }
+         }
+         if (running_modules[x].module_restart_deadline > now) {
+            continue;
+         }
+         // A module waiting for its producers is started as soon as they are ready
+         if (dataflow_producers_ready(x) == FALSE) {
+            continue;
+         }
+         running_modules[x].module_restart_deadline = 0;
          service_start_module(x);
       }
    }
 }
 
+void service_probe_started_modules()
+{
+   unsigned int x = 0;
+   uint64_t now = get_monotonic_time_ms();
+
+   // Service interface of a module is created after its TRAP interfaces, the module is ready once supervisor connects to it
+   for (x = 0; x < loaded_modules_cnt; x++) {
+      if (running_modules[x].startup_probing == FALSE) {
+         continue;
+      }
+      if (running_modules[x].module_status == FALSE || running_modules[x].module_service_ifc_isconnected == TRUE
+          || now >= running_modules[x].startup_ready_deadline) {
+         running_modules[x].startup_probing = FALSE;
+         continue;
+      }
+      if (now >= running_modules[x].startup_next_probe) {
+         if (running_modules[x].module_service_sd != -1) {
+            close(running_modules[x].module_service_sd);
+            running_modules[x].module_service_sd = -1;
+         }
+         service_connect_to_module(x);
+         if (running_modules[x].module_service_ifc_isconnected == TRUE) {
+            running_modules[x].startup_probing = FALSE;
+         } else if (now + STARTUP_PROBE_INTERVAL_MS < running_modules[x].startup_ready_deadline) {
+            running_modules[x].startup_next_probe = now + STARTUP_PROBE_INTERVAL_MS;
+         } else {
+            running_modules[x].startup_next_probe = running_modules[x].startup_ready_deadline;
+         }
+      }
+   }
+}
+
 
 void service_check_connections()
 {
@@ -2061,107 +5403,490 @@ void service_check_connections()
 }
 
 
-int service_recv_data(int module_idx, uint32_t size, void **data)
+int service_send_data(int module_idx, uint32_t size, void **data)
 {
-   int num_of_timeouts = 0;
-   int total_receved = 0;
-   int last_receved = 0;
+   int total_sent = 0, last_sent = 0;
 
-   while (total_receved < size) {
-      last_receved = recv(running_modules[module_idx].module_service_sd, (*data) + total_receved, size - total_receved, MSG_DONTWAIT);
-      if (last_receved == 0) {
-         VERBOSE(STATISTICS,"! Modules service thread closed its socket, im done !\n");
-         return -1;
-      } else if (last_receved == -1) {
-         if (errno == EAGAIN  || errno == EWOULDBLOCK) {
-            num_of_timeouts++;
-            if (num_of_timeouts > SERVICE_WAIT_MAX_TRY) {
-               VERBOSE(MODULE_EVENT,"%s [SERVICE] Timeout while receiving from module %d_%s !\n", get_formatted_time(), module_idx, running_modules[module_idx].module_name);
-               return -1;
-            } else {
-               usleep(SERVICE_WAIT_BEFORE_TIMEOUT);
-               continue;
-            }
+   // The service thread holds running_modules_lock here, so it must not wait for the module
+   while (total_sent < size) {
+      last_sent = send(running_modules[module_idx].module_service_sd, (*data) + total_sent, size - total_sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+      if (last_sent == -1) {
+         if (errno == EINTR) {
+            continue;
+         } else if (errno == EAGAIN  || errno == EWOULDBLOCK) {
+            VERBOSE(MODULE_EVENT,"%s [SERVICE] Module %d_%s does not read its service interface!\n", get_formatted_time(), module_idx, running_modules[module_idx].module_name);
+            return -1;
          }
-         VERBOSE(MODULE_EVENT,"%s [SERVICE] Error while receiving from module %d_%s !\n", get_formatted_time(), module_idx, running_modules[module_idx].module_name);
+         VERBOSE(MODULE_EVENT,"%s [SERVICE] Error while sending to module %d_%s !\n", get_formatted_time(), module_idx, running_modules[module_idx].module_name);
          return -1;
       }
-      total_receved += last_receved;
+      total_sent += last_sent;
    }
    return 0;
 }
 
-int service_send_data(int module_idx, uint32_t size, void **data)
+int service_request_module_stats(const int module_idx)
 {
-   int num_of_timeouts = 0, total_sent = 0, last_sent = 0;
+   service_msg_header_t header;
+   service_msg_header_t *header_ptr = &header;
 
-   while (total_sent < size) {
-      last_sent = send(running_modules[module_idx].module_service_sd, (*data) + total_sent, size - total_sent, MSG_DONTWAIT);
-      if (last_sent == -1) {
-         if (errno == EAGAIN  || errno == EWOULDBLOCK) {
-            num_of_timeouts++;
-            if (num_of_timeouts > SERVICE_WAIT_MAX_TRY) {
-               VERBOSE(MODULE_EVENT,"%s [SERVICE] Timeout while sending to module %d_%s !\n", get_formatted_time(), module_idx, running_modules[module_idx].module_name);
-               return -1;
-            } else {
-               usleep(SERVICE_WAIT_BEFORE_TIMEOUT);
-               continue;
+   memset(&header, 0, sizeof(header));
+   // Binary stats are requested until the module replies in JSON (older libtrap)
+   if (running_modules[module_idx].service_stats_format == SERVICE_STATS_FORMAT_JSON) {
+      header.com = SERVICE_GET_COM;
+   } else {
+      header.com = SERVICE_GET_BIN_COM;
+   }
+   header.data_size = 0;
+
+   if (service_send_data(module_idx, sizeof(service_msg_header_t), (void **) &header_ptr) == -1) {
+      return -1;
+   }
+
+   running_modules[module_idx].service_reply_pending = TRUE;
+   running_modules[module_idx].service_reply_received = 0;
+   running_modules[module_idx].service_reply_deadline = get_monotonic_time_ms() + SERVICE_REPLY_TIMEOUT_MS;
+   return 0;
+}
+
+void service_recv_module_reply(const int module_idx)
+{
+   const uint32_t header_size = sizeof(service_msg_header_t);
+   service_msg_header_t *header = &running_modules[module_idx].service_reply_header;
+   char *dest = NULL;
+   uint32_t len = 0;
+   ssize_t last_received = 0;
+   int ret_val = 0;
+
+   if (running_modules[module_idx].service_reply_pending == FALSE) {
+      VERBOSE(MODULE_EVENT, "%s [SERVICE] Unexpected data from module %d_%s.\n", get_formatted_time(), module_idx, running_modules[module_idx].module_name);
+      service_disconnect_from_module(module_idx);
+      return;
+   }
+
+   // Read everything that is available, the rest of the reply is read after next EPOLLIN event
+   while (running_modules[module_idx].service_reply_pending == TRUE) {
+      if (running_modules[module_idx].service_reply_received < header_size) {
+         dest = ((char *) header) + running_modules[module_idx].service_reply_received;
+         len = header_size - running_modules[module_idx].service_reply_received;
+      } else {
+         dest = running_modules[module_idx].service_buffer + (running_modules[module_idx].service_reply_received - header_size);
+         len = header_size + header->data_size - running_modules[module_idx].service_reply_received;
+      }
+
+      last_received = recv(running_modules[module_idx].module_service_sd, dest, len, MSG_DONTWAIT);
+      if (last_received == 0) {
+         VERBOSE(MODULE_EVENT, "%s [SERVICE] Module %d_%s closed its service interface.\n", get_formatted_time(), module_idx, running_modules[module_idx].module_name);
+         service_disconnect_from_module(module_idx);
+         return;
+      } else if (last_received == -1) {
+         if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return;
+         } else if (errno == EINTR) {
+            continue;
+         }
+         VERBOSE(MODULE_EVENT, "%s [SERVICE] Error while receiving from module %d_%s !\n", get_formatted_time(), module_idx, running_modules[module_idx].module_name);
+         service_disconnect_from_module(module_idx);
+         return;
+      }
+      running_modules[module_idx].service_reply_received += last_received;
+
+      if (running_modules[module_idx].service_reply_received == header_size) {
+         // Check if the reply is OK
+         if (header->com != SERVICE_OK_REPLY && header->com != SERVICE_OK_BIN_REPLY) {
+            VERBOSE(MODULE_EVENT, "%s [SERVICE] Wrong reply from module %d_%s.\n", get_formatted_time(), module_idx, running_modules[module_idx].module_name);
+            service_disconnect_from_module(module_idx);
+            return;
+         }
+         if (header->data_size + 1 > running_modules[module_idx].service_buffer_size) {
+            // Reallocate buffer for incoming data
+            running_modules[module_idx].service_buffer_size = header->data_size + 1;
+            running_modules[module_idx].service_buffer = (char *) realloc(running_modules[module_idx].service_buffer, running_modules[module_idx].service_buffer_size * sizeof(char));
+            if (running_modules[module_idx].service_buffer == NULL) {
+               running_modules[module_idx].service_buffer_size = 0;
+               VERBOSE(MODULE_EVENT, "%s [SERVICE] Could not allocate buffer for stats of module %d_%s.\n", get_formatted_time(), module_idx, running_modules[module_idx].module_name);
+               service_disconnect_from_module(module_idx);
+               return;
+            }
+         }
+      }
+
+      if (running_modules[module_idx].service_reply_received >= header_size
+          && running_modules[module_idx].service_reply_received == header_size + header->data_size) {
+         // Whole reply was received, decode it and save stats into module structure
+         running_modules[module_idx].service_buffer[header->data_size] = 0;
+         running_modules[module_idx].service_reply_pending = FALSE;
+         if (header->com == SERVICE_OK_BIN_REPLY) {
+            running_modules[module_idx].service_stats_format = SERVICE_STATS_FORMAT_BIN;
+            running_modules[module_idx].service_bin_unanswered = 0;
+            ret_val = service_decode_module_stats_bin(running_modules[module_idx].service_buffer, header->data_size, module_idx);
+         } else {
+            if (running_modules[module_idx].service_stats_format != SERVICE_STATS_FORMAT_JSON) {
+               VERBOSE(MODULE_EVENT, "%s [SERVICE] Module %d_%s replies stats in JSON.\n", get_formatted_time(), module_idx, running_modules[module_idx].module_name);
+               running_modules[module_idx].service_stats_format = SERVICE_STATS_FORMAT_JSON;
             }
+            ret_val = service_decode_module_stats(&running_modules[module_idx].service_buffer, module_idx);
+         }
+         if (ret_val == -1) {
+            VERBOSE(MODULE_EVENT, "%s [SERVICE] Error while receiving stats from module %d_%s.\n", get_formatted_time(), module_idx, running_modules[module_idx].module_name);
+            service_disconnect_from_module(module_idx);
+         } else {
+            service_adapt_stats_interval(module_idx);
+         }
+      }
+   }
+}
+
+void service_check_reply_timeouts()
+{
+   unsigned int x = 0;
+   uint64_t now = get_monotonic_time_ms();
+
+   for (x = 0; x < loaded_modules_cnt; x++) {
+      if (running_modules[x].module_service_ifc_isconnected == TRUE && running_modules[x].service_reply_pending == TRUE
+          && now >= running_modules[x].service_reply_deadline) {
+         VERBOSE(MODULE_EVENT,"%s [SERVICE] Timeout while receiving from module %d_%s !\n", get_formatted_time(), x, running_modules[x].module_name);
+         service_disconnect_from_module(x);
+      }
+   }
+}
+
+uint32_t service_get_stats_interval(const int module_idx)
+{
+   int interval = running_modules[module_idx].module_stats_interval;
+
+   if (interval == -1) {
+      interval = stats_interval_config;
+   }
+   if (interval != STATS_INTERVAL_ADAPTIVE) {
+      return (uint32_t) interval;
+   }
+
+   // Adaptive mode starts with the default interval
+   if (running_modules[module_idx].stats_adaptive_interval == 0) {
+      running_modules[module_idx].stats_adaptive_interval = DEFAULT_STATS_INTERVAL_MS;
+   }
+   return running_modules[module_idx].stats_adaptive_interval;
+}
+
+void service_adapt_stats_interval(const int module_idx)
+{
+   uint64_t now = get_monotonic_time_ms(), msg_cnt = 0, msg_rate = 0;
+   uint32_t x = 0, interval = 0;
+
+   for (x = 0; x < running_modules[module_idx].total_in_ifces_cnt; x++) {
+      msg_cnt += running_modules[module_idx].in_ifces_data[x].recv_msg_cnt;
+   }
+   for (x = 0; x < running_modules[module_idx].total_out_ifces_cnt; x++) {
+      msg_cnt += running_modules[module_idx].out_ifces_data[x].sent_msg_cnt;
+   }
+
+   interval = service_get_stats_interval(module_idx);
+   if ((running_modules[module_idx].module_stats_interval == -1 && stats_interval_config == STATS_INTERVAL_ADAPTIVE)
+       || running_modules[module_idx].module_stats_interval == STATS_INTERVAL_ADAPTIVE) {
+      /* Busy modules are sampled more often, idle modules rarely. The counters are reset after restart of the module,
+         the interval is kept in such case. */
+      if (running_modules[module_idx].stats_last_sample_time != 0 && now > running_modules[module_idx].stats_last_sample_time
+          && msg_cnt >= running_modules[module_idx].stats_last_msg_cnt) {
+         msg_rate = ((msg_cnt - running_modules[module_idx].stats_last_msg_cnt) * 1000) / (now - running_modules[module_idx].stats_last_sample_time);
+         if (msg_rate >= ADAPTIVE_STATS_BUSY_RATE) {
+            interval /= 2;
+         } else if (msg_cnt == running_modules[module_idx].stats_last_msg_cnt) {
+            interval *= 2;
+         }
+         if (interval < ADAPTIVE_STATS_MIN_INTERVAL_MS) {
+            interval = ADAPTIVE_STATS_MIN_INTERVAL_MS;
+         } else if (interval > ADAPTIVE_STATS_MAX_INTERVAL_MS) {
+            interval = ADAPTIVE_STATS_MAX_INTERVAL_MS;
+         }
+         running_modules[module_idx].stats_adaptive_interval = interval;
+      }
+   }
+
+   running_modules[module_idx].stats_last_msg_cnt = msg_cnt;
+   running_modules[module_idx].stats_last_sample_time = now;
+}
+
+void service_request_stats()
+{
+   unsigned int x = 0;
+   uint64_t now = get_monotonic_time_ms();
+
+   for (x = 0; x < loaded_modules_cnt; x++) {
+      if (running_modules[x].module_status == TRUE && running_modules[x].module_service_ifc_isconnected == TRUE
+          && running_modules[x].service_reply_pending == FALSE && now >= running_modules[x].stats_next_request) {
+         if (service_request_module_stats(x) == -1) {
+            VERBOSE(MODULE_EVENT,"%s [SERVICE] Error while sending request to module %d_%s.\n", get_formatted_time(), x, running_modules[x].module_name);
+            service_disconnect_from_module(x);
+            continue;
+         }
+         running_modules[x].stats_next_request = now + service_get_stats_interval(x);
+      }
+   }
+}
+
+void service_connect_to_module(const int module)
+{
+   // service_sock_spec size is length of "service_PID" where PID is max 5 chars (8 + 5 + 1 zero terminating)
+   char service_sock_spec[14];
+   int sockfd = -1;
+   union tcpip_socket_addr addr;
+
+   memset(service_sock_spec, 0, 14 * sizeof(char));
+   sprintf(service_sock_spec, "service_%d", running_modules[module].module_pid);
+
+   memset(&addr, 0, sizeof(addr));
+
+   addr.unix_addr.sun_family = AF_UNIX;
+   snprintf(addr.unix_addr.sun_path, sizeof(addr.unix_addr.sun_path) - 1, trap_default_socket_path_format, service_sock_spec);
+   sockfd = socket(AF_UNIX, SOCK_STREAM, 0);
+   if (sockfd == -1) {
+      VERBOSE(MODULE_EVENT,"%s [SERVICE] Error while opening socket for connection with module %s.\n", get_formatted_time(), running_modules[module].module_name);
+      running_modules[module].module_service_ifc_isconnected = FALSE;
+      return;
+   }
+   if (connect(sockfd, (struct sockaddr *) &addr.unix_addr, sizeof(addr.unix_addr)) == -1) {
+      if (running_modules[module].service_ifc_conn_timer == 1) {
+         VERBOSE(MODULE_EVENT,"%s [SERVICE] Error while connecting to module %s with socket \"%s\"\n", get_formatted_time(), running_modules[module].module_name, addr.unix_addr.sun_path);
+      }
+      running_modules[module].module_service_ifc_isconnected = FALSE;
+      close(sockfd);
+      return;
+   }
+   if (service_watch_fd(sockfd, EPOLLIN | EPOLLRDHUP) == -1) {
+      VERBOSE(MODULE_EVENT,"%s [SERVICE] Could not watch service connection with module %s.\n", get_formatted_time(), running_modules[module].module_name);
+   }
+   running_modules[module].module_service_sd = sockfd;
+   running_modules[module].module_service_ifc_isconnected = TRUE;
+   running_modules[module].service_reply_pending = FALSE;
+   running_modules[module].stats_next_request = 0; // Request stats right after the connection
+   running_modules[module].stats_last_sample_time = 0;
+   running_modules[module].service_ifc_conn_timer = 0; // Successfully connected to the module, reset connection timer
+   VERBOSE(MODULE_EVENT,"%s [SERVICE] Connected to module %s.\n", get_formatted_time(), running_modules[module].module_name);
+}
+
+int service_init_event_loop()
+{
+   struct itimerspec period;
+   sigset_t sigchld_mask;
+
+   service_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+   if (service_epoll_fd == -1) {
+      VERBOSE(N_STDOUT, "%s [ERROR] Service thread: could not create epoll instance (%s).\n", get_formatted_time(), strerror(errno));
+      goto init_fail;
+   }
+
+   // Timer expiring at the end of every service thread period
+   service_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+   if (service_timer_fd == -1) {
+      VERBOSE(N_STDOUT, "%s [ERROR] Service thread: could not create timer (%s).\n", get_formatted_time(), strerror(errno));
+      goto init_fail;
+   }
+   memset(&period, 0, sizeof(period));
+   period.it_interval.tv_sec = SERVICE_THREAD_PERIOD_IN_MICSEC / 1000000;
+   period.it_interval.tv_nsec = (SERVICE_THREAD_PERIOD_IN_MICSEC % 1000000) * 1000;
+   period.it_value = period.it_interval;
+   if (timerfd_settime(service_timer_fd, 0, &period, NULL) == -1 || service_watch_fd(service_timer_fd, EPOLLIN) == -1) {
+      VERBOSE(N_STDOUT, "%s [ERROR] Service thread: could not set timer (%s).\n", get_formatted_time(), strerror(errno));
+      goto init_fail;
+   }
+
+   // Eventfd used by other threads to wake up the service thread
+   service_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+   if (service_event_fd == -1 || service_watch_fd(service_event_fd, EPOLLIN) == -1) {
+      VERBOSE(N_STDOUT, "%s [ERROR] Service thread: could not create eventfd (%s).\n", get_formatted_time(), strerror(errno));
+      goto init_fail;
+   }
+
+   /* SIGCHLD is blocked in all supervisor threads (they inherit the mask of the calling thread) and received via signalfd,
+      started modules unblock it before exec. Without signalfd the exits are still detected at the end of every period. */
+   sigemptyset(&sigchld_mask);
+   sigaddset(&sigchld_mask, SIGCHLD);
+   if (pthread_sigmask(SIG_BLOCK, &sigchld_mask, NULL) == 0) {
+      service_signal_fd = signalfd(-1, &sigchld_mask, SFD_NONBLOCK | SFD_CLOEXEC);
+      if (service_signal_fd == -1 || service_watch_fd(service_signal_fd, EPOLLIN) == -1) {
+         VERBOSE(N_STDOUT, "%s [WARNING] Service thread: could not create signalfd, module exits will be detected periodically.\n", get_formatted_time());
+         if (service_signal_fd != -1) {
+            close(service_signal_fd);
+            service_signal_fd = -1;
+         }
+         pthread_sigmask(SIG_UNBLOCK, &sigchld_mask, NULL);
+      }
+   }
+
+   return 0;
+
+init_fail:
+   service_free_event_loop();
+   return -1;
+}
+
+void service_free_event_loop()
+{
+   if (service_signal_fd != -1) {
+      close(service_signal_fd);
+      service_signal_fd = -1;
+   }
+   if (service_event_fd != -1) {
+      close(service_event_fd);
+      service_event_fd = -1;
+   }
+   if (service_timer_fd != -1) {
+      close(service_timer_fd);
+      service_timer_fd = -1;
+   }
+   if (service_epoll_fd != -1) {
+      close(service_epoll_fd);
+      service_epoll_fd = -1;
+   }
+}
+
+int service_watch_fd(int fd, uint32_t events)
+{
+   struct epoll_event ev;
+
+   if (service_epoll_fd == -1) {
+      return -1;
+   }
+   memset(&ev, 0, sizeof(ev));
+   ev.events = events;
+   ev.data.fd = fd;
+   return epoll_ctl(service_epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+void service_wakeup()
+{
+   uint64_t value = 1;
+
+   if (service_event_fd != -1) {
+      if (write(service_event_fd, &value, sizeof(value)) == -1 && errno != EAGAIN) {
+         VERBOSE(DEBUG, "%s [SERVICE] Could not wake up service thread (%s).\n", get_formatted_time(), strerror(errno));
+      }
+   }
+}
+
+int service_get_wait_timeout()
+{
+   unsigned int x = 0;
+   uint64_t now = get_monotonic_time_ms(), nearest_deadline = 0;
+
+   for (x = 0; x < loaded_modules_cnt; x++) {
+      if (running_modules[x].module_status == TRUE && running_modules[x].module_stop_state == MODULE_STOP_SIGINT_SENT) {
+         if (nearest_deadline == 0 || running_modules[x].module_sigkill_deadline < nearest_deadline) {
+            nearest_deadline = running_modules[x].module_sigkill_deadline;
+         }
+      }
+      if (running_modules[x].module_status == FALSE && running_modules[x].module_enabled == TRUE && running_modules[x].module_restart_deadline != 0) {
+         if (nearest_deadline == 0 || running_modules[x].module_restart_deadline < nearest_deadline) {
+            nearest_deadline = running_modules[x].module_restart_deadline;
+         }
+      }
+      if (running_modules[x].module_retiring_pid > 0 && running_modules[x].module_retiring_stop_state == MODULE_STOP_SIGINT_SENT) {
+         if (nearest_deadline == 0 || running_modules[x].module_retiring_deadline < nearest_deadline) {
+            nearest_deadline = running_modules[x].module_retiring_deadline;
+         }
+      }
+      if (running_modules[x].startup_probing == TRUE) {
+         if (nearest_deadline == 0 || running_modules[x].startup_next_probe < nearest_deadline) {
+            nearest_deadline = running_modules[x].startup_next_probe;
+         }
+      }
+      if (running_modules[x].module_service_ifc_isconnected == TRUE && running_modules[x].service_reply_pending == TRUE) {
+         if (nearest_deadline == 0 || running_modules[x].service_reply_deadline < nearest_deadline) {
+            nearest_deadline = running_modules[x].service_reply_deadline;
+         }
+      } else if (running_modules[x].module_status == TRUE && running_modules[x].module_service_ifc_isconnected == TRUE) {
+         // Next stats request (a zero value means the stats are requested as soon as possible)
+         if (running_modules[x].stats_next_request <= now) {
+            return 0;
+         } else if (nearest_deadline == 0 || running_modules[x].stats_next_request < nearest_deadline) {
+            nearest_deadline = running_modules[x].stats_next_request;
          }
-         VERBOSE(MODULE_EVENT,"%s [SERVICE] Error while sending to module %d_%s !\n", get_formatted_time(), module_idx, running_modules[module_idx].module_name);
-         return -1;
       }
-      total_sent += last_sent;
    }
-   return 0;
+
+   if (nearest_deadline == 0) {
+      // Nothing is scheduled, wait for the end of the period or for an event
+      return -1;
+   } else if (nearest_deadline <= now) {
+      return 0;
+   }
+   return (int) (nearest_deadline - now);
 }
 
-void service_connect_to_module(const int module)
+void service_process_events(struct epoll_event *events, int events_cnt, int *period_elapsed)
 {
-   // service_sock_spec size is length of "service_PID" where PID is max 5 chars (8 + 5 + 1 zero terminating)
-   char service_sock_spec[14];
-   int sockfd = -1;
-   union tcpip_socket_addr addr;
-
-   memset(service_sock_spec, 0, 14 * sizeof(char));
-   sprintf(service_sock_spec, "service_%d", running_modules[module].module_pid);
-
-   memset(&addr, 0, sizeof(addr));
-
-   addr.unix_addr.sun_family = AF_UNIX;
-   snprintf(addr.unix_addr.sun_path, sizeof(addr.unix_addr.sun_path) - 1, trap_default_socket_path_format, service_sock_spec);
-   sockfd = socket(AF_UNIX, SOCK_STREAM, 0);
-   if (sockfd == -1) {
-      VERBOSE(MODULE_EVENT,"%s [SERVICE] Error while opening socket for connection with module %s.\n", get_formatted_time(), running_modules[module].module_name);
-      running_modules[module].module_service_ifc_isconnected = FALSE;
-      return;
-   }
-   if (connect(sockfd, (struct sockaddr *) &addr.unix_addr, sizeof(addr.unix_addr)) == -1) {
-      if (running_modules[module].service_ifc_conn_timer == 1) {
-         VERBOSE(MODULE_EVENT,"%s [SERVICE] Error while connecting to module %s with socket \"%s\"\n", get_formatted_time(), running_modules[module].module_name, addr.unix_addr.sun_path);
+   int x = 0, module_idx = -1;
+   unsigned int y = 0;
+   uint64_t value = 0;
+   struct signalfd_siginfo siginfo;
+
+   for (x = 0; x < events_cnt; x++) {
+      if (events[x].data.fd == service_timer_fd) {
+         if (read(service_timer_fd, &value, sizeof(value)) > 0) {
+            *period_elapsed = TRUE;
+         }
+      } else if (events[x].data.fd == service_event_fd) {
+         // Somebody changed modules configuration, the counter is just cleared
+         if (read(service_event_fd, &value, sizeof(value)) == -1) {
+            VERBOSE(DEBUG, "%s [SERVICE] Could not read wake up event (%s).\n", get_formatted_time(), strerror(errno));
+         }
+      } else if (events[x].data.fd == service_signal_fd) {
+         // Some child exited, the children are cleaned and modules status is checked during the following pass
+         while (read(service_signal_fd, &siginfo, sizeof(siginfo)) == sizeof(siginfo)) {
+            // Module without pidfd is reaped as soon as its exit is reported (SIGCHLD signals can be merged, the pass cleans the rest)
+            module_idx = find_module_by_pid((pid_t) siginfo.ssi_pid);
+            if (module_idx == -1) {
+               continue;
+            }
+            if (running_modules[module_idx].module_pid == (pid_t) siginfo.ssi_pid && running_modules[module_idx].module_pidfd == -1) {
+               service_reap_module(module_idx);
+            } else if (running_modules[module_idx].module_retiring_pid == (pid_t) siginfo.ssi_pid && running_modules[module_idx].module_retiring_pidfd == -1) {
+               hot_restart_reap_retiring_module(module_idx);
+            }
+         }
+      } else {
+         for (y = 0; y < loaded_modules_cnt; y++) {
+            if (running_modules[y].module_pid > 0 && running_modules[y].module_pidfd == events[x].data.fd) {
+               // Module exited
+               service_reap_module(y);
+               break;
+            } else if (running_modules[y].module_retiring_pid > 0 && running_modules[y].module_retiring_pidfd == events[x].data.fd) {
+               // Previous instance of hot restarted module exited
+               hot_restart_reap_retiring_module(y);
+               break;
+            } else if (running_modules[y].module_service_sd == events[x].data.fd) {
+               if (events[x].events & EPOLLIN) {
+                  // (Part of) reply with module stats
+                  service_recv_module_reply(y);
+               }
+               if ((events[x].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) && running_modules[y].module_service_sd == events[x].data.fd) {
+                  // Module closed its service interface (it probably exited)
+                  service_disconnect_from_module(y);
+               }
+               break;
+            }
+         }
       }
-      running_modules[module].module_service_ifc_isconnected = FALSE;
-      close(sockfd);
-      return;
    }
-   running_modules[module].module_service_sd = sockfd;
-   running_modules[module].module_service_ifc_isconnected = TRUE;
-   running_modules[module].service_ifc_conn_timer = 0; // Successfully connected to the module, reset connection timer
-   VERBOSE(MODULE_EVENT,"%s [SERVICE] Connected to module %s.\n", get_formatted_time(), running_modules[module].module_name);
 }
 
 void *service_thread_routine(void *arg __attribute__ ((unused)))
 {
    uint64_t period_cnt = 0;
-   service_msg_header_t *header = (service_msg_header_t *) calloc(1, sizeof(service_msg_header_t));
-   uint32_t buffer_size = 256;
-   char *buffer = (char *) calloc(buffer_size, sizeof(char));
    int running_modules_cnt = 0;
    unsigned int x,y;
+   struct epoll_event events[SERVICE_MAX_EPOLL_EVENTS];
+   int events_cnt = 0, wait_timeout = -1;
+   int period_elapsed = TRUE; // The first pass does all the period tasks
 
    while (TRUE) {
       pthread_mutex_lock(&running_modules_lock);
 
+      service_process_events(events, events_cnt, &period_elapsed);
+      service_check_reply_timeouts();
+
+      service_clean_after_children();
       running_modules_cnt = service_check_modules_status();
       if (service_thread_continue == FALSE) {
          if (service_stop_all_modules == FALSE) {
@@ -2172,28 +5897,34 @@ void *service_thread_routine(void *arg __attribute__ ((unused)))
             break;
          }
       }
+      service_probe_started_modules();
       service_update_modules_status();
       service_stop_modules_sigint();
-
-      usleep(SERVICE_WAIT_FOR_MODULES_TO_FINISH);
-
-      service_clean_after_children();
-      running_modules_cnt = service_check_modules_status();
       service_stop_modules_sigkill();
+      hot_restart_stop_retiring_modules();
       service_clean_after_children();
+      running_modules_cnt = service_check_modules_status();
 
       for (y=0; y<loaded_modules_cnt; y++) {
          if (running_modules[y].module_served_by_service_thread == FALSE) {
             if (running_modules[y].remove_module == TRUE) {
-               if (running_modules[y].module_status == FALSE) {
+               if (running_modules[y].module_status == FALSE && running_modules[y].module_retiring_pid == 0) {
                   free_module_and_shift_array(y);
                }
+            } else if (running_modules[y].module_hot_restart_pending == TRUE) {
+               running_modules[y].module_hot_restart_pending = FALSE;
+               running_modules[y].module_served_by_service_thread = TRUE;
+               if (running_modules[y].module_status == TRUE) {
+                  hot_restart_module(y);
+               }
             } else if (running_modules[y].init_module == TRUE) {
                if (running_modules[y].module_status == FALSE) {
                   running_modules[y].module_enabled = TRUE;
                   running_modules[y].module_restart_cnt = -1;
                   running_modules[y].init_module = FALSE;
                   running_modules[y].module_served_by_service_thread = TRUE;
+                  // Start the module again without waiting for the end of the period
+                  service_wakeup();
                } else {
                   service_disconnect_from_module(y);
                }
@@ -2203,83 +5934,45 @@ void *service_thread_routine(void *arg __attribute__ ((unused)))
          }
       }
 
-      // Update status of every module before sending a request for their stats
-      running_modules_cnt = service_check_modules_status();
-
-      // Update CPU and memory usage
-      update_modules_resources_usage();
+      if (period_elapsed == TRUE) {
+         // Update CPU and memory usage
+         update_modules_resources_usage();
 
-      // Set request header
-      header->com = SERVICE_GET_COM;
-      header->data_size = 0;
-
-      // Handle connection between supervisor and modules via service interface
-      service_check_connections();
-
-      for (x=0;x<loaded_modules_cnt;x++) {
-         // If the module and supervisor are connected via service interface, request for stats is sent
-         if (running_modules[x].module_service_ifc_isconnected == TRUE) {
-            if (service_send_data(x, sizeof(service_msg_header_t), (void **) &header) == -1) {
-               VERBOSE(MODULE_EVENT,"%s [SERVICE] Error while sending request to module %d_%s.\n", get_formatted_time(), x, running_modules[x].module_name);
-               service_disconnect_from_module(x);
-            }
-         }
+         // Handle connection between supervisor and modules via service interface
+         service_check_connections();
       }
 
-      // Update status of every module before receiving their stats
-      running_modules_cnt = service_check_modules_status();
-
-      for (x=0;x<loaded_modules_cnt;x++) {
-         // Check whether the module is running and is connected with supervisor via service interface
-         if (running_modules[x].module_status == TRUE && running_modules[x].module_service_ifc_isconnected == TRUE) {
-            // Receive reply header
-            if (service_recv_data(x, sizeof(service_msg_header_t), (void **) &header) == -1) {
-               VERBOSE(MODULE_EVENT, "%s [SERVICE] Error while receiving reply header from module %d_%s.\n", get_formatted_time(), x, running_modules[x].module_name);
-               service_disconnect_from_module(x);
-               continue;
-            }
-
-            // Check if the reply is OK
-            if (header->com != SERVICE_OK_REPLY) {
-               VERBOSE(MODULE_EVENT, "%s [SERVICE] Wrong reply from module %d_%s.\n", get_formatted_time(), x, running_modules[x].module_name);
-               service_disconnect_from_module(x);
-               continue;
-            }
-
-            if (header->data_size > buffer_size) {
-               // Reallocate buffer for incoming data
-               buffer_size += (header->data_size - buffer_size) + 1;
-               buffer = (char *) realloc(buffer, buffer_size * sizeof(char));
-            }
-            memset(buffer, 0, buffer_size * sizeof(char));
-
-            // Receive module stats in json format
-            if (service_recv_data(x, header->data_size, (void **) &buffer) == -1) {
-               VERBOSE(MODULE_EVENT, "%s [SERVICE] Error while receiving stats from module %d_%s.\n", get_formatted_time(), x, running_modules[x].module_name);
-               service_disconnect_from_module(x);
-               continue;
-            }
+      /* Request stats from all modules whose stats interval elapsed, the replies are received in parallel
+         by service_process_events() as they arrive (see service_recv_module_reply()). */
+      service_request_stats();
 
-            // Decode json and save stats into module structure
-            if (service_decode_module_stats(&buffer, x) == -1) {
-               VERBOSE(MODULE_EVENT, "%s [SERVICE] Error while receiving stats from module %d_%s.\n", get_formatted_time(), x, running_modules[x].module_name);
-               service_disconnect_from_module(x);
-               continue;
-            }
-         }
+      // Publish current state of modules for readers
+      modules_snapshot_publish();
+      if (period_elapsed == TRUE) {
+         // Subscribed clients of daemon receive the published state after every period
+         daemon_notify_subscribers();
       }
 
+      wait_timeout = service_get_wait_timeout();
       pthread_mutex_unlock(&running_modules_lock);
 
-      if ((period_cnt%30 == 0) && (running_modules_cnt > 0)) {
-         print_statistics();
+      if (period_elapsed == TRUE) {
+         if ((period_cnt%30 == 0) && (running_modules_cnt > 0)) {
+            print_statistics();
+         }
+         period_cnt++;
+         period_elapsed = FALSE;
       }
 
-      if (service_thread_continue == TRUE) {
-         usleep(SERVICE_THREAD_SLEEP_IN_MICSEC);
+      // Sleep until something happens (module exit, user request, end of the period) or until the nearest deadline
+      events_cnt = epoll_wait(service_epoll_fd, events, SERVICE_MAX_EPOLL_EVENTS, wait_timeout);
+      if (events_cnt == -1) {
+         if (errno != EINTR) {
+            VERBOSE(N_STDOUT, "%s [ERROR] Service thread: epoll_wait failed (%s).\n", get_formatted_time(), strerror(errno));
+            usleep(SERVICE_WAIT_BEFORE_TIMEOUT);
+         }
+         events_cnt = 0;
       }
-
-      period_cnt++;
    } // Service thread loop
 
    // Disconnect from running modules
@@ -2287,280 +5980,535 @@ void *service_thread_routine(void *arg __attribute__ ((unused)))
       service_disconnect_from_module(x);
    }
 
-   NULLP_TEST_AND_FREE(buffer)
-   NULLP_TEST_AND_FREE(header)
-
    pthread_exit(EXIT_SUCCESS);
 }
 
-int service_decode_module_stats(char **data, int module_idx)
+int service_set_ifces_cnt(int module_idx, uint32_t in_cnt, uint32_t out_cnt)
 {
-   int actual_ifc_index = 0, x = 0;
-   size_t arr_idx = 0;
-
-   json_error_t error;
-   json_t *json_struct = NULL;
-
-   json_t *in_ifces_arr = NULL;
-   json_t *out_ifces_arr = NULL;
-   json_t *in_ifc_cnts  = NULL;
-   json_t *out_ifc_cnts = NULL;
-   json_t *cnt = NULL;
-
-   uint32_t ifc_cnt = 0;
-   const char *str = NULL;
-
-   /***********************************/
-
-   // Parse received modules counters in json format
-   json_struct = json_loads(*data , 0, &error);
-   if (json_struct == NULL) {
-      VERBOSE(MODULE_EVENT, "%s [ERROR] Could not convert modules (%s) stats to json structure on line %d: %s\n", get_formatted_time(), running_modules[module_idx].module_name, error.line, error.text);
-      return -1;
-   }
+   uint32_t x = 0;
 
-   // Check whether the root elem is a json object
-   if (json_is_object(json_struct) == 0) {
-      VERBOSE(MODULE_EVENT, "%s [ERROR] Root elem is not a json object (module %s).\n", get_formatted_time(), running_modules[module_idx].module_name);
-      json_decref(json_struct);
-      return -1;
-   }
-
-   // Check number of input interfaces the module is running with
-   cnt = json_object_get(json_struct, "in_cnt");
-   if (cnt == NULL) {
-      VERBOSE(MODULE_EVENT, "%s [ERROR] Could not get key \"in_cnt\" from root json object while parsing modules stats (module %s).\n", get_formatted_time(), running_modules[module_idx].module_name);
-      json_decref(json_struct);
-      return -1;
-   }
-   ifc_cnt = json_integer_value(cnt);
    // Realloc memory for input ifces data if needed
-   if (ifc_cnt != running_modules[module_idx].total_in_ifces_cnt) { // TODO do we need any limit check?
-      VERBOSE(MODULE_EVENT, "%s [SERVICE] Number of \"%s\" input interfaces has changed (%u -> %u).\n", get_formatted_time(), running_modules[module_idx].module_name, running_modules[module_idx].total_in_ifces_cnt, ifc_cnt);
+   if (in_cnt != running_modules[module_idx].total_in_ifces_cnt) {
+      VERBOSE(MODULE_EVENT, "%s [SERVICE] Number of \"%s\" input interfaces has changed (%u -> %u).\n", get_formatted_time(), running_modules[module_idx].module_name, running_modules[module_idx].total_in_ifces_cnt, in_cnt);
       if (running_modules[module_idx].in_ifces_data != NULL) {
          for (x = 0; x < running_modules[module_idx].total_in_ifces_cnt; x++) {
             NULLP_TEST_AND_FREE(running_modules[module_idx].in_ifces_data[x].ifc_id);
          }
          free(running_modules[module_idx].in_ifces_data);
       }
-      running_modules[module_idx].in_ifces_data = (in_ifc_stats_t *) calloc(ifc_cnt, sizeof(in_ifc_stats_t));
+      running_modules[module_idx].in_ifces_data = (in_ifc_stats_t *) calloc(in_cnt, sizeof(in_ifc_stats_t));
       if (running_modules[module_idx].in_ifces_data == NULL) {
          VERBOSE(MODULE_EVENT, "%s [SERVICE] Error: could not allocate memory for \"%s\" input ifces data (statistics about ifces).\n", get_formatted_time(), running_modules[module_idx].module_name);
          running_modules[module_idx].total_in_ifces_cnt = 0;
-         json_decref(json_struct);
          return -1;
       }
-      running_modules[module_idx].total_in_ifces_cnt = ifc_cnt;
+      running_modules[module_idx].total_in_ifces_cnt = in_cnt;
    }
 
-   // Check number of output interfaces the module is running with
-   cnt = json_object_get(json_struct, "out_cnt");
-   if (cnt == NULL) {
-      VERBOSE(MODULE_EVENT, "%s [ERROR] Could not get key \"out_cnt\" from root json object while parsing modules stats (module %s).\n", get_formatted_time(), running_modules[module_idx].module_name);
-      json_decref(json_struct);
-      return -1;
-   }
-   ifc_cnt = json_integer_value(cnt);
    // Realloc memory for output ifces data if needed
-   if (ifc_cnt != running_modules[module_idx].total_out_ifces_cnt) { // TODO do we need any limit check?
-      VERBOSE(MODULE_EVENT, "%s [SERVICE] Number of \"%s\" output interfaces has changed (%u -> %u).\n", get_formatted_time(), running_modules[module_idx].module_name, running_modules[module_idx].total_out_ifces_cnt, ifc_cnt);
+   if (out_cnt != running_modules[module_idx].total_out_ifces_cnt) {
+      VERBOSE(MODULE_EVENT, "%s [SERVICE] Number of \"%s\" output interfaces has changed (%u -> %u).\n", get_formatted_time(), running_modules[module_idx].module_name, running_modules[module_idx].total_out_ifces_cnt, out_cnt);
       if (running_modules[module_idx].out_ifces_data != NULL) {
          for (x = 0; x < running_modules[module_idx].total_out_ifces_cnt; x++) {
             NULLP_TEST_AND_FREE(running_modules[module_idx].out_ifces_data[x].ifc_id);
          }
          free(running_modules[module_idx].out_ifces_data);
       }
-      running_modules[module_idx].out_ifces_data = (out_ifc_stats_t *) calloc(ifc_cnt, sizeof(out_ifc_stats_t));
+      running_modules[module_idx].out_ifces_data = (out_ifc_stats_t *) calloc(out_cnt, sizeof(out_ifc_stats_t));
       if (running_modules[module_idx].out_ifces_data == NULL) {
          VERBOSE(MODULE_EVENT, "%s [SERVICE] Error: could not allocate memory for \"%s\" output ifces data (statistics about ifces).\n", get_formatted_time(), running_modules[module_idx].module_name);
          running_modules[module_idx].total_out_ifces_cnt = 0;
-         json_decref(json_struct);
          return -1;
       }
-      running_modules[module_idx].total_out_ifces_cnt = ifc_cnt;
+      running_modules[module_idx].total_out_ifces_cnt = out_cnt;
+   }
+   return 0;
+}
+
+/* Counters of interfaces decoded from JSON stats, every key is required */
+const stats_json_field_t in_ifc_json_fields[] = {
+   {"messages", offsetof(in_ifc_stats_t, recv_msg_cnt), STATS_JSON_UINT64},
+   {"buffers", offsetof(in_ifc_stats_t, recv_buffer_cnt), STATS_JSON_UINT64},
+   {"ifc_type", offsetof(in_ifc_stats_t, ifc_type), STATS_JSON_CHAR},
+   {"ifc_state", offsetof(in_ifc_stats_t, ifc_state), STATS_JSON_UINT8},
+   {"ifc_id", offsetof(in_ifc_stats_t, ifc_id), STATS_JSON_STRING},
+   {NULL, 0, 0}
+};
+
+const stats_json_field_t out_ifc_json_fields[] = {
+   {"sent-messages", offsetof(out_ifc_stats_t, sent_msg_cnt), STATS_JSON_UINT64},
+   {"dropped-messages", offsetof(out_ifc_stats_t, dropped_msg_cnt), STATS_JSON_UINT64},
+   {"buffers", offsetof(out_ifc_stats_t, sent_buffer_cnt), STATS_JSON_UINT64},
+   {"autoflushes", offsetof(out_ifc_stats_t, autoflush_cnt), STATS_JSON_UINT64},
+   {"num_clients", offsetof(out_ifc_stats_t, num_clients), STATS_JSON_INT32},
+   {"ifc_type", offsetof(out_ifc_stats_t, ifc_type), STATS_JSON_CHAR},
+   {"ifc_id", offsetof(out_ifc_stats_t, ifc_id), STATS_JSON_STRING},
+   {NULL, 0, 0}
+};
+
+char *stats_json_skip_ws(char *pos)
+{
+   while (*pos == ' ' || *pos == '\t' || *pos == '\n' || *pos == '\r') {
+      pos++;
    }
+   return pos;
+}
 
-   if (running_modules[module_idx].total_in_ifces_cnt > 0) {
-      // Get value of the key "in" from json root elem (it should be an array of json objects - every object contains counters of one input interface)
-      in_ifces_arr = json_object_get(json_struct, "in");
-      if (in_ifces_arr == NULL) {
-         VERBOSE(MODULE_EVENT, "%s [ERROR] Could not get key \"in\" from root json object while parsing modules stats (module %s).\n", get_formatted_time(), running_modules[module_idx].module_name);
-         json_decref(json_struct);
-         return -1;
-      }
+int stats_json_expect(char **pos, char c)
+{
+   *pos = stats_json_skip_ws(*pos);
+   if (**pos != c) {
+      return -1;
+   }
+   (*pos)++;
+   return 0;
+}
 
-      if (json_is_array(in_ifces_arr) == 0) {
-         VERBOSE(MODULE_EVENT, "%s [ERROR] Value of key \"in\" is not a json array (module %s).\n", get_formatted_time(), running_modules[module_idx].module_name);
-         json_decref(json_struct);
+int stats_json_get_string(char **pos, char **str, size_t *len, int *escaped)
+{
+   char *p = NULL;
+
+   if (stats_json_expect(pos, '"') == -1) {
+      return -1;
+   }
+   *escaped = FALSE;
+   for (p = *pos; *p != '"'; p++) {
+      if (*p == 0) {
          return -1;
+      } else if (*p == '\\') {
+         *escaped = TRUE;
+         p++;
+         if (*p == 0) {
+            return -1;
+         }
       }
+   }
+   *str = *pos;
+   *len = p - *pos;
+   *pos = p + 1;
+   return 0;
+}
 
-      actual_ifc_index = 0;
-      json_array_foreach(in_ifces_arr, arr_idx, in_ifc_cnts) {
-         if (actual_ifc_index >= running_modules[module_idx].total_in_ifces_cnt) {
-            break;
-         }
-         if (json_is_object(in_ifc_cnts) == 0) {
-            VERBOSE(MODULE_EVENT, "%s [ERROR] Counters of an input interface are not a json object in received json structure (module %s).\n", get_formatted_time(), running_modules[module_idx].module_name);
-            json_decref(json_struct);
+int stats_json_unescape(char *str, size_t *len)
+{
+   size_t x = 0, y = 0;
+   unsigned int code = 0;
+   char hex[5];
+
+   for (x = 0; x < *len; x++) {
+      if (str[x] != '\\') {
+         str[y++] = str[x];
+         continue;
+      }
+      x++;
+      switch (str[x]) {
+      case 'b': str[y++] = '\b'; break;
+      case 'f': str[y++] = '\f'; break;
+      case 'n': str[y++] = '\n'; break;
+      case 'r': str[y++] = '\r'; break;
+      case 't': str[y++] = '\t'; break;
+      case 'u':
+         if (x + 4 >= *len) {
             return -1;
          }
+         memcpy(hex, str + x + 1, 4);
+         hex[4] = 0;
+         code = strtoul(hex, NULL, 16);
+         x += 4;
+         // Code points of BMP are encoded in UTF-8 (surrogate pairs are not expected in ifc_id)
+         if (code < 0x80) {
+            str[y++] = (char) code;
+         } else if (code < 0x800) {
+            str[y++] = (char) (0xC0 | (code >> 6));
+            str[y++] = (char) (0x80 | (code & 0x3F));
+         } else {
+            str[y++] = (char) (0xE0 | (code >> 12));
+            str[y++] = (char) (0x80 | ((code >> 6) & 0x3F));
+            str[y++] = (char) (0x80 | (code & 0x3F));
+         }
+         break;
+      default: // '"', '\\' and '/'
+         str[y++] = str[x];
+         break;
+      }
+   }
+   *len = y;
+   return 0;
+}
+
+int stats_json_get_integer(char **pos, long long *value)
+{
+   char *end = NULL;
+
+   *pos = stats_json_skip_ws(*pos);
+   errno = 0;
+   *value = strtoll(*pos, &end, 10);
+   if (end == *pos || errno == ERANGE) {
+      return -1;
+   }
+   *pos = end;
+   return 0;
+}
+
+int stats_json_skip_value(char **pos, int depth)
+{
+   char *str = NULL;
+   size_t len = 0;
+   int escaped = FALSE, first = TRUE, ret = 0;
 
-         cnt = json_object_get(in_ifc_cnts, "messages");
-         if (cnt == NULL) {
-            VERBOSE(MODULE_EVENT, "%s [ERROR] Could not get key \"%s\" from an input interface json object (module %s).\n", get_formatted_time(), "messages", running_modules[module_idx].module_name);
-            json_decref(json_struct);
+   if (depth > STATS_JSON_MAX_DEPTH) {
+      return -1;
+   }
+   *pos = stats_json_skip_ws(*pos);
+   switch (**pos) {
+   case '"':
+      return stats_json_get_string(pos, &str, &len, &escaped);
+   case '{':
+      (*pos)++;
+      while ((ret = stats_json_next_member(pos, &str, &len, &first)) == 1) {
+         if (stats_json_skip_value(pos, depth + 1) == -1) {
             return -1;
          }
-         running_modules[module_idx].in_ifces_data[actual_ifc_index].recv_msg_cnt = json_integer_value(cnt);
-
-         cnt = json_object_get(in_ifc_cnts, "buffers");
-         if (cnt == NULL) {
-            VERBOSE(MODULE_EVENT, "%s [ERROR] Could not get key \"%s\" from an input interface json object (module %s).\n", get_formatted_time(), "buffers", running_modules[module_idx].module_name);
-            json_decref(json_struct);
+      }
+      return ret;
+   case '[':
+      (*pos)++;
+      while ((ret = stats_json_next_element(pos, &first)) == 1) {
+         if (stats_json_skip_value(pos, depth + 1) == -1) {
             return -1;
          }
-         running_modules[module_idx].in_ifces_data[actual_ifc_index].recv_buffer_cnt = json_integer_value(cnt);
+      }
+      return ret;
+   default:
+      // Number, true, false or null
+      if (strchr("-0123456789tfn", **pos) == NULL || **pos == 0) {
+         return -1;
+      }
+      while (**pos != 0 && strchr(",}] \t\n\r", **pos) == NULL) {
+         (*pos)++;
+      }
+      return 0;
+   }
+}
+
+int stats_json_next_member(char **pos, char **key, size_t *key_len, int *first)
+{
+   int escaped = FALSE;
+
+   *pos = stats_json_skip_ws(*pos);
+   if (**pos == '}') {
+      (*pos)++;
+      return 0;
+   }
+   if (*first == FALSE && stats_json_expect(pos, ',') == -1) {
+      return -1;
+   }
+   *first = FALSE;
+   if (stats_json_get_string(pos, key, key_len, &escaped) == -1 || stats_json_expect(pos, ':') == -1) {
+      return -1;
+   }
+   return 1;
+}
+
+int stats_json_next_element(char **pos, int *first)
+{
+   *pos = stats_json_skip_ws(*pos);
+   if (**pos == ']') {
+      (*pos)++;
+      return 0;
+   }
+   if (*first == FALSE && stats_json_expect(pos, ',') == -1) {
+      return -1;
+   }
+   *first = FALSE;
+   return 1;
+}
 
-         cnt = json_object_get(in_ifc_cnts, "ifc_type");
-         if (cnt == NULL) {
-            VERBOSE(MODULE_EVENT, "%s [ERROR] Could not get key \"ifc_type\" from an input interface json object (module %s).\n", get_formatted_time(), running_modules[module_idx].module_name);
-            json_decref(json_struct);
+int stats_json_key_is(const char *key, size_t key_len, const char *name)
+{
+   return (strlen(name) == key_len && memcmp(key, name, key_len) == 0) ? TRUE : FALSE;
+}
+
+int stats_json_decode_ifc(char **pos, const stats_json_field_t *fields, void *ifc)
+{
+   char *key = NULL, *str = NULL;
+   size_t key_len = 0, len = 0;
+   int first = TRUE, escaped = FALSE, ret = 0, x = 0;
+   uint32_t found = 0, required = 0;
+   long long value = 0;
+
+   if (stats_json_expect(pos, '{') == -1) {
+      return -1;
+   }
+   while ((ret = stats_json_next_member(pos, &key, &key_len, &first)) == 1) {
+      for (x = 0; fields[x].key != NULL; x++) {
+         if (stats_json_key_is(key, key_len, fields[x].key) == TRUE) {
+            break;
+         }
+      }
+      if (fields[x].key == NULL) {
+         if (stats_json_skip_value(pos, 0) == -1) {
             return -1;
          }
-         running_modules[module_idx].in_ifces_data[actual_ifc_index].ifc_type = (char)(json_integer_value(cnt));
+         continue;
+      }
 
-         cnt = json_object_get(in_ifc_cnts, "ifc_state");
-         if (cnt == NULL) {
-            VERBOSE(MODULE_EVENT, "%s [ERROR] Could not get key \"ifc_state\" from an input interface json object (module %s).\n", get_formatted_time(), running_modules[module_idx].module_name);
-            json_decref(json_struct);
+      // Write the value straight into the interface structure
+      if (fields[x].type == STATS_JSON_STRING) {
+         if (stats_json_get_string(pos, &str, &len, &escaped) == -1) {
             return -1;
          }
-         running_modules[module_idx].in_ifces_data[actual_ifc_index].ifc_state = (uint8_t)(json_integer_value(cnt));
-
-         cnt = json_object_get(in_ifc_cnts, "ifc_id");
-         if (cnt == NULL) {
-            VERBOSE(MODULE_EVENT, "%s [ERROR] Could not get key \"ifc_id\" from an input interface json object (module %s).\n", get_formatted_time(), running_modules[module_idx].module_name);
-            json_decref(json_struct);
+         if (escaped == TRUE && stats_json_unescape(str, &len) == -1) {
             return -1;
          }
-         str = json_string_value(cnt);
-         if (str == NULL) {
-            VERBOSE(MODULE_EVENT, "%s [ERROR] Could not get string value of key \"ifc_id\" from an input interface json object (module %s).\n", get_formatted_time(), running_modules[module_idx].module_name);
-            json_decref(json_struct);
+         if (service_update_ifc_id((char **) ((char *) ifc + fields[x].offset), str, len) == -1) {
             return -1;
          }
-         if (running_modules[module_idx].in_ifces_data[actual_ifc_index].ifc_id == NULL) {
-            running_modules[module_idx].in_ifces_data[actual_ifc_index].ifc_id = strdup(str);
-         } else if (strcmp(running_modules[module_idx].in_ifces_data[actual_ifc_index].ifc_id, str) != 0) {
-            NULLP_TEST_AND_FREE(running_modules[module_idx].in_ifces_data[actual_ifc_index].ifc_id);
-            running_modules[module_idx].in_ifces_data[actual_ifc_index].ifc_id = strdup(str);
+      } else {
+         if (stats_json_get_integer(pos, &value) == -1) {
+            return -1;
+         }
+         switch (fields[x].type) {
+         case STATS_JSON_UINT64:
+            *(uint64_t *) ((char *) ifc + fields[x].offset) = (uint64_t) value;
+            break;
+         case STATS_JSON_INT32:
+            *(int32_t *) ((char *) ifc + fields[x].offset) = (int32_t) value;
+            break;
+         case STATS_JSON_UINT8:
+            *(uint8_t *) ((char *) ifc + fields[x].offset) = (uint8_t) value;
+            break;
+         case STATS_JSON_CHAR:
+            *((char *) ifc + fields[x].offset) = (char) value;
+            break;
          }
-
-         actual_ifc_index++;
       }
+      found |= 1 << x;
+   }
+   if (ret == -1) {
+      return -1;
    }
 
+   for (x = 0; fields[x].key != NULL; x++) {
+      required |= 1 << x;
+   }
+   return (found == required) ? 0 : -1;
+}
 
-   if (running_modules[module_idx].total_out_ifces_cnt > 0) {
-      // Get value of the key "out" from json root elem (it should be an array of json objects - every object contains counters of one output interface)
-      out_ifces_arr = json_object_get(json_struct, "out");
-      if (out_ifces_arr == NULL) {
-         VERBOSE(MODULE_EVENT, "%s [ERROR] Could not get key \"out\" from root json object while parsing modules stats (module %s).\n", get_formatted_time(), running_modules[module_idx].module_name);
-         json_decref(json_struct);
-         return -1;
+int service_decode_module_stats(char **data, int module_idx)
+{
+   char *pos = *data, *key = NULL;
+   size_t key_len = 0;
+   int first = TRUE, first_ifc = TRUE, ret = 0, in_found = FALSE, out_found = FALSE;
+   uint32_t actual_ifc_index = 0;
+   long long in_cnt = -1, out_cnt = -1;
+
+   /* The stats are parsed in place in the service buffer of the module and the counters are written
+    * straight into its interfaces structures. Numbers of interfaces are needed first, so the first pass
+    * reads only "in_cnt" and "out_cnt" and the second one decodes the interfaces. */
+   if (stats_json_expect(&pos, '{') == -1) {
+      goto parse_error;
+   }
+   while ((ret = stats_json_next_member(&pos, &key, &key_len, &first)) == 1) {
+      if (stats_json_key_is(key, key_len, "in_cnt") == TRUE) {
+         ret = stats_json_get_integer(&pos, &in_cnt);
+      } else if (stats_json_key_is(key, key_len, "out_cnt") == TRUE) {
+         ret = stats_json_get_integer(&pos, &out_cnt);
+      } else {
+         ret = stats_json_skip_value(&pos, 0);
+      }
+      if (ret == -1) {
+         goto parse_error;
+      }
+   }
+   if (ret == -1) {
+      goto parse_error;
+   }
+   if (in_cnt < 0 || out_cnt < 0 || in_cnt > UINT32_MAX || out_cnt > UINT32_MAX) {
+      VERBOSE(MODULE_EVENT, "%s [ERROR] Could not get keys \"in_cnt\" and \"out_cnt\" from root json object while parsing modules stats (module %s).\n", get_formatted_time(), running_modules[module_idx].module_name);
+      return -1;
+   }
+   if (service_set_ifces_cnt(module_idx, (uint32_t) in_cnt, (uint32_t) out_cnt) == -1) {
+      return -1;
+   }
+
+   pos = *data;
+   first = TRUE;
+   stats_json_expect(&pos, '{');
+   while ((ret = stats_json_next_member(&pos, &key, &key_len, &first)) == 1) {
+      if (stats_json_key_is(key, key_len, "in") == TRUE) {
+         in_found = TRUE;
+         if (stats_json_expect(&pos, '[') == -1) {
+            goto parse_error;
+         }
+         first_ifc = TRUE;
+         actual_ifc_index = 0;
+         while ((ret = stats_json_next_element(&pos, &first_ifc)) == 1) {
+            if (actual_ifc_index < running_modules[module_idx].total_in_ifces_cnt) {
+               ret = stats_json_decode_ifc(&pos, in_ifc_json_fields, &running_modules[module_idx].in_ifces_data[actual_ifc_index]);
+            } else {
+               ret = stats_json_skip_value(&pos, 0);
+            }
+            if (ret == -1) {
+               goto parse_error;
+            }
+            actual_ifc_index++;
+         }
+      } else if (stats_json_key_is(key, key_len, "out") == TRUE) {
+         out_found = TRUE;
+         if (stats_json_expect(&pos, '[') == -1) {
+            goto parse_error;
+         }
+         first_ifc = TRUE;
+         actual_ifc_index = 0;
+         while ((ret = stats_json_next_element(&pos, &first_ifc)) == 1) {
+            if (actual_ifc_index < running_modules[module_idx].total_out_ifces_cnt) {
+               ret = stats_json_decode_ifc(&pos, out_ifc_json_fields, &running_modules[module_idx].out_ifces_data[actual_ifc_index]);
+            } else {
+               ret = stats_json_skip_value(&pos, 0);
+            }
+            if (ret == -1) {
+               goto parse_error;
+            }
+            actual_ifc_index++;
+         }
+      } else {
+         ret = stats_json_skip_value(&pos, 0);
       }
+      if (ret == -1) {
+         goto parse_error;
+      }
+   }
+   if (ret == -1) {
+      goto parse_error;
+   }
+
+   if ((running_modules[module_idx].total_in_ifces_cnt > 0 && in_found == FALSE) || (running_modules[module_idx].total_out_ifces_cnt > 0 && out_found == FALSE)) {
+      VERBOSE(MODULE_EVENT, "%s [ERROR] Could not get key \"in\" or \"out\" from root json object while parsing modules stats (module %s).\n", get_formatted_time(), running_modules[module_idx].module_name);
+      return -1;
+   }
+   return 0;
+
+parse_error:
+   VERBOSE(MODULE_EVENT, "%s [ERROR] Could not parse stats of module %s at offset %ld.\n", get_formatted_time(), running_modules[module_idx].module_name, (long) (pos - *data));
+   return -1;
+}
 
-      if (json_is_array(out_ifces_arr) == 0) {
-         VERBOSE(MODULE_EVENT, "%s [ERROR] Value of key \"out\" is not a json array (module %s).\n", get_formatted_time(), running_modules[module_idx].module_name);
-         json_decref(json_struct);
+int service_update_ifc_id(char **ifc_id, const char *str, size_t len)
+{
+   // The string is reallocated only if it has changed
+   if (*ifc_id == NULL || strlen(*ifc_id) != len || memcmp(*ifc_id, str, len) != 0) {
+      NULLP_TEST_AND_FREE(*ifc_id);
+      *ifc_id = strndup(str, len);
+      if (*ifc_id == NULL) {
          return -1;
       }
+   }
+   return 0;
+}
 
-      actual_ifc_index = 0;
-      json_array_foreach(out_ifces_arr, arr_idx, out_ifc_cnts) {
-         if (actual_ifc_index >= running_modules[module_idx].total_out_ifces_cnt) {
-            break;
-         }
-         if (json_is_object(out_ifc_cnts) == 0) {
-            VERBOSE(MODULE_EVENT, "%s [ERROR] Counters of an output interface are not a json object in received json structure (module %s).\n", get_formatted_time(), running_modules[module_idx].module_name);
-            json_decref(json_struct);
-            return -1;
-         }
+int service_decode_ifc_id(const uint8_t **data, const uint8_t *data_end, char **ifc_id)
+{
+   uint16_t len = 0;
 
-         cnt = json_object_get(out_ifc_cnts, "sent-messages");
-         if (cnt == NULL) {
-            VERBOSE(MODULE_EVENT, "%s [ERROR] Could not get key \"%s\" from an output interface json object (module %s).\n", get_formatted_time(), "sent-messages", running_modules[module_idx].module_name);
-            json_decref(json_struct);
-            return -1;
-         }
-         running_modules[module_idx].out_ifces_data[actual_ifc_index].sent_msg_cnt = json_integer_value(cnt);
+   if (data_end - *data < sizeof(uint16_t)) {
+      return -1;
+   }
+   memcpy(&len, *data, sizeof(uint16_t));
+   len = le16toh(len);
+   *data += sizeof(uint16_t);
+   if (data_end - *data < len) {
+      return -1;
+   }
 
-         cnt = json_object_get(out_ifc_cnts, "dropped-messages");
-         if (cnt == NULL) {
-            VERBOSE(MODULE_EVENT, "%s [ERROR] Could not get key \"%s\" from an output interface json object (module %s).\n", get_formatted_time(), "dropped-messages", running_modules[module_idx].module_name);
-            json_decref(json_struct);
-            return -1;
-         }
-         running_modules[module_idx].out_ifces_data[actual_ifc_index].dropped_msg_cnt = json_integer_value(cnt);
+   if (service_update_ifc_id(ifc_id, (const char *) *data, len) == -1) {
+      return -1;
+   }
+   *data += len;
+   return 0;
+}
+
+int service_decode_module_stats_bin(const char *data, uint32_t data_size, int module_idx)
+{
+   const uint8_t *ptr = (const uint8_t *) data, *data_end = ((const uint8_t *) data) + data_size;
+   uint32_t in_cnt = 0, out_cnt = 0, x = 0, u32 = 0;
+   uint64_t u64[4];
+   uint8_t flags = 0;
+   in_ifc_stats_t *in_ifc = NULL;
+   out_ifc_stats_t *out_ifc = NULL;
+
+   if (data_size < SERVICE_BIN_STATS_HDR_SIZE || ptr[0] != SERVICE_BIN_STATS_VERSION) {
+      VERBOSE(MODULE_EVENT, "%s [ERROR] Wrong header of binary stats (module %s).\n", get_formatted_time(), running_modules[module_idx].module_name);
+      return -1;
+   }
+   memcpy(&in_cnt, ptr + 4, sizeof(uint32_t));
+   memcpy(&out_cnt, ptr + 8, sizeof(uint32_t));
+   in_cnt = le32toh(in_cnt);
+   out_cnt = le32toh(out_cnt);
+   ptr += SERVICE_BIN_STATS_HDR_SIZE;
 
-         cnt = json_object_get(out_ifc_cnts, "buffers");
-         if (cnt == NULL) {
-            VERBOSE(MODULE_EVENT, "%s [ERROR] Could not get key \"%s\" from an output interface json object (module %s).\n", get_formatted_time(), "buffers", running_modules[module_idx].module_name);
-            json_decref(json_struct);
-            return -1;
-         }
-         running_modules[module_idx].out_ifces_data[actual_ifc_index].sent_buffer_cnt = json_integer_value(cnt);
+   // Every interface needs at least its fixed-width counters
+   if ((uint64_t) in_cnt * SERVICE_BIN_STATS_IN_IFC_SIZE + (uint64_t) out_cnt * SERVICE_BIN_STATS_OUT_IFC_SIZE > data_end - ptr) {
+      VERBOSE(MODULE_EVENT, "%s [ERROR] Binary stats are shorter than %u input and %u output interfaces (module %s).\n", get_formatted_time(), in_cnt, out_cnt, running_modules[module_idx].module_name);
+      return -1;
+   }
+   if (service_set_ifces_cnt(module_idx, in_cnt, out_cnt) == -1) {
+      return -1;
+   }
 
-         cnt = json_object_get(out_ifc_cnts, "autoflushes");
-         if (cnt == NULL) {
-            VERBOSE(MODULE_EVENT, "%s [ERROR] Could not get key \"%s\" from an output interface json object (module %s).\n", get_formatted_time(), "autoflushes", running_modules[module_idx].module_name);
-            json_decref(json_struct);
-            return -1;
-         }
-         running_modules[module_idx].out_ifces_data[actual_ifc_index].autoflush_cnt = json_integer_value(cnt);
+   for (x = 0; x < in_cnt; x++) {
+      if (data_end - ptr < SERVICE_BIN_STATS_IN_IFC_SIZE) {
+         goto truncated;
+      }
+      in_ifc = &running_modules[module_idx].in_ifces_data[x];
+      flags = ptr[0];
+      in_ifc->ifc_state = ptr[1];
+      in_ifc->ifc_type = (char) ptr[2];
+      memcpy(u64, ptr + 4, 2 * sizeof(uint64_t));
+      in_ifc->recv_msg_cnt = le64toh(u64[0]);
+      in_ifc->recv_buffer_cnt = le64toh(u64[1]);
+      ptr += SERVICE_BIN_STATS_IN_IFC_SIZE;
 
-         cnt = json_object_get(out_ifc_cnts, "num_clients");
-         if (cnt == NULL) {
-            VERBOSE(MODULE_EVENT, "%s [ERROR] Could not get key \"num_clients\" from an output interface json object (module %s).\n", get_formatted_time(), running_modules[module_idx].module_name);
-            json_decref(json_struct);
-            return -1;
+      if ((flags & SERVICE_BIN_STATS_IFC_ID_FLAG) != 0) {
+         if (service_decode_ifc_id(&ptr, data_end, &in_ifc->ifc_id) == -1) {
+            goto truncated;
          }
-         running_modules[module_idx].out_ifces_data[actual_ifc_index].num_clients = (int32_t)(json_integer_value(cnt));
+      } else if (in_ifc->ifc_id == NULL) {
+         VERBOSE(MODULE_EVENT, "%s [ERROR] Binary stats do not contain ifc_id of a new input interface (module %s).\n", get_formatted_time(), running_modules[module_idx].module_name);
+         return -1;
+      }
+   }
 
-         cnt = json_object_get(out_ifc_cnts, "ifc_type");
-         if (cnt == NULL) {
-            VERBOSE(MODULE_EVENT, "%s [ERROR] Could not get key \"ifc_type\" from an output interface json object (module %s).\n", get_formatted_time(), running_modules[module_idx].module_name);
-            json_decref(json_struct);
-            return -1;
-         }
-         running_modules[module_idx].out_ifces_data[actual_ifc_index].ifc_type = (char)(json_integer_value(cnt));
+   for (x = 0; x < out_cnt; x++) {
+      if (data_end - ptr < SERVICE_BIN_STATS_OUT_IFC_SIZE) {
+         goto truncated;
+      }
+      out_ifc = &running_modules[module_idx].out_ifces_data[x];
+      flags = ptr[0];
+      out_ifc->ifc_type = (char) ptr[1];
+      memcpy(&u32, ptr + 4, sizeof(uint32_t));
+      out_ifc->num_clients = (int32_t) le32toh(u32);
+      memcpy(u64, ptr + 8, 4 * sizeof(uint64_t));
+      out_ifc->sent_msg_cnt = le64toh(u64[0]);
+      out_ifc->dropped_msg_cnt = le64toh(u64[1]);
+      out_ifc->sent_buffer_cnt = le64toh(u64[2]);
+      out_ifc->autoflush_cnt = le64toh(u64[3]);
+      ptr += SERVICE_BIN_STATS_OUT_IFC_SIZE;
 
-         cnt = json_object_get(out_ifc_cnts, "ifc_id");
-         if (cnt == NULL) {
-            VERBOSE(MODULE_EVENT, "%s [ERROR] Could not get key \"ifc_id\" from an output interface json object (module %s).\n", get_formatted_time(), running_modules[module_idx].module_name);
-            json_decref(json_struct);
-            return -1;
-         }
-         str = json_string_value(cnt);
-         if (str == NULL) {
-            VERBOSE(MODULE_EVENT, "%s [ERROR] Could not get string value of key \"ifc_id\" from an output interface json object (module %s).\n", get_formatted_time(), running_modules[module_idx].module_name);
-            json_decref(json_struct);
-            return -1;
+      if ((flags & SERVICE_BIN_STATS_IFC_ID_FLAG) != 0) {
+         if (service_decode_ifc_id(&ptr, data_end, &out_ifc->ifc_id) == -1) {
+            goto truncated;
          }
-         if (running_modules[module_idx].out_ifces_data[actual_ifc_index].ifc_id == NULL) {
-            running_modules[module_idx].out_ifces_data[actual_ifc_index].ifc_id = strdup(str);
-         } else if (strcmp(running_modules[module_idx].out_ifces_data[actual_ifc_index].ifc_id, str) != 0) {
-            NULLP_TEST_AND_FREE(running_modules[module_idx].out_ifces_data[actual_ifc_index].ifc_id);
-            running_modules[module_idx].out_ifces_data[actual_ifc_index].ifc_id = strdup(str);
-         }
-
-         actual_ifc_index++;
+      } else if (out_ifc->ifc_id == NULL) {
+         VERBOSE(MODULE_EVENT, "%s [ERROR] Binary stats do not contain ifc_id of a new output interface (module %s).\n", get_formatted_time(), running_modules[module_idx].module_name);
+         return -1;
       }
    }
-
-   json_decref(json_struct);
    return 0;
+
+truncated:
+   VERBOSE(MODULE_EVENT, "%s [ERROR] Binary stats are truncated (module %s).\n", get_formatted_time(), running_modules[module_idx].module_name);
+   return -1;
 }
 
 
@@ -2624,6 +6572,26 @@ int interactive_get_option()
    return get_number_from_input_choosing_option();
 }
 
+int interactive_read_user_selection(int **array)
+{
+   unsigned int config_generation = modules_config_generation;
+   int selected_cnt = 0;
+
+   // Do not block service thread and other clients while waiting for the user
+   pthread_mutex_unlock(&running_modules_lock);
+   VERBOSE(N_STDOUT, FORMAT_INTERACTIVE "[INTERACTIVE] Type in number or interval separated by comma (e.g. \"2,4-6,13\"): " FORMAT_RESET);
+   selected_cnt = parse_numbers_user_selection(array);
+   pthread_mutex_lock(&running_modules_lock);
+
+   // Printed numbers are not valid if the modules were reloaded or removed in the meantime
+   if (selected_cnt != RET_ERROR && config_generation != modules_config_generation) {
+      VERBOSE(N_STDOUT, FORMAT_WARNING "[WARNING] Loaded configuration was changed in the meantime, try it again please.\n" FORMAT_RESET);
+      NULLP_TEST_AND_FREE(*array)
+      return RET_ERROR;
+   }
+   return selected_cnt;
+}
+
 void interactive_start_configuration()
 {
    pthread_mutex_lock(&running_modules_lock);
@@ -2636,6 +6604,7 @@ void interactive_start_configuration()
       }
    }
    pthread_mutex_unlock(&running_modules_lock);
+   service_wakeup();
 }
 
 
@@ -2650,6 +6619,7 @@ void interactive_stop_configuration()
       }
    }
    pthread_mutex_unlock(&running_modules_lock);
+   service_wakeup();
 }
 
 int get_num_disabled_modules()
@@ -2757,8 +6727,7 @@ user_input:
       return;
    }
 
-   VERBOSE(N_STDOUT, FORMAT_INTERACTIVE "[INTERACTIVE] Type in number or interval separated by comma (e.g. \"2,4-6,13\"): " FORMAT_RESET);
-   modules_to_enable_cnt = parse_numbers_user_selection(&modules_to_enable);
+   modules_to_enable_cnt = interactive_read_user_selection(&modules_to_enable);
 
    if (modules_to_enable_cnt != RET_ERROR) {
       for (x = 0; x < modules_to_enable_cnt; x++) {
@@ -2794,6 +6763,7 @@ user_input:
    }
 
    pthread_mutex_unlock(&running_modules_lock);
+   service_wakeup();
 }
 
 
@@ -2856,8 +6826,7 @@ void interactive_restart_module()
       ptr = ptr->next;
    }
 
-   VERBOSE(N_STDOUT, FORMAT_INTERACTIVE "[INTERACTIVE] Type in number or interval separated by comma (e.g. \"2,4-6,13\"): " FORMAT_RESET);
-   modules_to_disable_cnt = parse_numbers_user_selection(&modules_to_disable);
+   modules_to_disable_cnt = interactive_read_user_selection(&modules_to_disable);
 
    if (modules_to_disable_cnt != RET_ERROR) {
       for (x = 0; x < modules_to_disable_cnt; x++) {
@@ -2883,6 +6852,7 @@ void interactive_restart_module()
    }
 
    pthread_mutex_unlock(&running_modules_lock);
+   service_wakeup();
 }
 
 
@@ -2964,8 +6934,7 @@ user_input:
       return;
    }
 
-   VERBOSE(N_STDOUT, FORMAT_INTERACTIVE "[INTERACTIVE] Type in number or interval separated by comma (e.g. \"2,4-6,13\"): " FORMAT_RESET);
-   modules_to_disable_cnt = parse_numbers_user_selection(&modules_to_disable);
+   modules_to_disable_cnt = interactive_read_user_selection(&modules_to_disable);
 
    if (modules_to_disable_cnt != RET_ERROR) {
       for (x = 0; x < modules_to_disable_cnt; x++) {
@@ -3004,6 +6973,7 @@ user_input:
    }
 
    pthread_mutex_unlock(&running_modules_lock);
+   service_wakeup();
 }
 
 void interactive_browse_log_files()
@@ -3380,6 +7350,17 @@ void free_module_on_index(const int module_idx)
    NULLP_TEST_AND_FREE(running_modules[module_idx].module_path)
    NULLP_TEST_AND_FREE(running_modules[module_idx].module_name)
    NULLP_TEST_AND_FREE(running_modules[module_idx].module_params)
+   if (running_modules[module_idx].module_cpu_affinity != NULL) {
+      xmlFree(running_modules[module_idx].module_cpu_affinity);
+      running_modules[module_idx].module_cpu_affinity = NULL;
+   }
+   NULLP_TEST_AND_FREE(running_modules[module_idx].service_buffer)
+   hot_restart_close_sockets(module_idx);
+   close_module_proc_fds(module_idx);
+   NULLP_TEST_AND_FREE(running_modules[module_idx].threads)
+   running_modules[module_idx].threads_arr_size = 0;
+   cgroup_remove_module(module_idx);
+   running_modules[module_idx].service_buffer_size = 0;
    if (running_modules[module_idx].out_ifces_data != NULL) {
       for (x = 0; x < running_modules[module_idx].total_out_ifces_cnt; x++) {
          NULLP_TEST_AND_FREE(running_modules[module_idx].out_ifces_data[x].ifc_id);
@@ -3429,16 +7410,29 @@ void free_output_file_strings_and_streams()
 
 void free_module_and_shift_array(const int module_idx)
 {
-   int y = 0;
+   modules_config_generation++;
 
+   // Handles of the following modules do not change, although their indexes are shifted
+   registry_release_handle(module_idx);
    free_module_on_index(module_idx);
    running_modules[module_idx].config_ifces_cnt = 0;
    running_modules[module_idx].config_ifces_arr_size = 0;
-   for (y=module_idx; y<(loaded_modules_cnt-1); y++) {
-      memcpy(&running_modules[y], &running_modules[y+1], sizeof(running_module_t));
-   }
+   memmove(&running_modules[module_idx], &running_modules[module_idx + 1], (loaded_modules_cnt - module_idx - 1) * sizeof(running_module_t));
    loaded_modules_cnt--;
    memset(&running_modules[loaded_modules_cnt], 0, sizeof(running_module_t));
+   // Indexes of the following modules were shifted
+   registry_rebuild_modules();
+   running_modules[loaded_modules_cnt].module_pidfd = -1;
+   running_modules[loaded_modules_cnt].proc_stat_fd = -1;
+   running_modules[loaded_modules_cnt].proc_statm_fd = -1;
+   running_modules[loaded_modules_cnt].proc_io_fd = -1;
+   running_modules[loaded_modules_cnt].cgroup_cpu_stat_fd = -1;
+   running_modules[loaded_modules_cnt].cgroup_memory_stat_fd = -1;
+   running_modules[loaded_modules_cnt].cgroup_io_stat_fd = -1;
+   running_modules[loaded_modules_cnt].module_numa_node = -1;
+   running_modules[loaded_modules_cnt].module_stop_timeout = -1;
+   running_modules[loaded_modules_cnt].module_retiring_pidfd = -1;
+   running_modules[loaded_modules_cnt].numa_node = -1;
 }
 
 void supervisor_termination(const uint8_t stop_all_modules, const uint8_t generate_backup)
@@ -3468,8 +7462,18 @@ void supervisor_termination(const uint8_t stop_all_modules, const uint8_t genera
 
          VERBOSE(N_STDOUT,"%s [SERVICE] Aborting service thread!\n", get_formatted_time());
          service_thread_continue = FALSE;
+         service_wakeup();
 
          x = pthread_join(service_thread_id, NULL);
+         service_free_event_loop();
+         modules_snapshot_free();
+         if (proc_stat_fd != -1) {
+            close(proc_stat_fd);
+            proc_stat_fd = -1;
+         }
+         NULLP_TEST_AND_FREE(cgroup_modules_path)
+         NULLP_TEST_AND_FREE(launcher_stack)
+         NULLP_TEST_AND_FREE(dataflow_edges)
 
          if (x == 0) {
             VERBOSE(N_STDOUT, "%s [SERVICE] pthread_join success: Service thread finished!\n", get_formatted_time())
@@ -3501,6 +7505,9 @@ void supervisor_termination(const uint8_t stop_all_modules, const uint8_t genera
       }
 
       NULLP_TEST_AND_FREE(running_modules)
+      name_index_free(&module_name_index);
+      NULLP_TEST_AND_FREE(module_pid_index.items)
+      module_pid_index.size = 0;
 
       modules_profile_t * ptr = first_profile_ptr;
       modules_profile_t * p = NULL;
@@ -3515,37 +7522,32 @@ void supervisor_termination(const uint8_t stop_all_modules, const uint8_t genera
    // If daemon_mode_initialization call was successful, cleanup after daemon
    if (daemon_mode_initialized == TRUE) {
       if (server_internals != NULL) {
-         if (server_internals->clients != NULL) {
-            // Wait for daemon clients threads
-            VERBOSE(SUP_LOG, "%s [INFO] Waiting for client's threads to terminate.\n", get_formatted_time());
-            for (x = 0; x < MAX_NUMBER_SUP_CLIENTS; x++) {
-               // After 2 unsuccessful attempts terminate
-               if (attemps >= 2) {
-                  VERBOSE(SUP_LOG, "%s [INFO] Enough waiting, gonna terminate anyway.\n", get_formatted_time());
-                  break;
-               }
-               // If any client is still connected, wait 300 ms and check all clients again
-               if (server_internals->clients[x]->client_connected == TRUE) {
-                  attemps++;
-                  x = -1;
-                  usleep(300000);
-                  VERBOSE(SUP_LOG, "...\n");
-               }
-            }
-            if (attemps < 2) {
-               VERBOSE(SUP_LOG, "%s [INFO] All client's threads terminated.\n", get_formatted_time());
-            }
-            for (x = 0; x < MAX_NUMBER_SUP_CLIENTS; x++) {
-               NULLP_TEST_AND_FREE(server_internals->clients[x])
+         // Wait for threads of clients in configuration mode (other clients were disconnected by the server thread)
+         VERBOSE(SUP_LOG, "%s [INFO] Waiting for client's threads to terminate.\n", get_formatted_time());
+         while (server_internals->clients_cnt > 0) {
+            // After 2 unsuccessful attempts terminate
+            if (attemps >= 2) {
+               VERBOSE(SUP_LOG, "%s [INFO] Enough waiting, gonna terminate anyway.\n", get_formatted_time());
+               break;
             }
-            free(server_internals->clients);
-            server_internals->clients = NULL;
+            // If any client is still connected, wait 300 ms and check again
+            attemps++;
+            usleep(300000);
+            VERBOSE(SUP_LOG, "...\n");
+         }
+         if (attemps < 2) {
+            VERBOSE(SUP_LOG, "%s [INFO] All client's threads terminated.\n", get_formatted_time());
          }
 
          if (server_internals->server_sd > 0) {
             close(server_internals->server_sd);
             server_internals->server_sd = 0;
          }
+         if (server_internals->subscribers_event_fd != -1) {
+            close(server_internals->subscribers_event_fd);
+            server_internals->subscribers_event_fd = -1;
+         }
+         metrics_close_socket();
          free(server_internals);
          server_internals = NULL;
          unlink(socket_path);
@@ -3845,6 +7847,12 @@ int start_service_thread()
 {
    service_stop_all_modules = FALSE;
    service_thread_continue = TRUE;
+   cgroup_init();
+   // Seed of restart jitter
+   srandom(time(NULL) ^ getpid());
+   if (service_init_event_loop() == -1) {
+      return -1;
+   }
    pthread_attr_t attr;
    pthread_attr_init(&attr);
    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
@@ -3862,6 +7870,7 @@ int parse_prog_args(int *argc, char **argv)
       {"help", no_argument,           0,  'h' },
       {"daemon-socket",  required_argument,  0, 's'},
       {"logs-path",  required_argument,  0, 'L'},
+      {"metrics",  required_argument,  0, 'M'},
       {0, 0, 0, 0}
    };
    /******/
@@ -3869,7 +7878,7 @@ int parse_prog_args(int *argc, char **argv)
    char c = 0;
 
    while (1) {
-      c = TRAP_GETOPT(*argc, argv, "dC:T:hs:L:", long_options);
+      c = TRAP_GETOPT(*argc, argv, "dC:T:hs:L:M:", long_options);
       if (c == -1) {
          break;
       }
@@ -3890,7 +7899,8 @@ int parse_prog_args(int *argc, char **argv)
                   "      [-d, --daemon]   Runs supervisor as a system daemon.\n"
                   "      [-h, --help]   Prints this help.\n"
                   "      [-s, --daemon-socket=path]   Path of the unix socket which is used for supervisor daemon and client communication.\n"
-                  "      [-C, --configs-path=path]   Path of the directory where the generated configuration files will be saved.\n");
+                  "      [-C, --configs-path=path]   Path of the directory where the generated configuration files will be saved.\n"
+                  "      [-M, --metrics=address]   Path of a unix socket or [host:]port of a TCP socket where the daemon serves metrics of modules for Prometheus.\n");
          return -1;
       case 's':
          socket_path = optarg;
@@ -3910,19 +7920,22 @@ int parse_prog_args(int *argc, char **argv)
          free(logs_path);
          logs_path = strdup(optarg);
          break;
+      case 'M':
+         metrics_address = optarg;
+         break;
       }
    }
 
    if (templ_config_file == NULL) {
-      fprintf(stderr, "[ERROR] Missing required configuration template.\n\nUsage: supervisor -T|--config-template=path  -L|--logs-path=path  [-d|--daemon]  [-h|--help]  [-s|--daemon-socket=path]  [-C|--configs-path=path]\n");
+      fprintf(stderr, "[ERROR] Missing required configuration template.\n\nUsage: supervisor -T|--config-template=path  -L|--logs-path=path  [-d|--daemon]  [-h|--help]  [-s|--daemon-socket=path]  [-C|--configs-path=path]  [-M|--metrics=address]\n");
       return -1;
    } else if (strstr(templ_config_file, ".xml") == NULL) {
-      fprintf(stderr, "[ERROR] Configuration template file does not have expected .xml extension.\n\nUsage: supervisor -T|--config-template=path  -L|--logs-path=path  [-d|--daemon]  [-h|--help]  [-s|--daemon-socket=path]  [-C|--configs-path=path]\n");
+      fprintf(stderr, "[ERROR] Configuration template file does not have expected .xml extension.\n\nUsage: supervisor -T|--config-template=path  -L|--logs-path=path  [-d|--daemon]  [-h|--help]  [-s|--daemon-socket=path]  [-C|--configs-path=path]  [-M|--metrics=address]\n");
       return -1;
    }
 
    if (logs_path == NULL) {
-      fprintf(stderr, "[ERROR] Missing required logs directory path.\n\nUsage: supervisor -T|--config-template=path  -L|--logs-path=path  [-d|--daemon]  [-h|--help]  [-s|--daemon-socket=path]  [-C|--configs-path=path]\n");
+      fprintf(stderr, "[ERROR] Missing required logs directory path.\n\nUsage: supervisor -T|--config-template=path  -L|--logs-path=path  [-d|--daemon]  [-h|--help]  [-s|--daemon-socket=path]  [-C|--configs-path=path]  [-M|--metrics=address]\n");
       return -1;
    }
 
@@ -3948,9 +7961,9 @@ int reload_check_supervisor_element(reload_config_vars_t **config_vars)
 {
    xmlChar *key = NULL;
    int number = 0;
-   int basic_elements[2];
-   memset(basic_elements, 0, 2 * sizeof(int));
-   uint8_t restarts_elem_idx = 0;
+   int basic_elements[4];
+   memset(basic_elements, 0, 4 * sizeof(int));
+   uint8_t restarts_elem_idx = 0, stats_interval_elem_idx = 1, backoff_max_elem_idx = 2, cooldown_elem_idx = 3;
 
    while ((*config_vars)->module_elem != NULL) {
       if ((*config_vars)->module_elem->type == XML_ELEMENT_NODE && (xmlStrcmp((*config_vars)->module_elem->name, BAD_CAST "module-restarts") == 0)) {
@@ -3972,6 +7985,51 @@ int reload_check_supervisor_element(reload_config_vars_t **config_vars)
             VERBOSE(N_STDOUT, "[ERROR] Empty value in \"module-restarts\" element!\n");
             goto error_label;
          }
+      } else if ((*config_vars)->module_elem->type == XML_ELEMENT_NODE && (xmlStrcmp((*config_vars)->module_elem->name, BAD_CAST "stats-interval") == 0)) {
+         basic_elements[stats_interval_elem_idx]++;
+         /* Check the number of found elements stats-interval (at most 1 is allowed) */
+         if (basic_elements[stats_interval_elem_idx] > 1) {
+            VERBOSE(N_STDOUT, "[ERROR] Too much \"stats-interval\" elements in \"supervisor\" element!\n");
+            goto error_label;
+         }
+         key = xmlNodeListGetString((*config_vars)->doc_tree_ptr, (*config_vars)->module_elem->xmlChildrenNode, 1);
+         if (key != NULL) {
+            /* The value in stats-interval element must be a number of milliseconds or "adaptive" */
+            if (parse_stats_interval((const char *) key, &number) == -1) {
+               VERBOSE(N_STDOUT, "[ERROR] Value in \"stats-interval\" element must be \"adaptive\" or number in range <%d,%d>!\n", MIN_STATS_INTERVAL_MS, MAX_STATS_INTERVAL_MS);
+               goto error_label;
+            }
+         } else {
+            /* Empty stats-interval element is not allowed */
+            VERBOSE(N_STDOUT, "[ERROR] Empty value in \"stats-interval\" element!\n");
+            goto error_label;
+         }
+      } else if ((*config_vars)->module_elem->type == XML_ELEMENT_NODE && (xmlStrcmp((*config_vars)->module_elem->name, BAD_CAST "restart-backoff-max") == 0)) {
+         basic_elements[backoff_max_elem_idx]++;
+         /* Check the number of found elements restart-backoff-max (at most 1 is allowed) */
+         if (basic_elements[backoff_max_elem_idx] > 1) {
+            VERBOSE(N_STDOUT, "[ERROR] Too much \"restart-backoff-max\" elements in \"supervisor\" element!\n");
+            goto error_label;
+         }
+         key = xmlNodeListGetString((*config_vars)->doc_tree_ptr, (*config_vars)->module_elem->xmlChildrenNode, 1);
+         if (key == NULL || (sscanf((const char *) key,"%d",&number) != 1) || (number < RESTART_BACKOFF_MIN_MS) || (number > MAX_RESTART_BACKOFF_MAX_MS)) {
+            /* The value in restart-backoff-max element must be a number of milliseconds */
+            VERBOSE(N_STDOUT, "[ERROR] Value in \"restart-backoff-max\" element must be number in range <%d,%d>!\n", RESTART_BACKOFF_MIN_MS, MAX_RESTART_BACKOFF_MAX_MS);
+            goto error_label;
+         }
+      } else if ((*config_vars)->module_elem->type == XML_ELEMENT_NODE && (xmlStrcmp((*config_vars)->module_elem->name, BAD_CAST "restart-cooldown") == 0)) {
+         basic_elements[cooldown_elem_idx]++;
+         /* Check the number of found elements restart-cooldown (at most 1 is allowed) */
+         if (basic_elements[cooldown_elem_idx] > 1) {
+            VERBOSE(N_STDOUT, "[ERROR] Too much \"restart-cooldown\" elements in \"supervisor\" element!\n");
+            goto error_label;
+         }
+         key = xmlNodeListGetString((*config_vars)->doc_tree_ptr, (*config_vars)->module_elem->xmlChildrenNode, 1);
+         if (key == NULL || (sscanf((const char *) key,"%d",&number) != 1) || (number < 0) || (number > MAX_RESTART_COOLDOWN_SEC)) {
+            /* The value in restart-cooldown element must be a number of seconds (including 0) */
+            VERBOSE(N_STDOUT, "[ERROR] Value in \"restart-cooldown\" element must be number in range <0,%d>!\n", MAX_RESTART_COOLDOWN_SEC);
+            goto error_label;
+         }
       } else if ((*config_vars)->module_elem->type == XML_COMMENT_NODE || (*config_vars)->module_elem->type == XML_TEXT_NODE) {
          // Nothing to do here
       } else {
@@ -4012,6 +8070,24 @@ void reload_process_supervisor_element(reload_config_vars_t **config_vars)
                module_restarts_num_config = x;
             }
          }
+      } else if (!xmlStrcmp((*config_vars)->module_elem->name, BAD_CAST "stats-interval")) {
+         // Process supervisor's element "stats-interval"
+         key = xmlNodeListGetString((*config_vars)->doc_tree_ptr, (*config_vars)->module_elem->xmlChildrenNode, 1);
+         if (key != NULL && parse_stats_interval((const char *) key, &number) == 0) {
+            stats_interval_config = number;
+         }
+      } else if (!xmlStrcmp((*config_vars)->module_elem->name, BAD_CAST "restart-backoff-max")) {
+         // Process supervisor's element "restart-backoff-max"
+         key = xmlNodeListGetString((*config_vars)->doc_tree_ptr, (*config_vars)->module_elem->xmlChildrenNode, 1);
+         if (key != NULL && (sscanf((const char *) key,"%d",&number) == 1) && (number >= RESTART_BACKOFF_MIN_MS) && (number <= MAX_RESTART_BACKOFF_MAX_MS)) {
+            restart_backoff_max_config = number;
+         }
+      } else if (!xmlStrcmp((*config_vars)->module_elem->name, BAD_CAST "restart-cooldown")) {
+         // Process supervisor's element "restart-cooldown"
+         key = xmlNodeListGetString((*config_vars)->doc_tree_ptr, (*config_vars)->module_elem->xmlChildrenNode, 1);
+         if (key != NULL && (sscanf((const char *) key,"%d",&number) == 1) && (number >= 0) && (number <= MAX_RESTART_COOLDOWN_SEC)) {
+            restart_cooldown_config = number;
+         }
       }
       if (key != NULL) {
          xmlFree(key);
@@ -4257,14 +8333,16 @@ void reload_check_modules_interfaces_count(reload_config_vars_t  **config_vars)
    return;
 }
 
-int reload_check_module_element(reload_config_vars_t **config_vars, str_lst_t **first_module_name, str_lst_t **last_module_name)
+int reload_check_module_element(reload_config_vars_t **config_vars, str_lst_t **first_module_name, str_lst_t **last_module_name, name_index_t *module_names)
 {
    int number = 0;
    str_lst_t *ptr1 = NULL;
    char *new_module_name = NULL;
    xmlChar *key = NULL;
-   int basic_elements[6], name_elem_idx = 0, path_elem_idx = 1, trapifc_elem_idx = 2, enabled_elem_idx = 3, restarts_elem_idx = 4, params_elem_idx = 5;
-   memset(basic_elements, 0, 6 * sizeof(int));
+   int basic_elements[14], name_elem_idx = 0, path_elem_idx = 1, trapifc_elem_idx = 2, enabled_elem_idx = 3, restarts_elem_idx = 4, params_elem_idx = 5, stats_interval_elem_idx = 6, cpu_max_elem_idx = 7, memory_max_elem_idx = 8, cpu_affinity_elem_idx = 9, numa_node_elem_idx = 10, stop_timeout_elem_idx = 11, hot_restart_elem_idx = 12, listen_fds_elem_idx = 13;
+   uint64_t memory_size = 0;
+   cpu_set_t cpus;
+   memset(basic_elements, 0, 14 * sizeof(int));
 
    while ((*config_vars)->module_atr_elem != NULL) {
       if ((*config_vars)->module_atr_elem->type == XML_ELEMENT_NODE && (xmlStrcmp((*config_vars)->module_atr_elem->name, BAD_CAST "name") == 0)) {
@@ -4277,29 +8355,23 @@ int reload_check_module_element(reload_config_vars_t **config_vars, str_lst_t **
          key = xmlNodeListGetString((*config_vars)->doc_tree_ptr, (*config_vars)->module_atr_elem->xmlChildrenNode, 1);
          if (key != NULL) {
             new_module_name = strdup((char *) key);
-            /* Add the module name to linked list */
+            // Check whether the module name is duplicated
+            if (name_index_find(module_names, new_module_name) != -1) {
+               VERBOSE(N_STDOUT, "[ERROR] Duplicated module name \"%s\"\n", new_module_name);
+               NULLP_TEST_AND_FREE(new_module_name)
+               goto error_label;
+            }
+            /* Add the module name to linked list (it owns the name) and to the index of names */
+            ptr1 = (str_lst_t *) calloc(1, sizeof(str_lst_t));
+            ptr1->str = new_module_name;
+            ptr1->next = NULL;
             if ((*first_module_name) == NULL) {
-               (*first_module_name) = (str_lst_t *) calloc(1, sizeof(str_lst_t));
-               (*first_module_name)->str = new_module_name;
-               (*first_module_name)->next = NULL;
-               (*last_module_name) = (*first_module_name);
+               (*first_module_name) = ptr1;
             } else {
-               ptr1 = (*first_module_name);
-               while (ptr1 != NULL) {
-                  // Check whether the module name is duplicated
-                  if ((strlen(new_module_name) == strlen(ptr1->str)) && strcmp(new_module_name, ptr1->str) == 0) {
-                     VERBOSE(N_STDOUT, "[ERROR] Duplicated module name \"%s\"\n", new_module_name);
-                     NULLP_TEST_AND_FREE(new_module_name)
-                     goto error_label;
-                  }
-                  ptr1 = ptr1->next;
-               }
-               ptr1 = (str_lst_t *) calloc(1, sizeof(str_lst_t));
-               ptr1->str = new_module_name;
-               ptr1->next = NULL;
                (*last_module_name)->next = ptr1;
-               (*last_module_name) = ptr1;
             }
+            (*last_module_name) = ptr1;
+            name_index_insert(module_names, new_module_name, 0);
          } else {
             /* Empty element name is not allowed */
             VERBOSE(N_STDOUT, "[ERROR] Empty value in \"name\" element!\n");
@@ -4366,6 +8438,116 @@ int reload_check_module_element(reload_config_vars_t **config_vars, str_lst_t **
             goto error_label;
          }
 
+      } else if ((*config_vars)->module_atr_elem->type == XML_ELEMENT_NODE && (xmlStrcmp((*config_vars)->module_atr_elem->name, BAD_CAST "stats-interval") == 0)) {
+         basic_elements[stats_interval_elem_idx]++;
+         /* Check the number of found elements stats-interval (at most 1 is allowed) */
+         if (basic_elements[stats_interval_elem_idx] > 1) {
+            VERBOSE(N_STDOUT, "[ERROR] Too much \"stats-interval\" elements in \"module\" element!\n");
+            goto error_label;
+         }
+         key = xmlNodeListGetString((*config_vars)->doc_tree_ptr, (*config_vars)->module_atr_elem->xmlChildrenNode, 1);
+         if (key != NULL) {
+            /* The value in stats-interval element must be a number of milliseconds or "adaptive" */
+            if (parse_stats_interval((const char *) key, &number) == -1) {
+               VERBOSE(N_STDOUT, "[ERROR] Value in \"stats-interval\" element must be \"adaptive\" or number in range <%d,%d>!\n", MIN_STATS_INTERVAL_MS, MAX_STATS_INTERVAL_MS);
+               goto error_label;
+            }
+         } else {
+            /* Empty stats-interval element is not allowed */
+            VERBOSE(N_STDOUT, "[ERROR] Empty value in \"stats-interval\" element!\n");
+            goto error_label;
+         }
+      } else if ((*config_vars)->module_atr_elem->type == XML_ELEMENT_NODE && (xmlStrcmp((*config_vars)->module_atr_elem->name, BAD_CAST "cpu-max") == 0)) {
+         basic_elements[cpu_max_elem_idx]++;
+         /* Check the number of found elements cpu-max (at most 1 is allowed) */
+         if (basic_elements[cpu_max_elem_idx] > 1) {
+            VERBOSE(N_STDOUT, "[ERROR] Too much \"cpu-max\" elements in \"module\" element!\n");
+            goto error_label;
+         }
+         key = xmlNodeListGetString((*config_vars)->doc_tree_ptr, (*config_vars)->module_atr_elem->xmlChildrenNode, 1);
+         if (key == NULL || parse_cpu_max((const char *) key, &number) == -1) {
+            /* The value in cpu-max element must be percent of one CPU or "max" */
+            VERBOSE(N_STDOUT, "[ERROR] Value in \"cpu-max\" element must be \"max\" or number (percent of one CPU) in range <1,%d>!\n", MAX_CPU_MAX_PERCENT);
+            goto error_label;
+         }
+      } else if ((*config_vars)->module_atr_elem->type == XML_ELEMENT_NODE && (xmlStrcmp((*config_vars)->module_atr_elem->name, BAD_CAST "memory-max") == 0)) {
+         basic_elements[memory_max_elem_idx]++;
+         /* Check the number of found elements memory-max (at most 1 is allowed) */
+         if (basic_elements[memory_max_elem_idx] > 1) {
+            VERBOSE(N_STDOUT, "[ERROR] Too much \"memory-max\" elements in \"module\" element!\n");
+            goto error_label;
+         }
+         key = xmlNodeListGetString((*config_vars)->doc_tree_ptr, (*config_vars)->module_atr_elem->xmlChildrenNode, 1);
+         if (key == NULL || parse_memory_size((const char *) key, &memory_size) == -1) {
+            /* The value in memory-max element must be number of bytes (with optional suffix K, M or G) or "max" */
+            VERBOSE(N_STDOUT, "[ERROR] Value in \"memory-max\" element must be \"max\" or number of bytes with optional suffix K, M or G!\n");
+            goto error_label;
+         }
+      } else if ((*config_vars)->module_atr_elem->type == XML_ELEMENT_NODE && (xmlStrcmp((*config_vars)->module_atr_elem->name, BAD_CAST "cpu-affinity") == 0)) {
+         basic_elements[cpu_affinity_elem_idx]++;
+         /* Check the number of found elements cpu-affinity (at most 1 is allowed) */
+         if (basic_elements[cpu_affinity_elem_idx] > 1) {
+            VERBOSE(N_STDOUT, "[ERROR] Too much \"cpu-affinity\" elements in \"module\" element!\n");
+            goto error_label;
+         }
+         key = xmlNodeListGetString((*config_vars)->doc_tree_ptr, (*config_vars)->module_atr_elem->xmlChildrenNode, 1);
+         if (key == NULL || parse_cpu_list((const char *) key, &cpus) == -1) {
+            /* The value in cpu-affinity element must be a non-empty list of CPUs */
+            VERBOSE(N_STDOUT, "[ERROR] Value in \"cpu-affinity\" element must be list of CPU numbers and ranges separated by commas (e.g. \"0-3,8\")!\n");
+            goto error_label;
+         }
+      } else if ((*config_vars)->module_atr_elem->type == XML_ELEMENT_NODE && (xmlStrcmp((*config_vars)->module_atr_elem->name, BAD_CAST "numa-node") == 0)) {
+         basic_elements[numa_node_elem_idx]++;
+         /* Check the number of found elements numa-node (at most 1 is allowed) */
+         if (basic_elements[numa_node_elem_idx] > 1) {
+            VERBOSE(N_STDOUT, "[ERROR] Too much \"numa-node\" elements in \"module\" element!\n");
+            goto error_label;
+         }
+         key = xmlNodeListGetString((*config_vars)->doc_tree_ptr, (*config_vars)->module_atr_elem->xmlChildrenNode, 1);
+         if (key == NULL || parse_numa_node((const char *) key, &number) == -1) {
+            /* The value in numa-node element must be number of the node or "auto" */
+            VERBOSE(N_STDOUT, "[ERROR] Value in \"numa-node\" element must be \"auto\" or number in range <0,%d>!\n", MAX_NUMA_NODES - 1);
+            goto error_label;
+         }
+      } else if ((*config_vars)->module_atr_elem->type == XML_ELEMENT_NODE && (xmlStrcmp((*config_vars)->module_atr_elem->name, BAD_CAST "stop-timeout") == 0)) {
+         basic_elements[stop_timeout_elem_idx]++;
+         /* Check the number of found elements stop-timeout (at most 1 is allowed) */
+         if (basic_elements[stop_timeout_elem_idx] > 1) {
+            VERBOSE(N_STDOUT, "[ERROR] Too much \"stop-timeout\" elements in \"module\" element!\n");
+            goto error_label;
+         }
+         key = xmlNodeListGetString((*config_vars)->doc_tree_ptr, (*config_vars)->module_atr_elem->xmlChildrenNode, 1);
+         if (key == NULL || (sscanf((const char *) key,"%d",&number) != 1) || (number < 0) || (number > MAX_STOP_TIMEOUT_MS)) {
+            /* The value in stop-timeout element must be a number of milliseconds */
+            VERBOSE(N_STDOUT, "[ERROR] Value in \"stop-timeout\" element must be number (milliseconds) in range <0,%d>!\n", MAX_STOP_TIMEOUT_MS);
+            goto error_label;
+         }
+      } else if ((*config_vars)->module_atr_elem->type == XML_ELEMENT_NODE && (xmlStrcmp((*config_vars)->module_atr_elem->name, BAD_CAST "hot-restart") == 0)) {
+         basic_elements[hot_restart_elem_idx]++;
+         /* Check the number of found elements hot-restart (at most 1 is allowed) */
+         if (basic_elements[hot_restart_elem_idx] > 1) {
+            VERBOSE(N_STDOUT, "[ERROR] Too much \"hot-restart\" elements in \"module\" element!\n");
+            goto error_label;
+         }
+         key = xmlNodeListGetString((*config_vars)->doc_tree_ptr, (*config_vars)->module_atr_elem->xmlChildrenNode, 1);
+         /* Only "true" or "false" values in element hot-restart are allowed */
+         if (key == NULL || (xmlStrcmp(key, BAD_CAST "true") != 0 && xmlStrcmp(key, BAD_CAST "false") != 0)) {
+            VERBOSE(N_STDOUT, "[ERROR] Expected one of {true,false} values in \"hot-restart\" element!\n");
+            goto error_label;
+         }
+      } else if ((*config_vars)->module_atr_elem->type == XML_ELEMENT_NODE && (xmlStrcmp((*config_vars)->module_atr_elem->name, BAD_CAST "listen-fds") == 0)) {
+         basic_elements[listen_fds_elem_idx]++;
+         /* Check the number of found elements listen-fds (at most 1 is allowed) */
+         if (basic_elements[listen_fds_elem_idx] > 1) {
+            VERBOSE(N_STDOUT, "[ERROR] Too much \"listen-fds\" elements in \"module\" element!\n");
+            goto error_label;
+         }
+         key = xmlNodeListGetString((*config_vars)->doc_tree_ptr, (*config_vars)->module_atr_elem->xmlChildrenNode, 1);
+         /* Only "true" or "false" values in element listen-fds are allowed */
+         if (key == NULL || (xmlStrcmp(key, BAD_CAST "true") != 0 && xmlStrcmp(key, BAD_CAST "false") != 0)) {
+            VERBOSE(N_STDOUT, "[ERROR] Expected one of {true,false} values in \"listen-fds\" element!\n");
+            goto error_label;
+         }
       } else if ((*config_vars)->module_atr_elem->type == XML_ELEMENT_NODE && (xmlStrcmp((*config_vars)->module_atr_elem->name,BAD_CAST "params") == 0)) {
          basic_elements[params_elem_idx]++;
          /* Check the number of found elements params (at most 1 is allowed) */
@@ -4536,7 +8718,7 @@ int reload_find_and_check_module_basic_elements(reload_config_vars_t **config_va
    return 0;
 }
 
-int reload_check_modules_element(reload_config_vars_t **config_vars, str_lst_t **first_profile_name, str_lst_t **last_profile_name)
+int reload_check_modules_element(reload_config_vars_t **config_vars, str_lst_t **first_profile_name, str_lst_t **last_profile_name, name_index_t *profile_names)
 {
    str_lst_t *ptr1 = NULL;
    char *new_profile_name = NULL;
@@ -4555,29 +8737,23 @@ int reload_check_modules_element(reload_config_vars_t **config_vars, str_lst_t *
          key = xmlNodeListGetString((*config_vars)->doc_tree_ptr, (*config_vars)->module_elem->xmlChildrenNode, 1);
          if (key != NULL) {
             new_profile_name = strdup((char *) key);
-            /* Add the profile name to linked list */
+            // Check whether the profile name is duplicated
+            if (name_index_find(profile_names, new_profile_name) != -1) {
+               VERBOSE(N_STDOUT, "[ERROR] Duplicated profile name \"%s\"\n", new_profile_name);
+               NULLP_TEST_AND_FREE(new_profile_name)
+               goto error_label;
+            }
+            /* Add the profile name to linked list (it owns the name) and to the index of names */
+            ptr1 = (str_lst_t *) calloc(1, sizeof(str_lst_t));
+            ptr1->str = new_profile_name;
+            ptr1->next = NULL;
             if ((*first_profile_name) == NULL) {
-               (*first_profile_name) = (str_lst_t *) calloc(1, sizeof(str_lst_t));
-               (*first_profile_name)->str = new_profile_name;
-               (*first_profile_name)->next = NULL;
-               (*last_profile_name) = (*first_profile_name);
+               (*first_profile_name) = ptr1;
             } else {
-               ptr1 = (*first_profile_name);
-               while (ptr1 != NULL) {
-                  // Check whether the profile name is duplicated
-                  if ((strlen(new_profile_name) == strlen(ptr1->str)) && strcmp(new_profile_name, ptr1->str) == 0) {
-                     VERBOSE(N_STDOUT, "[ERROR] Duplicated profile name \"%s\"\n", new_profile_name);
-                     NULLP_TEST_AND_FREE(new_profile_name)
-                     goto error_label;
-                  }
-                  ptr1 = ptr1->next;
-               }
-               ptr1 = (str_lst_t *) calloc(1, sizeof(str_lst_t));
-               ptr1->str = new_profile_name;
-               ptr1->next = NULL;
                (*last_profile_name)->next = ptr1;
-               (*last_profile_name) = ptr1;
             }
+            (*last_profile_name) = ptr1;
+            name_index_insert(profile_names, new_profile_name, 0);
          } else {
             /* Empty element name is not allowed */
             VERBOSE(N_STDOUT, "[ERROR] Empty value in \"name\" element!\n");
@@ -4795,6 +8971,18 @@ void check_running_modules_allocated_memory()
          running_modules[x].module_running = FALSE;
          running_modules[x].config_ifces_arr_size = IFCES_ARRAY_START_SIZE;
          running_modules[x].config_ifces_cnt = 0;
+         running_modules[x].module_pidfd = -1;
+         running_modules[x].proc_stat_fd = -1;
+         running_modules[x].proc_statm_fd = -1;
+         running_modules[x].proc_io_fd = -1;
+         running_modules[x].cgroup_cpu_stat_fd = -1;
+         running_modules[x].cgroup_memory_stat_fd = -1;
+         running_modules[x].cgroup_io_stat_fd = -1;
+         running_modules[x].module_stats_interval = -1;
+         running_modules[x].module_numa_node = -1;
+         running_modules[x].module_stop_timeout = -1;
+         running_modules[x].module_retiring_pidfd = -1;
+         running_modules[x].numa_node = -1;
       }
    } else if (loaded_modules_cnt == running_modules_array_size) {
       origin_size = running_modules_array_size;
@@ -4807,6 +8995,18 @@ void check_running_modules_allocated_memory()
          running_modules[x].module_running = FALSE;
          running_modules[x].config_ifces_arr_size = IFCES_ARRAY_START_SIZE;
          running_modules[x].config_ifces_cnt = 0;
+         running_modules[x].module_pidfd = -1;
+         running_modules[x].proc_stat_fd = -1;
+         running_modules[x].proc_statm_fd = -1;
+         running_modules[x].proc_io_fd = -1;
+         running_modules[x].cgroup_cpu_stat_fd = -1;
+         running_modules[x].cgroup_memory_stat_fd = -1;
+         running_modules[x].cgroup_io_stat_fd = -1;
+         running_modules[x].module_stats_interval = -1;
+         running_modules[x].module_numa_node = -1;
+         running_modules[x].module_stop_timeout = -1;
+         running_modules[x].module_retiring_pidfd = -1;
+         running_modules[x].numa_node = -1;
       }
    }
 }
@@ -4855,6 +9055,11 @@ int validate_configuration(reload_config_vars_t **config_vars)
    str_lst_t *first_module_name = NULL, *last_module_name = NULL;
    str_lst_t *first_profile_name = NULL, *last_profile_name = NULL;
    str_lst_t *ptr1 = NULL;
+   name_index_t module_names, profile_names;
+
+   // Duplicated names are found in indexes of names, the lists own the names
+   memset(&module_names, 0, sizeof(name_index_t));
+   memset(&profile_names, 0, sizeof(name_index_t));
 
    VERBOSE(N_STDOUT, "- - -\n[RELOAD] Validating the configuration file...\n");
 
@@ -4904,7 +9109,7 @@ int validate_configuration(reload_config_vars_t **config_vars)
             goto end_label;
          }
          (*config_vars)->module_atr_elem = NULL, (*config_vars)->ifc_elem = NULL, (*config_vars)->ifc_atr_elem = NULL;
-         if (reload_check_modules_element(config_vars, &first_profile_name, &last_profile_name) == -1) {
+         if (reload_check_modules_element(config_vars, &first_profile_name, &last_profile_name, &profile_names) == -1) {
             ret_val = -1;
             goto end_label;
          }
@@ -4919,7 +9124,7 @@ int validate_configuration(reload_config_vars_t **config_vars)
                   ret_val = -1;
                   goto end_label;
                }
-               if (reload_check_module_element(config_vars, &first_module_name, &last_module_name) == -1) {
+               if (reload_check_module_element(config_vars, &first_module_name, &last_module_name, &module_names) == -1) {
                   ret_val = -1;
                   goto end_label;
                }
@@ -4973,6 +9178,8 @@ int validate_configuration(reload_config_vars_t **config_vars)
    }
 
 end_label:
+   name_index_free(&module_names);
+   name_index_free(&profile_names);
    ptr1 = NULL;
    // free linked list of module names
    while (first_module_name != NULL) {
@@ -5181,9 +9388,129 @@ int generate_config_file()
 }
 
 
+uint64_t reload_hash_element(const xmlNodePtr elem, uint64_t hash)
+{
+   xmlNodePtr child = NULL;
+   const xmlChar *str = NULL;
+
+   for (str = elem->name; str != NULL && *str != 0; str++) {
+      hash = (hash ^ *str) * 1099511628211ULL;
+   }
+   // Separator of the element, so "<a><b/></a>" and "<ab/>" differ
+   hash = (hash ^ '<') * 1099511628211ULL;
+   for (child = elem->xmlChildrenNode; child != NULL; child = child->next) {
+      if (child->type == XML_ELEMENT_NODE) {
+         hash = reload_hash_element(child, hash);
+      } else if ((child->type == XML_TEXT_NODE || child->type == XML_CDATA_SECTION_NODE) && xmlIsBlankNode(child) == 0) {
+         for (str = child->content; str != NULL && *str != 0; str++) {
+            hash = (hash ^ *str) * 1099511628211ULL;
+         }
+      }
+   }
+   return (hash ^ '>') * 1099511628211ULL;
+}
+
+xmlChar *reload_get_module_elem_name(const reload_config_vars_t *config_vars, const xmlNodePtr module_elem)
+{
+   xmlNodePtr atr_elem = NULL;
+
+   for (atr_elem = module_elem->xmlChildrenNode; atr_elem != NULL; atr_elem = atr_elem->next) {
+      if (atr_elem->type == XML_ELEMENT_NODE && !xmlStrcmp(atr_elem->name, BAD_CAST "name")) {
+         return xmlNodeListGetString(config_vars->doc_tree_ptr, atr_elem->xmlChildrenNode, 1);
+      }
+   }
+   return NULL;
+}
+
+void reload_hash_module_elements(reload_config_vars_t *config_vars)
+{
+   xmlNodePtr modules_elem = NULL, module_elem = NULL;
+   uint32_t module_elems_cnt = 0;
+
+   for (modules_elem = config_vars->root_node->xmlChildrenNode; modules_elem != NULL; modules_elem = modules_elem->next) {
+      if (!xmlStrcmp(modules_elem->name, BAD_CAST "modules")) {
+         for (module_elem = modules_elem->xmlChildrenNode; module_elem != NULL; module_elem = module_elem->next) {
+            if (!xmlStrcmp(module_elem->name, BAD_CAST "module")) {
+               module_elems_cnt++;
+            }
+         }
+      }
+   }
+   if (module_elems_cnt == 0) {
+      return;
+   }
+   config_vars->module_hashes = (reload_module_hash_t *) calloc(module_elems_cnt, sizeof(reload_module_hash_t));
+   if (config_vars->module_hashes == NULL) {
+      // All modules are processed as changed
+      return;
+   }
+
+   for (modules_elem = config_vars->root_node->xmlChildrenNode; modules_elem != NULL; modules_elem = modules_elem->next) {
+      if (!xmlStrcmp(modules_elem->name, BAD_CAST "modules")) {
+         for (module_elem = modules_elem->xmlChildrenNode; module_elem != NULL; module_elem = module_elem->next) {
+            if (!xmlStrcmp(module_elem->name, BAD_CAST "module")) {
+               config_vars->module_hashes[config_vars->module_hashes_cnt].module_elem = module_elem;
+               config_vars->module_hashes[config_vars->module_hashes_cnt].module_name = reload_get_module_elem_name(config_vars, module_elem);
+               config_vars->module_hashes[config_vars->module_hashes_cnt].hash = reload_hash_element(module_elem, 14695981039346656037ULL);
+               // Module without name is not loaded, so its hash is never looked up
+               if (config_vars->module_hashes[config_vars->module_hashes_cnt].module_name != NULL) {
+                  name_index_insert(&config_vars->module_hashes_index, (char *) config_vars->module_hashes[config_vars->module_hashes_cnt].module_name, config_vars->module_hashes_cnt);
+               }
+               config_vars->module_hashes_cnt++;
+            }
+         }
+      }
+   }
+}
+
+uint64_t reload_get_module_hash(const reload_config_vars_t *config_vars, const xmlNodePtr module_elem)
+{
+   xmlChar *name = reload_get_module_elem_name(config_vars, module_elem);
+   int x = name_index_find(&config_vars->module_hashes_index, (char *) name);
+
+   if (name != NULL) {
+      xmlFree(name);
+   }
+   // Names of modules are unique (checked before), but the element has to be the hashed one
+   if (x == -1 || config_vars->module_hashes[x].module_elem != module_elem) {
+      return 0;
+   }
+   return config_vars->module_hashes[x].hash;
+}
+
+void reload_free_module_hashes(reload_config_vars_t *config_vars)
+{
+   uint32_t x = 0;
+
+   for (x = 0; x < config_vars->module_hashes_cnt; x++) {
+      if (config_vars->module_hashes[x].module_name != NULL) {
+         xmlFree(config_vars->module_hashes[x].module_name);
+      }
+   }
+   NULLP_TEST_AND_FREE(config_vars->module_hashes)
+   config_vars->module_hashes_cnt = 0;
+   name_index_free(&config_vars->module_hashes_index);
+}
+
+void reload_reset_module_config(const int module_idx)
+{
+   running_modules[module_idx].module_max_restarts_per_minute = -1;
+   running_modules[module_idx].module_stats_interval = -1;
+   running_modules[module_idx].module_cpu_max = 0;
+   running_modules[module_idx].module_memory_max = 0;
+   if (running_modules[module_idx].module_cpu_affinity != NULL) {
+      xmlFree(running_modules[module_idx].module_cpu_affinity);
+      running_modules[module_idx].module_cpu_affinity = NULL;
+   }
+   running_modules[module_idx].module_numa_node = -1;
+   running_modules[module_idx].module_stop_timeout = -1;
+   running_modules[module_idx].module_hot_restart = FALSE;
+   running_modules[module_idx].module_listen_fds = FALSE;
+}
+
 int reload_configuration(const int choice, xmlNodePtr *node)
 {
-   pthread_mutex_lock(&running_modules_lock);
+   pthread_mutex_lock(&reload_lock);
    modules_profile_t *ptr1 = NULL, *ptr2 = NULL;
    int ret_val = 0;
    FILE *tmp_err = NULL;
@@ -5195,6 +9522,8 @@ int reload_configuration(const int choice, xmlNodePtr *node)
    int ifc_cnt = 0;
    reload_config_vars_t * config_vars = (reload_config_vars_t *) calloc(1, sizeof(reload_config_vars_t));
    xmlChar *key = NULL;
+   uint64_t module_hash = 0;
+   int *original_numa_nodes = NULL;
 
    switch (choice) {
       case RELOAD_INIT_LOAD_CONFIG: {
@@ -5204,7 +9533,7 @@ parse_default_config_file:
                if (generate_config_file() == -1) {
                   VERBOSE(N_STDOUT, "%s [ERROR] Could not generate configuration file with path \"%s\"!\n- - -\n", get_formatted_time(), gener_config_file);
                   NULLP_TEST_AND_FREE(backup_file_name)
-                  pthread_mutex_unlock(&running_modules_lock);
+                  pthread_mutex_unlock(&reload_lock);
                   xmlCleanupParser();
                   free(config_vars);
                   return FALSE;
@@ -5218,7 +9547,7 @@ parse_default_config_file:
                   xmlErrorPtr error = xmlGetLastError();
                   VERBOSE(N_STDOUT, "INFO:\n\tFile: %s\n\tError message: %s\tLine: %d\n- - -\n", error->file, error->message, error->line);
                   NULLP_TEST_AND_FREE(backup_file_name)
-                  pthread_mutex_unlock(&running_modules_lock);
+                  pthread_mutex_unlock(&reload_lock);
                   xmlCleanupParser();
                   free(config_vars);
                   return FALSE;
@@ -5256,7 +9585,7 @@ parse_default_config_file:
          if (generate_config_file() == -1) {
             VERBOSE(N_STDOUT, "[ERROR] Could not generate configuration file with path \"%s\"!\n- - -\n", gener_config_file);
             NULLP_TEST_AND_FREE(backup_file_name)
-            pthread_mutex_unlock(&running_modules_lock);
+            pthread_mutex_unlock(&reload_lock);
             xmlCleanupParser();
             free(config_vars);
             return FALSE;
@@ -5269,7 +9598,7 @@ parse_default_config_file:
             VERBOSE(N_STDOUT, "- - -\n[ERROR] Could not parse generated configuration file with path \"%s\"!\n", gener_config_file);
             xmlErrorPtr error = xmlGetLastError();
             VERBOSE(N_STDOUT, "INFO:\n\tFile: %s\n\tError message: %s\tLine: %d\n- - -\n", error->file, error->message, error->line);
-            pthread_mutex_unlock(&running_modules_lock);
+            pthread_mutex_unlock(&reload_lock);
             xmlCleanupParser();
             free(config_vars);
             return FALSE;
@@ -5283,7 +9612,7 @@ parse_default_config_file:
 
       default:
          xmlCleanupParser();
-         pthread_mutex_unlock(&running_modules_lock);
+         pthread_mutex_unlock(&reload_lock);
          free(config_vars);
          return FALSE;
    }
@@ -5297,7 +9626,7 @@ parse_default_config_file:
          xmlFreeDoc(config_vars->doc_tree_ptr);
          xmlCleanupParser();
       }
-      pthread_mutex_unlock(&running_modules_lock);
+      pthread_mutex_unlock(&reload_lock);
       free(config_vars);
       return FALSE;
    }
@@ -5308,14 +9637,24 @@ parse_default_config_file:
    VERBOSE(DEBUG, "\n\n%s [DEBUG] Request to reload this configuration --->\n\n", get_formatted_time());
    print_xmlDoc_to_stream(config_vars->root_node->doc, supervisor_debug_log_fd);
 
+   // Modules are compared by hashes of their elements, the new configuration is hashed before the modules are locked
+   reload_hash_module_elements(config_vars);
+
    config_vars->current_node = config_vars->root_node->xmlChildrenNode;
 
+   pthread_mutex_lock(&running_modules_lock);
    /*****************/
+   modules_config_generation++;
+   stats_interval_config = DEFAULT_STATS_INTERVAL_MS;
+   restart_backoff_max_config = DEFAULT_RESTART_BACKOFF_MAX_MS;
+   restart_cooldown_config = DEFAULT_RESTART_COOLDOWN_SEC;
+   // Values loaded from module elements are reset only for changed modules (see reload_reset_module_config())
    for (x=0; x<running_modules_array_size; x++) {
       running_modules[x].module_checked_by_reload = FALSE;
       running_modules[x].module_modified_by_reload = FALSE;
+      running_modules[x].module_config_changed = FALSE;
       running_modules[x].modules_profile = NULL;
-      running_modules[x].module_max_restarts_per_minute = -1;
+      running_modules[x].module_hot_restart_pending = FALSE;
       running_modules[x].module_is_my_child = TRUE;
       running_modules[x].module_root_perm_needed = FALSE;
       running_modules[x].init_module = FALSE;
@@ -5382,6 +9721,17 @@ parse_default_config_file:
                   running_modules[config_vars->current_module_idx].module_checked_by_reload = TRUE;
                }
 
+               // Unchanged module keeps all its values, changed and new modules are loaded from their elements
+               config_vars->unchanged_module = FALSE;
+               module_hash = reload_get_module_hash(config_vars, config_vars->module_elem);
+               if (config_vars->new_module == FALSE && module_hash != 0 && module_hash == running_modules[config_vars->current_module_idx].module_config_hash) {
+                  config_vars->unchanged_module = TRUE;
+               } else {
+                  reload_reset_module_config(config_vars->current_module_idx);
+                  running_modules[config_vars->current_module_idx].module_config_changed = TRUE;
+               }
+               running_modules[config_vars->current_module_idx].module_config_hash = module_hash;
+
                // Get module's PID from "module" element if it exists
                if (choice == RELOAD_INIT_LOAD_CONFIG) {
                   key = xmlGetProp(config_vars->module_elem, BAD_CAST "module_pid");
@@ -5394,6 +9744,11 @@ parse_default_config_file:
 
                config_vars->module_atr_elem = config_vars->module_elem->xmlChildrenNode;
                while (config_vars->module_atr_elem != NULL) {
+                  if (config_vars->unchanged_module == TRUE && xmlStrcmp(config_vars->module_atr_elem->name, BAD_CAST "enabled")) {
+                     // Module could be enabled or disabled by user since the last reload, the element is applied again
+                     config_vars->module_atr_elem = config_vars->module_atr_elem->next;
+                     continue;
+                  }
                   if ((!xmlStrcmp(config_vars->module_atr_elem->name,BAD_CAST "enabled"))) {
                      // Process module's "enabled" attribute
                      reload_resolve_module_enabled(&config_vars);
@@ -5409,6 +9764,78 @@ parse_default_config_file:
                         xmlFree(key);
                         key = NULL;
                      }
+                  } else if (!xmlStrcmp(config_vars->module_atr_elem->name, BAD_CAST "stats-interval")) {
+                     // Process module's "stats-interval" attribute
+                     key = xmlNodeListGetString(config_vars->doc_tree_ptr, config_vars->module_atr_elem->xmlChildrenNode, 1);
+                     if (key != NULL) {
+                        if (parse_stats_interval((char *) key, &number) == 0) {
+                           running_modules[config_vars->current_module_idx].module_stats_interval = number;
+                        }
+                        xmlFree(key);
+                        key = NULL;
+                     }
+                  } else if (!xmlStrcmp(config_vars->module_atr_elem->name, BAD_CAST "cpu-max")) {
+                     // Process module's "cpu-max" attribute
+                     key = xmlNodeListGetString(config_vars->doc_tree_ptr, config_vars->module_atr_elem->xmlChildrenNode, 1);
+                     if (key != NULL) {
+                        if (parse_cpu_max((char *) key, &number) == 0) {
+                           running_modules[config_vars->current_module_idx].module_cpu_max = number;
+                        }
+                        xmlFree(key);
+                        key = NULL;
+                     }
+                  } else if (!xmlStrcmp(config_vars->module_atr_elem->name, BAD_CAST "memory-max")) {
+                     // Process module's "memory-max" attribute
+                     key = xmlNodeListGetString(config_vars->doc_tree_ptr, config_vars->module_atr_elem->xmlChildrenNode, 1);
+                     if (key != NULL) {
+                        parse_memory_size((char *) key, &running_modules[config_vars->current_module_idx].module_memory_max);
+                        xmlFree(key);
+                        key = NULL;
+                     }
+                  } else if (!xmlStrcmp(config_vars->module_atr_elem->name, BAD_CAST "stop-timeout")) {
+                     // Process module's "stop-timeout" attribute
+                     key = xmlNodeListGetString(config_vars->doc_tree_ptr, config_vars->module_atr_elem->xmlChildrenNode, 1);
+                     if (key != NULL) {
+                        if ((sscanf((char *) key,"%d",&number) == 1) && (number >= 0) && (number <= MAX_STOP_TIMEOUT_MS)) {
+                           running_modules[config_vars->current_module_idx].module_stop_timeout = number;
+                        }
+                        xmlFree(key);
+                        key = NULL;
+                     }
+                  } else if (!xmlStrcmp(config_vars->module_atr_elem->name, BAD_CAST "hot-restart")) {
+                     // Process module's "hot-restart" attribute
+                     key = xmlNodeListGetString(config_vars->doc_tree_ptr, config_vars->module_atr_elem->xmlChildrenNode, 1);
+                     if (key != NULL) {
+                        running_modules[config_vars->current_module_idx].module_hot_restart = (xmlStrcmp(key, BAD_CAST "true") == 0 ? TRUE : FALSE);
+                        xmlFree(key);
+                        key = NULL;
+                     }
+                  } else if (!xmlStrcmp(config_vars->module_atr_elem->name, BAD_CAST "listen-fds")) {
+                     // Process module's "listen-fds" attribute
+                     key = xmlNodeListGetString(config_vars->doc_tree_ptr, config_vars->module_atr_elem->xmlChildrenNode, 1);
+                     if (key != NULL) {
+                        running_modules[config_vars->current_module_idx].module_listen_fds = (xmlStrcmp(key, BAD_CAST "true") == 0 ? TRUE : FALSE);
+                        xmlFree(key);
+                        key = NULL;
+                     }
+                  } else if (!xmlStrcmp(config_vars->module_atr_elem->name, BAD_CAST "cpu-affinity")) {
+                     // Process module's "cpu-affinity" attribute
+                     key = xmlNodeListGetString(config_vars->doc_tree_ptr, config_vars->module_atr_elem->xmlChildrenNode, 1);
+                     if (key != NULL) {
+                        running_modules[config_vars->current_module_idx].module_cpu_affinity = (char *) xmlStrdup(key);
+                        xmlFree(key);
+                        key = NULL;
+                     }
+                  } else if (!xmlStrcmp(config_vars->module_atr_elem->name, BAD_CAST "numa-node")) {
+                     // Process module's "numa-node" attribute
+                     key = xmlNodeListGetString(config_vars->doc_tree_ptr, config_vars->module_atr_elem->xmlChildrenNode, 1);
+                     if (key != NULL) {
+                        if (parse_numa_node((char *) key, &number) == 0) {
+                           running_modules[config_vars->current_module_idx].module_numa_node = number;
+                        }
+                        xmlFree(key);
+                        key = NULL;
+                     }
                   } else if ((!xmlStrcmp(config_vars->module_atr_elem->name,BAD_CAST "params"))) {
                      // Process module's "parameters" attribute
                      reload_process_module_atribute(&config_vars, &running_modules[config_vars->current_module_idx].module_params);
@@ -5418,6 +9845,8 @@ parse_default_config_file:
                         key = xmlNodeListGetString(config_vars->doc_tree_ptr, config_vars->module_atr_elem->xmlChildrenNode, 1);
                         if (key != NULL) {
                            running_modules[config_vars->current_module_idx].module_name = (char *) xmlStrdup(key);
+                           registry_add_module(config_vars->current_module_idx);
+                           registry_assign_handle(config_vars->current_module_idx);
                            xmlFree(key);
                            key = NULL;
                         }
@@ -5503,12 +9932,6 @@ parse_default_config_file:
       config_vars->current_node = config_vars->current_node->next;
    }
 
-   // do not free libnetconf xml structures or parsers data!!!
-   if (choice != RELOAD_CALLBACK_ROOT_ELEM) {
-      xmlFreeDoc(config_vars->doc_tree_ptr);
-      xmlCleanupParser();
-   }
-
    // Stop and remove missing modules from loaded configuration (modules deleted by user)
    for (x = 0; x < original_loaded_modules_cnt; x++) {
       if (running_modules[x].module_checked_by_reload == FALSE) {
@@ -5519,15 +9942,36 @@ parse_default_config_file:
       }
    }
 
+   // Automatic placement can move unchanged modules as well
+   original_numa_nodes = (int *) calloc(loaded_modules_cnt + 1, sizeof(int));
+   for (x=0; original_numa_nodes != NULL && x<loaded_modules_cnt; x++) {
+      original_numa_nodes[x] = running_modules[x].numa_node;
+   }
+   placement_assign_numa_nodes();
    for (x=0; x<loaded_modules_cnt; x++) {
       running_modules[x].module_served_by_service_thread = FALSE;
+      // Limits and CPU affinity of changed modules are applied to running modules immediately
+      if (running_modules[x].module_config_changed == TRUE) {
+         cgroup_apply_module_limits(x);
+      }
+      if (running_modules[x].module_config_changed == TRUE || original_numa_nodes == NULL || original_numa_nodes[x] != running_modules[x].numa_node) {
+         placement_apply_running_module(x);
+      }
       // Count modified modules
       if (running_modules[x].module_modified_by_reload == TRUE) {
          config_vars->modified_modules++;
          // If they were or are running, restart them with new configuration and initialize their variables
-         if (running_modules[x].module_running == TRUE) {
+         if (running_modules[x].module_running == TRUE && running_modules[x].module_enabled == TRUE && running_modules[x].module_hot_restart == TRUE
+             && running_modules[x].module_listen_fds == TRUE && running_modules[x].module_listen_socks_cnt > 0 && running_modules[x].module_pid > 0 && running_modules[x].module_retiring_pid == 0) {
+            // The running instance got its sockets from supervisor, the new one is started before it is stopped
+            VERBOSE(N_STDOUT, "[WARNING] %s was modified by reload and it has been running -> it will be hot restarted with new configuration.\n", running_modules[x].module_name);
+            running_modules[x].module_hot_restart_pending = TRUE;
+         } else if (running_modules[x].module_running == TRUE) {
             running_modules[x].module_running = FALSE;
             if (running_modules[x].module_enabled == TRUE) {
+               if (running_modules[x].module_hot_restart == TRUE && running_modules[x].module_listen_fds == FALSE) {
+                  VERBOSE(N_STDOUT, "[WARNING] %s has hot-restart enabled without listen-fds -> it owns its sockets and cannot be hot restarted.\n", running_modules[x].module_name);
+               }
                VERBOSE(N_STDOUT, "[WARNING] %s was modified by reload and it has been running -> it will be restarted with new configuration.\n", running_modules[x].module_name);
                running_modules[x].module_enabled = FALSE;
                running_modules[x].init_module = TRUE;
@@ -5553,6 +9997,16 @@ parse_default_config_file:
    VERBOSE(N_STDOUT, "Unmodified modules:\t%d\n", original_loaded_modules_cnt - config_vars->modified_modules - config_vars->removed_modules);
    VERBOSE(N_STDOUT, "[RELOAD] Processing of the new configuration successfully finished.\n- - -\n");
    pthread_mutex_unlock(&running_modules_lock);
+   service_wakeup();
+
+   // do not free libnetconf xml structures or parsers data!!!
+   if (choice != RELOAD_CALLBACK_ROOT_ELEM) {
+      xmlFreeDoc(config_vars->doc_tree_ptr);
+      xmlCleanupParser();
+   }
+   pthread_mutex_unlock(&reload_lock);
+   NULLP_TEST_AND_FREE(original_numa_nodes)
+   reload_free_module_hashes(config_vars);
    free(config_vars);
    return TRUE;
 }
@@ -5611,6 +10065,9 @@ xmlDocPtr netconf_get_state_data()
    xmlDocPtr doc_tree_ptr = NULL;
    xmlNodePtr root_elem = NULL, modules_elem = NULL, module_elem = NULL, trapinterfaces_elem = NULL, interface_elem = NULL;
    xmlNodePtr avail_modules = NULL, binpaths = NULL, param = NULL;
+   modules_snapshot_t *snapshot = NULL;
+   module_snapshot_t *module_state = NULL;
+   unsigned int reader_parity = 0, in_ifc_idx = 0, out_ifc_idx = 0;
 
    if (loaded_modules_cnt > 0 || first_available_modules_path != NULL) {
       doc_tree_ptr = xmlParseMemory(template, strlen(template));
@@ -5670,6 +10127,8 @@ xmlDocPtr netconf_get_state_data()
       }
 
    if (loaded_modules_cnt > 0) {
+      // State of modules is read from the snapshot published by service thread
+      snapshot = modules_snapshot_acquire(&reader_parity);
       // get state data about modules with a profile
       while (ptr != NULL) {
          if (ptr->profile_name != NULL) {
@@ -5679,29 +10138,37 @@ xmlDocPtr netconf_get_state_data()
                if (running_modules[x].modules_profile == NULL) {
                   continue;
                }
-               if (strcmp(running_modules[x].modules_profile->profile_name, ptr->profile_name) != 0) {
+               if (running_modules[x].modules_profile != ptr) {
                   continue;
                }
                memset(buffer,0,DEFAULT_SIZE_OF_BUFFER);
                module_elem = xmlNewChild(modules_elem, NULL, BAD_CAST "module", NULL);
                xmlNewChild(module_elem, NULL, BAD_CAST "name", BAD_CAST running_modules[x].module_name);
 
-               if (running_modules[x].module_status == TRUE) {
+               module_state = NULL;
+               if (snapshot != NULL && x < snapshot->modules_cnt && snapshot->modules[x].module_name != NULL && running_modules[x].module_name != NULL &&
+                   strcmp(snapshot->modules[x].module_name, running_modules[x].module_name) == 0) {
+                  module_state = &snapshot->modules[x];
+               }
+
+               if (module_state != NULL && module_state->module_status == TRUE) {
                   xmlNewChild(module_elem, NULL, BAD_CAST "running", BAD_CAST "true");
                } else {
                   xmlNewChild(module_elem, NULL, BAD_CAST "running", BAD_CAST "false");
                }
 
-               if (running_modules[x].module_restart_cnt < 0) {
+               if (module_state == NULL || module_state->module_restart_cnt < 0) {
                   snprintf(buffer, DEFAULT_SIZE_OF_BUFFER, "%d",0);
                   xmlNewChild(module_elem, NULL, BAD_CAST "restart-counter", BAD_CAST buffer);
                } else {
-                  snprintf(buffer, DEFAULT_SIZE_OF_BUFFER, "%d",running_modules[x].module_restart_cnt);
+                  snprintf(buffer, DEFAULT_SIZE_OF_BUFFER, "%d",module_state->module_restart_cnt);
                   xmlNewChild(module_elem, NULL, BAD_CAST "restart-counter", BAD_CAST buffer);
                }
 
-               if (running_modules[x].module_service_ifc_isconnected == TRUE && running_modules[x].module_status) {
+               if (module_state != NULL && module_state->module_service_ifc_isconnected == TRUE && module_state->module_status) {
                   trapinterfaces_elem = xmlNewChild(module_elem, NULL, BAD_CAST "trapinterfaces", NULL);
+                  in_ifc_idx = 0;
+                  out_ifc_idx = 0;
                   for (y=0; y<running_modules[x].config_ifces_cnt; y++) {
                      if (running_modules[x].config_ifces[y].int_ifc_direction != INVALID_MODULE_IFC_ATTR && running_modules[x].config_ifces[y].ifc_params != NULL && running_modules[x].config_ifces[y].int_ifc_type != INVALID_MODULE_IFC_ATTR) {
                         interface_elem = xmlNewChild(trapinterfaces_elem, NULL, BAD_CAST "interface", NULL);
@@ -5710,11 +10177,16 @@ xmlDocPtr netconf_get_state_data()
                         xmlNewChild(interface_elem, NULL, BAD_CAST "params", BAD_CAST running_modules[x].config_ifces[y].ifc_params);
                         if (running_modules[x].config_ifces[y].int_ifc_direction == IN_MODULE_IFC_DIRECTION) {
                            memset(buffer,0,DEFAULT_SIZE_OF_BUFFER);
-                           // snprintf(buffer, DEFAULT_SIZE_OF_BUFFER, "%"PRIu64, ((in_ifc_stats_t *) running_modules[x].config_ifces[y].ifc_data)->recv_buffer_cnt);
+                           if (in_ifc_idx < module_state->total_in_ifces_cnt) {
+                              snprintf(buffer, DEFAULT_SIZE_OF_BUFFER, "%"PRIu64, module_state->in_ifces_data[in_ifc_idx].recv_buffer_cnt);
+                           }
                            xmlNewChild(interface_elem, NULL, BAD_CAST "recv-buffer-cnt", BAD_CAST buffer);
                            memset(buffer,0,DEFAULT_SIZE_OF_BUFFER);
-                           // snprintf(buffer, DEFAULT_SIZE_OF_BUFFER, "%"PRIu64, ((in_ifc_stats_t *) running_modules[x].config_ifces[y].ifc_data)->recv_msg_cnt);
+                           if (in_ifc_idx < module_state->total_in_ifces_cnt) {
+                              snprintf(buffer, DEFAULT_SIZE_OF_BUFFER, "%"PRIu64, module_state->in_ifces_data[in_ifc_idx].recv_msg_cnt);
+                           }
                            xmlNewChild(interface_elem, NULL, BAD_CAST "recv-msg-cnt", BAD_CAST buffer);
+                           in_ifc_idx++;
                            xmlNewChild(interface_elem, NULL, BAD_CAST "sent-msg-cnt", BAD_CAST "0");
                            xmlNewChild(interface_elem, NULL, BAD_CAST "dropped-msg-cnt", BAD_CAST "0");
                            xmlNewChild(interface_elem, NULL, BAD_CAST "sent-buffer-cnt", BAD_CAST "0");
@@ -5723,17 +10195,26 @@ xmlDocPtr netconf_get_state_data()
                            xmlNewChild(interface_elem, NULL, BAD_CAST "recv-buffer-cnt", BAD_CAST "0");
                            xmlNewChild(interface_elem, NULL, BAD_CAST "recv-msg-cnt", BAD_CAST "0");
                            memset(buffer,0,DEFAULT_SIZE_OF_BUFFER);
-                           // snprintf(buffer, DEFAULT_SIZE_OF_BUFFER, "%"PRIu64, ((out_ifc_stats_t *) running_modules[x].config_ifces[y].ifc_data)->sent_msg_cnt);
+                           if (out_ifc_idx < module_state->total_out_ifces_cnt) {
+                              snprintf(buffer, DEFAULT_SIZE_OF_BUFFER, "%"PRIu64, module_state->out_ifces_data[out_ifc_idx].sent_msg_cnt);
+                           }
                            xmlNewChild(interface_elem, NULL, BAD_CAST "sent-msg-cnt", BAD_CAST buffer);
                            memset(buffer,0,DEFAULT_SIZE_OF_BUFFER);
-                           // snprintf(buffer, DEFAULT_SIZE_OF_BUFFER, "%"PRIu64, ((out_ifc_stats_t *) running_modules[x].config_ifces[y].ifc_data)->dropped_msg_cnt);
+                           if (out_ifc_idx < module_state->total_out_ifces_cnt) {
+                              snprintf(buffer, DEFAULT_SIZE_OF_BUFFER, "%"PRIu64, module_state->out_ifces_data[out_ifc_idx].dropped_msg_cnt);
+                           }
                            xmlNewChild(interface_elem, NULL, BAD_CAST "dropped-msg-cnt", BAD_CAST buffer);
                            memset(buffer,0,DEFAULT_SIZE_OF_BUFFER);
-                           // snprintf(buffer, DEFAULT_SIZE_OF_BUFFER, "%"PRIu64, ((out_ifc_stats_t *) running_modules[x].config_ifces[y].ifc_data)->sent_buffer_cnt);
+                           if (out_ifc_idx < module_state->total_out_ifces_cnt) {
+                              snprintf(buffer, DEFAULT_SIZE_OF_BUFFER, "%"PRIu64, module_state->out_ifces_data[out_ifc_idx].sent_buffer_cnt);
+                           }
                            xmlNewChild(interface_elem, NULL, BAD_CAST "sent-buffer-cnt", BAD_CAST buffer);
                            memset(buffer,0,DEFAULT_SIZE_OF_BUFFER);
-                           // snprintf(buffer, DEFAULT_SIZE_OF_BUFFER, "%"PRIu64, ((out_ifc_stats_t *) running_modules[x].config_ifces[y].ifc_data)->autoflush_cnt);
+                           if (out_ifc_idx < module_state->total_out_ifces_cnt) {
+                              snprintf(buffer, DEFAULT_SIZE_OF_BUFFER, "%"PRIu64, module_state->out_ifces_data[out_ifc_idx].autoflush_cnt);
+                           }
                            xmlNewChild(interface_elem, NULL, BAD_CAST "autoflush-cnt", BAD_CAST buffer);
+                           out_ifc_idx++;
                         }
                      }
                   }
@@ -5752,6 +10233,7 @@ xmlDocPtr netconf_get_state_data()
          }
          ptr = ptr->next;
       }
+      modules_snapshot_release(reader_parity);
    }
    xmlCleanupParser();
    return doc_tree_ptr;
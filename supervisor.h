@@ -61,6 +61,11 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <limits.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <stddef.h>
+#include <sched.h>
+#include <stdatomic.h>
 
 #include <libtrap/trap.h>
 #include "config.h"
@@ -90,6 +95,14 @@
 
 #define INVALID_MODULE_IFC_ATTR   -1  ///< Constant for invalid module interface attribute
 
+#define DAEMON_CLIENT_CODE_SIZE   1024  ///< Size of buffer for the mode code (and its arguments) received from a supervisor client (or HTTP request)
+
+/* Types of replies cached by the server thread (see daemon_get_shared_reply()). */
+#define DAEMON_REPLY_STATS   0  ///< JSON with stats of running modules
+#define DAEMON_REPLY_INFO   1  ///< JSON with information about all modules
+#define DAEMON_REPLY_METRICS   2  ///< HTTP response with metrics in OpenMetrics text format
+#define DAEMON_REPLY_TYPES_CNT   3
+
 
 /**
  * Version of supervisor
@@ -133,6 +146,34 @@ typedef struct out_ifc_stats_s {
 } out_ifc_stats_t;
 
 
+/** Resources usage of one thread of a module (read from /proc/PID/task/TID/stat and status) */
+typedef struct module_thread_stats_s {
+   pid_t tid; ///< Thread ID
+   char name[17]; ///< Name of the thread (comm)
+   uint8_t seen; ///< Flag used to find finished threads
+   int stat_fd; ///< Descriptor of /proc/PID/task/TID/stat kept opened between samples (-1 ~ opened in every sample)
+   int status_fd; ///< Descriptor of /proc/PID/task/TID/status kept opened between samples (-1 ~ opened in every sample)
+   unsigned long int last_cpu_usage_user_mode; ///< CPU time in user mode (clock ticks) in the last sample
+   unsigned long int last_cpu_usage_kernel_mode; ///< CPU time in kernel mode (clock ticks) in the last sample
+   unsigned long int percent_cpu_usage_user_mode; ///< Percentage of one CPU used in user mode in the last period
+   unsigned long int percent_cpu_usage_kernel_mode; ///< Percentage of one CPU used in kernel mode in the last period
+   uint64_t voluntary_ctxt_switches; ///< Number of voluntary context switches
+   uint64_t nonvoluntary_ctxt_switches; ///< Number of involuntary context switches
+   uint64_t major_faults; ///< Number of major page faults
+} module_thread_stats_t;
+
+/** Key of interface counters decoded from JSON stats and its place in in_ifc_stats_t or out_ifc_stats_t */
+typedef struct stats_json_field_s {
+   const char *key; ///< JSON key
+   size_t offset; ///< Offset of the counter in the interface structure
+   uint8_t type; ///< Type of the counter (STATS_JSON_UINT64, _INT32, _UINT8, _CHAR or _STRING)
+} stats_json_field_t;
+
+typedef struct service_msg_header_s {
+   uint8_t com;
+   uint32_t data_size;
+} service_msg_header_t;
+
 /** Structure with information about one loaded interface of module */
 typedef struct interface_s {
    char *ifc_note; ///< Interface note
@@ -152,6 +193,12 @@ struct modules_profile_s {
 };
 
 /** Structure with information about one running module */
+typedef struct handover_socket_s {
+   int fd; ///< Listening socket held by supervisor and inherited by every instance of the module.
+   int ifc_type; ///< Type of the output interface (UNIXSOCKET_MODULE_IFC_TYPE or TCP_MODULE_IFC_TYPE).
+   char *name; ///< Name of the unix socket or TCP port of the output interface (also passed in LISTEN_FDNAMES).
+} handover_socket_t;
+
 typedef struct running_module_s {
    uint32_t total_in_ifces_cnt;  ///< Number of all trap input interfaces the module is running with - received via service interface
    uint32_t total_out_ifces_cnt;  ///< Number of all trap output interfaces the module is running with - received via service interface
@@ -172,6 +219,9 @@ typedef struct running_module_s {
    int module_served_by_service_thread; ///< TRUE if module was added to graph struct by sevice thread, FALSE on start.   /*** RELOAD ***/
    uint8_t module_modified_by_reload; ///< Variable used during reload_configuration, TRUE if already loaded module is changed by reload, else FALSE
    uint8_t module_checked_by_reload; ///< Variable used during reload_configuration, TRUE if a new module is added or already loaded module is checked (used for excluding modules with non-unique name)
+   uint8_t module_config_changed; ///< Variable used during reload_configuration, TRUE if the module element differs from the loaded configuration (its limits and placement are applied again)
+   uint64_t module_config_hash; ///< Hash of the module element of the loaded configuration (0 ~ unknown).   /*** RELOAD ***/
+   uint64_t module_handle; ///< Stable identifier of the module in info and stats output, it is never reused for another module (0 ~ none).   /*** RELOAD ***/
    modules_profile_t *modules_profile;   /*** RELOAD ***/
    int module_is_my_child;   /*** RELOAD ***/
    uint8_t module_root_perm_needed;
@@ -181,10 +231,53 @@ typedef struct running_module_s {
    int module_status; ///< Module status (TRUE ~ running, FALSE ~ stopped)   /*** SERVICE ***/
    int module_running; ///< TRUE after first start of module, else FALSE.   /*** RELOAD/ALLOCATION ***/
    int module_restart_cnt; ///< Number of module restarts.   /*** INIT ***/
-   int module_restart_timer;  ///< Timer used for monitoring max number of restarts/minute.   /*** INIT ***/
+   uint64_t module_starts_cnt; ///< Number of starts (including failed ones) of the module since it was loaded, it is never reset.   /*** SERVICE ***/
+   uint32_t module_restart_failures; ///< Number of consecutive exits of the module that ran shorter than RESTART_STABLE_RUN_MS.   /*** SERVICE ***/
+   uint64_t module_restart_deadline; ///< Monotonic time (ms) when the exited module is started again (0 ~ no restart is scheduled).   /*** SERVICE ***/
+   uint64_t module_start_time; ///< Monotonic time (ms) of the last start of the module.   /*** SERVICE ***/
    int module_max_restarts_per_minute;   /*** RELOAD ***/
+   int module_stats_interval; ///< Interval of requesting stats in ms loaded from config file (-1 ~ global value is used, 0 ~ adaptive).   /*** RELOAD ***/
+   int module_cpu_max; ///< CPU limit of the module cgroup in percent of one CPU loaded from config file (0 ~ unlimited).   /*** RELOAD ***/
+   uint64_t module_memory_max; ///< Memory limit of the module cgroup in bytes loaded from config file (0 ~ unlimited).   /*** RELOAD ***/
+   char *module_cpu_affinity; ///< List of CPUs the module is bound to loaded from config file (NULL ~ CPUs of supervisor).   /*** RELOAD ***/
+   int module_numa_node; ///< NUMA node of the module loaded from config file (-1 ~ none, NUMA_NODE_AUTO ~ chosen by supervisor).   /*** RELOAD ***/
+   int numa_node; ///< NUMA node the module is placed on (-1 ~ the module is not placed), resolved after reload of the configuration.
+   char *cgroup_path; ///< Path of the cgroup of the module (NULL if the module is not started in a cgroup).   /*** START ***/
+   int cgroup_cpu_stat_fd; ///< Descriptor of cpu.stat of the module cgroup (-1 if it is not opened).   /*** START ***/
+   int cgroup_memory_stat_fd; ///< Descriptor of memory.stat of the module cgroup (-1 if it is not opened).   /*** START ***/
+   int cgroup_io_stat_fd; ///< Descriptor of io.stat of the module cgroup (-1 if it is not opened).   /*** START ***/
+   uint64_t cgroup_last_user_usec; ///< CPU time of the module cgroup in user mode in the last sample.
+   uint64_t cgroup_last_system_usec; ///< CPU time of the module cgroup in kernel mode in the last sample.
    pid_t module_pid; ///< Modules process PID.   /*** RELOAD/START ***/
-   int sent_sigint;   /*** INIT ***/
+   int module_pidfd; ///< Pidfd of the module process watched by service thread (-1 if it is not opened).   /*** START ***/
+   int proc_stat_fd; ///< Descriptor of /proc/PID/stat of the module process kept opened between samples (-1 if it is not opened).   /*** START ***/
+   int proc_statm_fd; ///< Descriptor of /proc/PID/statm of the module process kept opened between samples (-1 if it is not opened).   /*** START ***/
+   int proc_io_fd; ///< Descriptor of /proc/PID/io of the module process kept opened between samples (-1 if it is not opened or accessible).   /*** START ***/
+   pid_t proc_fds_pid; ///< PID of the process proc_stat_fd, proc_statm_fd and proc_io_fd belong to.   /*** START ***/
+   module_thread_stats_t *threads; ///< Resources usage of threads of the module process (at most MODULE_THREADS_STATS_MAX).
+   uint32_t threads_cnt; ///< Number of monitored threads in threads array.
+   uint32_t threads_arr_size; ///< Size of allocated threads array.
+   uint64_t finished_threads_voluntary_ctxt_switches; ///< Voluntary context switches of finished threads of the module process.
+   uint64_t finished_threads_nonvoluntary_ctxt_switches; ///< Involuntary context switches of finished threads of the module process.
+   uint64_t major_faults; ///< Number of major page faults of the module process (from /proc/PID/stat).
+   uint64_t voluntary_ctxt_switches; ///< Sum of voluntary context switches of monitored threads.
+   uint64_t nonvoluntary_ctxt_switches; ///< Sum of involuntary context switches of monitored threads.
+   uint64_t read_bytes; ///< Number of bytes the module process caused to be read from storage (from /proc/PID/io).
+   uint64_t write_bytes; ///< Number of bytes the module process caused to be written to storage (from /proc/PID/io).
+   int module_exit_status; ///< Status of the last exit of the module as returned by wait4() (-1 if it is unknown).   /*** SERVICE ***/
+   struct rusage module_exit_rusage; ///< Resource usage of the last exited module process (zeroed if it is unknown).   /*** SERVICE ***/
+   int module_stop_timeout; ///< Time in ms the module has to finish after SIGINT loaded from config file (-1 ~ DEFAULT_STOP_TIMEOUT_MS).   /*** RELOAD ***/
+   uint8_t module_stop_state; ///< State of stopping the module (MODULE_STOP_NONE, MODULE_STOP_SIGINT_SENT or MODULE_STOP_SIGKILL_SENT).   /*** INIT ***/
+   uint64_t module_sigkill_deadline; ///< Monotonic time (ms) after which the module is killed if it does not finish after SIGINT.   /*** INIT ***/
+   uint8_t module_hot_restart; ///< TRUE if the module is restarted after reload without closing its listening sockets (loaded from config file).   /*** RELOAD ***/
+   uint8_t module_listen_fds; ///< TRUE if the module (its TRAP library) takes listening sockets from LISTEN_FDS instead of binding them (loaded from config file).   /*** RELOAD ***/
+   uint8_t module_hot_restart_pending; ///< TRUE if the module was modified by reload and the service thread restarts it by hot restart.   /*** RELOAD ***/
+   handover_socket_t *module_listen_socks; ///< Listening sockets of output interfaces held by supervisor (hot restart modules only).   /*** START ***/
+   uint32_t module_listen_socks_cnt; ///< Number of sockets in module_listen_socks.   /*** START ***/
+   pid_t module_retiring_pid; ///< PID of the previous instance of the module stopped after the new one is ready (0 ~ none).   /*** SERVICE ***/
+   int module_retiring_pidfd; ///< Pidfd of the previous instance of the module (-1 if it is not opened).   /*** SERVICE ***/
+   uint8_t module_retiring_stop_state; ///< State of stopping the previous instance (MODULE_STOP_NONE ~ waiting for the new instance).   /*** SERVICE ***/
+   uint64_t module_retiring_deadline; ///< Monotonic time (ms) after which the previous instance is killed if it does not finish after SIGINT.   /*** SERVICE ***/
 
    uint64_t virtual_memory_size;  ///< loaded from /proc/PID/stat in B
    uint64_t resident_set_size;  ///< loaded from /proc/PID/status in kB
@@ -197,10 +290,102 @@ typedef struct running_module_s {
    int module_service_sd; ///< Socket descriptor of the service connection.   /*** INIT ***/
    uint8_t module_service_ifc_isconnected; ///< if supervisor is connected to module ~ TRUE, else ~ FALSE   /*** INIT ***/
    uint64_t service_ifc_conn_timer;   /*** INIT ***/
+   uint8_t service_reply_pending; ///< TRUE if a stats request was sent to the module and the reply was not received yet.   /*** SERVICE ***/
+   uint64_t service_reply_deadline; ///< Monotonic time (ms) until the whole reply has to be received.   /*** SERVICE ***/
+   uint32_t service_reply_received; ///< Number of bytes of the current reply (header and data) received so far.   /*** SERVICE ***/
+   service_msg_header_t service_reply_header; ///< Header of the current reply.   /*** SERVICE ***/
+   char *service_buffer; ///< Reassembly buffer for the data of the current reply (reused for every reply).   /*** SERVICE ***/
+   uint32_t service_buffer_size; ///< Size of allocated service_buffer.   /*** SERVICE ***/
+   uint8_t service_stats_format; ///< Format of stats negotiated with the module (SERVICE_STATS_FORMAT_UNKNOWN, _JSON or _BIN).   /*** SERVICE ***/
+   uint8_t service_bin_unanswered; ///< Number of connections closed while the first request of binary stats was pending.   /*** SERVICE ***/
+   uint64_t stats_next_request; ///< Monotonic time (ms) when the next stats request is sent to the module.   /*** SERVICE ***/
+   uint32_t stats_adaptive_interval; ///< Current interval of requesting stats in ms in adaptive mode.   /*** SERVICE ***/
+   uint64_t stats_last_msg_cnt; ///< Number of messages received and sent by the module in the last stats (used by adaptive mode).   /*** SERVICE ***/
+   uint64_t stats_last_sample_time; ///< Monotonic time (ms) of the last stats (used by adaptive mode).   /*** SERVICE ***/
+   uint32_t startup_wave; ///< Wave of dataflow graph the module is started in (after modules of lower waves are ready).
+   uint8_t startup_probing; ///< TRUE if the module was started and supervisor tries to connect to it to find out it is ready.   /*** SERVICE ***/
+   uint64_t startup_next_probe; ///< Monotonic time (ms) of the next connection attempt to the started module.   /*** SERVICE ***/
+   uint64_t startup_ready_deadline; ///< Monotonic time (ms) after which consumers of the started module do not wait for it.   /*** SERVICE ***/
 } running_module_t;
 
+typedef struct dataflow_edge_s {
+   uint32_t producer; ///< Index of the module with the output interface.
+   uint32_t consumer; ///< Index of the module with the input interface connected to it.
+} dataflow_edge_t;
+
+typedef struct module_launch_s {
+   char **argv; ///< Arguments of the module binary (prepared by prep_module_args()).
+   char *path; ///< Path of the module binary (resolved using PATH if it does not contain '/').
+   char **sh_argv; ///< Arguments of LAUNCHER_SHELL executing the binary if it is not in an executable format (as execvp() does).
+   int stdout_fd; ///< Descriptor of the stdout log of the module.
+   int stderr_fd; ///< Descriptor of the stderr log of the module.
+   int cgroup_procs_fd; ///< Descriptor of cgroup.procs of the module cgroup (-1 if the module is not started in a cgroup).
+   int cpus_set; ///< TRUE if CPU affinity of the module is set to cpus.
+   cpu_set_t cpus; ///< CPUs of the module.
+   int numa_node; ///< Preferred NUMA node of memory of the module (-1 ~ memory policy is not set).
+   int exec_errno; ///< Error returned by the module process if it could not execute the binary (0 ~ success).
+   int *listen_fds; ///< Listening sockets passed to the module from LISTEN_FDS_START (NULL ~ none).
+   uint32_t listen_fds_cnt; ///< Number of sockets in listen_fds.
+   char **envp; ///< Environment of the module with LISTEN_* variables (NULL ~ environment of supervisor is used).
+   char listen_pid_env[32]; ///< "LISTEN_PID=" variable of envp, the PID is filled in by the module process.
+} module_launch_t;
+
+
+/** Copy of state of one module stored in modules snapshot (see modules_snapshot_t) */
+typedef struct module_snapshot_s {
+   char *module_name;  ///< Copy of running_module_t module_name
+   char *module_params;  ///< Copy of running_module_t module_params
+   char *module_path;  ///< Copy of running_module_t module_path
+   unsigned int module_idx;  ///< Index of the module in running_modules array at the time the snapshot was created
+   uint64_t module_handle;  ///< Stable handle of the module (see running_module_t module_handle)
+   int module_status;  ///< Module status (TRUE ~ running, FALSE ~ stopped)
+   int module_restart_cnt;  ///< Number of module restarts
+   uint64_t module_starts_cnt;  ///< Copy of running_module_t module_starts_cnt
+   uint8_t module_service_ifc_isconnected;  ///< if supervisor was connected to module ~ TRUE, else ~ FALSE
+   unsigned long int last_period_percent_cpu_usage_kernel_mode;  ///< Percentage of CPU usage in the last period in kernel mode.
+   unsigned long int last_period_percent_cpu_usage_user_mode;  ///< Percentage of CPU usage in the last period in user mode.
+   uint64_t virtual_memory_size;  ///< in B
+   uint64_t resident_set_size;  ///< in kB
+   uint64_t major_faults;  ///< Number of major page faults
+   uint64_t voluntary_ctxt_switches;  ///< Sum of voluntary context switches of threads (including finished ones)
+   uint64_t nonvoluntary_ctxt_switches;  ///< Sum of involuntary context switches of threads (including finished ones)
+   uint64_t read_bytes;  ///< Bytes read from storage
+   uint64_t write_bytes;  ///< Bytes written to storage
+   uint32_t threads_cnt;  ///< Number of threads in threads array
+   module_thread_stats_t *threads;  ///< Copy of resources usage of threads
+   uint32_t total_in_ifces_cnt;  ///< Number of input interfaces in in_ifces_data
+   uint32_t total_out_ifces_cnt;  ///< Number of output interfaces in out_ifces_data
+   in_ifc_stats_t *in_ifces_data;  ///< Copy of statistics of input interfaces
+   out_ifc_stats_t *out_ifces_data;  ///< Copy of statistics of output interfaces
+} module_snapshot_t;
+
+/**
+ * Immutable copy of the state of all loaded modules published by service thread after every pass.
+ * Readers (daemon clients, netconf, statistics log) read it without any lock, the replaced snapshot
+ * is freed by service thread after all readers which could use it have finished.
+ * The snapshot is allocated as one block.
+ */
+typedef struct modules_snapshot_s {
+   module_snapshot_t *modules;  ///< Array of modules (size of modules_cnt)
+   unsigned int modules_cnt;  ///< Number of modules in the snapshot
+   uint64_t version;  ///< Incremented with every published snapshot
+} modules_snapshot_t;
+
+
 
 
+/**
+ * Serialized stats or info of modules shared by all clients which are sent the same reply.
+ * It is used only by the server thread, so the reference counter is not atomic.
+ */
+typedef struct shared_reply_s {
+   char *data; ///< JSON of modules (without trailing new line)
+   size_t len; ///< Length of data
+   unsigned int refcnt; ///< Number of references (cache and clients sending the reply)
+   unsigned int modules_cnt; ///< Number of modules in the reply
+   uint64_t version; ///< Version of the snapshot of modules the reply was created from
+} shared_reply_t;
+
 
 typedef struct sup_client_s {
    FILE *client_input_stream;
@@ -209,21 +394,73 @@ typedef struct sup_client_s {
    int client_sd;
    int client_connected;
    int client_id;
-   pthread_t client_thread_id;
+   int client_state; ///< DAEMON_CLIENT_READING_CODE, DAEMON_CLIENT_READING_HTTP, DAEMON_CLIENT_SENDING_REPLY, DAEMON_CLIENT_SUBSCRIBED or DAEMON_CLIENT_CONFIG_MODE
+   int client_http; ///< TRUE if the client is connected to metrics exporter
+   uint64_t client_deadline; ///< Monotonic time in ms the client is disconnected at if it does not send the code or receive the reply
+   char client_code[DAEMON_CLIENT_CODE_SIZE]; ///< Received part of the mode code (or HTTP request)
+   char **client_filter; ///< Names of modules a subscribed client wants to receive stats of (all modules if there is none)
+   unsigned int client_filter_cnt;
+   int client_delta; ///< TRUE if the subscribed client receives keyframes and deltas instead of full records
+   json_t *client_last_record; ///< Stats of modules sent to the client in the last record (base of the next delta)
+   uint64_t client_last_version; ///< Version of the last record sent to the client
+   unsigned int client_records_cnt; ///< Number of records sent to the client (every DAEMON_KEYFRAME_INTERVAL-th one is a keyframe)
+   size_t client_code_len;
+   char *client_reply; ///< Reply for the client owned by the client (filtered or delta record, warning)
+   shared_reply_t *client_shared_reply; ///< Reply for the client shared with other clients (stats or info in JSON)
+   int client_reply_newline; ///< TRUE if the shared reply is followed by a new line
+   size_t client_reply_len; ///< Length of the whole reply (0 ~ no reply), including the new line
+   size_t client_reply_sent; ///< Number of already sent bytes of the reply
+   struct sup_client_s *prev; ///< Previous client served by the server thread
+   struct sup_client_s *next; ///< Next client served by the server thread
 } sup_client_t;
 
 
 typedef struct server_internals_s {
-   sup_client_t **clients;
-   int clients_cnt;
+   sup_client_t *clients; ///< List of clients served by the server thread (clients in configuration mode have their own threads)
+   int clients_cnt; ///< Number of all connected clients
    int server_sd;
+   int epoll_fd; ///< Epoll instance of the server thread
+   int subscribers_event_fd; ///< Eventfd used by service thread to tell the server thread a new record for subscribers is available
+   atomic_int subscribers_cnt; ///< Number of subscribed clients (changed by the server thread, read also by the service thread)
+   uint64_t records_version; ///< Version of the last records sent to subscribed clients
+   shared_reply_t *cached_replies[DAEMON_REPLY_TYPES_CNT]; ///< Serialized replies (DAEMON_REPLY_*) created from the last requested snapshot
+   int metrics_sd; ///< Listening socket of metrics exporter (-1 if it is disabled)
    int daemon_terminated;
    uint16_t next_client_id;
    int config_mode_active;
-   pthread_mutex_t lock;
+   uint64_t accept_resume_time; ///< Monotonic time in ms accepting of clients is retried at (0 ~ accepting is not paused)
+   int accept_paused_clients_cnt; ///< Number of connected clients when accepting was paused, it is resumed once a client disconnects
+   pthread_mutex_t lock; ///< Protects the list and the number of clients and config_mode_active
 } server_internals_t;
 
 
+typedef struct name_index_item_s {
+   const char *name; ///< Name of the item (owned by the indexed structure, NULL ~ empty item).
+   int idx; ///< Index of the item (e.g. index of the module in running_modules).
+} name_index_item_t;
+
+typedef struct name_index_s {
+   name_index_item_t *items; ///< Open addressing table of items.
+   uint32_t size; ///< Number of allocated items (power of 2).
+   uint32_t cnt; ///< Number of used items.
+} name_index_t;
+
+typedef struct pid_index_item_s {
+   pid_t pid; ///< PID of the module process (0 ~ empty item).
+   int idx; ///< Index of the module in running_modules.
+} pid_index_item_t;
+
+typedef struct pid_index_s {
+   pid_index_item_t *items; ///< Open addressing table of items.
+   uint32_t size; ///< Number of allocated items (power of 2).
+} pid_index_t;
+
+typedef struct reload_module_hash_s {
+   xmlNodePtr module_elem; ///< Module element of the new configuration.
+   xmlChar *module_name; ///< Name of the module element (key in module_hashes_index, NULL if the element has no name).
+   uint64_t hash; ///< Hash of the module element subtree (see reload_hash_element()).
+} reload_module_hash_t;
+
 typedef struct reload_config_vars_s {
    xmlDocPtr doc_tree_ptr;
    xmlNodePtr root_node;
@@ -238,6 +475,10 @@ typedef struct reload_config_vars_s {
    int inserted_modules;
    int removed_modules;
    int modified_modules;
+   int unchanged_module; ///< TRUE if the current module element is the same as in the loaded configuration (only "enabled" is processed).
+   reload_module_hash_t *module_hashes; ///< Hashes of all module elements of the new configuration (computed without running_modules_lock).
+   uint32_t module_hashes_cnt; ///< Number of items in module_hashes.
+   name_index_t module_hashes_index; ///< Index of module_hashes by module name (see reload_get_module_hash()).
 } reload_config_vars_t;
 
 union tcpip_socket_addr {
@@ -245,10 +486,6 @@ union tcpip_socket_addr {
    struct sockaddr_un unix_addr; ///< used for path of UNIX socket
 };
 
-typedef struct service_msg_header_s {
-   uint8_t com;
-   uint32_t data_size;
-} service_msg_header_t;
 
 /***********FUNCTIONS***********/
 
@@ -268,6 +505,56 @@ void create_shutdown_info(char **backup_file_path);
 void print_xmlDoc_to_stream(xmlDocPtr doc_ptr, FILE *stream);
 char *get_formatted_time();
 
+/**
+ * Returns current time of CLOCK_MONOTONIC clock in milliseconds (used for deadlines of service thread).
+ */
+uint64_t get_monotonic_time_ms();
+
+/**
+ * Parses value of "stats-interval" element from the configuration file.
+ *
+ * @param[in] value String with a number of milliseconds or "adaptive".
+ * @param[out] interval In case of success it contains the interval in ms or STATS_INTERVAL_ADAPTIVE.
+ * @return Returns 0 if success, otherwise -1.
+ */
+int parse_stats_interval(const char *value, int *interval);
+
+/**
+ * Parses value of "memory-max" element from the configuration file.
+ *
+ * @param[in] value String with a number of bytes with optional suffix K, M or G, or "max".
+ * @param[out] size In case of success it contains the size in bytes (0 ~ "max").
+ * @return Returns 0 if success, otherwise -1.
+ */
+int parse_memory_size(const char *value, uint64_t *size);
+
+/**
+ * Parses value of "cpu-max" element from the configuration file.
+ *
+ * @param[in] value String with a percent of one CPU (e.g. 150 ~ one and a half CPU), or "max".
+ * @param[out] percent In case of success it contains the percent (0 ~ "max").
+ * @return Returns 0 if success, otherwise -1.
+ */
+int parse_cpu_max(const char *value, int *percent);
+
+/**
+ * Parses list of CPUs, e.g. value of "cpu-affinity" element from the configuration file or a list from sysfs.
+ *
+ * @param[in] value String with CPU numbers and ranges separated by commas (e.g. "0-3,8").
+ * @param[out] set In case of success it contains the listed CPUs.
+ * @return Returns 0 if success, otherwise -1 (also for an empty list).
+ */
+int parse_cpu_list(const char *value, cpu_set_t *set);
+
+/**
+ * Parses value of "numa-node" element from the configuration file.
+ *
+ * @param[in] value String with a number of NUMA node or "auto".
+ * @param[out] node In case of success it contains the node or NUMA_NODE_AUTO.
+ * @return Returns 0 if success, otherwise -1.
+ */
+int parse_numa_node(const char *value, int *node);
+
 /**
  * Parsing function for modules "params" element from the configuration file
  * that it is used by prepare_module_args() function.
@@ -292,7 +579,7 @@ char *get_formatted_time();
 char **parse_module_params(const uint32_t module_idx, uint32_t *params_num);
 
 /**
- * Function prepares an array of strings which is passed to execvp() function by service_start_module() function.
+ * Function prepares an array of strings which is passed to execve() function by launcher_child() function.
  * The array contains all needed arguments for the module binary. If the module has trap interfaces, "-i" arg is added
  * and interfaces specifier is generated (e.g. "t:1234,u:sock,s:service_sock"). If the module has a non-empty
  * "params", parse_module_params() function is used to add all module parameters.
@@ -312,6 +599,7 @@ char *get_param_by_delimiter(const char *source, char **dest, const char delimit
 void print_statistics();
 void print_statistics_legend();
 char *make_formated_statistics(uint8_t stats_mask);
+json_t *make_json_modules_object(uint8_t info_mask, uint64_t *version);
 int find_loaded_module(char *name);
 void generate_backup_config_file();
 /**@}*/
@@ -355,6 +643,44 @@ void reload_count_module_interfaces(reload_config_vars_t **config_vars);
 void reload_check_module_allocated_interfaces(const int running_module_idx, const int ifc_cnt);
 void check_running_modules_allocated_memory();
 void reload_resolve_module_enabled(reload_config_vars_t **config_vars);
+
+/**
+ * Computes FNV-1a hash of the element subtree (names of elements and their non-blank text).
+ * Formatting of the configuration file and comments do not change the hash.
+ */
+uint64_t reload_hash_element(const xmlNodePtr elem, uint64_t hash);
+
+/**
+ * Returns name of the module element (allocated, it has to be freed by xmlFree()) or NULL if it has no name element.
+ */
+xmlChar *reload_get_module_elem_name(const reload_config_vars_t *config_vars, const xmlNodePtr module_elem);
+
+/**
+ * Computes hashes of all module elements of the new configuration, it does not access running_modules.
+ */
+void reload_hash_module_elements(reload_config_vars_t *config_vars);
+
+/**
+ * Returns hash of the module element computed by reload_hash_module_elements() (0 if it is not found).
+ * The hash is found by name of the module in module_hashes_index, so reload of n modules is O(n).
+ */
+uint64_t reload_get_module_hash(const reload_config_vars_t *config_vars, const xmlNodePtr module_elem);
+
+/**
+ * Frees hashes of module elements and their index.
+ */
+void reload_free_module_hashes(reload_config_vars_t *config_vars);
+
+/**
+ * Resets values of the module loaded from its module element before the changed element is processed again.
+ */
+void reload_reset_module_config(const int module_idx);
+
+/**
+ * Loads the configuration and applies the differences to loaded modules. The configuration file is generated, parsed,
+ * validated and hashed without running_modules_lock. Modules whose module element has the same hash as in the loaded
+ * configuration are not processed again (only their "enabled" element is).
+ */
 int reload_configuration(const int choice, xmlNodePtr *node);
 /**@}*/
 
@@ -520,6 +846,15 @@ void interactive_print_brief_status();
  * (package version, git version, startup date, config file path, logs directory path etc.)
  */
 void interactive_print_supervisor_info();
+
+/**
+ * Reads numbers of modules selected by user. It must be called with running_modules_lock locked,
+ * the lock is released while waiting for the user input and locked again before return.
+ *
+ * @param[out] array Allocated array with selected numbers.
+ * @return Number of selected numbers or RET_ERROR (-1) in case of wrong input or change of loaded configuration in the meantime.
+ */
+int interactive_read_user_selection(int **array);
 /**@}*/
 
 
@@ -542,12 +877,31 @@ int service_check_modules_status();
 
 /**
  * Function starts stopped modules which are enabled (they should run).
- * Part of this function is also restart limit checking of every module which is being stared.
+ * Modules enabled by user or by reload are started immediately, exited modules are restarted
+ * with exponential backoff (see service_schedule_restart()).
  */
 void service_update_modules_status();
 
 /**
- * Creates a new process and executes modules binary with all needed parameters.
+ * Computes delay of the next restart of a module: RESTART_BACKOFF_MIN_MS doubled with every consecutive
+ * failure up to restart-backoff-max, with random jitter (the delay is from <delay/2, delay>).
+ *
+ * @param[in] failures Number of consecutive failures of the module (at least 1).
+ * @return Returns the delay in ms.
+ */
+uint64_t service_restart_backoff(uint32_t failures);
+
+/**
+ * Schedules the restart of an exited module. If the module exceeded its number of consecutive restarts
+ * (module-restarts), it is started after restart-cooldown, or disabled if the cool-down is 0.
+ *
+ * @param[in] module_idx Index to array of modules (array of structures).
+ * @return Returns 0 if the restart is scheduled, -1 if the module was disabled.
+ */
+int service_schedule_restart(const int module_idx);
+
+/**
+ * Creates a new process and executes modules binary with all needed parameters (see launcher functions).
  * It also redirects stdout and stderr of the new process.
  *
  * @param[in] module_idx Index to array of modules (array of structures).
@@ -555,18 +909,46 @@ void service_update_modules_status();
 void service_start_module(const int module_idx);
 
 /**
- * Function cleans up after finished children processes of stopped modules.
+ * Function cleans up after finished children processes of stopped modules which are not tracked by pidfd.
  */
 void service_clean_after_children();
 
+/**
+ * Opens pidfd of the module process and adds it to the service thread event loop, so the exit of the module
+ * is reported immediately (without polling by kill -0). If pidfd_open() is not supported, the module is tracked
+ * by service_check_modules_status() and service_clean_after_children().
+ *
+ * @param[in] module_idx Index to array of modules (array of structures).
+ */
+void service_track_module_exit(const int module_idx);
+
+/**
+ * Reaps exited module process using wait4() (if it is a child of supervisor) and handles its exit.
+ *
+ * @param[in] module_idx Index to array of modules (array of structures).
+ */
+void service_reap_module(const int module_idx);
+
+/**
+ * Logs the exit of the module (exit status or signal and resource usage if known), saves them to modules structure
+ * and resets modules variables (status, PID, pidfd, service interface connection).
+ *
+ * @param[in] module_idx Index to array of modules (array of structures).
+ * @param[in] status Status of the exited process returned by wait4(), -1 if it is unknown.
+ * @param[in] usage Resource usage of the exited process, NULL if it is unknown.
+ */
+void service_handle_module_exit(const int module_idx, const int status, const struct rusage *usage);
+
 /**
  * Function tries to stop running modules which are disabled using SIGINT signal.
+ * The module has its stop-timeout to finish (e.g. to flush its state), the service thread does not wait for it.
  */
 void service_stop_modules_sigint();
 
 /**
  * Function stops running modules which are disabled using SIGKILL signal.
- * Used only if the module does not responds to SIGINT signal.
+ * Used only if the module does not responds to SIGINT signal until its deadline (module_sigkill_deadline),
+ * SIGKILL is sent only once.
  */
 void service_stop_modules_sigkill();
 
@@ -577,6 +959,12 @@ void service_stop_modules_sigkill();
  */
 void service_check_connections();
 
+/**
+ * Function tries to connect to service interface of recently started modules every STARTUP_PROBE_INTERVAL_MS,
+ * until the module is connected (ready) or its ready deadline expires.
+ */
+void service_probe_started_modules();
+
 /**
  * Connects to service interface of the specified module.
  * It also checks number of connection attempts and if the limit is reached, connection is blocked.
@@ -593,14 +981,49 @@ void service_connect_to_module(const int module_idx);
 void service_disconnect_from_module(const int module_idx);
 
 /**
- * Function receives the data from a service interface of the specified module and saves it to the output parameter data.
+ * Sends a request for statistics to a service interface of the specified module. The reply is received
+ * asynchronously by service_recv_module_reply() and it has to arrive in SERVICE_REPLY_TIMEOUT_MS.
  *
  * @param[in] module_idx Index to array of modules (array of structures).
- * @param[in] size Number of bytes to receive.
- * @param[out] data Already allocated memory used for saving the data.
  * @return Returns 0 if success, otherwise -1.
  */
-int service_recv_data(int module_idx, uint32_t size, void **data);
+int service_request_module_stats(const int module_idx);
+
+/**
+ * Function receives all available data of the pending reply from a service interface of the specified module
+ * (without blocking) into the modules reassembly buffer. When the whole reply is received, the statistics are decoded.
+ * In case of an error, the connection with the module is closed.
+ *
+ * @param[in] module_idx Index to array of modules (array of structures).
+ */
+void service_recv_module_reply(const int module_idx);
+
+/**
+ * Closes connections with modules which did not send the whole reply until their deadline.
+ */
+void service_check_reply_timeouts();
+
+/**
+ * Returns the interval of requesting stats from the specified module - the value of its "stats-interval" element,
+ * the global value from "supervisor" element or (in adaptive mode) the interval adapted to the module traffic.
+ *
+ * @param[in] module_idx Index to array of modules (array of structures).
+ * @return Interval in milliseconds.
+ */
+uint32_t service_get_stats_interval(const int module_idx);
+
+/**
+ * Called after the stats of the module were decoded. In adaptive mode it shortens the interval of modules
+ * with high traffic (at least ADAPTIVE_STATS_BUSY_RATE messages per second) and prolongs the interval of idle modules.
+ *
+ * @param[in] module_idx Index to array of modules (array of structures).
+ */
+void service_adapt_stats_interval(const int module_idx);
+
+/**
+ * Sends stats requests to all connected modules whose stats interval elapsed.
+ */
+void service_request_stats();
 
 /**
  * Function sends the data to a service interface of the specified module.
@@ -613,122 +1036,1089 @@ int service_recv_data(int module_idx, uint32_t size, void **data);
 int service_send_data(int module_idx, uint32_t size, void **data);
 
 /**
- * Service thread routine is periodically checking and updating modules status
- * and connection with the modules. It also receives statistics from modules service interface.
+ * Creates the event loop of service thread - epoll instance with a timerfd (end of every period),
+ * an eventfd (see service_wakeup()) and a signalfd receiving SIGCHLD. SIGCHLD is blocked in the calling thread,
+ * so the function has to be called before any other supervisor thread is created.
+ *
+ * @return Returns 0 if success, otherwise -1.
+ */
+int service_init_event_loop();
+
+/**
+ * Closes all file descriptors of the service thread event loop.
+ */
+void service_free_event_loop();
+
+/**
+ * Adds a file descriptor to the epoll instance of service thread.
+ *
+ * @param[in] fd File descriptor to watch.
+ * @param[in] events Epoll events to watch (EPOLLIN, EPOLLRDHUP etc.).
+ * @return Returns 0 if success, otherwise -1.
+ */
+int service_watch_fd(int fd, uint32_t events);
+
+/**
+ * Wakes up service thread so it handles a change of modules (enabled flag, reload, termination)
+ * without waiting for the end of the period. It can be called from any thread.
+ */
+void service_wakeup();
+
+/**
+ * Computes how long service thread can sleep until the nearest deadline (stopped module or pending stats reply).
+ *
+ * @return Returns timeout in milliseconds for epoll_wait(), -1 if there is no deadline.
+ */
+int service_get_wait_timeout();
+
+/**
+ * Handles events returned by epoll_wait() in service thread - the end of the period, wake up requests,
+ * exited children and hang-ups of modules service interfaces.
+ *
+ * @param[in] events Array of events returned by epoll_wait().
+ * @param[in] events_cnt Number of events in the array.
+ * @param[out] period_elapsed Set to TRUE if the period of service thread elapsed.
+ */
+void service_process_events(struct epoll_event *events, int events_cnt, int *period_elapsed);
+
+/**
+ * Service thread routine is checking and updating modules status and connection with the modules.
+ * It sleeps in epoll_wait() and it is woken up at the end of every period (then it also receives statistics
+ * from modules service interface), when a module exits, when a service interface is closed, after a change
+ * made by user or reload, or when a deadline of stopped module expires.
  */
 void *service_thread_routine(void *arg __attribute__ ((unused)));
 
 /**
  * Function decodes the data in JSON format and saves the statistics to specified modules structure.
+ * The data are parsed in place without building a JSON tree, memory is allocated only for changed ifc_id.
  *
- * @param[in] data Memory with the data in JSON format.
+ * @param[in] data Memory with the data in JSON format (null-terminated, it is modified by unescaping of strings).
  * @param[in] module_idx Index to array of modules (array of structures).
  * @return Returns 0 if success, otherwise -1.
  */
 int service_decode_module_stats(char **data, int module_idx);
-/**@}*/
 
+/**
+ * Reallocates arrays with interfaces stats of the module if the number of its interfaces has changed.
+ *
+ * @param[in] module_idx Index to array of modules (array of structures).
+ * @param[in] in_cnt Number of input interfaces.
+ * @param[in] out_cnt Number of output interfaces.
+ * @return Returns 0 if success, otherwise -1.
+ */
+int service_set_ifces_cnt(int module_idx, uint32_t in_cnt, uint32_t out_cnt);
 
+/**
+ * Skips JSON whitespace.
+ *
+ * @param[in] pos Position in the data.
+ * @return Returns position of the first non-whitespace character.
+ */
+char *stats_json_skip_ws(char *pos);
 
 /**
- * \defgroup GROUP_NAME short_description
+ * Skips whitespace and the expected character.
  *
- * TODO group description.
- * @{
+ * @param[in,out] pos Position in the data, it is moved after the character.
+ * @param[in] c Expected character.
+ * @return Returns 0 if the character was found, otherwise -1.
  */
+int stats_json_expect(char **pos, char c);
 
 /**
+ * Finds a JSON string in the data, it is neither copied nor unescaped.
  *
+ * @param[in,out] pos Position in the data, it is moved after the closing quote.
+ * @param[out] str Pointer to the first character of the string in the data.
+ * @param[out] len Length of the string (without quotes).
+ * @param[out] escaped Set to TRUE if the string contains an escape sequence.
+ * @return Returns 0 if success, otherwise -1 (malformed or unterminated string).
  */
-int get_total_cpu_usage(unsigned long int *total_cpu_usage);
-void update_modules_resources_usage();
-/**@}*/
+int stats_json_get_string(char **pos, char **str, size_t *len, int *escaped);
 
+/**
+ * Unescapes a string found by stats_json_get_string() in place.
+ *
+ * @param[in,out] str The string.
+ * @param[in,out] len Length of the string, it is updated to the length after unescaping.
+ * @return Returns 0 if success, otherwise -1 (truncated \u sequence).
+ */
+int stats_json_unescape(char *str, size_t *len);
 
+/**
+ * Parses a JSON integer.
+ *
+ * @param[in,out] pos Position in the data, it is moved after the number.
+ * @param[out] value Parsed value.
+ * @return Returns 0 if success, otherwise -1 (not a number or out of range).
+ */
+int stats_json_get_integer(char **pos, long long *value);
 
 /**
- * \defgroup daemon_functions Supervisor daemon mode functions
+ * Skips any JSON value (used for unknown keys).
  *
- * Set of functions used by supervisor while running as a daemon process.
- * It behaves as a server and serves incoming supervisor clients and their requests.
- * The request can be: reloading configuration (reloading the configuration file),
- * receiving modules statistics (their interfaces counters) or changing configuration
- * (start / stop module, check modules status etc.).
+ * @param[in,out] pos Position in the data, it is moved after the value.
+ * @param[in] depth Current nesting, values nested deeper than STATS_JSON_MAX_DEPTH are rejected.
+ * @return Returns 0 if success, otherwise -1.
+ */
+int stats_json_skip_value(char **pos, int depth);
+
+/**
+ * Moves to the next member of a JSON object (the opening brace must be already consumed).
  *
- * @{
+ * @param[in,out] pos Position in the data, it is set to the value of the member or after the object.
+ * @param[out] key Pointer to the key in the data (not unescaped).
+ * @param[out] key_len Length of the key.
+ * @param[in,out] first TRUE before the first member, it is cleared by this function.
+ * @return Returns 1 if there is another member, 0 at the end of the object, -1 in case of malformed data.
  */
+int stats_json_next_member(char **pos, char **key, size_t *key_len, int *first);
 
 /**
- * Creates a new process and disconnects it from terminal (daemon process).
+ * Moves to the next element of a JSON array (the opening bracket must be already consumed).
+ *
+ * @param[in,out] pos Position in the data, it is set to the element or after the array.
+ * @param[in,out] first TRUE before the first element, it is cleared by this function.
+ * @return Returns 1 if there is another element, 0 at the end of the array, -1 in case of malformed data.
+ */
+int stats_json_next_element(char **pos, int *first);
+
+/**
+ * Compares a key found in the data with a name.
+ *
+ * @param[in] key Key in the data (not null-terminated).
+ * @param[in] key_len Length of the key.
+ * @param[in] name Null-terminated name.
+ * @return Returns TRUE if they are equal, otherwise FALSE.
+ */
+int stats_json_key_is(const char *key, size_t key_len, const char *name);
+
+/**
+ * Decodes one JSON object with counters of an interface and writes them to the interface structure.
  *
+ * @param[in,out] pos Position in the data.
+ * @param[in] fields Array of known keys terminated by the key NULL, all of them are required.
+ * @param[out] ifc Pointer to in_ifc_stats_t or out_ifc_stats_t.
  * @return Returns 0 if success, otherwise -1.
  */
-int daemon_init_process();
+int stats_json_decode_ifc(char **pos, const stats_json_field_t *fields, void *ifc);
 
 /**
- * Allocates needed structures and variables (clients array etc.)
+ * Saves ifc_id of an interface, the memory is reallocated only if it has changed.
  *
+ * @param[in,out] ifc_id Saved ifc_id of the interface.
+ * @param[in] str New ifc_id (not null-terminated).
+ * @param[in] len Length of the new ifc_id.
  * @return Returns 0 if success, otherwise -1.
  */
-int daemon_init_structures();
+int service_update_ifc_id(char **ifc_id, const char *str, size_t len);
 
 /**
- * Creates and binds a socket for incoming connections.
+ * Reads ifc_id (uint16 length and string) from binary stats and updates the saved one if it has changed.
  *
+ * @param[in,out] data Pointer to the current position in the data, it is moved after the ifc_id.
+ * @param[in] data_end End of the data.
+ * @param[in,out] ifc_id Saved ifc_id of the interface.
  * @return Returns 0 if success, otherwise -1.
  */
-int daemon_init_socket();
+int service_decode_ifc_id(const uint8_t **data, const uint8_t *data_end, char **ifc_id);
 
 /**
- * Function initializes daemon process, structures and socket using daemon_init_{process,structures,socket} functions.
+ * Function decodes the data in binary format (see SERVICE_OK_BIN_REPLY) and saves the statistics to specified modules structure.
  *
+ * @param[in] data Memory with the data in binary format.
+ * @param[in] data_size Size of the data.
+ * @param[in] module_idx Index to array of modules (array of structures).
  * @return Returns 0 if success, otherwise -1.
  */
-int daemon_mode_initialization();
+int service_decode_module_stats_bin(const char *data, uint32_t data_size, int module_idx);
+/**@}*/
+
+
 
 /**
- * Server routine for daemon process (acceptor thread).
- * It accepts a new incoming connection and starts a serving thread (if there is a space for another client).
+ * \defgroup GROUP_NAME short_description
+ *
+ * TODO group description.
+ * @{
  */
-void daemon_mode_server_routine();
 
 /**
- * Tries to receive initial data from a new client and reads a mode code.
+ * Reads the whole content of an opened file in /proc from its beginning (using pread()).
  *
- * @param[in] cli Structure with clients private data.
- * @return If success, it returns mode code (client wants to configure, reload configuration or receive stats about modules).
- * Otherwise it returns negative value (-3 timeout, -2 client disconnection, -1 another error).
+ * @param[in] fd Descriptor of the file.
+ * @param[out] buffer Buffer for the content, it is null-terminated.
+ * @param[in] buffer_size Size of the buffer.
+ * @return Returns 0 if success, otherwise -1.
  */
-int daemon_get_code_from_client(sup_client_t **cli);
+int proc_read_file(int fd, char *buffer, size_t buffer_size);
 
 /**
- * Function sends options to a client during configuration mode (a menu with options the client can choose from - start or stop module etc.).
+ * Reads a file in /proc/PID/task/TID of a module thread. If the descriptor of the file is not kept opened (fd is -1),
+ * the file is opened just for this read.
+ *
+ * @param[in] module_idx Index to array of modules (array of structures).
+ * @param[in] thread The thread.
+ * @param[in] fd Opened descriptor of the file or -1.
+ * @param[in] file Name of the file in the task directory ("stat" or "status").
+ * @param[out] buffer Buffer for the content, it is null-terminated.
+ * @param[in] buffer_size Size of the buffer.
+ * @return Returns 0 if success, otherwise -1.
  */
-void daemon_send_options_to_client();
+int proc_read_thread_file(const int module_idx, const module_thread_stats_t *thread, const int fd, const char *file, char *buffer, size_t buffer_size);
 
 /**
- * Function opens input and output streams for a new client.
+ * Skips given number of fields separated by spaces.
+ *
+ * @return Pointer to the beginning of the next field.
+ */
+char *proc_skip_fields(char *pos, int cnt);
+
+/**
+ * Reads a decimal number and moves the position after it.
+ *
+ * @return Returns 0 if success, -1 if there is no number at the position.
+ */
+int proc_get_number(char **pos, unsigned long int *num);
+
+/**
+ * Finds the key in the content of a /proc file and reads the number following it.
  *
- * @param[in] cli Structure with clients private data.
  * @return Returns 0 if success, otherwise -1.
  */
-int daemon_open_client_streams(sup_client_t **cli);
+int proc_find_value(char *buffer, const char *key, unsigned long int *num);
 
 /**
- * Function disconnects a client and makes needed clean up (closing streams etc.).
+ * Gets the sum of times spent by all CPUs in all modes from the first line of /proc/stat (its descriptor stays opened).
+ */
+int get_total_cpu_usage(unsigned long int *total_cpu_usage);
+
+/**
+ * Opens /proc/PID/stat and /proc/PID/statm of the module if they are not opened for its current process.
+ */
+int open_module_proc_fds(const int module_idx);
+void close_module_proc_fds(const int module_idx);
+
+/**
+ * Functions maintaining resources usage of threads of a module. Descriptors of /proc/PID/task/TID files
+ * are kept opened until the thread finishes, at most PROC_THREADS_OPEN_FDS_MAX of them for all modules.
+ */
+module_thread_stats_t *add_module_thread(const int module_idx, pid_t tid);
+void remove_module_thread(const int module_idx, const uint32_t thread_idx);
+void update_module_threads_usage(const int module_idx, const unsigned long int diff_total_cpu);
+
+/**
+ * Updates CPU usage, memory usage, I/O counters, page faults and resources usage of threads of running modules.
+ */
+void update_modules_resources_usage();
+/**@}*/
+
+
+
+/**
+ * \defgroup registry_functions Module registry functions
  *
- * @param[in] cli Structure with clients private data.
+ * Hash indexes of loaded modules by name and by PID of their processes and of names in the validated configuration.
+ * The name index is updated when a module is inserted by reload and rebuilt when modules are shifted after removal
+ * of a module. The PID index is rebuilt when it does not know the looked up PID.
+ * Every module has a handle, a number which does not change when other modules are removed and which is never
+ * assigned to another module, so clients can identify the module in the info and stats output across reloads.
+ * The handle is only an identifier in the output, modules are addressed by name or index.
+ * @{
  */
-void daemon_disconnect_client(sup_client_t *cli);
 
 /**
- * Daemons routine for serving new incoming clients (every client gets a thread doing this routine).
- * This routine opens clients streams, receives a mode code from the client and according to the the received mode code
- * it performs required operations.
+ * FNV-1a hash of the name.
+ */
+uint32_t name_index_hash(const char *name);
+
+/**
+ * Moves items of the index to a new table with the given size (power of 2).
  *
- * @param[in] cli Structure with clients private data.
+ * @return Returns 0 if success, otherwise -1 (the index is not changed).
  */
-void *daemon_serve_client_routine (void *cli);
+int name_index_resize(name_index_t *index, const uint32_t size);
+
+/**
+ * Inserts the name to the index (or updates its index if the name is already there). The name is not copied.
+ *
+ * @return Returns 0 if success, otherwise -1.
+ */
+int name_index_insert(name_index_t *index, const char *name, const int idx);
+
+/**
+ * @return Returns index of the item with the name, -1 if it is not found.
+ */
+int name_index_find(const name_index_t *index, const char *name);
+
+/**
+ * Frees the table of the index (names are not freed).
+ */
+void name_index_free(name_index_t *index);
+
+/**
+ * Inserts the loaded module to the index of names.
+ */
+void registry_add_module(const int module_idx);
+
+/**
+ * Rebuilds the index of names of loaded modules (after indexes of modules changed).
+ */
+void registry_rebuild_modules();
+
+/**
+ * Rebuilds the index of PIDs of modules (including previous instances of hot restarted modules).
+ */
+void registry_rebuild_pids();
+
+/**
+ * Assigns a new handle to the module inserted by reload.
+ */
+void registry_assign_handle(const int module_idx);
+
+/**
+ * Clears the handle of the removed module, the handle is not assigned again.
+ */
+void registry_release_handle(const int module_idx);
+
+/**
+ * Finds the module by PID of its process or of its previous instance during hot restart.
+ *
+ * @return Returns index of the module, -1 if no module has the PID.
+ */
+int find_module_by_pid(const pid_t pid);
+/**@}*/
+
+
+
+/**
+ * \defgroup cgroup_functions Cgroup functions
+ *
+ * Modules are started in their own cgroup v2 leaf under a subtree owned by supervisor (if cgroup v2 is
+ * available). CPU, memory and I/O usage of a module is then read from its cgroup and it includes all
+ * child processes of the module. The cgroup also enforces optional cpu-max and memory-max limits.
+ * @{
+ */
+
+/**
+ * Writes the value to a file in cgroup directory.
+ *
+ * @return Returns 0 if success, otherwise -1.
+ */
+int cgroup_write_file(const char *dir, const char *file, const char *value);
+
+/**
+ * Creates supervisor subtree in cgroup v2 hierarchy and enables cpu, memory and io controllers in it.
+ * If supervisor is not in the root cgroup, it moves itself to a leaf "supervisor" of its cgroup.
+ */
+void cgroup_init();
+
+/**
+ * Builds the path of the module cgroup, the name of the module is escaped so it is one directory unique for the module.
+ *
+ * @return Returns allocated path or NULL if there is not enough memory.
+ */
+char *cgroup_module_path(const char *module_name);
+
+/**
+ * Opens a file in the module cgroup.
+ *
+ * @return Returns the descriptor if success, -1 if it can not be opened or the path is too long.
+ */
+int cgroup_open_module_file(const int module_idx, const char *file, const int flags);
+
+/**
+ * Creates the cgroup of the module (if needed), applies its limits and opens its statistics files.
+ *
+ * @return Returns 0 if success, -1 if the module is not started in a cgroup.
+ */
+int cgroup_prepare_module(const int module_idx);
+
+/**
+ * Opens cgroup.procs of the module cgroup, the module process enters the cgroup by writing "0" to it.
+ *
+ * @return Returns the descriptor if success, -1 if the module is not started in a cgroup.
+ */
+int cgroup_open_module_procs(const int module_idx);
+
+/**
+ * Writes cpu-max and memory-max of the module to its cgroup.
+ */
+void cgroup_apply_module_limits(const int module_idx);
+
+void cgroup_close_module_fds(const int module_idx);
+
+/**
+ * Closes statistics files of the module cgroup and removes the cgroup (if there are no processes).
+ */
+void cgroup_remove_module(const int module_idx);
+
+/**
+ * Updates CPU usage, memory usage and I/O counters of the module from its cgroup.
+ *
+ * @param[in] module_idx Index to array of modules (array of structures).
+ * @param[in] diff_total_cpu CPU time of all CPUs in the last period (clock ticks).
+ * @return Returns 0 if success, -1 if the module is not in a cgroup or its statistics could not be read.
+ */
+int cgroup_update_module_usage(const int module_idx, const unsigned long int diff_total_cpu);
+/**@}*/
+
+
+
+/**
+ * \defgroup placement_functions Placement functions
+ *
+ * Modules can be bound to a list of CPUs ("cpu-affinity" element) and to a NUMA node ("numa-node" element).
+ * A module on a NUMA node runs on the CPUs of the node and its memory is preferably allocated there.
+ * With "numa-node" set to "auto", modules connected by unix socket interfaces are placed on the same node,
+ * so the data they exchange stays in memory of one node.
+ * @{
+ */
+
+/**
+ * Reads a list of CPUs or NUMA nodes from a file in sysfs.
+ *
+ * @return Returns 0 if success, otherwise -1.
+ */
+int placement_read_sysfs_list(const char *path, cpu_set_t *set);
+
+/**
+ * Detects online NUMA nodes (only once).
+ */
+void placement_init_numa();
+
+/**
+ * Checks whether the output interface and the input interface are connected by the same unix socket.
+ */
+int placement_unixsocket_connects(const interface_t *out_ifc, const interface_t *in_ifc);
+
+/**
+ * Checks whether the modules are connected by a unix socket interface (in any direction).
+ */
+int placement_modules_connected(const int module_idx1, const int module_idx2);
+
+int placement_find_group(int *groups, int module_idx);
+
+/**
+ * Resolves NUMA nodes of all loaded modules. Modules with a fixed node are placed on it, groups of modules
+ * connected by unix sockets with automatic placement are placed on the node of a module with fixed node
+ * in the group, or on the node with the least number of enabled modules.
+ */
+void placement_assign_numa_nodes();
+
+/**
+ * Computes CPUs the module should run on (cpu-affinity restricted to CPUs of its NUMA node).
+ *
+ * @param[in] module_idx Index to array of modules (array of structures).
+ * @param[out] cpus In case of success it contains CPUs of the module.
+ * @return Returns 0 if success, -1 if the module is not placed.
+ */
+int placement_get_module_cpus(const int module_idx, cpu_set_t *cpus);
+
+/**
+ * Sets CPU affinity and memory policy of the calling process (called by the module process before execve()).
+ *
+ * @param[in] cpus CPUs of the module or NULL if the affinity is not changed.
+ * @param[in] numa_node Preferred NUMA node of memory of the module or -1 if the policy is not changed.
+ */
+void placement_enter_module(const cpu_set_t *cpus, const int numa_node);
+
+/**
+ * Sets CPU affinity of all threads of the running module after reload of the configuration.
+ * Memory policy and removed placement take effect after restart of the module.
+ */
+void placement_apply_running_module(const int module_idx);
+/**@}*/
+
+
+
+/**
+ * \defgroup launcher_functions Module launcher functions
+ *
+ * Modules are started by clone(CLONE_VM | CLONE_VFORK), page tables of supervisor are not copied and the calling
+ * thread is suspended until the module process executes the binary. Arguments, paths, log files and the placement
+ * of the module are prepared in supervisor, the module process only uses system calls (no memory allocation, which
+ * could deadlock after fork of a multithreaded process).
+ * @{
+ */
+
+/**
+ * Writes the message to stderr of the module process (used before execve()).
+ */
+void launcher_child_error(const char *msg);
+
+/**
+ * Function executed by the module process: it enters the cgroup, redirects stdout and stderr, sets the placement,
+ * resets signal handlers and mask and executes the module binary.
+ *
+ * @param[in] arg Pointer to module_launch_t prepared by launcher_prepare().
+ */
+int launcher_child(void *arg);
+
+/**
+ * Opens the log file of the module (the descriptor is never 0, 1 or 2).
+ *
+ * @return Returns the descriptor if success, otherwise -1.
+ */
+int launcher_open_log(const char *path);
+
+/**
+ * Finds the binary in directories of PATH variable (if the name does not contain '/').
+ *
+ * @param[in] name Path of the module binary from the configuration file.
+ * @return Returns allocated resolved path or NULL if there is not enough memory.
+ */
+char *launcher_resolve_path(const char *name);
+
+/**
+ * Prepares arguments, log files, cgroup and placement of the module and writes the start header to the logs.
+ *
+ * @param[in] module_idx Index to array of modules (array of structures).
+ * @param[out] launch Structure filled for launcher_spawn() (it has to be freed by launcher_cleanup() if success).
+ * @return Returns 0 if success, otherwise -1.
+ */
+int launcher_prepare(const int module_idx, module_launch_t *launch, const char *log_path_stdout, const char *log_path_stderr);
+
+/**
+ * Prepares listening sockets held for the module and the environment with LISTEN_PID, LISTEN_FDS and LISTEN_FDNAMES
+ * variables. The module process moves the sockets to descriptors from LISTEN_FDS_START and fills in LISTEN_PID.
+ *
+ * @return Returns 0 if success, otherwise -1.
+ */
+int launcher_prepare_listen_fds(const int module_idx, module_launch_t *launch);
+
+/**
+ * Creates the module process. It returns after the process executed the binary or failed (see exec_errno).
+ *
+ * @return Returns PID of the module process if success, otherwise -1.
+ */
+pid_t launcher_spawn(module_launch_t *launch);
+
+/**
+ * Frees arguments and closes descriptors of the prepared launch.
+ */
+void launcher_cleanup(module_launch_t *launch);
+/**@}*/
+
+
+
+/**
+ * \defgroup dataflow_functions Dataflow functions
+ *
+ * Supervisor derives a dataflow graph of loaded modules from their interfaces in the configuration
+ * (output interface -> input interface with the same TCP port on localhost or the same unix socket).
+ * Modules are started in topological waves: all modules of a wave are started in one pass of the service
+ * thread and a module is started once its producers are ready (connected to supervisor via service interface).
+ * @{
+ */
+
+/**
+ * Checks whether the input interface connects to the TCP port of the output interface on this machine.
+ */
+int dataflow_tcp_connects(const interface_t *out_ifc, const interface_t *in_ifc);
+
+/**
+ * Checks whether an output interface of the producer is connected to an input interface of the consumer.
+ */
+int dataflow_modules_connected(const int producer_idx, const int consumer_idx);
+
+/**
+ * Builds the dataflow graph and startup waves of loaded modules if the configuration changed (see modules_config_generation).
+ * Modules forming a cycle are started in the last wave without waiting for each other.
+ */
+void dataflow_update_graph();
+
+/**
+ * Checks whether all producers of the module that are going to run are ready.
+ *
+ * @param[in] module_idx Index to array of modules (array of structures).
+ * @return Returns TRUE if the module can be started, otherwise FALSE.
+ */
+int dataflow_producers_ready(const int module_idx);
+/**@}*/
+
+
+
+/**
+ * \defgroup hot_restart_functions Hot restart functions
+ *
+ * Listening sockets of UNIXSOCKET and TCP output interfaces of modules with hot restart and listen-fds (the module
+ * takes the sockets from LISTEN_FDS instead of binding them itself) are created by supervisor
+ * and every instance of the module inherits them (LISTEN_FDS, LISTEN_FDNAMES and LISTEN_PID variables as in socket
+ * activation of systemd). After reload of the configuration, the new instance is started while the previous one
+ * keeps running and the previous one is stopped once the new one is ready, so the sockets are never closed.
+ * @{
+ */
+
+/**
+ * Creates a listening socket of the output interface.
+ *
+ * @param[in] ifc_type UNIXSOCKET_MODULE_IFC_TYPE or TCP_MODULE_IFC_TYPE.
+ * @param[in] name Name of the unix socket or TCP port.
+ * @return Descriptor of the socket or -1 on error.
+ */
+int hot_restart_open_socket(const int ifc_type, const char *name);
+
+/**
+ * Closes listening sockets held for the module (and removes files of its unix sockets).
+ */
+void hot_restart_close_sockets(const int module_idx);
+
+/**
+ * Updates listening sockets held for the module according to its output interfaces before the module is started.
+ * Sockets of unchanged interfaces are kept, so the new instance inherits the same sockets as the previous one.
+ * Modules without hot restart or listen-fds own their sockets, nothing is held for them.
+ */
+void hot_restart_update_sockets(const int module_idx);
+
+/**
+ * Starts a new instance of the module modified by reload, the running instance becomes the previous one
+ * and it is stopped by hot_restart_stop_retiring_modules().
+ */
+void hot_restart_module(const int module_idx);
+
+/**
+ * Reaps the previous instance of the module if it has finished.
+ */
+void hot_restart_reap_retiring_module(const int module_idx);
+
+/**
+ * Sends SIGINT to previous instances of modules whose new instances are ready (or gave up waiting)
+ * and SIGKILL to those which did not finish until their stop-timeout.
+ */
+void hot_restart_stop_retiring_modules();
+/**@}*/
+
+
+
+/**
+ * \defgroup snapshot_functions Modules snapshot functions
+ *
+ * Service thread publishes a snapshot of modules state after every pass, so readers of
+ * statistics do not have to wait for running_modules_lock (and the service thread).
+ * The snapshot pointer is swapped atomically and the replaced snapshot is reclaimed once
+ * the readers counted in the epoch it was published in have released it.
+ * @{
+ */
+
+/**
+ * Creates a snapshot of the current state of loaded modules. It must be called with running_modules_lock locked.
+ *
+ * @return Pointer to the new snapshot or NULL in case of allocation error.
+ */
+modules_snapshot_t *modules_snapshot_create();
+
+/**
+ * Frees the retired snapshot if no reader can use it anymore (called only by service thread).
+ *
+ * @return TRUE if there is no retired snapshot anymore, otherwise FALSE.
+ */
+int modules_snapshot_reclaim();
+
+/**
+ * Creates a new snapshot and replaces the published one. If readers of the previously replaced
+ * snapshot have not finished yet, publication is postponed to the next call.
+ */
+void modules_snapshot_publish();
+
+/**
+ * Gets version of the latest published snapshot (used to check validity of data created from a snapshot).
+ *
+ * @return Version of the snapshot or 0 if there is no snapshot published yet.
+ */
+uint64_t modules_snapshot_get_version();
+
+/**
+ * Gets the latest published snapshot without any lock. Every acquire must be followed by
+ * modules_snapshot_release() (even if NULL was returned).
+ *
+ * @param[out] reader_parity Parity of the epoch the reader entered in, it must be passed to modules_snapshot_release().
+ * @return Pointer to the snapshot or NULL if there is no snapshot published yet.
+ */
+modules_snapshot_t *modules_snapshot_acquire(unsigned int *reader_parity);
+
+/**
+ * Ends reading of the acquired snapshot.
+ *
+ * @param[in] reader_parity Parity returned by modules_snapshot_acquire().
+ */
+void modules_snapshot_release(unsigned int reader_parity);
+
+/**
+ * Drops the published snapshot (used during supervisor termination).
+ */
+void modules_snapshot_free();
+/**@}*/
+
+
+
+/**
+ * \defgroup daemon_functions Supervisor daemon mode functions
+ *
+ * Set of functions used by supervisor while running as a daemon process.
+ * It behaves as a server and serves incoming supervisor clients and their requests.
+ * The request can be: reloading configuration (reloading the configuration file),
+ * receiving modules statistics (their interfaces counters) or changing configuration
+ * (start / stop module, check modules status etc.).
+ *
+ * All clients are multiplexed by a single server thread using epoll and non-blocking sockets,
+ * only a client in configuration mode (interactive session) is served by its own thread.
+ *
+ * A client in subscribe mode stays connected and receives a record with stats (one line of JSON)
+ * after every period of service thread, optionally only for the modules it named after the mode code.
+ * In delta subscribe mode, the client receives a keyframe with all stats periodically and records
+ * with only the values changed since the previous record it received in between.
+ *
+ * @{
+ */
+
+/**
+ * Creates a new process and disconnects it from terminal (daemon process).
+ *
+ * @return Returns 0 if success, otherwise -1.
+ */
+int daemon_init_process();
+
+/**
+ * Allocates needed structures and variables (server internals, its lock etc.)
+ *
+ * @return Returns 0 if success, otherwise -1.
+ */
+int daemon_init_structures();
+
+/**
+ * Creates and binds a socket for incoming connections.
+ *
+ * @return Returns 0 if success, otherwise -1.
+ */
+int daemon_init_socket();
+
+/**
+ * Function initializes daemon process, structures and socket using daemon_init_{process,structures,socket} functions.
+ *
+ * @return Returns 0 if success, otherwise -1.
+ */
+int daemon_mode_initialization();
+
+/**
+ * Server routine for daemon process (server thread).
+ * It waits for events on the daemon socket and sockets of connected clients, accepts new clients,
+ * receives their mode codes, sends them replies and disconnects clients that do not respond in time.
+ */
+void daemon_mode_server_routine();
+
+/**
+ * Stops watching of listening sockets when a new client cannot be accepted for lack of file descriptors,
+ * otherwise the level-triggered sockets would wake up the server thread in a loop.
+ */
+void daemon_pause_accept();
+
+/**
+ * Watches listening sockets again after a client disconnected or DAEMON_ACCEPT_RETRY_MS elapsed since they were paused.
+ *
+ * @param[in] now Current monotonic time in ms.
+ */
+void daemon_resume_accept(const uint64_t now);
+
+/**
+ * Accepts all pending connections on a listening socket and registers new clients to the server's epoll instance.
+ * A new client is rejected if there are already MAX_NUMBER_SUP_CLIENTS connected clients.
+ *
+ * @param[in] listen_sd Daemon socket or listening socket of metrics exporter.
+ * @param[in] http TRUE if new clients are HTTP clients of metrics exporter.
+ */
+void daemon_accept_clients(const int listen_sd, const int http);
+
+/**
+ * Receives available data of the mode code from a client without blocking.
+ * Only the line with the code is consumed from the socket, the rest belongs to the configuration mode session.
+ *
+ * @param[in] cli Structure with clients private data.
+ * @return If the whole code was received, it returns the mode code (client wants to configure, reload configuration
+ * or receive stats about modules). It returns 0 if the code is not complete yet, otherwise negative value
+ * (-2 client disconnection, -1 another error).
+ */
+int daemon_get_code_from_client(sup_client_t *cli);
+
+/**
+ * Performs the operation requested by a mode code. Stats and info are sent by the server thread, configuration
+ * mode session is passed to a new thread and reload of the configuration is done by a new thread as well.
+ *
+ * @param[in] cli Structure with clients private data.
+ * @param[in] code Mode code received from the client.
+ */
+void daemon_serve_client_code(sup_client_t *cli, const int code);
+
+/**
+ * Starts sending a reply to a client, the rest of the reply is sent when the socket becomes writable.
+ * The client is disconnected after the whole reply is sent or in case of error.
+ *
+ * @param[in] cli Structure with clients private data.
+ * @param[in] reply Reply owned by the client, or NULL if shared reply is sent.
+ * @param[in] shared_reply Shared reply (the client takes the reference), or NULL.
+ * @param[in] newline TRUE if the shared reply is followed by a new line.
+ */
+void daemon_start_reply(sup_client_t *cli, char *reply, shared_reply_t *shared_reply, const int newline);
+
+/**
+ * Returns serialized stats, info or metrics of modules from the current snapshot. The reply is serialized only once
+ * for every published snapshot and it is shared by all clients until a new snapshot is published.
+ *
+ * @param[in] reply_type DAEMON_REPLY_STATS (running modules), DAEMON_REPLY_INFO (all modules with details)
+ * or DAEMON_REPLY_METRICS (HTTP response of metrics exporter).
+ * @return New reference to the reply (see daemon_release_shared_reply()), NULL in case of error.
+ */
+shared_reply_t *daemon_get_shared_reply(const int reply_type);
+
+/**
+ * Releases a reference to a shared reply, the reply is freed with the last reference.
+ *
+ * @param[in] reply Shared reply.
+ */
+void daemon_release_shared_reply(shared_reply_t *reply);
+
+/**
+ * Drops the client's reply (owned or shared).
+ *
+ * @param[in] cli Structure with clients private data.
+ */
+void daemon_clear_reply(sup_client_t *cli);
+
+/**
+ * Sends as much of the client's reply as possible without blocking.
+ * Shared reply and its new line are sent by one sendmsg() call with two buffers.
+ *
+ * @param[in] cli Structure with clients private data.
+ * @return Returns 1 if the whole reply was sent, 0 if the rest has to wait for the socket to be writable, -1 in case of error.
+ */
+int daemon_send_reply(sup_client_t *cli);
+
+/**
+ * Disconnects clients of the server thread that have not sent the mode code or received the reply in time.
+ *
+ * @param[in] now Current monotonic time in ms.
+ */
+void daemon_check_clients_timeouts(const uint64_t now);
+
+/**
+ * Routine of a thread reloading the configuration requested by a client (server thread keeps serving other clients).
+ */
+void *daemon_reload_routine(void *arg);
+
+/**
+ * Parses names of modules following the subscribe mode code ("CODE name1 name2 ...") into the client's filter.
+ *
+ * @param[in] cli Structure with clients private data.
+ * @return Returns 0 if success, otherwise -1.
+ */
+int daemon_parse_subscriber_filter(sup_client_t *cli);
+
+/**
+ * Selects stats of modules from the filter.
+ *
+ * @param[in] modules_obj JSON object with stats of all modules (see make_json_modules_object()).
+ * @param[in] filter Names of modules to select.
+ * @param[in] filter_cnt Number of names in the filter, 0 ~ all modules.
+ * @return New reference to JSON object with the selected modules (it shares values with modules_obj), NULL in case of error.
+ */
+json_t *daemon_filter_modules(json_t *modules_obj, char **filter, const unsigned int filter_cnt);
+
+/**
+ * Dumps a record for subscribers to JSON terminated by a new line.
+ *
+ * @param[in] record_obj JSON value of the record.
+ * @return Allocated string with the record, NULL in case of error.
+ */
+char *daemon_dump_record(json_t *record_obj);
+
+/**
+ * Creates a record for subscribers - stats of modules (all of them or only those from the filter)
+ * in JSON terminated by a new line.
+ *
+ * @param[in] modules_obj JSON object with stats of all modules (see make_json_modules_object()).
+ * @param[in] filter Names of modules to include in the record.
+ * @param[in] filter_cnt Number of names in the filter, 0 ~ all modules.
+ * @return Allocated string with the record, NULL in case of error.
+ */
+char *daemon_make_record(json_t *modules_obj, char **filter, const unsigned int filter_cnt);
+
+/**
+ * Computes changes between two JSON values. Changed members of objects and elements of arrays (with the same size)
+ * are compared recursively, the changes of an array are an object with indexes of changed elements as keys.
+ * Removed members of objects are null. Other changed values are included as a whole.
+ *
+ * @param[in] old_value Value sent in the previous record (NULL if there was none).
+ * @param[in] new_value Current value.
+ * @return New reference to JSON value with changes, NULL if there is no change (or in case of error).
+ */
+json_t *daemon_json_diff(json_t *old_value, json_t *new_value);
+
+/**
+ * Creates a record for a client in delta subscribe mode. The record is a keyframe ({"version": N, "modules": {...}})
+ * if it is the first or every DAEMON_KEYFRAME_INTERVAL-th record of the client, otherwise it contains only changes
+ * since the last record sent to the client ({"version": N, "base": M, "modules": {changes}}).
+ *
+ * @param[in] cli Structure with clients private data.
+ * @param[in] modules_obj JSON object with stats of all modules (see make_json_modules_object()).
+ * @param[in] version Version of the new record.
+ * @return Allocated string with the record, NULL if nothing has changed since the last record or in case of error.
+ */
+char *daemon_make_delta_record(sup_client_t *cli, json_t *modules_obj, const uint64_t version);
+
+/**
+ * Starts sending a record to a subscribed client, the rest of the record is sent when the socket becomes writable.
+ * The client is disconnected in case of error.
+ *
+ * @param[in] cli Structure with clients private data.
+ * @param[in] record Record for the client (the client takes ownership of it), or NULL if shared record is sent.
+ * @param[in] shared_record Shared stats of all modules sent as a record (the client takes the reference), or NULL.
+ */
+void daemon_send_record(sup_client_t *cli, char *record, shared_reply_t *shared_record);
+
+/**
+ * Sends a new record to every subscribed client. A client that has not received the previous record yet skips this one.
+ * It can disconnect (and free) any subscribed client, so the server thread calls it after all events of a batch are processed.
+ */
+void daemon_send_records();
+
+/**
+ * Serves an event on a socket of a subscribed client (sends the rest of the record or detects disconnection).
+ *
+ * @param[in] cli Structure with clients private data.
+ * @param[in] events Events returned by epoll_wait().
+ */
+void daemon_serve_subscriber(sup_client_t *cli, const uint32_t events);
+
+/**
+ * Tells the server thread that a new record for subscribed clients is available (called by service thread).
+ */
+void daemon_notify_subscribers();
+
+/**
+ * Function sends options to a client during configuration mode (a menu with options the client can choose from - start or stop module etc.).
+ */
+void daemon_send_options_to_client();
+
+/**
+ * Function opens input and output streams for a new client.
+ *
+ * @param[in] cli Structure with clients private data.
+ * @return Returns 0 if success, otherwise -1.
+ */
+int daemon_open_client_streams(sup_client_t **cli);
+
+/**
+ * Function disconnects a client and makes needed clean up (closing streams etc.) and frees its structure.
+ *
+ * @param[in] cli Structure with clients private data.
+ */
+void daemon_disconnect_client(sup_client_t *cli);
+
+/**
+ * Daemons routine for serving a client in configuration mode (the client gets a thread doing this routine).
+ * This routine switches the client's socket to blocking mode, opens clients streams and serves options
+ * chosen by the client until it disconnects.
+ *
+ * @param[in] cli Structure with clients private data.
+ */
+void *daemon_serve_client_routine (void *cli);
+/**@}*/
+
+
+
+/**
+ * \defgroup metrics_functions Metrics exporter functions
+ *
+ * Optional HTTP endpoint (enabled by --metrics program parameter) serving metrics of modules in OpenMetrics
+ * text format for Prometheus. It listens on a unix or TCP socket and its clients are served by the daemon's
+ * server thread. Metrics are rendered from the modules snapshot and the response is cached until a new snapshot
+ * is published, so a scrape costs only sending of the cached response.
+ *
+ * @{
+ */
+
+/** Growing buffer used to render metrics. */
+typedef struct metrics_buffer_s {
+   char *data; ///< Rendered text (null-terminated)
+   size_t len; ///< Length of the text
+   size_t size; ///< Allocated size of data
+} metrics_buffer_t;
+
+/** Description of a metric family. */
+typedef struct metrics_family_s {
+   const char *name; ///< Name of the family (samples of counters have "_total" suffix)
+   const char *type; ///< "gauge" or "counter"
+   const char *help; ///< Description of the family
+} metrics_family_t;
+
+/**
+ * Opens listening socket of metrics exporter.
+ *
+ * @param[in] address Path of a unix socket (it must contain '/') or "[host:]port" of a TCP socket.
+ * @return Non-blocking listening socket, -1 in case of error.
+ */
+int metrics_open_socket(const char *address);
+
+/**
+ * Closes listening socket of metrics exporter (and removes the file of a unix socket).
+ */
+void metrics_close_socket();
+
+/**
+ * Makes sure the buffer has space for another needed bytes (plus terminating null byte).
+ *
+ * @param[in] buffer Buffer with rendered metrics.
+ * @param[in] needed Number of needed bytes.
+ * @return Returns 0 if success, otherwise -1.
+ */
+int metrics_reserve(metrics_buffer_t *buffer, const size_t needed);
+
+/**
+ * Appends formatted text to the buffer.
+ *
+ * @return Returns 0 if success, otherwise -1.
+ */
+int metrics_append(metrics_buffer_t *buffer, const char *format, ...);
+
+/**
+ * Appends a label value escaped according to OpenMetrics (backslash, double quote and new line are escaped).
+ *
+ * @return Returns 0 if success, otherwise -1.
+ */
+int metrics_append_label_value(metrics_buffer_t *buffer, const char *value);
+
+/**
+ * Renders metrics of all modules from the current snapshot.
+ *
+ * @param[out] version Version of the snapshot the metrics were rendered from.
+ * @return Allocated text in OpenMetrics format (terminated by "# EOF"), NULL in case of error.
+ */
+char *metrics_render(uint64_t *version);
+
+/**
+ * Creates the whole HTTP response with the current metrics.
+ *
+ * @param[out] version Version of the snapshot the metrics were rendered from.
+ * @return Allocated HTTP response, NULL in case of error.
+ */
+char *metrics_make_response(uint64_t *version);
+
+/**
+ * Receives available part of HTTP request from a client of metrics exporter without blocking.
+ *
+ * @param[in] cli Structure with clients private data.
+ * @return Returns 1 if the request header was received, 0 if it is not complete yet, otherwise negative value
+ * (-2 client disconnection, -1 another error).
+ */
+int metrics_get_request(sup_client_t *cli);
+
+/**
+ * Sends the cached metrics to the client if it requested "GET /metrics", otherwise it sends an error response.
+ *
+ * @param[in] cli Structure with clients private data.
+ */
+void metrics_serve_request(sup_client_t *cli);
 /**@}*/
 
 #endif
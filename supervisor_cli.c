@@ -142,6 +142,8 @@ int main(int argc, char **argv)
    int modules_stats_flag = FALSE;
    int modules_info_flag = FALSE;
    int reload_command_flag = FALSE;
+   int subscribe_flag = FALSE;
+   int delta_flag = FALSE;
    int flag_cnt = 0;
    char read_buffer[READ_BUFF_SIZE];
 
@@ -150,16 +152,19 @@ int main(int argc, char **argv)
    int file_path_len = 0;
 
    int opt;
-   while ((opt = getopt(argc, argv, "rhs:xi")) != -1) {
+   while ((opt = getopt(argc, argv, "rhs:xiwd")) != -1) {
       switch (opt) {
       case 'h':
-         printf("Usage:  supervisor_cli  [OPTIONAL]...\n"
+         printf("Usage:  supervisor_cli  [OPTIONAL]... [MODULE]...\n"
                   "   OPTIONAL parameters:\n"
                   "      [-h]   Prints this help.\n"
                   "      [-s <path>]   Path of the unix socket which is used for supervisor daemon and client communication.\n"
                   "      [-x]   Receives and prints statistics about modules and terminates.\n"
                   "      [-r]   Sends a command to supervisor to reload the configuration.\n"
-                  "      [-i]   Receives and prints information about modules in JSON and terminates.\n");
+                  "      [-i]   Receives and prints information about modules in JSON and terminates.\n"
+                  "      [-w]   Subscribes to statistics about modules and prints them as one line of JSON after every period of supervisor\n"
+                  "             until it is interrupted (only statistics of given MODULEs if there are any).\n"
+                  "      [-d]   With -w, receives periodic keyframes with all statistics and only changed values in between.\n");
          exit(EXIT_SUCCESS);
 
       case 's':
@@ -181,6 +186,15 @@ int main(int argc, char **argv)
          flag_cnt++;
          break;
 
+      case 'w':
+         subscribe_flag = TRUE;
+         flag_cnt++;
+         break;
+
+      case 'd':
+         delta_flag = TRUE;
+         break;
+
       default:
          fprintf(stderr, "[ERROR] Invalid program arguments! (try to run it with \"-h\" argument)\n");
          exit(EXIT_FAILURE);
@@ -188,7 +202,13 @@ int main(int argc, char **argv)
    }
 
    if (flag_cnt > 1) {
-      fprintf(stderr, "[ERROR] Cannot run client with more than one parameter {x, r, i} at the same time!\n");
+      fprintf(stderr, "[ERROR] Cannot run client with more than one parameter {x, r, i, w} at the same time!\n");
+      free_client_internals_variables();
+      exit(EXIT_FAILURE);
+   }
+
+   if ((optind < argc || delta_flag == TRUE) && subscribe_flag == FALSE) {
+      fprintf(stderr, "[ERROR] Names of modules and \"-d\" parameter can be given only with \"-w\" parameter!\n");
       free_client_internals_variables();
       exit(EXIT_FAILURE);
    }
@@ -234,6 +254,13 @@ int main(int argc, char **argv)
       fprintf(client_internals->supervisor_output_stream,"%d\n", CLIENT_STATS_MODE_CODE);
    } else if (modules_info_flag == TRUE) {
       fprintf(client_internals->supervisor_output_stream,"%d\n", CLIENT_INFO_MODE_CODE);
+   } else if (subscribe_flag == TRUE) {
+      // Names of modules are sent on the same line as the code
+      fprintf(client_internals->supervisor_output_stream,"%d", (delta_flag == TRUE ? CLIENT_DELTA_SUBSCRIBE_MODE_CODE : CLIENT_SUBSCRIBE_MODE_CODE));
+      for (x = optind; x < argc; x++) {
+         fprintf(client_internals->supervisor_output_stream," %s", argv[x]);
+      }
+      fprintf(client_internals->supervisor_output_stream,"\n");
    } else if (reload_command_flag == TRUE) {
       fprintf(client_internals->supervisor_output_stream,"%d\n", CLIENT_RELOAD_MODE_CODE);
       fflush(client_internals->supervisor_output_stream);
@@ -248,7 +275,10 @@ int main(int argc, char **argv)
    while (client_internals->connected) {
       FD_ZERO(&read_fds);
       FD_SET(client_internals->supervisor_input_stream_fd, &read_fds);
-      FD_SET(0, &read_fds);
+      // Subscribed client only prints records, it does not need any input
+      if (subscribe_flag == FALSE) {
+         FD_SET(0, &read_fds);
+      }
 
       tv.tv_sec = 0;
       tv.tv_usec = 200000;
@@ -283,7 +313,7 @@ int main(int argc, char **argv)
             usleep(200000);
             bytes_to_read = read(client_internals->supervisor_input_stream_fd, read_buffer, READ_BUFF_SIZE);
             if (bytes_to_read == 0 || bytes_to_read == -1) {
-               if (modules_stats_flag != TRUE && modules_info_flag != TRUE) {
+               if (modules_stats_flag != TRUE && modules_info_flag != TRUE && subscribe_flag != TRUE) {
                   fprintf(stderr, FORMAT_WARNING "[WARNING] Supervisor has disconnected, I'm done!" FORMAT_RESET "\n");
                   fflush(stderr);
                }